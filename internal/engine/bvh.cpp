@@ -0,0 +1,505 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define BVH_USE_SSE
+#include <emmintrin.h>
+#endif
+
+#include "bvh.hpp"
+
+namespace
+{
+constexpr uint32_t s_emptyChild = UINT32_MAX;
+
+/**
+ * @brief depth after which the nodes are split at the median instead of with the surface area heuristic, keeps the
+ * traversal stack bounded
+ *
+ */
+constexpr uint32_t s_maxSahDepth = 32u;
+constexpr uint32_t s_maxStackSize = 256u;
+
+struct Bounds
+{
+    glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 max = glm::vec3(std::numeric_limits<float>::lowest());
+
+    void grow(const glm::vec3 &point)
+    {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+    void grow(const Bounds &other)
+    {
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+    [[nodiscard]] float area() const
+    {
+        glm::vec3 e = max - min;
+        if (e.x < 0.f)
+            return 0.f;
+        return 2.f * (e.x * e.y + e.y * e.z + e.z * e.x);
+    }
+};
+
+struct Range
+{
+    uint32_t begin;
+    uint32_t end;
+    Bounds bounds;
+
+    [[nodiscard]] uint32_t count() const
+    {
+        return end - begin;
+    }
+};
+
+struct BuildContext
+{
+    std::vector<Bounds> triangleBounds;
+    std::vector<glm::vec3> centroids;
+    std::vector<uint32_t> &order;
+    uint32_t maxLeafSize;
+    uint32_t binCount;
+};
+
+Bounds computeBounds(const BuildContext &ctx, uint32_t begin, uint32_t end)
+{
+    Bounds b;
+    for (uint32_t i = begin; i < end; ++i)
+        b.grow(ctx.triangleBounds[ctx.order[i]]);
+    return b;
+}
+
+/**
+ * @brief split a range in two, with the surface area heuristic or at the median of the longest axis
+ *
+ */
+std::pair<Range, Range> splitRange(BuildContext &ctx, const Range &range, uint32_t depth)
+{
+    Bounds centroidBounds;
+    for (uint32_t i = range.begin; i < range.end; ++i)
+        centroidBounds.grow(ctx.centroids[ctx.order[i]]);
+    glm::vec3 extent = centroidBounds.max - centroidBounds.min;
+
+    uint32_t mid = range.begin;
+
+    if (depth < s_maxSahDepth)
+    {
+        struct Bin
+        {
+            Bounds bounds;
+            uint32_t count = 0u;
+        };
+        std::vector<Bin> bins(ctx.binCount);
+        std::vector<float> rightCosts(ctx.binCount);
+
+        float bestCost = std::numeric_limits<float>::max();
+        int bestAxis = -1;
+        uint32_t bestBin = 0u;
+
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            if (extent[axis] <= 0.f)
+                continue;
+
+            std::fill(bins.begin(), bins.end(), Bin{});
+            float scale = static_cast<float>(ctx.binCount) / extent[axis];
+            for (uint32_t i = range.begin; i < range.end; ++i)
+            {
+                uint32_t t = ctx.order[i];
+                float offset = ctx.centroids[t][axis] - centroidBounds.min[axis];
+                uint32_t b = std::min(ctx.binCount - 1u, static_cast<uint32_t>(offset * scale));
+                bins[b].bounds.grow(ctx.triangleBounds[t]);
+                bins[b].count++;
+            }
+
+            // sweep from the right to get the cost of every right side, then from the left
+            Bounds right;
+            uint32_t rightCount = 0u;
+            for (uint32_t b = ctx.binCount - 1u; b > 0u; --b)
+            {
+                right.grow(bins[b].bounds);
+                rightCount += bins[b].count;
+                rightCosts[b] = right.area() * static_cast<float>(rightCount);
+            }
+            Bounds left;
+            uint32_t leftCount = 0u;
+            for (uint32_t b = 0u; b < ctx.binCount - 1u; ++b)
+            {
+                left.grow(bins[b].bounds);
+                leftCount += bins[b].count;
+                float cost = left.area() * static_cast<float>(leftCount) + rightCosts[b + 1u];
+                if (leftCount > 0u && leftCount < range.count() && cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestBin = b;
+                }
+            }
+        }
+
+        if (bestAxis >= 0)
+        {
+            float scale = static_cast<float>(ctx.binCount) / extent[bestAxis];
+            auto it = std::partition(ctx.order.begin() + range.begin, ctx.order.begin() + range.end, [&](uint32_t t) {
+                uint32_t b = std::min(
+                    ctx.binCount - 1u,
+                    static_cast<uint32_t>((ctx.centroids[t][bestAxis] - centroidBounds.min[bestAxis]) * scale));
+                return b <= bestBin;
+            });
+            mid = static_cast<uint32_t>(it - ctx.order.begin());
+        }
+    }
+
+    // no split found (coincident centroids) or too deep : object median
+    if (mid == range.begin || mid == range.end)
+    {
+        int axis = 0;
+        if (extent.y > extent[axis])
+            axis = 1;
+        if (extent.z > extent[axis])
+            axis = 2;
+
+        mid = range.begin + range.count() / 2u;
+        std::nth_element(ctx.order.begin() + range.begin, ctx.order.begin() + mid, ctx.order.begin() + range.end,
+                         [&](uint32_t a, uint32_t b) { return ctx.centroids[a][axis] < ctx.centroids[b][axis]; });
+    }
+
+    Range left = {range.begin, mid, computeBounds(ctx, range.begin, mid)};
+    Range right = {mid, range.end, computeBounds(ctx, mid, range.end)};
+    return {left, right};
+}
+
+/**
+ * @brief split the range in up to 4 children, the largest child is split until there are 4 of them
+ *
+ */
+uint32_t buildNode(BuildContext &ctx, std::vector<BVH::Node> &nodes, const Range &range, uint32_t depth)
+{
+    std::vector<Range> children = {range};
+    while (children.size() < BVH::s_width)
+    {
+        int largest = -1;
+        for (int i = 0; i < static_cast<int>(children.size()); ++i)
+        {
+            if (children[i].count() <= ctx.maxLeafSize)
+                continue;
+            if (largest < 0 || children[i].bounds.area() > children[largest].bounds.area())
+                largest = i;
+        }
+        if (largest < 0)
+            break;
+
+        auto [left, right] = splitRange(ctx, children[largest], depth);
+        children[largest] = left;
+        children.push_back(right);
+    }
+
+    uint32_t nodeIndex = static_cast<uint32_t>(nodes.size());
+    nodes.emplace_back();
+
+    for (uint32_t i = 0u; i < BVH::s_width; ++i)
+    {
+        uint32_t child = s_emptyChild;
+        uint32_t triangleCount = 0u;
+        Bounds bounds;
+
+        if (i < children.size())
+        {
+            bounds = children[i].bounds;
+            if (children[i].count() <= ctx.maxLeafSize)
+            {
+                child = children[i].begin;
+                triangleCount = children[i].count();
+            }
+            else
+            {
+                child = buildNode(ctx, nodes, children[i], depth + 1u);
+            }
+        }
+
+        // nodes may have been reallocated by the recursion
+        BVH::Node &node = nodes[nodeIndex];
+        node.minX[i] = bounds.min.x;
+        node.minY[i] = bounds.min.y;
+        node.minZ[i] = bounds.min.z;
+        node.maxX[i] = bounds.max.x;
+        node.maxY[i] = bounds.max.y;
+        node.maxZ[i] = bounds.max.z;
+        node.child[i] = child;
+        node.triangleCount[i] = triangleCount;
+    }
+
+    return nodeIndex;
+}
+
+} // namespace
+
+uint32_t BVH::intersectChildren(const Node &node, const glm::vec3 &origin, const glm::vec3 &invDirection, float tMin,
+                                float tMax, float distances[s_width]) const
+{
+    uint32_t mask = 0u;
+
+#ifdef BVH_USE_SSE
+    const __m128 ox = _mm_set1_ps(origin.x);
+    const __m128 oy = _mm_set1_ps(origin.y);
+    const __m128 oz = _mm_set1_ps(origin.z);
+    const __m128 ix = _mm_set1_ps(invDirection.x);
+    const __m128 iy = _mm_set1_ps(invDirection.y);
+    const __m128 iz = _mm_set1_ps(invDirection.z);
+
+    __m128 t1x = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minX), ox), ix);
+    __m128 t2x = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxX), ox), ix);
+    __m128 t1y = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minY), oy), iy);
+    __m128 t2y = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxY), oy), iy);
+    __m128 t1z = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minZ), oz), iz);
+    __m128 t2z = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxZ), oz), iz);
+
+    __m128 tNear = _mm_max_ps(_mm_max_ps(_mm_min_ps(t1x, t2x), _mm_min_ps(t1y, t2y)),
+                              _mm_max_ps(_mm_min_ps(t1z, t2z), _mm_set1_ps(tMin)));
+    __m128 tFar = _mm_min_ps(_mm_min_ps(_mm_max_ps(t1x, t2x), _mm_max_ps(t1y, t2y)),
+                             _mm_min_ps(_mm_max_ps(t1z, t2z), _mm_set1_ps(tMax)));
+
+    mask = static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(tNear, tFar)));
+    _mm_storeu_ps(distances, tNear);
+#else
+    for (uint32_t i = 0u; i < s_width; ++i)
+    {
+        float t1x = (node.minX[i] - origin.x) * invDirection.x;
+        float t2x = (node.maxX[i] - origin.x) * invDirection.x;
+        float t1y = (node.minY[i] - origin.y) * invDirection.y;
+        float t2y = (node.maxY[i] - origin.y) * invDirection.y;
+        float t1z = (node.minZ[i] - origin.z) * invDirection.z;
+        float t2z = (node.maxZ[i] - origin.z) * invDirection.z;
+
+        float tNear = std::max({std::min(t1x, t2x), std::min(t1y, t2y), std::min(t1z, t2z), tMin});
+        float tFar = std::min({std::max(t1x, t2x), std::max(t1y, t2y), std::max(t1z, t2z), tMax});
+
+        distances[i] = tNear;
+        if (tNear <= tFar)
+            mask |= 1u << i;
+    }
+#endif
+
+    // the slab test does not reject the inverted boxes of the empty slots
+    for (uint32_t i = 0u; i < s_width; ++i)
+    {
+        if (node.child[i] == s_emptyChild)
+            mask &= ~(1u << i);
+    }
+
+    return mask;
+}
+
+bool BVH::intersectTriangle(uint32_t triangle, const Ray &ray, float tMax, Hit &hit) const
+{
+    // Moller-Trumbore
+    const glm::vec3 &v0 = m_vertices[triangle * 3u + 0u];
+    const glm::vec3 e1 = m_vertices[triangle * 3u + 1u] - v0;
+    const glm::vec3 e2 = m_vertices[triangle * 3u + 2u] - v0;
+
+    glm::vec3 p = glm::cross(ray.direction, e2);
+    float det = glm::dot(e1, p);
+    if (std::abs(det) < 1e-12f)
+        return false;
+
+    float invDet = 1.f / det;
+    glm::vec3 s = ray.origin - v0;
+    float u = glm::dot(s, p) * invDet;
+    if (u < 0.f || u > 1.f)
+        return false;
+
+    glm::vec3 q = glm::cross(s, e1);
+    float v = glm::dot(ray.direction, q) * invDet;
+    if (v < 0.f || u + v > 1.f)
+        return false;
+
+    float t = glm::dot(e2, q) * invDet;
+    if (t < ray.tMin || t > tMax)
+        return false;
+
+    hit.t = t;
+    hit.triangle = triangle;
+    hit.u = u;
+    hit.v = v;
+    return true;
+}
+
+template <bool AnyHit> bool BVH::traverse(const Ray &ray, Hit &hit) const
+{
+    if (m_nodes.empty())
+        return false;
+
+    // avoid the infinities of the axis aligned directions turning into NaNs in the slab test
+    auto safeInverse = [](float d) { return 1.f / (std::abs(d) > 1e-20f ? d : std::copysign(1e-20f, d)); };
+    const glm::vec3 invDirection =
+        glm::vec3(safeInverse(ray.direction.x), safeInverse(ray.direction.y), safeInverse(ray.direction.z));
+
+    struct StackEntry
+    {
+        uint32_t node;
+        float distance;
+    };
+    std::array<StackEntry, s_maxStackSize> stack;
+    uint32_t stackSize = 0u;
+    stack[stackSize++] = {0u, ray.tMin};
+
+    bool found = false;
+    float tMax = ray.tMax;
+
+    while (stackSize > 0u)
+    {
+        StackEntry entry = stack[--stackSize];
+        if (entry.distance > tMax)
+            continue;
+
+        const Node &node = m_nodes[entry.node];
+        alignas(16) float distances[s_width];
+        uint32_t mask = intersectChildren(node, ray.origin, invDirection, ray.tMin, tMax, distances);
+
+        // inner children are pushed farthest first so that the nearest one is visited next
+        StackEntry inner[s_width];
+        uint32_t innerCount = 0u;
+
+        for (uint32_t i = 0u; i < s_width; ++i)
+        {
+            if ((mask & (1u << i)) == 0u)
+                continue;
+
+            if (node.triangleCount[i] == 0u)
+            {
+                inner[innerCount++] = {node.child[i], distances[i]};
+                continue;
+            }
+
+            for (uint32_t j = 0u; j < node.triangleCount[i]; ++j)
+            {
+                if (intersectTriangle(m_triangleIndices[node.child[i] + j], ray, tMax, hit))
+                {
+                    if constexpr (AnyHit)
+                        return true;
+                    found = true;
+                    tMax = hit.t;
+                }
+            }
+        }
+
+        for (uint32_t i = 1u; i < innerCount; ++i)
+        {
+            for (uint32_t j = i; j > 0u && inner[j - 1u].distance < inner[j].distance; --j)
+                std::swap(inner[j - 1u], inner[j]);
+        }
+        for (uint32_t i = 0u; i < innerCount; ++i)
+            stack[stackSize++] = inner[i];
+    }
+
+    return found;
+}
+
+bool BVH::intersect(const Ray &ray, Hit &hit) const
+{
+    return traverse<false>(ray, hit);
+}
+
+bool BVH::occluded(const Ray &ray) const
+{
+    Hit hit;
+    return traverse<true>(ray, hit);
+}
+
+uint32_t BVH::countTrianglesInBox(const glm::vec3 &boxMin, const glm::vec3 &boxMax) const
+{
+    if (m_nodes.empty())
+        return 0u;
+
+    std::array<uint32_t, s_maxStackSize> stack;
+    uint32_t stackSize = 0u;
+    stack[stackSize++] = 0u;
+
+    uint32_t count = 0u;
+    while (stackSize > 0u)
+    {
+        const Node &node = m_nodes[stack[--stackSize]];
+        for (uint32_t i = 0u; i < s_width; ++i)
+        {
+            if (node.child[i] == s_emptyChild || node.minX[i] > boxMax.x || node.maxX[i] < boxMin.x ||
+                node.minY[i] > boxMax.y || node.maxY[i] < boxMin.y || node.minZ[i] > boxMax.z ||
+                node.maxZ[i] < boxMin.z)
+                continue;
+
+            if (node.triangleCount[i] == 0u)
+            {
+                stack[stackSize++] = node.child[i];
+                continue;
+            }
+
+            for (uint32_t j = 0u; j < node.triangleCount[i]; ++j)
+            {
+                const glm::vec3 *vertices = &m_vertices[m_triangleIndices[node.child[i] + j] * 3u];
+                const glm::vec3 triangleMin = glm::min(vertices[0], glm::min(vertices[1], vertices[2]));
+                const glm::vec3 triangleMax = glm::max(vertices[0], glm::max(vertices[1], vertices[2]));
+                if (glm::all(glm::lessThanEqual(triangleMin, boxMax)) &&
+                    glm::all(glm::greaterThanEqual(triangleMax, boxMin)))
+                    count++;
+            }
+        }
+    }
+
+    return count;
+}
+
+const glm::vec3 &BVH::getHitVertex(const Hit &hit, uint32_t vertex) const
+{
+    return m_vertices[hit.triangle * 3u + vertex];
+}
+
+void BVHBuilder::addTriangles(const std::vector<Vertex> &vertices, const std::vector<uint16_t> &indices,
+                              const glm::mat4 &transform)
+{
+    m_vertices.reserve(m_vertices.size() + indices.size());
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        for (size_t j = 0; j < 3; ++j)
+            m_vertices.push_back(glm::vec3(transform * glm::vec4(vertices[indices[i + j]].position, 1.f)));
+    }
+}
+
+std::unique_ptr<BVH> BVHBuilder::build()
+{
+    BVH &bvh = *m_product;
+    bvh.m_vertices = std::move(m_vertices);
+
+    uint32_t triangleCount = static_cast<uint32_t>(bvh.m_vertices.size() / 3u);
+    bvh.m_triangleIndices.resize(triangleCount);
+    for (uint32_t i = 0u; i < triangleCount; ++i)
+        bvh.m_triangleIndices[i] = i;
+
+    if (triangleCount > 0u)
+    {
+        BuildContext ctx = {
+            .triangleBounds = std::vector<Bounds>(triangleCount),
+            .centroids = std::vector<glm::vec3>(triangleCount),
+            .order = bvh.m_triangleIndices,
+            .maxLeafSize = std::max(m_maxLeafSize, 1u),
+            .binCount = std::max(m_binCount, 2u),
+        };
+        for (uint32_t i = 0u; i < triangleCount; ++i)
+        {
+            for (uint32_t j = 0u; j < 3u; ++j)
+                ctx.triangleBounds[i].grow(bvh.m_vertices[i * 3u + j]);
+            ctx.centroids[i] = (ctx.triangleBounds[i].min + ctx.triangleBounds[i].max) * 0.5f;
+        }
+
+        Range root = {0u, triangleCount, computeBounds(ctx, 0u, triangleCount)};
+        buildNode(ctx, bvh.m_nodes, root, 0u);
+    }
+
+    auto result = std::move(m_product);
+    restart();
+    return result;
+}
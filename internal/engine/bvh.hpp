@@ -0,0 +1,178 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "vertex.hpp"
+
+class BVHBuilder;
+
+/**
+ * @brief bounding volume hierarchy over triangles, used to trace rays on the CPU
+ * built as a binary tree with the surface area heuristic, then collapsed into nodes of 4 children whose boxes are
+ * tested together (SSE when available)
+ * the queries are const and can be made from several threads at once
+ *
+ */
+class BVH
+{
+    friend BVHBuilder;
+
+  public:
+    static constexpr uint32_t s_width = 4u;
+
+    struct Ray
+    {
+        glm::vec3 origin;
+        glm::vec3 direction;
+        float tMin = 0.f;
+        float tMax = 1e30f;
+    };
+
+    struct Hit
+    {
+        float t = 1e30f;
+        /**
+         * @brief index of the triangle in the order they were added to the builder
+         *
+         */
+        uint32_t triangle = UINT32_MAX;
+        float u = 0.f;
+        float v = 0.f;
+    };
+
+    /**
+     * @brief the boxes of the children are stored plane by plane so that the 4 of them are tested at once
+     *
+     */
+    struct alignas(16) Node
+    {
+        float minX[s_width];
+        float minY[s_width];
+        float minZ[s_width];
+        float maxX[s_width];
+        float maxY[s_width];
+        float maxZ[s_width];
+        /**
+         * @brief node index of an inner child, first triangle of a leaf child
+         *
+         */
+        uint32_t child[s_width];
+        /**
+         * @brief triangle count of a leaf child, 0 for an inner child or an empty slot
+         *
+         */
+        uint32_t triangleCount[s_width];
+    };
+
+  private:
+    std::vector<Node> m_nodes;
+
+    /**
+     * @brief three vertices per triangle, in the order they were added
+     *
+     */
+    std::vector<glm::vec3> m_vertices;
+    /**
+     * @brief triangles sorted by leaf
+     *
+     */
+    std::vector<uint32_t> m_triangleIndices;
+
+    BVH() = default;
+
+    /**
+     * @brief nearest child boxes hit by the ray
+     *
+     * @return bit mask of the children hit
+     */
+    [[nodiscard]] uint32_t intersectChildren(const Node &node, const glm::vec3 &origin, const glm::vec3 &invDirection,
+                                             float tMin, float tMax, float distances[s_width]) const;
+    [[nodiscard]] bool intersectTriangle(uint32_t triangle, const Ray &ray, float tMax, Hit &hit) const;
+
+    template <bool AnyHit> bool traverse(const Ray &ray, Hit &hit) const;
+
+  public:
+    BVH(const BVH &) = delete;
+    BVH &operator=(const BVH &) = delete;
+    BVH(BVH &&) = delete;
+    BVH &operator=(BVH &&) = delete;
+
+    /**
+     * @brief closest intersection between tMin and tMax
+     *
+     * @return true if a triangle was hit
+     */
+    [[nodiscard]] bool intersect(const Ray &ray, Hit &hit) const;
+    /**
+     * @brief any intersection between tMin and tMax, for shadow rays
+     *
+     */
+    [[nodiscard]] bool occluded(const Ray &ray) const;
+    /**
+     * @brief number of triangles whose bounding box overlaps the given box
+     *
+     */
+    [[nodiscard]] uint32_t countTrianglesInBox(const glm::vec3 &boxMin, const glm::vec3 &boxMax) const;
+
+  public:
+    [[nodiscard]] inline uint32_t getTriangleCount() const
+    {
+        return static_cast<uint32_t>(m_triangleIndices.size());
+    }
+    [[nodiscard]] inline uint32_t getNodeCount() const
+    {
+        return static_cast<uint32_t>(m_nodes.size());
+    }
+    /**
+     * @brief vertex of a triangle hit, in world space
+     *
+     */
+    [[nodiscard]] const glm::vec3 &getHitVertex(const Hit &hit, uint32_t vertex) const;
+};
+
+class BVHBuilder
+{
+  private:
+    std::unique_ptr<BVH> m_product;
+
+    std::vector<glm::vec3> m_vertices;
+    uint32_t m_maxLeafSize = 4u;
+    uint32_t m_binCount = 16u;
+
+    void restart()
+    {
+        m_product = std::unique_ptr<BVH>(new BVH);
+        m_vertices.clear();
+    }
+
+  public:
+    BVHBuilder()
+    {
+        restart();
+    }
+
+    /**
+     * @brief add the triangles of an indexed mesh, transformed to world space
+     *
+     */
+    void addTriangles(const std::vector<Vertex> &vertices, const std::vector<uint16_t> &indices,
+                      const glm::mat4 &transform);
+    void setMaxLeafSize(uint32_t size)
+    {
+        m_maxLeafSize = size;
+    }
+    /**
+     * @brief number of candidate splits per axis evaluated with the surface area heuristic
+     *
+     */
+    void setBinCount(uint32_t count)
+    {
+        m_binCount = count;
+    }
+
+    std::unique_ptr<BVH> build();
+};
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * @brief DirectDraw Surface container layout
+ * only the subset used for block-compressed 2D textures with mips is described here
+ * https://learn.microsoft.com/en-us/windows/win32/direct3ddds/dx-graphics-dds-pguide
+ *
+ */
+
+constexpr uint32_t DDS_MAGIC = 0x20534444; // "DDS "
+
+constexpr uint32_t makeFourCC(char a, char b, char c, char d)
+{
+    return (uint32_t)a | ((uint32_t)b << 8) | ((uint32_t)c << 16) | ((uint32_t)d << 24);
+}
+
+constexpr uint32_t DDSD_CAPS = 0x1;
+constexpr uint32_t DDSD_HEIGHT = 0x2;
+constexpr uint32_t DDSD_WIDTH = 0x4;
+constexpr uint32_t DDSD_PIXELFORMAT = 0x1000;
+constexpr uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+constexpr uint32_t DDSD_LINEARSIZE = 0x80000;
+
+constexpr uint32_t DDPF_FOURCC = 0x4;
+
+constexpr uint32_t DDSCAPS_COMPLEX = 0x8;
+constexpr uint32_t DDSCAPS_TEXTURE = 0x1000;
+constexpr uint32_t DDSCAPS_MIPMAP = 0x400000;
+
+constexpr uint32_t DDS_DIMENSION_TEXTURE2D = 3;
+
+enum class DXGIFormat : uint32_t
+{
+    UNKNOWN = 0,
+    BC1_UNORM = 71,
+    BC1_UNORM_SRGB = 72,
+    BC5_UNORM = 83,
+    BC7_UNORM = 98,
+    BC7_UNORM_SRGB = 99,
+};
+
+struct DDSPixelFormat
+{
+    uint32_t size;
+    uint32_t flags;
+    uint32_t fourCC;
+    uint32_t RGBBitCount;
+    uint32_t RBitMask;
+    uint32_t GBitMask;
+    uint32_t BBitMask;
+    uint32_t ABitMask;
+};
+
+struct DDSHeader
+{
+    uint32_t size;
+    uint32_t flags;
+    uint32_t height;
+    uint32_t width;
+    uint32_t pitchOrLinearSize;
+    uint32_t depth;
+    uint32_t mipMapCount;
+    uint32_t reserved1[11];
+    DDSPixelFormat pixelFormat;
+    uint32_t caps;
+    uint32_t caps2;
+    uint32_t caps3;
+    uint32_t caps4;
+    uint32_t reserved2;
+};
+
+struct DDSHeaderDXT10
+{
+    DXGIFormat dxgiFormat;
+    uint32_t resourceDimension;
+    uint32_t miscFlag;
+    uint32_t arraySize;
+    uint32_t miscFlags2;
+};
+
+static_assert(sizeof(DDSPixelFormat) == 32);
+static_assert(sizeof(DDSHeader) == 124);
+static_assert(sizeof(DDSHeaderDXT10) == 20);
+
+/**
+ * @brief size in bytes of a 4x4 block for the given format, 0 if the format is not block-compressed
+ *
+ */
+constexpr uint32_t getDXGIFormatBlockSize(DXGIFormat format)
+{
+    switch (format)
+    {
+    case DXGIFormat::BC1_UNORM:
+    case DXGIFormat::BC1_UNORM_SRGB:
+        return 8;
+    case DXGIFormat::BC5_UNORM:
+    case DXGIFormat::BC7_UNORM:
+    case DXGIFormat::BC7_UNORM_SRGB:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+/**
+ * @brief size in bytes of one mip level of the given extent
+ *
+ */
+constexpr uint64_t getDXGIFormatLevelSize(DXGIFormat format, uint32_t width, uint32_t height)
+{
+    const uint64_t blockCountX = (width + 3) / 4;
+    const uint64_t blockCountY = (height + 3) / 4;
+    return blockCountX * blockCountY * getDXGIFormatBlockSize(format);
+}
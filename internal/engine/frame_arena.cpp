@@ -0,0 +1,62 @@
+#include <algorithm>
+#include <cassert>
+
+#include "frame_arena.hpp"
+
+FrameArena::FrameArena(uint32_t regionCount, size_t regionCapacity) : m_regionCount(std::max(regionCount, 1u))
+{
+    // every region starts on the alignment of the heap
+    constexpr size_t regionAlignment = alignof(std::max_align_t);
+    m_regionCapacity = (regionCapacity + regionAlignment - 1u) & ~(regionAlignment - 1u);
+    m_memory = std::make_unique<std::byte[]>(m_regionCapacity * m_regionCount);
+
+    m_currentStatistics.capacity = m_regionCapacity;
+    m_lastFrameStatistics.capacity = m_regionCapacity;
+}
+
+void *FrameArena::do_allocate(size_t bytes, size_t alignment)
+{
+    m_currentStatistics.allocationCount++;
+
+    const size_t offset = (m_head + alignment - 1u) & ~(alignment - 1u);
+    if (alignment > alignof(std::max_align_t) || offset + bytes > m_regionCapacity)
+    {
+        m_currentStatistics.overflowCount++;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    m_head = offset + bytes;
+    m_currentStatistics.allocatedBytes = m_head;
+    m_peakAllocatedBytes = std::max(m_peakAllocatedBytes, m_head);
+    return m_memory.get() + m_regionIndex * m_regionCapacity + offset;
+}
+
+void FrameArena::do_deallocate(void *p, size_t bytes, size_t alignment)
+{
+    std::byte *ptr = static_cast<std::byte *>(p);
+    std::byte *memoryEnd = m_memory.get() + m_regionCapacity * m_regionCount;
+    if (ptr < m_memory.get() || ptr >= memoryEnd)
+    {
+        std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+        return;
+    }
+
+    // the last allocation is given back, a growing container reuses its space
+    std::byte *region = m_memory.get() + m_regionIndex * m_regionCapacity;
+    if (ptr + bytes == region + m_head)
+        m_head -= bytes;
+}
+
+bool FrameArena::do_is_equal(const std::pmr::memory_resource &other) const noexcept
+{
+    return this == &other;
+}
+
+void FrameArena::beginFrame()
+{
+    m_lastFrameStatistics = m_currentStatistics;
+    m_currentStatistics = Statistics{.capacity = m_regionCapacity};
+
+    m_regionIndex = (m_regionIndex + 1u) % m_regionCount;
+    m_head = 0u;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+/**
+ * @brief linear allocator for the temporary containers of the frame loop, the CPU counterpart of the FrameAllocator
+ * one region per frame in flight, the allocations of a frame stay valid until its region is used again
+ * an allocation that does not fit in the region is made on the heap and counted as an overflow
+ * used by the main thread only
+ *
+ */
+class FrameArena : public std::pmr::memory_resource
+{
+  public:
+    struct Statistics
+    {
+        uint32_t allocationCount = 0u;
+        /**
+         * @brief allocations that did not fit in the region
+         *
+         */
+        uint32_t overflowCount = 0u;
+        size_t allocatedBytes = 0u;
+        size_t capacity = 0u;
+    };
+
+  private:
+    std::unique_ptr<std::byte[]> m_memory;
+    size_t m_regionCapacity;
+    uint32_t m_regionCount;
+
+    uint32_t m_regionIndex = 0u;
+    size_t m_head = 0u;
+
+    Statistics m_currentStatistics;
+    Statistics m_lastFrameStatistics;
+    size_t m_peakAllocatedBytes = 0u;
+
+    void *do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void *p, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override;
+
+  public:
+    /**
+     * @brief
+     *
+     * @param regionCount number of frames in flight
+     * @param regionCapacity bytes available to a frame
+     */
+    FrameArena(uint32_t regionCount, size_t regionCapacity);
+
+    FrameArena(const FrameArena &) = delete;
+    FrameArena &operator=(const FrameArena &) = delete;
+    FrameArena(FrameArena &&) = delete;
+    FrameArena &operator=(FrameArena &&) = delete;
+
+    /**
+     * @brief move on to the region of the next frame, the allocations made in it two frames ago are released
+     *
+     */
+    void beginFrame();
+
+    template <typename T> [[nodiscard]] std::pmr::vector<T> makeVector(size_t capacity = 0u)
+    {
+        std::pmr::vector<T> vector(this);
+        vector.reserve(capacity);
+        return vector;
+    }
+
+  public:
+    [[nodiscard]] inline const Statistics &getLastFrameStatistics() const
+    {
+        return m_lastFrameStatistics;
+    }
+    [[nodiscard]] inline size_t getPeakAllocatedBytes() const
+    {
+        return m_peakAllocatedBytes;
+    }
+};
@@ -0,0 +1,3 @@
+#include "heap_counter.hpp"
+
+std::atomic<uint64_t> HeapCounter::s_allocationCount = 0u;
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * @brief number of allocations made on the general heap, counted by the global operator new of the executable
+ *
+ */
+class HeapCounter
+{
+  private:
+    static std::atomic<uint64_t> s_allocationCount;
+
+  public:
+    static inline void recordAllocation()
+    {
+        s_allocationCount.fetch_add(1u, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] static inline uint64_t getAllocationCount()
+    {
+        return s_allocationCount.load(std::memory_order_relaxed);
+    }
+};
@@ -0,0 +1,165 @@
+#include <algorithm>
+
+#include "job_system.hpp"
+
+namespace
+{
+/**
+ * @brief queue of the calling thread if it is a worker of this job system
+ *
+ */
+thread_local const JobSystem *t_owner = nullptr;
+thread_local uint32_t t_queueIndex = 0u;
+} // namespace
+
+JobSystem::JobSystem(uint32_t workerCount)
+{
+    m_queues.reserve(workerCount + 1u);
+    for (uint32_t i = 0u; i < workerCount + 1u; ++i)
+        m_queues.push_back(std::make_unique<JobQueue>());
+
+    m_workers.reserve(workerCount);
+    for (uint32_t i = 0u; i < workerCount; ++i)
+        m_workers.emplace_back(&JobSystem::workerLoop, this, i + 1u);
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_stop = true;
+    }
+    m_wakeCondition.notify_all();
+
+    for (std::thread &worker : m_workers)
+        worker.join();
+}
+
+void JobSystem::workerLoop(uint32_t queueIndex)
+{
+    t_owner = this;
+    t_queueIndex = queueIndex;
+
+    while (true)
+    {
+        if (runQueuedJob())
+            continue;
+
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_wakeCondition.wait(lock, [this]() { return m_stop || m_queuedCount.load() > 0u; });
+        if (m_stop && m_queuedCount.load() == 0u)
+            return;
+    }
+}
+
+bool JobSystem::runQueuedJob()
+{
+    if (m_queuedCount.load() == 0u)
+        return false;
+
+    const uint32_t ownQueueIndex = t_owner == this ? t_queueIndex : 0u;
+    const uint32_t queueCount = static_cast<uint32_t>(m_queues.size());
+
+    QueuedJob job;
+    bool found = false;
+    bool stolen = false;
+    for (uint32_t i = 0u; i < queueCount && !found; ++i)
+    {
+        JobQueue &queue = *m_queues[(ownQueueIndex + i) % queueCount];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.count == 0u)
+            continue;
+
+        // the newest job of its own queue is the most likely to be in cache, the oldest job of another queue is the
+        // most likely to spawn more work
+        if (i == 0u)
+        {
+            job = std::move(queue.jobs[(queue.first + queue.count - 1u) % s_queueCapacity]);
+        }
+        else
+        {
+            job = std::move(queue.jobs[queue.first]);
+            queue.first = (queue.first + 1u) % s_queueCapacity;
+            stolen = true;
+        }
+        queue.count--;
+        found = true;
+    }
+    if (!found)
+        return false;
+
+    m_queuedCount.fetch_sub(1u);
+
+    job.function();
+
+    m_jobCount.fetch_add(1u, std::memory_order_relaxed);
+    if (stolen)
+        m_stolenCount.fetch_add(1u, std::memory_order_relaxed);
+    job.group->m_pendingCount.fetch_sub(1u, std::memory_order_release);
+    return true;
+}
+
+void JobSystem::submit(Group &group, Job function)
+{
+    {
+        JobQueue &queue = *m_queues[t_owner == this ? t_queueIndex : 0u];
+        std::unique_lock<std::mutex> lock(queue.mutex);
+        // run right away rather than growing the queue
+        if (queue.count == s_queueCapacity)
+        {
+            lock.unlock();
+            function();
+            m_jobCount.fetch_add(1u, std::memory_order_relaxed);
+            return;
+        }
+
+        group.m_pendingCount.fetch_add(1u, std::memory_order_relaxed);
+
+        // counted before being queued so that the count never goes below the number of queued jobs
+        m_queuedCount.fetch_add(1u);
+        queue.jobs[(queue.first + queue.count) % s_queueCapacity] =
+            QueuedJob{.function = std::move(function), .group = &group};
+        queue.count++;
+    }
+
+    // a worker checking the count under the lock cannot miss the notification
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+    }
+    m_wakeCondition.notify_one();
+}
+
+void JobSystem::wait(Group &group)
+{
+    while (group.m_pendingCount.load(std::memory_order_acquire) > 0u)
+    {
+        if (!runQueuedJob())
+            std::this_thread::yield();
+    }
+}
+
+uint32_t JobSystem::parallelFor(uint32_t count, uint32_t chunkSize, uint32_t maxConcurrency, const RangeJob &function)
+{
+    if (count == 0u)
+        return 0u;
+
+    chunkSize = std::max(chunkSize, 1u);
+    const uint32_t chunkCount = (count + chunkSize - 1u) / chunkSize;
+    const uint32_t concurrency =
+        std::min({maxConcurrency == 0u ? getThreadCount() : maxConcurrency, getThreadCount(), chunkCount});
+
+    // the chunks are handed out one at a time, a thread slowed down by its chunks does not hold the others back
+    std::atomic<uint32_t> nextChunk = 0u;
+    auto runChunks = [&](uint32_t threadIndex) {
+        for (uint32_t c = nextChunk.fetch_add(1u); c < chunkCount; c = nextChunk.fetch_add(1u))
+            function(c * chunkSize, std::min(count, (c + 1u) * chunkSize), threadIndex);
+    };
+
+    Group group;
+    for (uint32_t i = 1u; i < concurrency; ++i)
+        submit(group, [&runChunks, i]() { runChunks(i); });
+    runChunks(0u);
+    wait(group);
+
+    return concurrency;
+}
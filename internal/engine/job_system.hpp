@@ -0,0 +1,153 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief thread pool with a job queue per worker, an idle worker steals the oldest jobs of the others
+ * the jobs submitted from a worker go to its own queue and are run last in first out, those submitted from any other
+ * thread go to a shared queue
+ * a thread waiting for a group runs the queued jobs meanwhile, jobs can submit and wait for other jobs
+ * the queues have a fixed capacity so that submitting does not allocate, a job submitted to a full queue is run right
+ * away by the submitting thread
+ *
+ */
+class JobSystem
+{
+  public:
+    using Job = std::function<void()>;
+    using RangeJob = std::function<void(uint32_t first, uint32_t last, uint32_t threadIndex)>;
+
+    /**
+     * @brief jobs waited for together, must outlive them
+     *
+     */
+    class Group
+    {
+        friend JobSystem;
+
+      private:
+        std::atomic<uint32_t> m_pendingCount = 0u;
+
+      public:
+        Group() = default;
+
+        Group(const Group &) = delete;
+        Group &operator=(const Group &) = delete;
+        Group(Group &&) = delete;
+        Group &operator=(Group &&) = delete;
+    };
+
+    struct Statistics
+    {
+        uint64_t jobCount = 0u;
+        /**
+         * @brief jobs taken from the queue of another thread
+         *
+         */
+        uint64_t stolenCount = 0u;
+    };
+
+  private:
+    struct QueuedJob
+    {
+        Job function;
+        Group *group = nullptr;
+    };
+
+    static constexpr uint32_t s_queueCapacity = 256u;
+
+    /**
+     * @brief ring of jobs, the owner takes the newest and the others steal the oldest
+     *
+     */
+    struct JobQueue
+    {
+        std::mutex mutex;
+        std::array<QueuedJob, s_queueCapacity> jobs;
+        uint32_t first = 0u;
+        uint32_t count = 0u;
+    };
+
+    /**
+     * @brief the shared queue first, then one queue per worker
+     *
+     */
+    std::vector<std::unique_ptr<JobQueue>> m_queues;
+    std::vector<std::thread> m_workers;
+
+    std::atomic<uint32_t> m_queuedCount = 0u;
+    std::atomic<bool> m_stop = false;
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wakeCondition;
+
+    std::atomic<uint64_t> m_jobCount = 0u;
+    std::atomic<uint64_t> m_stolenCount = 0u;
+
+    void workerLoop(uint32_t queueIndex);
+
+    /**
+     * @brief run a job of the queue of the calling thread, or steal one
+     *
+     * @return false if every queue is empty
+     */
+    bool runQueuedJob();
+
+  public:
+    /**
+     * @brief
+     *
+     * @param workerCount threads started besides the calling thread, 0 runs the jobs on the waiting threads only
+     */
+    explicit JobSystem(uint32_t workerCount);
+    ~JobSystem();
+
+    JobSystem(const JobSystem &) = delete;
+    JobSystem &operator=(const JobSystem &) = delete;
+    JobSystem(JobSystem &&) = delete;
+    JobSystem &operator=(JobSystem &&) = delete;
+
+    /**
+     * @brief
+     *
+     * @param function its captures should fit in the small buffer of std::function so that submitting does not
+     * allocate
+     */
+    void submit(Group &group, Job function);
+    void wait(Group &group);
+
+    /**
+     * @brief split [0, count) in chunks, the chunks are taken in order by the calling thread and up to
+     * maxConcurrency - 1 jobs
+     *
+     * @param maxConcurrency threads running the chunks at once, 0 for all of them
+     * @param function called with the range of a chunk and the index of the thread running it, lower than the
+     * concurrency, so that the results can be accumulated per thread
+     * @return uint32_t concurrency
+     */
+    uint32_t parallelFor(uint32_t count, uint32_t chunkSize, uint32_t maxConcurrency, const RangeJob &function);
+
+  public:
+    /**
+     * @brief workers and the calling thread
+     *
+     */
+    [[nodiscard]] inline uint32_t getThreadCount() const
+    {
+        return static_cast<uint32_t>(m_workers.size()) + 1u;
+    }
+    [[nodiscard]] Statistics getStatistics() const
+    {
+        return Statistics{
+            .jobCount = m_jobCount.load(std::memory_order_relaxed),
+            .stolenCount = m_stolenCount.load(std::memory_order_relaxed),
+        };
+    }
+};
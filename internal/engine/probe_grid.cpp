@@ -1,22 +1,244 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+#include <glm/gtc/constants.hpp>
+
+#include "bvh.hpp"
+
 #include "probe_grid.hpp"
 
+// a probe is inside the geometry when more than this fraction of its rays hit back faces
+static constexpr float s_backfaceThreshold = 0.25f;
+static constexpr int s_maxRelocationIterationCount = 3;
+
+struct ProbeSurroundings
+{
+	uint32_t backfaceCount = 0u;
+	float closestFrontfaceDistance = 1e30f;
+	glm::vec3 closestFrontfaceDirection = glm::vec3(0.f);
+	float closestBackfaceDistance = 1e30f;
+	glm::vec3 closestBackfaceDirection = glm::vec3(0.f);
+};
+
+// directions evenly spread on the unit sphere (Fibonacci lattice)
+static std::vector<glm::vec3> getSphereDirections(uint32_t count)
+{
+	const float goldenAngle = glm::pi<float>() * (3.f - std::sqrt(5.f));
+
+	std::vector<glm::vec3> directions(count);
+	for (uint32_t i = 0u; i < count; i++)
+	{
+		const float y = 1.f - (i + 0.5f) * 2.f / count;
+		const float radius = std::sqrt(1.f - y * y);
+		const float phi = i * goldenAngle;
+		directions[i] = glm::vec3(std::cos(phi) * radius, y, std::sin(phi) * radius);
+	}
+	return directions;
+}
+
+static ProbeSurroundings traceSurroundings(const BVH &bvh, const glm::vec3 &position,
+                                           const std::vector<glm::vec3> &directions)
+{
+	ProbeSurroundings surroundings;
+	for (const glm::vec3 &direction : directions)
+	{
+		BVH::Hit hit;
+		if (!bvh.intersect(BVH::Ray{.origin = position, .direction = direction}, hit))
+			continue;
+
+		const glm::vec3 &v0 = bvh.getHitVertex(hit, 0u);
+		const glm::vec3 normal = glm::cross(bvh.getHitVertex(hit, 1u) - v0, bvh.getHitVertex(hit, 2u) - v0);
+		if (glm::dot(normal, direction) > 0.f)
+		{
+			surroundings.backfaceCount++;
+			if (hit.t < surroundings.closestBackfaceDistance)
+			{
+				surroundings.closestBackfaceDistance = hit.t;
+				surroundings.closestBackfaceDirection = direction;
+			}
+		}
+		else if (hit.t < surroundings.closestFrontfaceDistance)
+		{
+			surroundings.closestFrontfaceDistance = hit.t;
+			surroundings.closestFrontfaceDirection = direction;
+		}
+	}
+	return surroundings;
+}
+
 std::unique_ptr<ProbeGrid> ProbeGridBuilder::build()
 {
-	const glm::vec3 probeSpacing = m_product->m_extent / static_cast<glm::vec3>(m_product->m_dimensions - glm::uvec3(1u));
+	ProbeGrid &grid = *m_product;
+
+	if (grid.m_brickSize == glm::uvec3(0u))
+		grid.m_brickSize = grid.m_dimensions;
+
+	if (glm::any(glm::equal(grid.m_brickSize, glm::uvec3(0u))) ||
+	    glm::any(glm::notEqual(grid.m_dimensions % grid.m_brickSize, glm::uvec3(0u))))
+	{
+		std::cerr << "Probe grid dimensions must be a multiple of the brick size" << std::endl;
+		return nullptr;
+	}
+	grid.m_brickDimensions = grid.m_dimensions / grid.m_brickSize;
 
-	for (uint32_t i = 0u; i < m_product->m_dimensions.x; i++)
+	allocateBricks();
+
+	const glm::vec3 probeSpacing = grid.m_extent / static_cast<glm::vec3>(grid.m_dimensions - glm::uvec3(1u));
+
+	for (uint32_t bx = 0u; bx < grid.m_brickDimensions.x; bx++)
 	{
-		const float x = m_product->m_cornerPosition.x + i * probeSpacing.x;
-		for (uint32_t j = 0u; j < m_product->m_dimensions.y; j++)
+		for (uint32_t by = 0u; by < grid.m_brickDimensions.y; by++)
 		{
-			const float y = m_product->m_cornerPosition.y + j * probeSpacing.y;
-			for (uint32_t k = 0u; k < m_product->m_dimensions.z; k++)
+			for (uint32_t bz = 0u; bz < grid.m_brickDimensions.z; bz++)
 			{
-				const float z = m_product->m_cornerPosition.z + k * probeSpacing.z;
-				m_product->m_probes.push_back(std::make_unique<Probe>(glm::vec3(x, y, z)));
+				const uint32_t brickIndex = (bx * grid.m_brickDimensions.y + by) * grid.m_brickDimensions.z + bz;
+				if (grid.m_brickProbeOffsets[brickIndex] < 0)
+					continue;
+
+				const glm::uvec3 firstProbe = glm::uvec3(bx, by, bz) * grid.m_brickSize;
+				for (uint32_t i = 0u; i < grid.m_brickSize.x; i++)
+				{
+					const float x = grid.m_cornerPosition.x + (firstProbe.x + i) * probeSpacing.x;
+					for (uint32_t j = 0u; j < grid.m_brickSize.y; j++)
+					{
+						const float y = grid.m_cornerPosition.y + (firstProbe.y + j) * probeSpacing.y;
+						for (uint32_t k = 0u; k < grid.m_brickSize.z; k++)
+						{
+							const float z = grid.m_cornerPosition.z + (firstProbe.z + k) * probeSpacing.z;
+							grid.m_probes.push_back(std::make_unique<Probe>(glm::vec3(x, y, z)));
+						}
+					}
+				}
 			}
 		}
 	}
 
+	if (m_geometry)
+		placeProbes();
+
 	return std::move(m_product);
+}
+
+void ProbeGridBuilder::allocateBricks()
+{
+	ProbeGrid &grid = *m_product;
+
+	const uint32_t brickCount = grid.m_brickDimensions.x * grid.m_brickDimensions.y * grid.m_brickDimensions.z;
+	const uint32_t brickProbeCount = grid.m_brickSize.x * grid.m_brickSize.y * grid.m_brickSize.z;
+
+	// without geometry every brick is allocated
+	std::vector<uint32_t> triangleCounts(brickCount, 1u);
+	if (m_geometry)
+	{
+		const glm::vec3 probeSpacing = grid.m_extent / static_cast<glm::vec3>(grid.m_dimensions - glm::uvec3(1u));
+		for (uint32_t bx = 0u; bx < grid.m_brickDimensions.x; bx++)
+		{
+			for (uint32_t by = 0u; by < grid.m_brickDimensions.y; by++)
+			{
+				for (uint32_t bz = 0u; bz < grid.m_brickDimensions.z; bz++)
+				{
+					// the probes of a brick shade the cells around them, up to one probe spacing away
+					const glm::vec3 firstProbe = glm::vec3(glm::uvec3(bx, by, bz) * grid.m_brickSize);
+					const glm::vec3 boxMin = grid.m_cornerPosition + (firstProbe - 1.f) * probeSpacing;
+					const glm::vec3 boxMax =
+						grid.m_cornerPosition + (firstProbe + glm::vec3(grid.m_brickSize)) * probeSpacing;
+					triangleCounts[(bx * grid.m_brickDimensions.y + by) * grid.m_brickDimensions.z + bz] =
+						m_geometry->countTrianglesInBox(boxMin, boxMax);
+				}
+			}
+		}
+	}
+
+	std::vector<uint32_t> candidates;
+	for (uint32_t i = 0u; i < brickCount; i++)
+	{
+		if (triangleCounts[i] > 0u)
+			candidates.push_back(i);
+	}
+
+	const uint32_t maxBrickCount = m_maxProbeCount / brickProbeCount;
+	if (candidates.size() > maxBrickCount)
+	{
+		std::stable_sort(candidates.begin(), candidates.end(),
+		                 [&](uint32_t a, uint32_t b) { return triangleCounts[a] > triangleCounts[b]; });
+		candidates.resize(maxBrickCount);
+	}
+
+	std::vector<bool> allocated(brickCount, false);
+	for (uint32_t brickIndex : candidates)
+		allocated[brickIndex] = true;
+
+	// the probes are stored in brick order
+	grid.m_brickProbeOffsets.assign(brickCount, -1);
+	int32_t probeOffset = 0;
+	for (uint32_t i = 0u; i < brickCount; i++)
+	{
+		if (!allocated[i])
+			continue;
+
+		grid.m_brickProbeOffsets[i] = probeOffset;
+		probeOffset += static_cast<int32_t>(brickProbeCount);
+	}
+
+	grid.m_placementStatistics.brickCount = brickCount;
+	grid.m_placementStatistics.allocatedBrickCount = static_cast<uint32_t>(candidates.size());
+}
+
+void ProbeGridBuilder::placeProbes()
+{
+	const auto start = std::chrono::steady_clock::now();
+
+	const std::vector<glm::vec3> directions = getSphereDirections(m_placementRayCount);
+
+	const glm::vec3 probeSpacing = m_product->m_extent / static_cast<glm::vec3>(m_product->m_dimensions - glm::uvec3(1u));
+	// a probe stays in its cell so that the shaders can still find it from a position
+	const glm::vec3 maxOffset = probeSpacing * 0.45f;
+	const float minSurfaceDistance = 0.1f * std::min(probeSpacing.x, std::min(probeSpacing.y, probeSpacing.z));
+
+	ProbeGrid::PlacementStatistics &stats = m_product->m_placementStatistics;
+	stats.relocatedProbeCount = 0u;
+	stats.inactiveProbeCount = 0u;
+	stats.rayCount = 0u;
+
+	for (std::unique_ptr<Probe> &probe : m_product->m_probes)
+	{
+		const glm::vec3 latticePosition = probe->position;
+
+		bool inside = false;
+		for (int iteration = 0;; iteration++)
+		{
+			const ProbeSurroundings surroundings = traceSurroundings(*m_geometry, probe->position, directions);
+			stats.rayCount += directions.size();
+
+			inside = surroundings.backfaceCount > s_backfaceThreshold * directions.size();
+			const bool tooClose = surroundings.closestFrontfaceDistance < minSurfaceDistance;
+			if ((!inside && !tooClose) || iteration == s_maxRelocationIterationCount)
+				break;
+
+			// go through the closest back face, or away from the closest front face
+			const glm::vec3 offset =
+				inside ? surroundings.closestBackfaceDirection *
+				             (surroundings.closestBackfaceDistance + minSurfaceDistance)
+				       : surroundings.closestFrontfaceDirection *
+				             (surroundings.closestFrontfaceDistance - minSurfaceDistance);
+			probe->position =
+				latticePosition + glm::clamp(probe->position + offset - latticePosition, -maxOffset, maxOffset);
+		}
+
+		probe->active = !inside;
+
+		if (probe->position != latticePosition)
+			stats.relocatedProbeCount++;
+		if (!probe->active)
+			stats.inactiveProbeCount++;
+	}
+
+	stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << "Placing " << m_product->m_probes.size() << " probes in " << stats.allocatedBrickCount << " of "
+	          << stats.brickCount << " bricks : " << stats.relocatedProbeCount
+	          << " relocated, " << stats.inactiveProbeCount << " inactive, " << stats.rayCount << " rays in "
+	          << stats.seconds * 1000.0 << " ms" << std::endl;
 }
\ No newline at end of file
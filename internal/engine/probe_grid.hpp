@@ -1,20 +1,45 @@
 
+#include <cstdint>
 #include <glm/glm.hpp>
 #include <memory>
 #include <vector>
 
 class ProbeGridBuilder;
+class BVH;
 
 class Probe
 {
   public:
     glm::vec3 position;
+    /**
+     * @brief an inactive probe is enclosed by the geometry, it is neither captured nor used for shading
+     *
+     */
+    bool active = true;
 };
 
+/**
+ * @brief probes laid out on a regular grid
+ * the grid is split into bricks of probes, only the bricks close to the geometry are allocated when it is given to
+ * the builder, the probes are stored brick by brick
+ * a dense grid is made of a single brick
+ *
+ */
 class ProbeGrid
 {
     friend ProbeGridBuilder;
 
+  public:
+    struct PlacementStatistics
+    {
+        uint32_t brickCount = 0u;
+        uint32_t allocatedBrickCount = 0u;
+        uint32_t relocatedProbeCount = 0u;
+        uint32_t inactiveProbeCount = 0u;
+        uint64_t rayCount = 0u;
+        double seconds = 0.0;
+    };
+
   private:
     std::vector<std::unique_ptr<Probe>> m_probes;
 
@@ -22,6 +47,20 @@ class ProbeGrid
     glm::vec3 m_cornerPosition = {0.f, 0.f, 0.f};
     glm::vec3 m_extent = {2.f, 2.f, 2.f};
 
+    /**
+     * @brief probes per dimension of a brick, the whole grid if 0
+     *
+     */
+    glm::uvec3 m_brickSize = glm::uvec3(0u);
+    glm::uvec3 m_brickDimensions = glm::uvec3(1u);
+    /**
+     * @brief index of the first probe of every brick, -1 if the brick is not allocated
+     *
+     */
+    std::vector<int32_t> m_brickProbeOffsets;
+
+    PlacementStatistics m_placementStatistics;
+
   public:
     int instanceCountOverride = -1;
 
@@ -50,6 +89,59 @@ class ProbeGrid
         return m_cornerPosition;
     }
 
+    [[nodiscard]] inline const glm::uvec3 &getBrickSize() const
+    {
+        return m_brickSize;
+    }
+
+    [[nodiscard]] inline const glm::uvec3 &getBrickDimensions() const
+    {
+        return m_brickDimensions;
+    }
+
+    [[nodiscard]] inline const std::vector<int32_t> &getBrickProbeOffsets() const
+    {
+        return m_brickProbeOffsets;
+    }
+
+    /**
+     * @brief index of a probe in the probe array from its index on the grid
+     *
+     * @return int32_t -1 if the brick of the probe is not allocated
+     */
+    [[nodiscard]] inline int32_t getProbeIndex(const glm::uvec3 &gridIndex) const
+    {
+        const glm::uvec3 brickIndex = gridIndex / m_brickSize;
+        const int32_t brickOffset = m_brickProbeOffsets[(brickIndex.x * m_brickDimensions.y + brickIndex.y) *
+                                                            m_brickDimensions.z +
+                                                        brickIndex.z];
+        if (brickOffset < 0)
+            return -1;
+
+        const glm::uvec3 localIndex = gridIndex - brickIndex * m_brickSize;
+        return brickOffset +
+               static_cast<int32_t>((localIndex.x * m_brickSize.y + localIndex.y) * m_brickSize.z + localIndex.z);
+    }
+
+    /**
+     * @brief an index past the last probe is inactive too, it has no probe to capture
+     *
+     */
+    [[nodiscard]] inline bool isProbeActive(const uint32_t index) const
+    {
+        return index < m_probes.size() && m_probes[index]->active;
+    }
+
+    /**
+     * @brief allocated bricks and result of the placement against the scene geometry, the probes are only placed when
+     * the geometry is given
+     *
+     */
+    [[nodiscard]] inline const PlacementStatistics &getPlacementStatistics() const
+    {
+        return m_placementStatistics;
+    }
+
   public:
     /**
      * @brief force set the probes to the given probe position
@@ -73,11 +165,28 @@ class ProbeGridBuilder
   private:
     std::unique_ptr<ProbeGrid> m_product;
 
+    const BVH *m_geometry = nullptr;
+    uint32_t m_placementRayCount = 64u;
+    uint32_t m_maxProbeCount = UINT32_MAX;
+
     void restart()
     {
         m_product = std::make_unique<ProbeGrid>();
     }
 
+    /**
+     * @brief allocate the bricks close to the geometry, the ones with the most triangles first if they do not all fit
+     * in the probe budget
+     *
+     */
+    void allocateBricks();
+    /**
+     * @brief move the probes out of the geometry they are in or too close to, deactivate the ones that stay inside
+     * a probe is inside the geometry when too many of its rays hit back faces
+     *
+     */
+    void placeProbes();
+
   public:
     ProbeGridBuilder()
     {
@@ -109,5 +218,41 @@ class ProbeGridBuilder
         m_product->m_extent = extent;
     }
 
+    /**
+     * @brief split the grid into bricks of the given probe count per dimension, the grid dimensions must be a multiple
+     * of it
+     *
+     */
+    void setBrickSize(const glm::uvec3 &brickSize)
+    {
+        m_product->m_brickSize = brickSize;
+    }
+
+    /**
+     * @brief probes allocated at most when placing the bricks against the geometry
+     *
+     */
+    void setMaxProbeCount(uint32_t count)
+    {
+        m_maxProbeCount = count;
+    }
+
+    /**
+     * @brief scene geometry the probes are placed against, only used while building
+     *
+     */
+    void setGeometry(const BVH *bvh)
+    {
+        m_geometry = bvh;
+    }
+    /**
+     * @brief rays traced from each probe to find the surfaces around it
+     *
+     */
+    void setPlacementRayCount(uint32_t count)
+    {
+        m_placementRayCount = count;
+    }
+
     std::unique_ptr<ProbeGrid> build();
 };
\ No newline at end of file
@@ -1,5 +1,39 @@
 #pragma once
 
+#include <cstdint>
+
+/**
+ * @brief scene data a script reads or writes when it is updated
+ *
+ */
+enum ScriptResourceBits : uint32_t
+{
+    SCRIPT_RESOURCE_MAIN_CAMERA_BIT = 1u << 0,
+    SCRIPT_RESOURCE_OBJECT_TRANSFORMS_BIT = 1u << 1,
+    SCRIPT_RESOURCE_LIGHTS_BIT = 1u << 2,
+    SCRIPT_RESOURCE_ALL = ~0u,
+};
+
+/**
+ * @brief the scripts of a scene whose accesses do not conflict are updated at the same time
+ *
+ */
+struct ScriptAccessT
+{
+    uint32_t reads = SCRIPT_RESOURCE_ALL;
+    uint32_t writes = SCRIPT_RESOURCE_ALL;
+    /**
+     * @brief the window and the glfw input functions can only be used from the main thread
+     *
+     */
+    bool mainThread = true;
+
+    [[nodiscard]] inline bool conflictsWith(const ScriptAccessT &other) const
+    {
+        return (writes & (other.reads | other.writes)) != 0u || (reads & other.writes) != 0u;
+    }
+};
+
 class ScriptableABC
 {
   public:
@@ -14,4 +48,13 @@ class ScriptableABC
     virtual void init(void *userData) = 0;
     virtual void begin() = 0;
     virtual void update(float deltaTime) = 0;
+
+    /**
+     * @brief what update touches, everything on the main thread by default so that the script is updated alone
+     *
+     */
+    [[nodiscard]] virtual ScriptAccessT getUpdateAccess() const
+    {
+        return ScriptAccessT{};
+    }
 };
\ No newline at end of file
@@ -1,14 +1,14 @@
-#include <glm/gtc/matrix_transform.hpp>
-
 #include "transform.hpp"
 
-glm::mat4 Transform::getTransformMatrix() const
+glm::mat4 Transform::compose(const glm::vec3 &position, const glm::quat &rotation, const glm::vec3 &scale)
 {
-    glm::mat4 identity = glm::identity<glm::mat4>();
+    const glm::mat3 r = glm::mat3_cast(rotation);
 
-    glm::mat4 t = glm::translate(identity, position);
-    glm::mat4 r = glm::mat4_cast(rotation);
-    glm::mat4 s = glm::scale(identity, scale);
+    return glm::mat4(glm::vec4(r[0] * scale.x, 0.f), glm::vec4(r[1] * scale.y, 0.f), glm::vec4(r[2] * scale.z, 0.f),
+                     glm::vec4(position, 1.f));
+}
 
-    return t * r * s;
+glm::mat4 Transform::getTransformMatrix() const
+{
+    return compose(position, rotation, scale);
 }
\ No newline at end of file
@@ -11,5 +11,12 @@ class Transform
     glm::vec3 scale = glm::vec3(1.f);
 
   public:
+    /**
+     * @brief translation * rotation * scale, written directly instead of multiplying the three matrices
+     *
+     */
+    [[nodiscard]] static glm::mat4 compose(const glm::vec3 &position, const glm::quat &rotation,
+                                           const glm::vec3 &scale);
+
     [[nodiscard]] glm::mat4 getTransformMatrix() const;
 };
\ No newline at end of file
@@ -0,0 +1,104 @@
+#include <algorithm>
+#include <cassert>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define TRANSFORM_STORE_USE_SSE
+#include <emmintrin.h>
+#endif
+
+#include "transform_store.hpp"
+
+namespace
+{
+/**
+ * @brief parent * local, the columns of the product are combinations of the columns of the parent
+ *
+ */
+void multiplyMatrices(const glm::mat4 &parent, const glm::mat4 &local, glm::mat4 &out)
+{
+#ifdef TRANSFORM_STORE_USE_SSE
+    const __m128 p0 = _mm_loadu_ps(&parent[0][0]);
+    const __m128 p1 = _mm_loadu_ps(&parent[1][0]);
+    const __m128 p2 = _mm_loadu_ps(&parent[2][0]);
+    const __m128 p3 = _mm_loadu_ps(&parent[3][0]);
+
+    for (int c = 0; c < 4; ++c)
+    {
+        __m128 column = _mm_mul_ps(p0, _mm_set1_ps(local[c][0]));
+        column = _mm_add_ps(column, _mm_mul_ps(p1, _mm_set1_ps(local[c][1])));
+        column = _mm_add_ps(column, _mm_mul_ps(p2, _mm_set1_ps(local[c][2])));
+        column = _mm_add_ps(column, _mm_mul_ps(p3, _mm_set1_ps(local[c][3])));
+        _mm_storeu_ps(&out[c][0], column);
+    }
+#else
+    out = parent * local;
+#endif
+}
+} // namespace
+
+uint32_t TransformStore::add(const Transform &transform, int32_t parentIndex)
+{
+    assert(parentIndex < static_cast<int32_t>(m_positions.size()));
+
+    const uint32_t index = static_cast<uint32_t>(m_positions.size());
+    m_positions.push_back(transform.position);
+    m_rotations.push_back(transform.rotation);
+    m_scales.push_back(transform.scale);
+    m_parents.push_back(parentIndex);
+
+    // computed right away so that the matrix can be read before the first update
+    const glm::mat4 local = Transform::compose(transform.position, transform.rotation, transform.scale);
+    if (parentIndex == s_noParent)
+    {
+        m_worldMatrices.push_back(local);
+        m_dirty.push_back(0u);
+    }
+    else
+    {
+        glm::mat4 world;
+        multiplyMatrices(m_worldMatrices[parentIndex], local, world);
+        const uint8_t parentDirty = m_dirty[parentIndex];
+        m_worldMatrices.push_back(world);
+        m_dirty.push_back(parentDirty);
+    }
+
+    return index;
+}
+
+void TransformStore::set(uint32_t index, const Transform &transform)
+{
+    m_positions[index] = transform.position;
+    m_rotations[index] = transform.rotation;
+    m_scales[index] = transform.scale;
+    m_dirty[index] = 1u;
+    m_anyDirty = true;
+}
+
+void TransformStore::update()
+{
+    m_lastUpdatedCount = 0u;
+    if (!m_anyDirty)
+        return;
+
+    const size_t count = m_positions.size();
+    for (size_t i = 0; i < count; ++i)
+    {
+        const int32_t parent = m_parents[i];
+        // the parent has already been visited, moving it moves the whole subtree
+        if (parent != s_noParent)
+            m_dirty[i] |= m_dirty[parent];
+        if (!m_dirty[i])
+            continue;
+
+        const glm::mat4 local = Transform::compose(m_positions[i], m_rotations[i], m_scales[i]);
+        if (parent == s_noParent)
+            m_worldMatrices[i] = local;
+        else
+            multiplyMatrices(m_worldMatrices[parent], local, m_worldMatrices[i]);
+
+        m_lastUpdatedCount++;
+    }
+
+    std::fill(m_dirty.begin(), m_dirty.end(), 0u);
+    m_anyDirty = false;
+}
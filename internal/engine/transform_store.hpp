@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "transform.hpp"
+
+/**
+ * @brief transforms of the objects of a scene stored component by component, with their world matrices cached
+ * a parent is always added before its children so that the world matrices are computed in a single pass
+ * only the transforms set since the last update and their children are computed again
+ *
+ */
+class TransformStore
+{
+  public:
+    static constexpr int32_t s_noParent = -1;
+
+  private:
+    std::vector<glm::vec3> m_positions;
+    std::vector<glm::quat> m_rotations;
+    std::vector<glm::vec3> m_scales;
+    std::vector<int32_t> m_parents;
+
+    /**
+     * @brief set since the last update, bytes rather than bits so that a child inherits the flag of its parent
+     * with a single read
+     *
+     */
+    std::vector<uint8_t> m_dirty;
+    bool m_anyDirty = false;
+
+    std::vector<glm::mat4> m_worldMatrices;
+
+    uint32_t m_lastUpdatedCount = 0u;
+
+  public:
+    /**
+     * @brief
+     *
+     * @param transform local to the parent
+     * @param parentIndex index of a transform of this store, or s_noParent
+     * @return uint32_t index of the transform
+     */
+    uint32_t add(const Transform &transform, int32_t parentIndex = s_noParent);
+
+    void set(uint32_t index, const Transform &transform);
+
+    /**
+     * @brief compute the world matrices of the transforms set since the last update, called once per frame
+     *
+     */
+    void update();
+
+  public:
+    [[nodiscard]] Transform get(uint32_t index) const
+    {
+        return Transform{
+            .position = m_positions[index],
+            .rotation = m_rotations[index],
+            .scale = m_scales[index],
+        };
+    }
+    [[nodiscard]] inline int32_t getParentIndex(uint32_t index) const
+    {
+        return m_parents[index];
+    }
+    /**
+     * @brief world matrix as of the last update
+     *
+     */
+    [[nodiscard]] inline const glm::mat4 &getWorldMatrix(uint32_t index) const
+    {
+        return m_worldMatrices[index];
+    }
+    [[nodiscard]] inline const std::vector<glm::mat4> &getWorldMatrices() const
+    {
+        return m_worldMatrices;
+    }
+    [[nodiscard]] inline uint32_t getCount() const
+    {
+        return static_cast<uint32_t>(m_positions.size());
+    }
+    /**
+     * @brief world matrices computed by the last update
+     *
+     */
+    [[nodiscard]] inline uint32_t getLastUpdatedCount() const
+    {
+        return m_lastUpdatedCount;
+    }
+};
@@ -1,3 +1,4 @@
+#include <array>
 #include <cassert>
 #include <iostream>
 
@@ -9,6 +10,12 @@
 
 void Buffer::mapMemory(void **ppData)
 {
+    if (m_persistentMappedData)
+    {
+        *ppData = m_persistentMappedData;
+        return;
+    }
+
     auto devicePtr = m_device.lock();
     auto deviceHandle = devicePtr->getHandle();
 
@@ -17,6 +24,12 @@ void Buffer::mapMemory(void **ppData)
 
 void Buffer::copyDataToMemory(const void *srcData)
 {
+    if (m_persistentMappedData)
+    {
+        memcpy(m_persistentMappedData, srcData, m_size);
+        return;
+    }
+
     auto devicePtr = m_device.lock();
     auto deviceHandle = devicePtr->getHandle();
 
@@ -30,6 +43,25 @@ void Buffer::copyDataToMemory(const void *srcData)
     vmaUnmapMemory(devicePtr->getAllocator(), m_allocation);
 }
 
+void Buffer::copyMemoryToData(void *dstData)
+{
+    if (m_persistentMappedData)
+    {
+        memcpy(dstData, m_persistentMappedData, m_size);
+        return;
+    }
+
+    auto devicePtr = m_device.lock();
+
+    void *data;
+
+    vmaMapMemory(devicePtr->getAllocator(), m_allocation, &data);
+
+    memcpy(dstData, data, m_size);
+
+    vmaUnmapMemory(devicePtr->getAllocator(), m_allocation);
+}
+
 void Buffer::transferBufferToBuffer(Buffer &src)
 {
     auto devicePtr = m_device.lock();
@@ -54,7 +86,8 @@ Buffer::~Buffer()
 
     VmaAllocationInfo info;
     vmaGetAllocationInfo(devicePtr->getAllocator(), m_allocation, &info);
-    if (info.pMappedData)
+    // persistently mapped memory is unmapped by VMA on destruction
+    if (info.pMappedData && !m_persistentMappedData)
         vmaUnmapMemory(devicePtr->getAllocator(), m_allocation);
 
     vmaDestroyBuffer(devicePtr->getAllocator(), m_handle, m_allocation);
@@ -84,18 +117,32 @@ std::unique_ptr<Buffer> BufferBuilder::build()
                                      .usage = m_usage,
                                      .sharingMode = VK_SHARING_MODE_EXCLUSIVE};
 
+    std::array<uint32_t, 2> queueFamilyIndices;
+    if (m_computeSharingEnable && devicePtr->isAsyncComputeSupported())
+    {
+        queueFamilyIndices = {devicePtr->getGraphicsFamilyIndex().value(), devicePtr->getComputeFamilyIndex().value()};
+        createInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        createInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilyIndices.size());
+        createInfo.pQueueFamilyIndices = queueFamilyIndices.data();
+    }
+
     VmaAllocationCreateInfo allocInfo = {
+        .flags = m_persistentlyMapped ? VMA_ALLOCATION_CREATE_MAPPED_BIT : 0u,
         .requiredFlags = m_properties,
     };
 
+    VmaAllocationInfo createdAllocInfo;
     VkResult res = vmaCreateBuffer(devicePtr->getAllocator(), &createInfo, &allocInfo, &m_product->m_handle,
-                                   &m_product->m_allocation, nullptr);
+                                   &m_product->m_allocation, &createdAllocInfo);
     if (res != VK_SUCCESS)
     {
         std::cerr << "Failed to create buffer and allocate memory: " << res << std::endl;
         return nullptr;
     }
 
+    if (m_persistentlyMapped)
+        m_product->m_persistentMappedData = createdAllocInfo.pMappedData;
+
     m_product->m_name += std::string(" Buffer " + std::to_string(devicePtr->getBufferCount()));
     devicePtr->addDebugObjectName(VkDebugUtilsObjectNameInfoEXT{
         .sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT,
@@ -125,12 +172,19 @@ void BufferDirector::configureStagingBufferBuilder(BufferBuilder &builder)
     builder.setUsage(VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
     builder.setProperties(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 }
+void BufferDirector::configureReadbackBufferBuilder(BufferBuilder &builder)
+{
+    builder.setUsage(VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+    builder.setProperties(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+}
 void BufferDirector::configureVertexBufferBuilder(BufferBuilder &builder)
 {
     builder.setUsage(VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
                      VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
                      VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR);
     builder.setProperties(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    // read by the ray queries of the async compute phases
+    builder.setComputeSharingEnable(true);
 }
 void BufferDirector::configureIndexBufferBuilder(BufferBuilder &builder)
 {
@@ -138,15 +192,26 @@ void BufferDirector::configureIndexBufferBuilder(BufferBuilder &builder)
                      VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
                      VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR);
     builder.setProperties(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    // read by the ray queries of the async compute phases
+    builder.setComputeSharingEnable(true);
 }
 void BufferDirector::configureUniformBufferBuilder(BufferBuilder &builder)
 {
     builder.setUsage(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
     builder.setProperties(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    builder.setPersistentlyMapped(true);
 }
 
 void BufferDirector::configureStorageBufferBuilder(BufferBuilder &builder)
 {
     builder.setUsage(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
     builder.setProperties(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    builder.setPersistentlyMapped(true);
+}
+
+void BufferDirector::configureFrameRingBufferBuilder(BufferBuilder &builder)
+{
+    builder.setUsage(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    builder.setProperties(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    builder.setPersistentlyMapped(true);
 }
\ No newline at end of file
@@ -23,6 +23,12 @@ class Buffer
     VmaAllocation m_allocation;
     size_t m_size;
 
+    /**
+     * @brief pointer to the memory if the buffer has been created persistently mapped
+     *
+     */
+    void *m_persistentMappedData = nullptr;
+
     Buffer() = default;
 
   public:
@@ -36,6 +42,11 @@ class Buffer
     void mapMemory(void **ppData);
 
     void copyDataToMemory(const void *srcData);
+    /**
+     * @brief read the whole buffer back, the memory must be host visible
+     *
+     */
+    void copyMemoryToData(void *dstData);
 
     void transferBufferToBuffer(Buffer &src);
 
@@ -55,6 +66,11 @@ class Buffer
         return m_name;
     }
 
+    [[nodiscard]] inline void *getMappedData() const
+    {
+        return m_persistentMappedData;
+    }
+
     [[nodiscard]] VkDeviceAddress getDeviceAddress() const;
 };
 
@@ -70,6 +86,9 @@ class BufferBuilder
     VkBufferUsageFlags m_usage;
     VkMemoryPropertyFlags m_properties;
 
+    bool m_persistentlyMapped = false;
+    bool m_computeSharingEnable = false;
+
   public:
     BufferBuilder()
     {
@@ -79,6 +98,8 @@ class BufferBuilder
     void restart()
     {
         m_product = std::unique_ptr<Buffer>(new Buffer);
+        m_persistentlyMapped = false;
+        m_computeSharingEnable = false;
     }
 
     void setDevice(std::weak_ptr<Device> a)
@@ -99,6 +120,24 @@ class BufferBuilder
     {
         m_properties = a;
     }
+    /**
+     * @brief keep the memory mapped for the whole lifetime of the buffer
+     * only valid with host visible memory properties
+     *
+     */
+    void setPersistentlyMapped(bool a)
+    {
+        m_persistentlyMapped = a;
+    }
+    /**
+     * @brief share the buffer between the graphics and the async compute queue families
+     * the compute phases may then read it without an ownership transfer, ignored without async compute
+     *
+     */
+    void setComputeSharingEnable(bool a)
+    {
+        m_computeSharingEnable = a;
+    }
     void setName(std::string name)
     {
         m_product->m_name = name;
@@ -111,8 +150,10 @@ class BufferDirector
 {
   public:
     void configureStagingBufferBuilder(BufferBuilder &builder);
+    void configureReadbackBufferBuilder(BufferBuilder &builder);
     void configureVertexBufferBuilder(BufferBuilder &builder);
     void configureIndexBufferBuilder(BufferBuilder &builder);
     void configureUniformBufferBuilder(BufferBuilder &builder);
     void configureStorageBufferBuilder(BufferBuilder &builder);
+    void configureFrameRingBufferBuilder(BufferBuilder &builder);
 };
\ No newline at end of file
@@ -43,6 +43,9 @@ Device::~Device()
 
     vkDestroyCommandPool(m_handle, m_commandPool, nullptr);
     vkDestroyCommandPool(m_handle, m_commandPoolTransient, nullptr);
+    vkDestroyCommandPool(m_handle, m_computeCommandPool, nullptr);
+
+    vkDestroyPipelineCache(m_handle, m_pipelineCache, nullptr);
 
     vkDestroyDevice(m_handle, nullptr);
 }
@@ -89,6 +92,17 @@ std::optional<uint32_t> Device::findQueueFamilyIndex(const VkQueueFlags &capabil
     }
     return std::optional<uint32_t>();
 }
+std::optional<uint32_t> Device::findDedicatedQueueFamilyIndex(const VkQueueFlags &capabilities,
+                                                              const VkQueueFlags &excluded) const
+{
+    auto props = getQueueFamilyProperties();
+    for (uint32_t i = 0; i < props.size(); ++i)
+    {
+        if ((props[i].queueFlags & capabilities) && !(props[i].queueFlags & excluded))
+            return std::optional<uint32_t>(i);
+    }
+    return std::optional<uint32_t>();
+}
 std::optional<uint32_t> Device::findPresentQueueFamilyIndex() const
 {
     if (!m_surface)
@@ -160,6 +174,33 @@ void Device::addDebugObjectName(VkDebugUtilsObjectNameInfoEXT nameInfo) const
     vkSetDebugUtilsObjectNameEXT(m_handle, &nameInfo);
 }
 
+VkDeviceSize Device::calculateAllocatedBytes() const
+{
+    VmaTotalStatistics stats;
+    vmaCalculateStatistics(m_allocator, &stats);
+    return stats.total.statistics.allocationBytes;
+}
+
+Device::MemoryBudgetT Device::calculateDeviceLocalBudget() const
+{
+    const VkPhysicalDeviceMemoryProperties *memoryProperties;
+    vmaGetMemoryProperties(m_allocator, &memoryProperties);
+
+    VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+    vmaGetHeapBudgets(m_allocator, budgets);
+
+    MemoryBudgetT out;
+    for (uint32_t i = 0u; i < memoryProperties->memoryHeapCount; ++i)
+    {
+        if (!(memoryProperties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT))
+            continue;
+
+        out.usage += budgets[i].usage;
+        out.budget += budgets[i].budget;
+    }
+    return out;
+}
+
 void DeviceBuilder::setPhysicalDevice(VkPhysicalDevice a)
 {
     m_product->m_physicalHandle = a;
@@ -235,7 +276,11 @@ void DeviceBuilder::setPhysicalDevice(VkPhysicalDevice a)
     }
 
     m_product->m_graphicsFamilyIndex = m_product->findQueueFamilyIndex(VK_QUEUE_GRAPHICS_BIT);
-    m_product->m_computeFamilyIndex = m_product->findQueueFamilyIndex(VK_QUEUE_COMPUTE_BIT);
+    // a family without graphics lets the compute work overlap the rendering
+    m_product->m_computeFamilyIndex =
+        m_product->findDedicatedQueueFamilyIndex(VK_QUEUE_COMPUTE_BIT, VK_QUEUE_GRAPHICS_BIT);
+    if (!m_product->m_computeFamilyIndex.has_value())
+        m_product->m_computeFamilyIndex = m_product->findQueueFamilyIndex(VK_QUEUE_COMPUTE_BIT);
 }
 
 #define VK_INSTANCE_PROC_ADDR_BUILDER(func)                                                                            \
@@ -321,6 +366,29 @@ std::unique_ptr<Device> DeviceBuilder::build()
         return nullptr;
     }
 
+    VkCommandPoolCreateInfo computeCommandPoolCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        .queueFamilyIndex = m_product->m_computeFamilyIndex.value_or(m_product->m_graphicsFamilyIndex.value()),
+    };
+    res = vkCreateCommandPool(m_product->m_handle, &computeCommandPoolCreateInfo, nullptr,
+                              &m_product->m_computeCommandPool);
+    if (res != VK_SUCCESS)
+    {
+        std::cerr << "Failed to create compute command pool : " << res << std::endl;
+        return nullptr;
+    }
+
+    VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+    };
+    res = vkCreatePipelineCache(m_product->m_handle, &pipelineCacheCreateInfo, nullptr, &m_product->m_pipelineCache);
+    if (res != VK_SUCCESS)
+    {
+        std::cerr << "Failed to create pipeline cache : " << res << std::endl;
+        return nullptr;
+    }
+
     VmaVulkanFunctions vulkanFunctions = {};
     vulkanFunctions.vkGetInstanceProcAddr = &vkGetInstanceProcAddr;
     vulkanFunctions.vkGetDeviceProcAddr = &vkGetDeviceProcAddr;
@@ -339,9 +407,12 @@ std::unique_ptr<Device> DeviceBuilder::build()
     VK_INSTANCE_PROC_ADDR_BUILDER(vkSetDebugUtilsObjectNameEXT);
 
     VK_INSTANCE_PROC_ADDR_BUILDER(vkCreateAccelerationStructureKHR);
+    VK_INSTANCE_PROC_ADDR_BUILDER(vkDestroyAccelerationStructureKHR);
     VK_INSTANCE_PROC_ADDR_BUILDER(vkGetAccelerationStructureBuildSizesKHR);
     VK_INSTANCE_PROC_ADDR_BUILDER(vkGetAccelerationStructureDeviceAddressKHR);
     VK_INSTANCE_PROC_ADDR_BUILDER(vkCmdBuildAccelerationStructuresKHR);
+    VK_INSTANCE_PROC_ADDR_BUILDER(vkCmdWriteAccelerationStructuresPropertiesKHR);
+    VK_INSTANCE_PROC_ADDR_BUILDER(vkCmdCopyAccelerationStructureKHR);
 
     return std::move(m_product);
 }
\ No newline at end of file
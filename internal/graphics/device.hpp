@@ -22,6 +22,18 @@ class Device
 {
     friend DeviceBuilder;
 
+  public:
+    struct MemoryBudgetT
+    {
+        VkDeviceSize usage = 0u;
+        /**
+         * @brief what the process can use before the allocations start to fail or to be moved to the host, accounts for
+         * the other processes
+         *
+         */
+        VkDeviceSize budget = 0u;
+    };
+
   private:
     PFN_DECLARE_VK(vkSetDebugUtilsObjectNameEXT);
 
@@ -65,6 +77,19 @@ class Device
 
     VkCommandPool m_commandPool;
     VkCommandPool m_commandPoolTransient;
+    /**
+     * @brief command pool of the compute queue family, the same family as the graphics one when the device has no
+     * dedicated compute family
+     *
+     */
+    VkCommandPool m_computeCommandPool;
+
+    /**
+     * @brief shared by every pipeline created on the device, the render graph of the next scene does not compile again
+     * the shaders of the pipelines it shares with the previous one
+     *
+     */
+    VkPipelineCache m_pipelineCache = VK_NULL_HANDLE;
 
     /**
      * @brief total number of allocated buffer
@@ -84,9 +109,12 @@ class Device
 
   public:
     PFN_DECLARE_VK(vkCreateAccelerationStructureKHR);
+    PFN_DECLARE_VK(vkDestroyAccelerationStructureKHR);
     PFN_DECLARE_VK(vkGetAccelerationStructureBuildSizesKHR);
     PFN_DECLARE_VK(vkGetAccelerationStructureDeviceAddressKHR);
     PFN_DECLARE_VK(vkCmdBuildAccelerationStructuresKHR);
+    PFN_DECLARE_VK(vkCmdWriteAccelerationStructuresPropertiesKHR);
+    PFN_DECLARE_VK(vkCmdCopyAccelerationStructureKHR);
 
     ~Device();
 
@@ -96,6 +124,13 @@ class Device
     Device &operator=(Device &&) = delete;
 
     std::optional<uint32_t> findQueueFamilyIndex(const VkQueueFlags &capabilities) const;
+    /**
+     * @brief first queue family with the capabilities but none of the excluded ones
+     * a compute family without graphics runs its work asynchronously to the graphics queue
+     *
+     */
+    std::optional<uint32_t> findDedicatedQueueFamilyIndex(const VkQueueFlags &capabilities,
+                                                          const VkQueueFlags &excluded) const;
     std::optional<uint32_t> findPresentQueueFamilyIndex() const;
 
     std::optional<uint32_t> findMemoryTypeIndex(VkMemoryRequirements requirements,
@@ -112,6 +147,17 @@ class Device
 
     void addDebugObjectName(VkDebugUtilsObjectNameInfoEXT nameInfo) const;
 
+    /**
+     * @brief total size of the allocations made through the VMA allocator, in bytes
+     *
+     */
+    [[nodiscard]] VkDeviceSize calculateAllocatedBytes() const;
+    /**
+     * @brief usage and budget of the device local heaps, as reported by VMA
+     *
+     */
+    [[nodiscard]] MemoryBudgetT calculateDeviceLocalBudget() const;
+
   public:
     [[nodiscard]] std::vector<VkQueueFamilyProperties> getQueueFamilyProperties() const;
 
@@ -149,6 +195,14 @@ class Device
     {
         return m_commandPool;
     }
+    [[nodiscard]] inline const VkCommandPool &getComputeCommandPool() const
+    {
+        return m_computeCommandPool;
+    }
+    [[nodiscard]] inline VkPipelineCache getPipelineCache() const
+    {
+        return m_pipelineCache;
+    }
 
     [[nodiscard]] inline const VkSurfaceKHR getSurfaceHandle() const
     {
@@ -164,6 +218,10 @@ class Device
     {
         return m_presentFamilyIndex;
     }
+    [[nodiscard]] inline const std::optional<uint32_t> &getComputeFamilyIndex() const
+    {
+        return m_computeFamilyIndex;
+    }
 
     [[nodiscard]] inline const VkQueue &getGraphicsQueue() const
     {
@@ -178,6 +236,32 @@ class Device
     {
         return m_computeQueue;
     }
+    /**
+     * @brief the compute queue belongs to another family than the graphics queue, the resources they share must be
+     * transferred between the families
+     *
+     */
+    [[nodiscard]] inline bool isAsyncComputeSupported() const
+    {
+        return m_computeFamilyIndex.has_value() && m_computeFamilyIndex != m_graphicsFamilyIndex;
+    }
+
+    /**
+     * @brief shaders can trace rays against acceleration structures without a ray tracing pipeline
+     *
+     */
+    [[nodiscard]] inline bool isRayQuerySupported() const
+    {
+        return m_rqFeatures.rayQuery;
+    }
+    /**
+     * @brief the acceleration structure entry points are loaded, they are null otherwise
+     *
+     */
+    [[nodiscard]] inline bool isAccelerationStructureSupported() const
+    {
+        return m_asFeatures.accelerationStructure;
+    }
 
     [[nodiscard]] inline bool isIntegrated() const
     {
@@ -0,0 +1,89 @@
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+
+#include "buffer.hpp"
+#include "device.hpp"
+
+#include "frame_allocator.hpp"
+
+FrameAllocator::~FrameAllocator() = default;
+
+void FrameAllocator::beginFrame(uint32_t frameIndex)
+{
+    assert(frameIndex < m_frameInFlightCount);
+
+    m_lastFrameStatistics = m_currentFrameStatistics;
+
+    m_currentFrameStatistics.allocationCount = 0u;
+    m_currentFrameStatistics.failedAllocationCount = 0u;
+    m_currentFrameStatistics.allocatedBytes = 0u;
+
+    m_frameIndex = frameIndex;
+    m_frameSerial++;
+    m_head = 0u;
+}
+
+FrameAllocator::Allocation FrameAllocator::allocate(VkDeviceSize size)
+{
+    const VkDeviceSize alignedSize = (size + m_alignment - 1u) & ~(m_alignment - 1u);
+    if (m_head + alignedSize > m_frameCapacity)
+    {
+        if (m_currentFrameStatistics.failedAllocationCount++ == 0u)
+            std::cerr << "Frame allocator is full : " << m_frameCapacity << " bytes per frame" << std::endl;
+        return Allocation{};
+    }
+
+    const VkDeviceSize offset = m_frameIndex * m_frameCapacity + m_head;
+    m_head += alignedSize;
+
+    m_currentFrameStatistics.allocationCount++;
+    m_currentFrameStatistics.allocatedBytes = m_head;
+    m_currentFrameStatistics.peakAllocatedBytes = std::max(m_currentFrameStatistics.peakAllocatedBytes, m_head);
+
+    return Allocation{
+        .data = m_mappedData + offset,
+        .dynamicOffset = static_cast<uint32_t>(offset),
+    };
+}
+
+VkBuffer FrameAllocator::getHandle() const
+{
+    return m_buffer->getHandle();
+}
+
+std::unique_ptr<FrameAllocator> FrameAllocatorBuilder::build()
+{
+    assert(m_device.lock());
+    assert(m_product->m_frameInFlightCount > 0u);
+
+    auto devicePtr = m_device.lock();
+
+    // the regions start on offsets that are valid for both uniform and storage dynamic descriptors
+    const VkPhysicalDeviceLimits &limits = devicePtr->getPhysicalDeviceProperties().limits;
+    m_product->m_alignment =
+        std::max(limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment);
+    m_product->m_frameCapacity =
+        (m_product->m_frameCapacity + m_product->m_alignment - 1u) & ~(m_product->m_alignment - 1u);
+    m_product->m_currentFrameStatistics.frameCapacity = m_product->m_frameCapacity;
+    m_product->m_lastFrameStatistics.frameCapacity = m_product->m_frameCapacity;
+
+    BufferBuilder bb;
+    BufferDirector bd;
+    bd.configureFrameRingBufferBuilder(bb);
+    bb.setSize(m_product->m_frameCapacity * m_product->m_frameInFlightCount);
+    bb.setDevice(m_device);
+    bb.setName(m_name);
+    m_product->m_buffer = bb.build();
+    if (!m_product->m_buffer)
+    {
+        std::cerr << "Failed to create frame allocator buffer" << std::endl;
+        return nullptr;
+    }
+
+    m_product->m_mappedData = static_cast<uint8_t *>(m_product->m_buffer->getMappedData());
+
+    auto result = std::move(m_product);
+    restart();
+    return result;
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <vulkan/vulkan.h>
+
+class Device;
+class Buffer;
+class FrameAllocatorBuilder;
+
+/**
+ * @brief linear allocator for the per draw data written by the CPU every frame
+ * a single persistently mapped buffer is split into one region per frame in flight
+ * allocations are bumped in the region of the current frame and are referenced with dynamic offsets
+ * so that one descriptor set can be bound for any frame
+ *
+ */
+class FrameAllocator
+{
+    friend FrameAllocatorBuilder;
+
+  public:
+    struct Allocation
+    {
+        void *data = nullptr;
+        uint32_t dynamicOffset = 0u;
+    };
+
+    struct Statistics
+    {
+        uint32_t allocationCount = 0u;
+        uint32_t failedAllocationCount = 0u;
+        VkDeviceSize allocatedBytes = 0u;
+        VkDeviceSize peakAllocatedBytes = 0u;
+        VkDeviceSize frameCapacity = 0u;
+    };
+
+  private:
+    std::unique_ptr<Buffer> m_buffer;
+    uint8_t *m_mappedData = nullptr;
+
+    uint32_t m_frameInFlightCount = 1u;
+    VkDeviceSize m_frameCapacity = 4u * 1024u * 1024u;
+    VkDeviceSize m_alignment = 1u;
+
+    uint32_t m_frameIndex = 0u;
+    uint64_t m_frameSerial = 0u;
+    VkDeviceSize m_head = 0u;
+
+    Statistics m_currentFrameStatistics;
+    Statistics m_lastFrameStatistics;
+
+    FrameAllocator() = default;
+
+  public:
+    ~FrameAllocator();
+
+    FrameAllocator(const FrameAllocator &) = delete;
+    FrameAllocator &operator=(const FrameAllocator &) = delete;
+    FrameAllocator(FrameAllocator &&) = delete;
+    FrameAllocator &operator=(FrameAllocator &&) = delete;
+
+    /**
+     * @brief move on to the region of the given frame
+     * must be called once per frame, after waiting for the fences of the frame that used this region last
+     *
+     * @param frameIndex back buffer index of the frame, the region is reused along with the back buffer
+     */
+    void beginFrame(uint32_t frameIndex);
+
+    /**
+     * @brief bump allocate in the region of the current frame
+     *
+     * @param size
+     * @return Allocation with a null data pointer if the region is full
+     */
+    [[nodiscard]] Allocation allocate(VkDeviceSize size);
+
+    template <typename T> [[nodiscard]] T *allocate(uint32_t &dynamicOffset)
+    {
+        Allocation allocation = allocate(sizeof(T));
+        dynamicOffset = allocation.dynamicOffset;
+        return static_cast<T *>(allocation.data);
+    }
+
+  public:
+    [[nodiscard]] VkBuffer getHandle() const;
+
+    /**
+     * @brief number of frames begun so far, used to detect the first allocation of a frame
+     *
+     */
+    [[nodiscard]] inline uint64_t getFrameSerial() const
+    {
+        return m_frameSerial;
+    }
+
+    [[nodiscard]] inline const Statistics &getLastFrameStatistics() const
+    {
+        return m_lastFrameStatistics;
+    }
+};
+
+class FrameAllocatorBuilder
+{
+  private:
+    std::unique_ptr<FrameAllocator> m_product;
+
+    std::weak_ptr<Device> m_device;
+
+    std::string m_name = "Frame Allocator";
+
+    void restart()
+    {
+        m_product = std::unique_ptr<FrameAllocator>(new FrameAllocator);
+    }
+
+  public:
+    FrameAllocatorBuilder()
+    {
+        restart();
+    }
+
+    void setDevice(std::weak_ptr<Device> device)
+    {
+        m_device = device;
+    }
+    void setFrameInFlightCount(uint32_t a)
+    {
+        m_product->m_frameInFlightCount = a;
+    }
+    /**
+     * @brief size in bytes available for each frame
+     *
+     */
+    void setFrameCapacity(VkDeviceSize a)
+    {
+        m_product->m_frameCapacity = a;
+    }
+    void setName(const std::string &name)
+    {
+        m_name = name;
+    }
+
+    std::unique_ptr<FrameAllocator> build();
+};
@@ -14,11 +14,30 @@ Image::~Image()
     auto devicePtr = m_device.lock();
     auto deviceHandle = devicePtr->getHandle();
 
-    vmaDestroyImage(devicePtr->getAllocator(), m_handle, m_allocation);
+    if (m_ownsAllocation)
+        vmaDestroyImage(devicePtr->getAllocator(), m_handle, m_allocation);
+    else
+        vkDestroyImage(deviceHandle, m_handle, nullptr);
     devicePtr->addImageCount(-1);
     devicePtr->untrackImageName(m_name);
 }
 
+VkDeviceSize Image::getAllocationSize() const
+{
+    auto devicePtr = m_device.lock();
+
+    if (!m_ownsAllocation)
+    {
+        VkMemoryRequirements requirements;
+        vkGetImageMemoryRequirements(devicePtr->getHandle(), m_handle, &requirements);
+        return requirements.size;
+    }
+
+    VmaAllocationInfo info;
+    vmaGetAllocationInfo(devicePtr->getAllocator(), m_allocation, &info);
+    return info.size;
+}
+
 void Image::transitionImageLayout(ImageLayoutTransition transition)
 {
     auto devicePtr = m_device.lock();
@@ -100,6 +119,52 @@ void Image::copyBufferToImageCube(VkBuffer buffer)
     devicePtr->cmdEndOneTimeSubmit(commandBuffer);
 }
 
+void Image::copyBufferToImageRegions(VkBuffer buffer, const std::vector<VkBufferImageCopy> &regions)
+{
+    auto devicePtr = m_device.lock();
+    VkCommandBuffer commandBuffer = devicePtr->cmdBeginOneTimeSubmit();
+
+    vkCmdCopyBufferToImage(commandBuffer, buffer, m_handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, regions.size(),
+                           regions.data());
+
+    devicePtr->cmdEndOneTimeSubmit(commandBuffer);
+}
+
+void Image::copyImageToBuffer(VkBuffer buffer, uint32_t layerCount)
+{
+    auto devicePtr = m_device.lock();
+    VkCommandBuffer commandBuffer = devicePtr->cmdBeginOneTimeSubmit();
+
+    VkBufferImageCopy region = {
+        .bufferOffset = 0,
+        .bufferRowLength = 0,
+        .bufferImageHeight = 0,
+        .imageSubresource =
+            {
+                .aspectMask = m_aspectFlags,
+                .mipLevel = 0,
+                .baseArrayLayer = 0,
+                .layerCount = layerCount,
+            },
+        .imageOffset =
+            {
+                .x = 0,
+                .y = 0,
+                .z = 0,
+            },
+        .imageExtent =
+            {
+                .width = m_width,
+                .height = m_height,
+                .depth = 1,
+            },
+    };
+
+    vkCmdCopyImageToBuffer(commandBuffer, m_handle, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffer, 1, &region);
+
+    devicePtr->cmdEndOneTimeSubmit(commandBuffer);
+}
+
 VkImageView Image::createImageView2D()
 {
     auto devicePtr = m_device.lock();
@@ -121,7 +186,7 @@ VkImageView Image::createImageView2D()
             {
                 .aspectMask = m_aspectFlags,
                 .baseMipLevel = 0,
-                .levelCount = 1,
+                .levelCount = m_mipLevels,
                 .baseArrayLayer = 0,
                 .layerCount = 1,
             },
@@ -182,14 +247,9 @@ VkImageView Image::createImageViewCube()
     return imageView;
 }
 
-std::unique_ptr<Image> ImageBuilder::build()
+VkImageCreateInfo ImageBuilder::getCreateInfo() const
 {
-    assert(m_device.lock());
-
-    auto devicePtr = m_device.lock();
-    auto deviceHandle = devicePtr->getHandle();
-
-    VkImageCreateInfo createInfo = {
+    return VkImageCreateInfo{
         .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
         .flags = m_flags,
         .imageType = m_imageType,
@@ -208,17 +268,68 @@ std::unique_ptr<Image> ImageBuilder::build()
         .sharingMode = m_sharingMode,
         .initialLayout = m_initialLayout,
     };
+}
+
+VkMemoryRequirements ImageBuilder::getMemoryRequirements() const
+{
+    assert(m_device.lock());
 
-    VmaAllocationCreateInfo allocInfo = {
-        .requiredFlags = m_properties,
+    const VkImageCreateInfo createInfo = getCreateInfo();
+    const VkDeviceImageMemoryRequirements info = {
+        .sType = VK_STRUCTURE_TYPE_DEVICE_IMAGE_MEMORY_REQUIREMENTS,
+        .pCreateInfo = &createInfo,
+    };
+    VkMemoryRequirements2 requirements = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2,
     };
+    vkGetDeviceImageMemoryRequirements(m_device.lock()->getHandle(), &info, &requirements);
 
-    VkResult res = vmaCreateImage(devicePtr->getAllocator(), &createInfo, &allocInfo, &m_product->m_handle,
-                                  &m_product->m_allocation, nullptr);
-    if (res != VK_SUCCESS)
+    return requirements.memoryRequirements;
+}
+
+std::unique_ptr<Image> ImageBuilder::build()
+{
+    assert(m_device.lock());
+
+    auto devicePtr = m_device.lock();
+    auto deviceHandle = devicePtr->getHandle();
+
+    const VkImageCreateInfo createInfo = getCreateInfo();
+
+    if (m_aliasedAllocation != VK_NULL_HANDLE)
     {
-        std::cerr << "Failed to create image : " << res << std::endl;
-        return nullptr;
+        VkResult res = vkCreateImage(deviceHandle, &createInfo, nullptr, &m_product->m_handle);
+        if (res != VK_SUCCESS)
+        {
+            std::cerr << "Failed to create aliased image : " << res << std::endl;
+            return nullptr;
+        }
+
+        res = vmaBindImageMemory2(devicePtr->getAllocator(), m_aliasedAllocation, m_aliasedAllocationOffset,
+                                  m_product->m_handle, nullptr);
+        if (res != VK_SUCCESS)
+        {
+            std::cerr << "Failed to bind aliased image memory : " << res << std::endl;
+            vkDestroyImage(deviceHandle, m_product->m_handle, nullptr);
+            return nullptr;
+        }
+
+        m_product->m_allocation = m_aliasedAllocation;
+        m_product->m_ownsAllocation = false;
+    }
+    else
+    {
+        VmaAllocationCreateInfo allocInfo = {
+            .requiredFlags = m_properties,
+        };
+
+        VkResult res = vmaCreateImage(devicePtr->getAllocator(), &createInfo, &allocInfo, &m_product->m_handle,
+                                      &m_product->m_allocation, nullptr);
+        if (res != VK_SUCCESS)
+        {
+            std::cerr << "Failed to create image : " << res << std::endl;
+            return nullptr;
+        }
     }
 
     m_product->m_name += std::string(" Image " + std::to_string(devicePtr->getImageCount()));
@@ -231,16 +342,20 @@ std::unique_ptr<Image> ImageBuilder::build()
     devicePtr->addImageCount(1);
     devicePtr->trackImageName(m_product->m_name);
 
-    VmaAllocationInfo info;
-    vmaGetAllocationInfo(devicePtr->getAllocator(), m_product->m_allocation, &info);
-
-    static int imageMemoryCount = 0;
-    devicePtr->addDebugObjectName(VkDebugUtilsObjectNameInfoEXT{
-        .sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT,
-        .objectType = VK_OBJECT_TYPE_DEVICE_MEMORY,
-        .objectHandle = (uint64_t)info.deviceMemory,
-        .pObjectName = std::string("Image Memory " + std::to_string(imageMemoryCount++)).c_str(),
-    });
+    // the memory of an aliased image is named by its owner
+    if (m_product->m_ownsAllocation)
+    {
+        VmaAllocationInfo info;
+        vmaGetAllocationInfo(devicePtr->getAllocator(), m_product->m_allocation, &info);
+
+        static int imageMemoryCount = 0;
+        devicePtr->addDebugObjectName(VkDebugUtilsObjectNameInfoEXT{
+            .sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT,
+            .objectType = VK_OBJECT_TYPE_DEVICE_MEMORY,
+            .objectHandle = (uint64_t)info.deviceMemory,
+            .pObjectName = std::string("Image Memory " + std::to_string(imageMemoryCount++)).c_str(),
+        });
+    }
 
     return std::move(m_product);
 }
@@ -287,6 +402,15 @@ void ImageDirector::configureSampledImage2DBuilder(ImageBuilder &builder)
     builder.setAspectFlags(VK_IMAGE_ASPECT_COLOR_BIT);
 }
 
+void ImageDirector::configureStorageImage2DBuilder(ImageBuilder &builder)
+{
+    configureImage2DBuilder(builder);
+    builder.setUsage(VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+                     VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+    builder.setProperties(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    builder.setAspectFlags(VK_IMAGE_ASPECT_COLOR_BIT);
+}
+
 void ImageDirector::configureSampledImageCubeBuilder(ImageBuilder &builder)
 {
     configureImageCubeBuilder(builder);
@@ -317,7 +441,7 @@ void ImageDirector::configureDepthImageCubeBuilder(ImageBuilder &builder)
 void ImageDirector::configureSampledResolveImageCubeBuilder(ImageBuilder &builder)
 {
     configureImageCubeBuilder(builder);
-    builder.setUsage(VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT |
+    builder.setUsage(VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT |
                      VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT);
     builder.setProperties(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
     builder.setAspectFlags(VK_IMAGE_ASPECT_COLOR_BIT);
@@ -364,7 +488,7 @@ std::unique_ptr<VkSampler> SamplerBuilder::build()
         .compareEnable = VK_FALSE,
         .compareOp = VK_COMPARE_OP_ALWAYS,
         .minLod = 0.f,
-        .maxLod = 0.f,
+        .maxLod = m_maxLod,
         .borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK,
         .unnormalizedCoordinates = VK_FALSE,
     };
@@ -2,6 +2,7 @@
 
 #include <cstdint>
 #include <string>
+#include <vector>
 
 #include <vulkan/vulkan.h>
 
@@ -38,11 +39,17 @@ class Image
     uint32_t m_width;
     uint32_t m_height;
     uint32_t m_depth;
+    uint32_t m_mipLevels = 1U;
 
     VkImageAspectFlags m_aspectFlags;
 
     VkImage m_handle;
     VmaAllocation m_allocation;
+    /**
+     * @brief false if the image is bound to memory owned by someone else (aliased transient images)
+     *
+     */
+    bool m_ownsAllocation = true;
 
     Image() = default;
 
@@ -57,6 +64,17 @@ class Image
     void transitionImageLayout(ImageLayoutTransition transition);
     void copyBufferToImage2D(VkBuffer buffer);
     void copyBufferToImageCube(VkBuffer buffer);
+    /**
+     * @brief copy several regions of a buffer in a single submission
+     * used to upload every mip level of a pre-compressed texture at once
+     *
+     */
+    void copyBufferToImageRegions(VkBuffer buffer, const std::vector<VkBufferImageCopy> &regions);
+    /**
+     * @brief copy the first mip level of every layer to a buffer, the image must be in the transfer source layout
+     *
+     */
+    void copyImageToBuffer(VkBuffer buffer, uint32_t layerCount);
 
     VkImageView createImageView2D();
     VkImageView createImageViewCube();
@@ -70,6 +88,11 @@ class Image
     {
         return m_height;
     }
+    [[nodiscard]] VkDeviceSize getAllocationSize() const;
+    [[nodiscard]] inline uint32_t getMipLevels() const
+    {
+        return m_mipLevels;
+    }
     [[nodiscard]] VkImageAspectFlags getAspectFlags() const
     {
         return m_aspectFlags;
@@ -111,11 +134,16 @@ class ImageBuilder
     VkSharingMode m_sharingMode;
     VkImageLayout m_initialLayout;
 
+    VmaAllocation m_aliasedAllocation = VK_NULL_HANDLE;
+    VkDeviceSize m_aliasedAllocationOffset = 0u;
+
     void restart()
     {
         m_product = std::unique_ptr<Image>(new Image);
     }
 
+    [[nodiscard]] VkImageCreateInfo getCreateInfo() const;
+
   public:
     ImageBuilder()
     {
@@ -166,6 +194,7 @@ class ImageBuilder
     void setMipLevels(uint32_t a)
     {
         m_mipLevels = a;
+        m_product->m_mipLevels = a;
     }
     void setArrayLayers(uint32_t a)
     {
@@ -191,6 +220,24 @@ class ImageBuilder
     {
         m_product->m_name = name;
     }
+    /**
+     * @brief bind the image to an existing allocation instead of allocating its own memory
+     * the allocation is not freed with the image, several images can share it if they are never used at the same time
+     *
+     * @param allocation
+     * @param offset
+     */
+    void setAliasedAllocation(VmaAllocation allocation, VkDeviceSize offset)
+    {
+        m_aliasedAllocation = allocation;
+        m_aliasedAllocationOffset = offset;
+    }
+
+    /**
+     * @brief memory requirements of the image being built, without creating it
+     *
+     */
+    [[nodiscard]] VkMemoryRequirements getMemoryRequirements() const;
 
     std::unique_ptr<Image> build();
 };
@@ -202,6 +249,7 @@ class ImageDirector
     void configureDepthImage2DBuilder(ImageBuilder &builder);
     void configureDepthImageCubeBuilder(ImageBuilder &builder);
     void configureSampledImage2DBuilder(ImageBuilder &builder);
+    void configureStorageImage2DBuilder(ImageBuilder &builder);
     void configureSampledImageCubeBuilder(ImageBuilder &builder);
     void configureNonSampledImageCubeBuilder(ImageBuilder &builder);
     void configureSampledResolveImageCubeBuilder(ImageBuilder &builder);
@@ -324,6 +372,18 @@ class ImageLayoutTransitionDirector
         builder.setDstStageMask(VK_PIPELINE_STAGE_TRANSFER_BIT);
     }
 
+    template <>
+    void configureBuilder<VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL>(
+        ImageLayoutTransitionBuilder &builder) const
+    {
+        builder.setOldLayout(VK_IMAGE_LAYOUT_UNDEFINED);
+        builder.setNewLayout(VK_IMAGE_LAYOUT_GENERAL);
+        builder.setSrcAccessMask(VK_ACCESS_NONE);
+        builder.setDstAccessMask(VK_ACCESS_SHADER_WRITE_BIT);
+        builder.setSrcStageMask(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+        builder.setDstStageMask(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    }
+
     template <>
     void configureBuilder<VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL>(
         ImageLayoutTransitionBuilder &builder) const
@@ -375,6 +435,8 @@ class SamplerBuilder
     VkSamplerAddressMode m_addressmodeY;
     VkSamplerAddressMode m_addressmodeZ;
 
+    float m_maxLod = 0.f;
+
     void restart()
     {
         m_product = std::make_unique<VkSampler>();
@@ -416,6 +478,10 @@ class SamplerBuilder
         m_addressmodeY = xyz;
         m_addressmodeZ = xyz;
     }
+    void setMaxLod(float maxLod)
+    {
+        m_maxLod = maxLod;
+    }
 
     std::unique_ptr<VkSampler> build();
 };
\ No newline at end of file
@@ -72,6 +72,8 @@ void BasePipelineBuilder::restart()
 {
     m_modules.clear();
     m_shaderStageCreateInfos.clear();
+    m_specializationMapEntries.clear();
+    m_specializationData.clear();
 
     m_pushConstantRanges.clear();
 
@@ -121,6 +123,21 @@ bool BasePipelineBuilder::createPipelineLayout()
     return true;
 }
 
+void BasePipelineBuilder::specializeShaderStages()
+{
+    if (m_specializationMapEntries.empty())
+        return;
+
+    m_specializationInfo = VkSpecializationInfo{
+        .mapEntryCount = static_cast<uint32_t>(m_specializationMapEntries.size()),
+        .pMapEntries = m_specializationMapEntries.data(),
+        .dataSize = m_specializationData.size() * sizeof(uint32_t),
+        .pData = m_specializationData.data(),
+    };
+    for (VkPipelineShaderStageCreateInfo &stage : m_shaderStageCreateInfos)
+        stage.pSpecializationInfo = &m_specializationInfo;
+}
+
 void PipelineBuilder<PipelineTypeE::GRAPHICS>::restart()
 {
     BasePipelineBuilder::restart();
@@ -186,6 +203,25 @@ void BasePipelineBuilder::addPushConstantRange(VkPushConstantRange pushConstantR
     m_pushConstantRanges.push_back(pushConstantRange);
 }
 
+void BasePipelineBuilder::addSpecializationConstant(uint32_t constantID, uint32_t value)
+{
+    for (const VkSpecializationMapEntry &entry : m_specializationMapEntries)
+    {
+        if (entry.constantID == constantID)
+        {
+            m_specializationData[entry.offset / sizeof(uint32_t)] = value;
+            return;
+        }
+    }
+
+    m_specializationMapEntries.push_back(VkSpecializationMapEntry{
+        .constantID = constantID,
+        .offset = static_cast<uint32_t>(m_specializationData.size() * sizeof(uint32_t)),
+        .size = sizeof(uint32_t),
+    });
+    m_specializationData.push_back(value);
+}
+
 void PipelineBuilder<PipelineTypeE::GRAPHICS>::setDrawTopology(VkPrimitiveTopology topology,
                                                                bool bPrimitiveRestartEnable)
 {
@@ -323,6 +359,8 @@ std::unique_ptr<Pipeline> PipelineBuilder<PipelineTypeE::GRAPHICS>::build()
     if (!createPipelineLayout())
         return nullptr;
 
+    specializeShaderStages();
+
     VkGraphicsPipelineCreateInfo pipelineCreateInfo = {
         .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
         // shader stage
@@ -346,8 +384,8 @@ std::unique_ptr<Pipeline> PipelineBuilder<PipelineTypeE::GRAPHICS>::build()
         .basePipelineIndex = -1,
     };
 
-    VkResult res =
-        vkCreateGraphicsPipelines(deviceHandle, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &m_product->m_handle);
+    VkResult res = vkCreateGraphicsPipelines(deviceHandle, m_device.lock()->getPipelineCache(), 1, &pipelineCreateInfo,
+                                             nullptr, &m_product->m_handle);
 
     if (res != VK_SUCCESS)
     {
@@ -430,12 +468,15 @@ std::unique_ptr<Pipeline> PipelineBuilder<PipelineTypeE::COMPUTE>::build()
     if (!createPipelineLayout())
         return nullptr;
 
+    specializeShaderStages();
+
     VkComputePipelineCreateInfo createInfo = {
         .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
         .stage = m_shaderStageCreateInfos[0],
         .layout = m_product->m_pipelineLayout,
     };
-    vkCreateComputePipelines(deviceHandle, VK_NULL_HANDLE, 1, &createInfo, nullptr, &m_product->m_handle);
+    vkCreateComputePipelines(deviceHandle, m_device.lock()->getPipelineCache(), 1, &createInfo, nullptr,
+                             &m_product->m_handle);
 
     for (int i = 0; i < m_modules.size(); ++i)
     {
@@ -108,6 +108,11 @@ class BasePipelineBuilder
     std::vector<VkShaderModule> m_modules;
     std::vector<VkPipelineShaderStageCreateInfo> m_shaderStageCreateInfos;
 
+    // specialization constants, shared by every shader stage
+    std::vector<VkSpecializationMapEntry> m_specializationMapEntries;
+    std::vector<uint32_t> m_specializationData;
+    VkSpecializationInfo m_specializationInfo;
+
     // descriptor set layout
     std::vector<VkPushConstantRange> m_pushConstantRanges;
 
@@ -119,6 +124,11 @@ class BasePipelineBuilder
     virtual void restart();
 
     virtual bool createPipelineLayout();
+    /**
+     * @brief point every shader stage to the specialization constants, called before creating the pipeline
+     *
+     */
+    void specializeShaderStages();
 
   public:
     virtual ~BasePipelineBuilder() = default;
@@ -140,6 +150,14 @@ class BasePipelineBuilder
         m_uniformDescriptorPacks.push_back(desc);
     }
     void addPushConstantRange(VkPushConstantRange pushConstantRange);
+    /**
+     * @brief set the value of a specialization constant (layout(constant_id = constantID)) of the shaders
+     * a constant that a shader does not declare is ignored by this shader
+     *
+     * @param constantID
+     * @param value 32 bits int, uint or bool
+     */
+    void addSpecializationConstant(uint32_t constantID, uint32_t value);
     // TODO : move to PipelineBuilder<PipelineTypeE::GRAPHICS>
     void setRenderPass(const RenderPass *a)
     {
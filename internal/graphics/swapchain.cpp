@@ -28,6 +28,11 @@ const VkFormat SwapChain::getDepthImageFormat() const
     return m_depthImage->getFormat();
 }
 
+VkImage SwapChain::getDepthImage() const
+{
+    return m_depthImage->getHandle();
+}
+
 std::unique_ptr<SwapChain> SwapChainBuilder::build()
 {
     assert(m_product->m_device.lock());
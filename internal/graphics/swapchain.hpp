@@ -68,6 +68,7 @@ class SwapChain
         return m_depthImageView;
     }
     [[nodiscard]] const VkFormat getDepthImageFormat() const;
+    [[nodiscard]] VkImage getDepthImage() const;
 
     [[nodiscard]] inline const VkExtent2D &getExtent() const
     {
@@ -0,0 +1,104 @@
+#include <array>
+#include <cassert>
+#include <iostream>
+#include <optional>
+
+#include "device.hpp"
+
+#include "timestamp_query.hpp"
+
+TimestampQuery::~TimestampQuery()
+{
+    if (!m_device.lock())
+        return;
+
+    vkDestroyQueryPool(m_device.lock()->getHandle(), m_handle, nullptr);
+}
+
+void TimestampQuery::recordBegin(VkCommandBuffer commandBuffer, uint32_t frameInFlightIndex)
+{
+    const uint32_t firstQuery = frameInFlightIndex * 2u;
+    vkCmdResetQueryPool(commandBuffer, m_handle, firstQuery, 2u);
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_handle, firstQuery);
+}
+
+void TimestampQuery::recordEnd(VkCommandBuffer commandBuffer, uint32_t frameInFlightIndex)
+{
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_handle, frameInFlightIndex * 2u + 1u);
+    m_recordedFrames[frameInFlightIndex] = true;
+}
+
+bool TimestampQuery::readResults(uint32_t frameInFlightIndex)
+{
+    if (!m_recordedFrames[frameInFlightIndex])
+        return false;
+
+    // value and availability of both timestamps
+    std::array<uint64_t, 4> results = {};
+    const VkResult res =
+        vkGetQueryPoolResults(m_device.lock()->getHandle(), m_handle, frameInFlightIndex * 2u, 2u,
+                              sizeof(results), results.data(), 2u * sizeof(uint64_t),
+                              VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    if ((res != VK_SUCCESS && res != VK_NOT_READY) || results[1] == 0u || results[3] == 0u)
+        return false;
+
+    const uint64_t ticks = (results[2] - results[0]) & m_timestampMask;
+    m_milliseconds = static_cast<double>(ticks) * m_timestampPeriod * 1e-6;
+    m_beginMilliseconds = static_cast<double>(results[0] & m_timestampMask) * m_timestampPeriod * 1e-6;
+    return true;
+}
+
+std::unique_ptr<TimestampQuery> TimestampQueryBuilder::build()
+{
+    assert(m_product->m_device.lock());
+    assert(m_product->m_frameInFlightCount > 0u);
+
+    auto devicePtr = m_product->m_device.lock();
+
+    const VkPhysicalDeviceLimits &limits = devicePtr->getPhysicalDeviceProperties().limits;
+    if (!limits.timestampComputeAndGraphics)
+    {
+        std::cerr << "Device does not support timestamps, " << m_product->m_name << " is not timed" << std::endl;
+        return nullptr;
+    }
+    m_product->m_timestampPeriod = limits.timestampPeriod;
+
+    const std::optional<uint32_t> familyIndex =
+        m_queueFamilyIndex.has_value() ? m_queueFamilyIndex : devicePtr->getGraphicsFamilyIndex();
+    if (familyIndex.has_value())
+    {
+        const uint32_t validBits = devicePtr->getQueueFamilyProperties()[familyIndex.value()].timestampValidBits;
+        if (validBits == 0u)
+        {
+            std::cerr << "Queue family " << familyIndex.value() << " does not support timestamps, "
+                      << m_product->m_name << " is not timed" << std::endl;
+            return nullptr;
+        }
+        if (validBits < 64u)
+            m_product->m_timestampMask = (1ull << validBits) - 1ull;
+    }
+
+    VkQueryPoolCreateInfo createInfo = {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = m_product->m_frameInFlightCount * 2u,
+    };
+    VkResult res = vkCreateQueryPool(devicePtr->getHandle(), &createInfo, nullptr, &m_product->m_handle);
+    if (res != VK_SUCCESS)
+    {
+        std::cerr << "Failed to create query pool : " << res << std::endl;
+        return nullptr;
+    }
+    devicePtr->addDebugObjectName(VkDebugUtilsObjectNameInfoEXT{
+        .sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT,
+        .objectType = VK_OBJECT_TYPE_QUERY_POOL,
+        .objectHandle = (uint64_t)(m_product->m_handle),
+        .pObjectName = std::string(m_product->m_name + " Timestamp Query Pool").c_str(),
+    });
+
+    m_product->m_recordedFrames.resize(m_product->m_frameInFlightCount, false);
+
+    auto result = std::move(m_product);
+    restart();
+    return result;
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+class Device;
+class TimestampQueryBuilder;
+
+/**
+ * @brief GPU duration of the commands recorded between two timestamps
+ * every frame in flight has its own pair of queries so that the results are read without waiting for the device
+ * the results are read back the next time the same frame in flight is recorded, after its fence has been waited for
+ *
+ */
+class TimestampQuery
+{
+    friend TimestampQueryBuilder;
+
+  private:
+    std::weak_ptr<Device> m_device;
+
+    std::string m_name;
+
+    VkQueryPool m_handle = VK_NULL_HANDLE;
+
+    uint32_t m_frameInFlightCount = 1u;
+
+    /**
+     * @brief nanoseconds per timestamp tick
+     *
+     */
+    float m_timestampPeriod = 1.f;
+    uint64_t m_timestampMask = ~0ull;
+
+    /**
+     * @brief the queries of a frame in flight have been recorded at least once and can be read back
+     *
+     */
+    std::vector<bool> m_recordedFrames;
+
+    double m_milliseconds = 0.0;
+    double m_beginMilliseconds = 0.0;
+
+    TimestampQuery() = default;
+
+  public:
+    ~TimestampQuery();
+
+    TimestampQuery(const TimestampQuery &) = delete;
+    TimestampQuery &operator=(const TimestampQuery &) = delete;
+    TimestampQuery(TimestampQuery &&) = delete;
+    TimestampQuery &operator=(TimestampQuery &&) = delete;
+
+    /**
+     * @brief reset the queries of the frame in flight and write the first timestamp
+     * must be recorded outside of a render pass
+     *
+     */
+    void recordBegin(VkCommandBuffer commandBuffer, uint32_t frameInFlightIndex);
+    void recordEnd(VkCommandBuffer commandBuffer, uint32_t frameInFlightIndex);
+
+    /**
+     * @brief update the duration with the results of the frame in flight if they are available
+     *
+     * @param frameInFlightIndex
+     * @return false if the queries have not completed yet, the previous duration is kept
+     */
+    bool readResults(uint32_t frameInFlightIndex);
+
+  public:
+    [[nodiscard]] inline const std::string &getName() const
+    {
+        return m_name;
+    }
+    [[nodiscard]] inline double getMilliseconds() const
+    {
+        return m_milliseconds;
+    }
+    /**
+     * @brief device time of the first timestamp, only meaningful relative to the other queries
+     * the graphics and compute queues share the same time domain on the common implementations, the offsets show
+     * which phases overlap
+     *
+     */
+    [[nodiscard]] inline double getBeginMilliseconds() const
+    {
+        return m_beginMilliseconds;
+    }
+};
+
+class TimestampQueryBuilder
+{
+  private:
+    std::unique_ptr<TimestampQuery> m_product;
+
+    std::optional<uint32_t> m_queueFamilyIndex;
+
+    void restart()
+    {
+        m_product = std::unique_ptr<TimestampQuery>(new TimestampQuery);
+    }
+
+  public:
+    TimestampQueryBuilder()
+    {
+        restart();
+    }
+
+    void setDevice(std::weak_ptr<Device> device)
+    {
+        m_product->m_device = device;
+    }
+    void setFrameInFlightCount(uint32_t a)
+    {
+        m_product->m_frameInFlightCount = a;
+    }
+    /**
+     * @brief family of the queue the commands are submitted to, the graphics family if not set
+     *
+     */
+    void setQueueFamilyIndex(std::optional<uint32_t> a)
+    {
+        m_queueFamilyIndex = a;
+    }
+    /**
+     * @brief name of the measured commands
+     *
+     */
+    void setName(const std::string &name)
+    {
+        m_product->m_name = name;
+    }
+
+    /**
+     * @brief
+     *
+     * @return std::unique_ptr<TimestampQuery> nullptr if the device cannot write timestamps on its graphics and
+     * compute queues or on the queue family
+     */
+    std::unique_ptr<TimestampQuery> build();
+};
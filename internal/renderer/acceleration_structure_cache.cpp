@@ -0,0 +1,711 @@
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+
+#include <tracy/Tracy.hpp>
+
+#include "graphics/buffer.hpp"
+#include "graphics/device.hpp"
+
+#include "mesh.hpp"
+#include "model.hpp"
+#include "render_state.hpp"
+
+#include "acceleration_structure_cache.hpp"
+
+#define alignup(x, alignment) ((x + alignment - 1) / alignment) * alignment
+
+AccelerationStructureCache::~AccelerationStructureCache()
+{
+    auto devicePtr = m_device.lock();
+    if (!devicePtr)
+        return;
+
+    for (auto &[key, tlas] : m_tlas)
+        devicePtr->vkDestroyAccelerationStructureKHR(devicePtr->getHandle(), tlas.structure.handle, nullptr);
+    for (auto &[mesh, blas] : m_blas)
+        devicePtr->vkDestroyAccelerationStructureKHR(devicePtr->getHandle(), blas.handle, nullptr);
+
+    if (!m_updateCommandBuffers.empty())
+        vkFreeCommandBuffers(devicePtr->getHandle(), devicePtr->getCommandPool(),
+                             static_cast<uint32_t>(m_updateCommandBuffers.size()), m_updateCommandBuffers.data());
+}
+
+AccelerationStructureCache::AsGeom AccelerationStructureCache::getMeshGeometry(const Mesh &mesh)
+{
+    // from
+    // https://nvpro-samples.github.io/vk_raytracing_tutorial_KHR/vkrt_tutorial.md.html#accelerationstructure/bottom-levelaccelerationstructure
+
+    // BLAS builder requires raw device addresses.
+    VkDeviceAddress vertexAddress = mesh.getVertexBuffer()->getDeviceAddress();
+    VkDeviceAddress indexAddress = mesh.getIndexBuffer()->getDeviceAddress();
+
+    uint32_t maxPrimitiveCount = mesh.getPrimitiveCount();
+
+    // Describe buffer as array of VertexObj.
+    VkAccelerationStructureGeometryTrianglesDataKHR triangles{
+        VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR};
+    triangles.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT; // vec3 vertex position data.
+    triangles.vertexData.deviceAddress = vertexAddress;
+    triangles.vertexStride = sizeof(Vertex);
+    // Describe index data (16-bit unsigned int)
+    triangles.indexType = VK_INDEX_TYPE_UINT16;
+    triangles.indexData.deviceAddress = indexAddress;
+    // Indicate identity transform by setting transformData to null device pointer.
+    // triangles.transformData = {};
+    triangles.maxVertex = mesh.getVertexCount() - 1;
+
+    // Identify the above data as containing opaque triangles.
+    VkAccelerationStructureGeometryKHR asGeom{VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR};
+    asGeom.geometryType = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
+    asGeom.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
+    asGeom.geometry.triangles = triangles;
+
+    // The entire array will be used to build the BLAS.
+    VkAccelerationStructureBuildRangeInfoKHR offset;
+    offset.firstVertex = 0;
+    offset.primitiveCount = maxPrimitiveCount;
+    offset.primitiveOffset = 0;
+    offset.transformOffset = 0;
+
+    return AsGeom(asGeom, offset);
+}
+
+AccelerationStructureCache::AccelerationStructure AccelerationStructureCache::createAccelerationStructure(
+    VkAccelerationStructureTypeKHR type, VkDeviceSize size, const std::string &name)
+{
+    auto devicePtr = m_device.lock();
+    auto deviceHandle = devicePtr->getHandle();
+
+    AccelerationStructure as;
+
+    BufferBuilder bb;
+    bb.setDevice(m_device);
+    bb.setName(name);
+    bb.setProperties(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    bb.setUsage(VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+    // built on the graphics queue, traversed by the ray queries of the async compute phases
+    bb.setComputeSharingEnable(true);
+    bb.setSize(size);
+    as.buffer = bb.build();
+    if (!as.buffer)
+        return as;
+
+    VkAccelerationStructureCreateInfoKHR createInfo = {
+        .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR,
+        .buffer = as.buffer->getHandle(),
+        .offset = 0,
+        .size = size,
+        .type = type,
+    };
+    VkResult res = devicePtr->vkCreateAccelerationStructureKHR(deviceHandle, &createInfo, nullptr, &as.handle);
+    if (res != VK_SUCCESS)
+    {
+        std::cerr << "Failed to create acceleration structure : " << res << std::endl;
+        as.handle = VK_NULL_HANDLE;
+        return as;
+    }
+
+    VkAccelerationStructureDeviceAddressInfoKHR addressInfo = {
+        .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR,
+        .accelerationStructure = as.handle,
+    };
+    as.address = devicePtr->vkGetAccelerationStructureDeviceAddressKHR(deviceHandle, &addressInfo);
+
+    m_statistics.memoryBytes += size;
+
+    return as;
+}
+
+std::unique_ptr<Buffer> AccelerationStructureCache::createScratchBuffer(VkDeviceSize size,
+                                                                        const std::string &name) const
+{
+    BufferBuilder bb;
+    bb.setDevice(m_device);
+    bb.setName(name);
+    bb.setProperties(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    bb.setUsage(VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    bb.setSize(size);
+    return bb.build();
+}
+
+void AccelerationStructureCache::buildBottomLevel(const std::vector<std::shared_ptr<Mesh>> &meshes)
+{
+    ZoneScoped;
+
+    auto devicePtr = m_device.lock();
+    auto deviceHandle = devicePtr->getHandle();
+
+    const VkDeviceSize minAlignment =
+        devicePtr->getPhysicalDeviceASProperties().minAccelerationStructureScratchOffsetAlignment;
+
+    std::vector<std::shared_ptr<Mesh>> toBuild;
+    for (const std::shared_ptr<Mesh> &mesh : meshes)
+    {
+        auto it = m_blas.find(mesh.get());
+        if (it != m_blas.end() && it->second.mesh.lock() == mesh)
+        {
+            m_statistics.blasReuseCount++;
+            continue;
+        }
+        if (it != m_blas.end())
+        {
+            // the mesh this structure was built from is gone, its address has been reused
+            devicePtr->vkDestroyAccelerationStructureKHR(deviceHandle, it->second.handle, nullptr);
+            m_statistics.memoryBytes -= it->second.buffer->getSize();
+            m_statistics.blasCount--;
+            m_blas.erase(it);
+        }
+        if (std::find(toBuild.begin(), toBuild.end(), mesh) == toBuild.end())
+            toBuild.push_back(mesh);
+    }
+
+    if (toBuild.empty())
+        return;
+
+    std::vector<VkAccelerationStructureGeometryKHR> geometries(toBuild.size());
+    std::vector<VkAccelerationStructureBuildRangeInfoKHR> rangeInfos(toBuild.size());
+    std::vector<VkAccelerationStructureBuildGeometryInfoKHR> buildInfos(toBuild.size());
+    std::vector<VkAccelerationStructureBuildSizesInfoKHR> sizeInfos(toBuild.size());
+
+    VkDeviceSize largestScratch = 0u;
+    for (size_t i = 0; i < toBuild.size(); ++i)
+    {
+        AsGeom g = getMeshGeometry(*toBuild[i]);
+        geometries[i] = g.first;
+        rangeInfos[i] = g.second;
+
+        buildInfos[i] = VkAccelerationStructureBuildGeometryInfoKHR{
+            .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR,
+            .type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR,
+            .flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR |
+                     VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR,
+            .mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR,
+            .geometryCount = 1,
+            .pGeometries = &geometries[i],
+        };
+
+        sizeInfos[i] = VkAccelerationStructureBuildSizesInfoKHR{
+            .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR,
+        };
+        devicePtr->vkGetAccelerationStructureBuildSizesKHR(deviceHandle,
+                                                           VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR,
+                                                           &buildInfos[i], &rangeInfos[i].primitiveCount,
+                                                           &sizeInfos[i]);
+        largestScratch = std::max<VkDeviceSize>(largestScratch, alignup(sizeInfos[i].buildScratchSize, minAlignment));
+    }
+
+    // the scratch buffer is reused by every batch, it only exceeds the budget for a structure larger than it
+    const VkDeviceSize scratchSize = std::max(m_scratchBudget, largestScratch);
+    std::unique_ptr<Buffer> scratchBuffer = createScratchBuffer(scratchSize + minAlignment, "blas scratch buffer");
+    if (!scratchBuffer)
+        return;
+    const VkDeviceAddress scratchAddress0 = alignup(scratchBuffer->getDeviceAddress(), minAlignment);
+
+    VkQueryPoolCreateInfo queryPoolInfo = {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .queryType = VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR,
+        .queryCount = static_cast<uint32_t>(toBuild.size()),
+    };
+    VkQueryPool queryPool;
+    VkResult res = vkCreateQueryPool(deviceHandle, &queryPoolInfo, nullptr, &queryPool);
+    if (res != VK_SUCCESS)
+    {
+        std::cerr << "Failed to create acceleration structure query pool : " << res << std::endl;
+        return;
+    }
+
+    std::vector<AccelerationStructure> built(toBuild.size());
+    std::vector<const VkAccelerationStructureBuildRangeInfoKHR *> ppRangeInfos(toBuild.size());
+    for (size_t batchBegin = 0; batchBegin < toBuild.size();)
+    {
+        // as many structures as the scratch buffer can hold are built together
+        size_t batchEnd = batchBegin;
+        VkDeviceAddress scratchAddress = scratchAddress0;
+        while (batchEnd < toBuild.size())
+        {
+            const VkDeviceSize alignedScratch = alignup(sizeInfos[batchEnd].buildScratchSize, minAlignment);
+            if (batchEnd > batchBegin && scratchAddress - scratchAddress0 + alignedScratch > scratchSize)
+                break;
+
+            built[batchEnd] = createAccelerationStructure(VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR,
+                                                          sizeInfos[batchEnd].accelerationStructureSize, "blas");
+            built[batchEnd].mesh = toBuild[batchEnd];
+            if (built[batchEnd].handle == VK_NULL_HANDLE)
+            {
+                for (const AccelerationStructure &blas : built)
+                    devicePtr->vkDestroyAccelerationStructureKHR(deviceHandle, blas.handle, nullptr);
+                vkDestroyQueryPool(deviceHandle, queryPool, nullptr);
+                return;
+            }
+
+            buildInfos[batchEnd].dstAccelerationStructure = built[batchEnd].handle;
+            buildInfos[batchEnd].scratchData.deviceAddress = scratchAddress;
+            scratchAddress += alignedScratch;
+            ppRangeInfos[batchEnd] = &rangeInfos[batchEnd];
+            batchEnd++;
+        }
+        const uint32_t batchCount = static_cast<uint32_t>(batchEnd - batchBegin);
+
+        std::vector<VkAccelerationStructureKHR> batchHandles(batchCount);
+        for (uint32_t i = 0; i < batchCount; ++i)
+            batchHandles[i] = built[batchBegin + i].handle;
+
+        VkCommandBuffer cmd = devicePtr->cmdBeginOneTimeSubmit("Bottom Level Acceleration Structure build");
+
+        vkCmdResetQueryPool(cmd, queryPool, static_cast<uint32_t>(batchBegin), batchCount);
+        devicePtr->vkCmdBuildAccelerationStructuresKHR(cmd, batchCount, &buildInfos[batchBegin],
+                                                       &ppRangeInfos[batchBegin]);
+
+        VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+        barrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+        barrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                             VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, 0, 1, &barrier, 0, nullptr, 0,
+                             nullptr);
+
+        devicePtr->vkCmdWriteAccelerationStructuresPropertiesKHR(
+            cmd, batchCount, batchHandles.data(), VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR, queryPool,
+            static_cast<uint32_t>(batchBegin));
+
+        devicePtr->cmdEndOneTimeSubmit(cmd);
+        m_statistics.buildBatchCount++;
+
+        compactBottomLevel(queryPool, built, static_cast<uint32_t>(batchBegin), batchCount);
+
+        batchBegin = batchEnd;
+    }
+
+    vkDestroyQueryPool(deviceHandle, queryPool, nullptr);
+
+    for (size_t i = 0; i < toBuild.size(); ++i)
+    {
+        m_blas[toBuild[i].get()] = std::move(built[i]);
+        m_statistics.blasCount++;
+    }
+}
+
+void AccelerationStructureCache::compactBottomLevel(VkQueryPool queryPool, std::vector<AccelerationStructure> &built,
+                                                    uint32_t first, uint32_t count)
+{
+    auto devicePtr = m_device.lock();
+    auto deviceHandle = devicePtr->getHandle();
+
+    std::vector<VkDeviceSize> compactedSizes(count);
+    VkResult res = vkGetQueryPoolResults(deviceHandle, queryPool, first, count, count * sizeof(VkDeviceSize),
+                                         compactedSizes.data(), sizeof(VkDeviceSize),
+                                         VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+    if (res != VK_SUCCESS)
+    {
+        std::cerr << "Failed to get acceleration structure compacted sizes : " << res << std::endl;
+        return;
+    }
+
+    std::vector<AccelerationStructure> compacted(count);
+    VkCommandBuffer cmd = devicePtr->cmdBeginOneTimeSubmit("Bottom Level Acceleration Structure compaction");
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const VkDeviceSize originalSize = built[first + i].buffer->getSize();
+        if (compactedSizes[i] == 0u || compactedSizes[i] >= originalSize)
+            continue;
+
+        compacted[i] =
+            createAccelerationStructure(VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, compactedSizes[i], "blas");
+        if (compacted[i].handle == VK_NULL_HANDLE)
+            continue;
+
+        VkCopyAccelerationStructureInfoKHR copyInfo = {
+            .sType = VK_STRUCTURE_TYPE_COPY_ACCELERATION_STRUCTURE_INFO_KHR,
+            .src = built[first + i].handle,
+            .dst = compacted[i].handle,
+            .mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_COMPACT_KHR,
+        };
+        devicePtr->vkCmdCopyAccelerationStructureKHR(cmd, &copyInfo);
+    }
+
+    VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    barrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+    barrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                         VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, 0, 1, &barrier, 0, nullptr, 0,
+                         nullptr);
+
+    devicePtr->cmdEndOneTimeSubmit(cmd);
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        AccelerationStructure &original = built[first + i];
+        const VkDeviceSize originalSize = original.buffer->getSize();
+        const std::string meshName = original.mesh.lock()->getName();
+        if (compacted[i].handle == VK_NULL_HANDLE)
+        {
+            std::cout << "BLAS " << meshName << " : " << originalSize << " bytes, not compacted" << std::endl;
+            continue;
+        }
+
+        std::cout << "BLAS " << meshName << " : " << originalSize << " bytes compacted to " << compactedSizes[i]
+                  << " bytes" << std::endl;
+
+        devicePtr->vkDestroyAccelerationStructureKHR(deviceHandle, original.handle, nullptr);
+        m_statistics.memoryBytes -= originalSize;
+        m_statistics.compactionSavedBytes += originalSize - compactedSizes[i];
+        compacted[i].mesh = original.mesh;
+        original = std::move(compacted[i]);
+    }
+}
+
+bool AccelerationStructureCache::refreshInstanceTransforms(TopLevel &tlas) const
+{
+    bool changed = false;
+    for (size_t i = 0; i < tlas.models.size(); ++i)
+    {
+        std::shared_ptr<Model> model = tlas.models[i].lock();
+        if (!model)
+            continue;
+
+        glm::mat4 trs = glm::transpose(model->getWorldMatrix());
+        VkTransformMatrixKHR matrix;
+        std::memcpy(&matrix, &trs, sizeof(VkTransformMatrixKHR));
+        if (std::memcmp(&matrix, &tlas.instances[i].transform, sizeof(VkTransformMatrixKHR)) == 0)
+            continue;
+
+        tlas.instances[i].transform = matrix;
+        changed = true;
+    }
+    return changed;
+}
+
+void AccelerationStructureCache::recordTopLevelBuild(VkCommandBuffer cmd, TopLevel &tlas, uint32_t frameIndex,
+                                                     bool update) const
+{
+    auto devicePtr = m_device.lock();
+
+    // each frame in flight has its own copy of the instances, the host never writes the ones being read
+    const VkDeviceSize instanceBytes = sizeof(VkAccelerationStructureInstanceKHR) * tlas.instances.size();
+    std::memcpy(static_cast<uint8_t *>(tlas.instanceBuffer->getMappedData()) + instanceBytes * frameIndex,
+                tlas.instances.data(), instanceBytes);
+
+    VkAccelerationStructureGeometryKHR geometry = {
+        .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR,
+        .geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR,
+        .geometry =
+            VkAccelerationStructureGeometryDataKHR{
+                .instances =
+                    VkAccelerationStructureGeometryInstancesDataKHR{
+                        .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR,
+                        .arrayOfPointers = VK_FALSE,
+                        .data =
+                            VkDeviceOrHostAddressConstKHR{
+                                .deviceAddress = tlas.instanceBuffer->getDeviceAddress() + instanceBytes * frameIndex,
+                            },
+                    },
+            },
+    };
+
+    VkAccelerationStructureBuildGeometryInfoKHR buildInfo = {
+        .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR,
+        .type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR,
+        .flags = s_topLevelBuildFlags,
+        .mode =
+            update ? VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR : VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR,
+        .srcAccelerationStructure = update ? tlas.structure.handle : VK_NULL_HANDLE,
+        .dstAccelerationStructure = tlas.structure.handle,
+        .geometryCount = 1,
+        .pGeometries = &geometry,
+        .scratchData =
+            VkDeviceOrHostAddressKHR{
+                .deviceAddress = tlas.scratchAddress,
+            },
+    };
+
+    VkAccelerationStructureBuildRangeInfoKHR rangeInfo = {
+        .primitiveCount = static_cast<uint32_t>(tlas.instances.size()),
+        .primitiveOffset = 0,
+        .firstVertex = 0,
+        .transformOffset = 0,
+    };
+    const VkAccelerationStructureBuildRangeInfoKHR *pRangeInfo = &rangeInfo;
+
+    devicePtr->vkCmdBuildAccelerationStructuresKHR(cmd, 1, &buildInfo, &pRangeInfo);
+}
+
+VkAccelerationStructureKHR AccelerationStructureCache::getTopLevel(const std::vector<Instance> &instances)
+{
+    ZoneScoped;
+
+    // the transforms are not part of the key, a moving instance keeps its structure and is refitted by update()
+    RecordKey key;
+    for (const Instance &instance : instances)
+    {
+        key.add(instance.mesh.get());
+        key.add(instance.model.lock().get());
+    }
+
+    auto devicePtr = m_device.lock();
+    auto deviceHandle = devicePtr->getHandle();
+
+    auto it = m_tlas.find(key.value);
+    if (it != m_tlas.end() &&
+        std::equal(it->second.models.begin(), it->second.models.end(), instances.begin(), instances.end(),
+                   [](const std::weak_ptr<Model> &model, const Instance &instance) {
+                       return model.lock() == instance.model.lock();
+                   }))
+    {
+        m_statistics.tlasReuseCount++;
+        return it->second.structure.handle;
+    }
+    if (it != m_tlas.end())
+    {
+        // a model this structure was built from is gone, its address has been reused
+        devicePtr->vkDestroyAccelerationStructureKHR(deviceHandle, it->second.structure.handle, nullptr);
+        m_statistics.memoryBytes -= it->second.structure.buffer->getSize();
+        m_statistics.tlasCount--;
+        m_tlas.erase(it);
+    }
+
+    std::vector<std::shared_ptr<Mesh>> meshes;
+    meshes.reserve(instances.size());
+    for (const Instance &instance : instances)
+        meshes.push_back(instance.mesh);
+    buildBottomLevel(meshes);
+
+    const VkDeviceSize minAlignment =
+        devicePtr->getPhysicalDeviceASProperties().minAccelerationStructureScratchOffsetAlignment;
+
+    // from https://web.engr.oregonstate.edu/~mjb/vulkan/Handouts/AccelerationStructures.2pp.pdf
+    TopLevel tlas;
+    tlas.instances.reserve(instances.size());
+    tlas.models.reserve(instances.size());
+    for (const Instance &instance : instances)
+    {
+        auto blas = m_blas.find(instance.mesh.get());
+        if (blas == m_blas.end())
+            return VK_NULL_HANDLE;
+
+        tlas.instances.push_back(VkAccelerationStructureInstanceKHR{
+            .instanceCustomIndex = static_cast<uint32_t>(tlas.instances.size()),
+            .mask = 0xff,
+            .instanceShaderBindingTableRecordOffset = 0,
+            .flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR,
+            .accelerationStructureReference = blas->second.address,
+        });
+        tlas.models.push_back(instance.model);
+    }
+    refreshInstanceTransforms(tlas);
+
+    BufferBuilder bb;
+    bb.setDevice(m_device);
+    bb.setName("tlas instance buffer");
+    bb.setProperties(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    bb.setUsage(VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
+                VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR);
+    bb.setPersistentlyMapped(true);
+    bb.setSize(std::max<size_t>(
+        sizeof(VkAccelerationStructureInstanceKHR) * tlas.instances.size() * m_frameInFlightCount, 1u));
+    tlas.instanceBuffer = bb.build();
+    if (!tlas.instanceBuffer)
+        return VK_NULL_HANDLE;
+
+    VkAccelerationStructureGeometryKHR geometry = {
+        .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR,
+        .geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR,
+        .geometry =
+            VkAccelerationStructureGeometryDataKHR{
+                .instances =
+                    VkAccelerationStructureGeometryInstancesDataKHR{
+                        .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR,
+                        .arrayOfPointers = VK_FALSE,
+                    },
+            },
+    };
+    VkAccelerationStructureBuildGeometryInfoKHR buildInfo = {
+        .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR,
+        .type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR,
+        .flags = s_topLevelBuildFlags,
+        .mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR,
+        .geometryCount = 1,
+        .pGeometries = &geometry,
+    };
+
+    const uint32_t instanceCount = static_cast<uint32_t>(tlas.instances.size());
+    VkAccelerationStructureBuildSizesInfoKHR sizeInfo = {
+        .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR,
+    };
+    devicePtr->vkGetAccelerationStructureBuildSizesKHR(deviceHandle, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR,
+                                                       &buildInfo, &instanceCount, &sizeInfo);
+
+    // kept alive for the refits and the periodic rebuilds
+    tlas.scratchBuffer = createScratchBuffer(
+        std::max(sizeInfo.buildScratchSize, sizeInfo.updateScratchSize) + minAlignment, "tlas scratch buffer");
+    if (!tlas.scratchBuffer)
+        return VK_NULL_HANDLE;
+    tlas.scratchAddress = alignup(tlas.scratchBuffer->getDeviceAddress(), minAlignment);
+
+    tlas.structure =
+        createAccelerationStructure(VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR, sizeInfo.accelerationStructureSize,
+                                    "tlas");
+    if (tlas.structure.handle == VK_NULL_HANDLE)
+        return VK_NULL_HANDLE;
+
+    VkCommandBuffer cmd = devicePtr->cmdBeginOneTimeSubmit("Top Level Acceleration Structure build");
+
+    recordTopLevelBuild(cmd, tlas, m_frameIndex, false);
+
+    VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    barrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+    barrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    devicePtr->cmdEndOneTimeSubmit(cmd);
+
+    VkAccelerationStructureKHR handle = tlas.structure.handle;
+    m_tlas[key.value] = std::move(tlas);
+    m_statistics.tlasCount++;
+
+    return handle;
+}
+
+void AccelerationStructureCache::update(uint32_t frameIndex)
+{
+    ZoneScoped;
+
+    // the fences of the frame that used this copy of the instances last have been waited by the renderer
+    assert(frameIndex < m_frameInFlightCount);
+    m_frameIndex = frameIndex;
+
+    auto devicePtr = m_device.lock();
+    VkCommandBuffer cmd = m_updateCommandBuffers[m_frameIndex];
+    bool recording = false;
+
+    for (auto &[key, tlas] : m_tlas)
+    {
+        if (!refreshInstanceTransforms(tlas))
+            continue;
+
+        if (!recording)
+        {
+            VkCommandBufferBeginInfo beginInfo = {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+                .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+            };
+            VkResult res = vkBeginCommandBuffer(cmd, &beginInfo);
+            if (res != VK_SUCCESS)
+            {
+                std::cerr << "Failed to begin acceleration structure update command buffer : " << res << std::endl;
+                return;
+            }
+
+            // the previous frames may still trace the structures that are about to be written
+            VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+            barrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+            barrier.dstAccessMask =
+                VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+            vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                                 VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, 0, 1, &barrier, 0, nullptr, 0,
+                                 nullptr);
+            recording = true;
+        }
+
+        // refits degrade the quality of the hierarchy, it is built again from scratch once in a while
+        const bool rebuild = ++tlas.updatesSinceRebuild >= m_rebuildPeriod;
+        if (rebuild)
+            tlas.updatesSinceRebuild = 0u;
+        recordTopLevelBuild(cmd, tlas, m_frameIndex, !rebuild);
+
+        if (rebuild)
+            m_statistics.tlasRebuildCount++;
+        else
+            m_statistics.tlasUpdateCount++;
+    }
+
+    if (!recording)
+        return;
+
+    VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    barrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+    barrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    VkResult res = vkEndCommandBuffer(cmd);
+    if (res != VK_SUCCESS)
+    {
+        std::cerr << "Failed to record acceleration structure update command buffer : " << res << std::endl;
+        return;
+    }
+
+    // submitted before the phases of the frame on the same queue, the barriers order it with them
+    VkSubmitInfo submitInfo = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &cmd,
+    };
+    res = vkQueueSubmit(devicePtr->getGraphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE);
+    if (res != VK_SUCCESS)
+        std::cerr << "Failed to submit acceleration structure update : " << res << std::endl;
+}
+
+void AccelerationStructureCache::releaseExpired()
+{
+    auto devicePtr = m_device.lock();
+    auto deviceHandle = devicePtr->getHandle();
+
+    for (auto it = m_tlas.begin(); it != m_tlas.end();)
+    {
+        const std::vector<std::weak_ptr<Model>> &models = it->second.models;
+        if (std::none_of(models.begin(), models.end(), [](const std::weak_ptr<Model> &m) { return m.expired(); }))
+        {
+            ++it;
+            continue;
+        }
+
+        devicePtr->vkDestroyAccelerationStructureKHR(deviceHandle, it->second.structure.handle, nullptr);
+        m_statistics.memoryBytes -= it->second.structure.buffer->getSize();
+        m_statistics.tlasCount--;
+        it = m_tlas.erase(it);
+    }
+
+    for (auto it = m_blas.begin(); it != m_blas.end();)
+    {
+        if (!it->second.mesh.expired())
+        {
+            ++it;
+            continue;
+        }
+
+        devicePtr->vkDestroyAccelerationStructureKHR(deviceHandle, it->second.handle, nullptr);
+        m_statistics.memoryBytes -= it->second.buffer->getSize();
+        m_statistics.blasCount--;
+        it = m_blas.erase(it);
+    }
+}
+
+std::unique_ptr<AccelerationStructureCache> AccelerationStructureCacheBuilder::build()
+{
+    assert(m_product->m_device.lock());
+    assert(m_product->m_frameInFlightCount > 0u);
+    assert(m_product->m_rebuildPeriod > 0u);
+
+    auto devicePtr = m_product->m_device.lock();
+
+    m_product->m_updateCommandBuffers.resize(m_product->m_frameInFlightCount);
+    VkCommandBufferAllocateInfo allocInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = devicePtr->getCommandPool(),
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = m_product->m_frameInFlightCount,
+    };
+    VkResult res =
+        vkAllocateCommandBuffers(devicePtr->getHandle(), &allocInfo, m_product->m_updateCommandBuffers.data());
+    if (res != VK_SUCCESS)
+    {
+        std::cerr << "Failed to allocate acceleration structure update command buffers : " << res << std::endl;
+        return nullptr;
+    }
+
+    auto result = std::move(m_product);
+    restart();
+    return result;
+}
@@ -0,0 +1,239 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <vulkan/vulkan.h>
+
+class Device;
+class Buffer;
+class Mesh;
+class Model;
+class AccelerationStructureCacheBuilder;
+
+/**
+ * @brief ray tracing acceleration structures shared by every phase of a render graph
+ * a bottom level structure is built once per mesh, whichever phase asks for it first
+ * a top level structure is built once per distinct set of instances, phases tracing the same scene share it
+ *
+ */
+class AccelerationStructureCache
+{
+    friend AccelerationStructureCacheBuilder;
+
+  public:
+    /**
+     * @brief combination of Vulkan structures representing a mesh as a ray traceable geometry
+     *
+     */
+    using AsGeom = std::pair<VkAccelerationStructureGeometryKHR, VkAccelerationStructureBuildRangeInfoKHR>;
+
+    /**
+     * @brief a mesh placed by the transform of its model
+     *
+     */
+    struct Instance
+    {
+        std::shared_ptr<Mesh> mesh;
+        std::weak_ptr<Model> model;
+    };
+
+    struct Statistics
+    {
+        uint32_t blasCount = 0u;
+        uint32_t blasReuseCount = 0u;
+        uint32_t tlasCount = 0u;
+        uint32_t tlasReuseCount = 0u;
+        VkDeviceSize memoryBytes = 0u;
+        /**
+         * @brief memory given back by compacting the bottom level structures once built
+         *
+         */
+        VkDeviceSize compactionSavedBytes = 0u;
+        uint32_t buildBatchCount = 0u;
+        /**
+         * @brief top level structures refitted to moved instances
+         *
+         */
+        uint32_t tlasUpdateCount = 0u;
+        uint32_t tlasRebuildCount = 0u;
+    };
+
+  private:
+    struct AccelerationStructure
+    {
+        VkAccelerationStructureKHR handle = VK_NULL_HANDLE;
+        std::unique_ptr<Buffer> buffer;
+        VkDeviceAddress address = 0u;
+
+        /**
+         * @brief the mesh the structure was built from, a new mesh at the same address must not reuse it
+         *
+         */
+        std::weak_ptr<Mesh> mesh;
+    };
+
+    struct TopLevel
+    {
+        AccelerationStructure structure;
+
+        std::vector<std::weak_ptr<Model>> models;
+        std::vector<VkAccelerationStructureInstanceKHR> instances;
+        /**
+         * @brief one copy of the instances per frame in flight
+         *
+         */
+        std::unique_ptr<Buffer> instanceBuffer;
+        std::unique_ptr<Buffer> scratchBuffer;
+        VkDeviceAddress scratchAddress = 0u;
+
+        uint32_t updatesSinceRebuild = 0u;
+    };
+
+    static constexpr VkBuildAccelerationStructureFlagsKHR s_topLevelBuildFlags =
+        VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR |
+        VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR;
+
+    std::weak_ptr<Device> m_device;
+
+    std::unordered_map<const Mesh *, AccelerationStructure> m_blas;
+    std::unordered_map<uint64_t, TopLevel> m_tlas;
+
+    uint32_t m_frameInFlightCount = 1u;
+    uint32_t m_frameIndex = 0u;
+    std::vector<VkCommandBuffer> m_updateCommandBuffers;
+
+    /**
+     * @brief number of refits after which a top level structure is built again from scratch
+     *
+     */
+    uint32_t m_rebuildPeriod = 60u;
+
+    /**
+     * @brief scratch memory used to build bottom level structures, larger scenes are built in several batches
+     *
+     */
+    VkDeviceSize m_scratchBudget = 32ull * 1024ull * 1024ull;
+
+    Statistics m_statistics;
+
+    AccelerationStructureCache() = default;
+
+    [[nodiscard]] AccelerationStructure createAccelerationStructure(VkAccelerationStructureTypeKHR type,
+                                                                    VkDeviceSize size, const std::string &name);
+    [[nodiscard]] std::unique_ptr<Buffer> createScratchBuffer(VkDeviceSize size, const std::string &name) const;
+
+    /**
+     * @brief read the transforms of the models of the instances
+     *
+     * @return true if one of them has moved
+     */
+    bool refreshInstanceTransforms(TopLevel &tlas) const;
+    void recordTopLevelBuild(VkCommandBuffer cmd, TopLevel &tlas, uint32_t frameIndex, bool update) const;
+
+    /**
+     * @brief replace the structures of a batch by copies of their compacted size
+     *
+     * @param queryPool holds the compacted size of each structure of the batch
+     * @param built
+     * @param first first structure of the batch
+     * @param count
+     */
+    void compactBottomLevel(VkQueryPool queryPool, std::vector<AccelerationStructure> &built, uint32_t first,
+                            uint32_t count);
+
+  public:
+    ~AccelerationStructureCache();
+
+    AccelerationStructureCache(const AccelerationStructureCache &) = delete;
+    AccelerationStructureCache &operator=(const AccelerationStructureCache &) = delete;
+    AccelerationStructureCache(AccelerationStructureCache &&) = delete;
+    AccelerationStructureCache &operator=(AccelerationStructureCache &&) = delete;
+
+    /**
+     * @brief Get the As Geometry object
+     * function implementation is from
+     * https://nvpro-samples.github.io/vk_raytracing_tutorial_KHR/vkrt_tutorial.md.html#accelerationstructure/bottom-levelaccelerationstructure
+     *
+     * @return AsGeom
+     */
+    [[nodiscard]] static AsGeom getMeshGeometry(const Mesh &mesh);
+
+    /**
+     * @brief build and compact the bottom level structures of the meshes that do not have one yet
+     * the structures are built in batches whose scratch memory fits in the budget
+     *
+     * @param meshes
+     */
+    void buildBottomLevel(const std::vector<std::shared_ptr<Mesh>> &meshes);
+
+    /**
+     * @brief top level structure over the given instances, only built the first time this set of instances is asked
+     * the structure follows the models afterwards, see update()
+     *
+     * @param instances
+     * @return VkAccelerationStructureKHR null if the build failed
+     */
+    [[nodiscard]] VkAccelerationStructureKHR getTopLevel(const std::vector<Instance> &instances);
+
+    /**
+     * @brief refit the top level structures whose instances have moved, submitted before the phases of the frame
+     *
+     * @param frameIndex back buffer index of the frame, the copy of the instances is reused along with the back buffer
+     */
+    void update(uint32_t frameIndex);
+
+    /**
+     * @brief destroy the structures of the meshes and models that do not exist anymore, the device being idle
+     *
+     */
+    void releaseExpired();
+
+  public:
+    [[nodiscard]] inline const Statistics &getStatistics() const
+    {
+        return m_statistics;
+    }
+};
+
+class AccelerationStructureCacheBuilder
+{
+  private:
+    std::unique_ptr<AccelerationStructureCache> m_product;
+
+    void restart()
+    {
+        m_product = std::unique_ptr<AccelerationStructureCache>(new AccelerationStructureCache);
+    }
+
+  public:
+    AccelerationStructureCacheBuilder()
+    {
+        restart();
+    }
+
+    void setDevice(std::weak_ptr<Device> device)
+    {
+        m_product->m_device = device;
+    }
+    void setScratchBudget(VkDeviceSize budget)
+    {
+        m_product->m_scratchBudget = budget;
+    }
+    void setFrameInFlightCount(uint32_t count)
+    {
+        m_product->m_frameInFlightCount = count;
+    }
+    void setRebuildPeriod(uint32_t period)
+    {
+        m_product->m_rebuildPeriod = period;
+    }
+
+    std::unique_ptr<AccelerationStructureCache> build();
+};
@@ -2,17 +2,33 @@
 
 #include <glm/glm.hpp>
 
+enum class LightTypeE
+{
+    POINT,
+    DIRECTIONAL,
+};
+
 class Light
 {
+  protected:
+    explicit Light(LightTypeE type) : type(type)
+    {
+    }
+
   public:
     virtual ~Light() = default;
 
-    Light() = default;
     Light(const Light &) = delete;
     Light &operator=(const Light &) = delete;
     Light(Light &&) = delete;
     Light &operator=(Light &&) = delete;
 
+    /**
+     * @brief allows the renderer to pack the lights without casting them
+     *
+     */
+    const LightTypeE type;
+
     glm::vec3 diffuseColor;
     float diffusePower;
     glm::vec3 specularColor;
@@ -22,6 +38,10 @@ class Light
 class PointLight : public Light
 {
   public:
+    PointLight() : Light(LightTypeE::POINT)
+    {
+    }
+
     glm::vec3 position;
     glm::vec3 attenuation = glm::vec3(0.f, 0.f, 1.f);
 };
@@ -29,5 +49,9 @@ class PointLight : public Light
 class DirectionalLight : public Light
 {
   public:
+    DirectionalLight() : Light(LightTypeE::DIRECTIONAL)
+    {
+    }
+
     glm::vec3 direction;
 };
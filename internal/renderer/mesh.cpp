@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 
 #include <glm/gtc/constants.hpp>
@@ -117,6 +119,28 @@ void MeshBuilder::setIndicesFromAiMesh(const aiMesh *pMesh)
     }
 }
 
+void MeshBuilder::computeBoundingSphere()
+{
+    // centered on the bounding box, not the smallest sphere but enough to estimate the size of the mesh on screen
+    glm::vec3 boundsMin = m_product->m_vertices[0].position;
+    glm::vec3 boundsMax = boundsMin;
+    for (const Vertex &vertex : m_product->m_vertices)
+    {
+        boundsMin = glm::min(boundsMin, vertex.position);
+        boundsMax = glm::max(boundsMax, vertex.position);
+    }
+
+    m_product->m_boundingCenter = (boundsMin + boundsMax) * 0.5f;
+
+    float radius2 = 0.f;
+    for (const Vertex &vertex : m_product->m_vertices)
+    {
+        const glm::vec3 offset = vertex.position - m_product->m_boundingCenter;
+        radius2 = std::max(radius2, glm::dot(offset, offset));
+    }
+    m_product->m_boundingRadius = std::sqrt(radius2);
+}
+
 std::unique_ptr<Mesh> MeshBuilder::buildAndRestart()
 {
     assert(!m_device.expired());
@@ -140,6 +164,7 @@ std::unique_ptr<Mesh> MeshBuilder::buildAndRestart()
 
     createVertexBuffer();
     createIndexBuffer();
+    computeBoundingSphere();
 
     auto result = std::move(m_product);
     restart();
@@ -31,6 +31,13 @@ class Mesh
 
     std::shared_ptr<Texture> m_texture;
 
+    /**
+     * @brief sphere enclosing the vertices, in the space of the model
+     *
+     */
+    glm::vec3 m_boundingCenter = glm::vec3(0.f);
+    float m_boundingRadius = 0.f;
+
     Mesh() = default;
 
   public:
@@ -66,6 +73,14 @@ class Mesh
     {
         return m_indices.size();
     }
+    [[nodiscard]] inline const std::vector<Vertex> &getVertices() const
+    {
+        return m_vertices;
+    }
+    [[nodiscard]] inline const std::vector<uint16_t> &getIndices() const
+    {
+        return m_indices;
+    }
     [[nodiscard]] inline std::weak_ptr<Texture> getTexture() const
     {
         return m_texture;
@@ -80,6 +95,14 @@ class Mesh
     {
         return m_indices.size() / 3;
     }
+    [[nodiscard]] inline const glm::vec3 &getBoundingCenter() const
+    {
+        return m_boundingCenter;
+    }
+    [[nodiscard]] inline float getBoundingRadius() const
+    {
+        return m_boundingRadius;
+    }
 
   public:
     void setTexture(const std::shared_ptr<Texture> &texture)
@@ -107,6 +130,7 @@ class MeshBuilder
 
     void createVertexBuffer();
     void createIndexBuffer();
+    void computeBoundingSphere();
 
   public:
     MeshBuilder()
@@ -12,13 +12,15 @@
 
 #include "mesh.hpp"
 #include "model.hpp"
+#include "resource_registry.hpp"
 #include "texture.hpp"
+#include "texture_streamer.hpp"
 
 Model::~Model()
 {
     std::cout << "Destroying model " << m_name << std::endl;
-    for (int i = 0; i < m_meshes.size(); ++i)
-        std::cout << "\t" << m_meshes[i]->getName() << std::endl;
+    for (int i = 0; i < m_meshes->size(); ++i)
+        std::cout << "\t" << (*m_meshes)[i]->getName() << std::endl;
 }
 
 void ModelBuilder::setMesh(const std::shared_ptr<Mesh> &mesh, uint32_t meshIndex)
@@ -32,72 +34,123 @@ void ModelBuilder::setName(const std::string &name)
     m_product->setName(name);
 }
 
-std::unique_ptr<Model> ModelBuilder::build()
+std::shared_ptr<std::vector<std::shared_ptr<Mesh>>> ModelBuilder::loadMeshesFromFile() const
 {
-    if (m_bLoadFromFile)
+    std::filesystem::path scenePath = m_modelFilename;
+    scenePath.remove_filename();
+
+    Assimp::Importer importer;
+    const aiScene *pScene = importer.ReadFile(m_modelFilename, m_importerFlags);
+    if (!pScene)
     {
-        std::filesystem::path scenePath = m_modelFilename;
-        scenePath.remove_filename();
+        std::cerr << "Failed to load model : " << m_modelFilename << std::endl;
+        return nullptr;
+    }
 
-        Assimp::Importer importer;
-        const aiScene *pScene = importer.ReadFile(m_modelFilename, m_importerFlags);
-        if (!pScene)
-        {
-            std::cerr << "Failed to load model : " << m_modelFilename << std::endl;
-            return nullptr;
-        }
+    TextureDirector textureDirector;
 
-        TextureDirector textureDirector;
+    std::unordered_map<std::filesystem::path, std::shared_ptr<Texture>> loadedTextures;
+    VkDeviceSize textureMemorySize = 0;
 
-        std::unordered_map<std::filesystem::path, std::shared_ptr<Texture>> loadedTextures;
+    auto meshes = std::make_shared<std::vector<std::shared_ptr<Mesh>>>();
+    meshes->reserve(pScene->mNumMeshes);
+    for (uint32_t i = 0u; i < pScene->mNumMeshes; i++)
+    {
+        const aiMesh *pMesh = pScene->mMeshes[i];
 
-        m_product->m_meshes.reserve(pScene->mNumMeshes);
-        for (uint32_t i = 0u; i < pScene->mNumMeshes; i++)
-        {
-            const aiMesh *pMesh = pScene->mMeshes[i];
+        MeshBuilder meshBuilder;
+        meshBuilder.setDevice(m_device);
+        meshBuilder.setVerticesFromAiMesh(pMesh);
+        meshBuilder.setIndicesFromAiMesh(pMesh);
 
-            MeshBuilder meshBuilder;
-            meshBuilder.setDevice(m_device);
-            meshBuilder.setVerticesFromAiMesh(pMesh);
-            meshBuilder.setIndicesFromAiMesh(pMesh);
+        std::shared_ptr<Mesh> mesh = meshBuilder.buildAndRestart();
 
-            std::shared_ptr<Mesh> mesh = meshBuilder.buildAndRestart();
+        const uint32_t matIndex = pMesh->mMaterialIndex;
+        const aiMaterial *pMaterial = pScene->mMaterials[matIndex];
 
-            const uint32_t matIndex = pMesh->mMaterialIndex;
-            const aiMaterial *pMaterial = pScene->mMaterials[matIndex];
+        aiString sTexture;
+        if (pMaterial->GetTexture(aiTextureType_DIFFUSE, 0, &sTexture) == aiReturn_SUCCESS)
+        {
+            std::shared_ptr<Texture> meshTexture;
+
+            const std::filesystem::path texturePath = scenePath / sTexture.C_Str();
 
-            aiString sTexture;
-            if (pMaterial->GetTexture(aiTextureType_DIFFUSE, 0, &sTexture) == aiReturn_SUCCESS)
+            auto loadedTextureIt = loadedTextures.find(texturePath);
+            if (loadedTextureIt != loadedTextures.end())
             {
-                std::shared_ptr<Texture> meshTexture;
+                meshTexture = loadedTextureIt->second;
+            }
+            else
+            {
+                TextureBuilder textureBuilder;
 
-                const std::filesystem::path texturePath = scenePath / sTexture.C_Str();
+                // loaded at a low resolution, the texture streamer of the registry loads the finer levels once they are
+                // needed
+                if (m_registry)
+                {
+                    textureBuilder.setStreamingEnable(true);
+                    textureBuilder.setMaxExtent(TextureStreamer::s_initialExtent);
+                }
 
-                auto loadedTextureIt = loadedTextures.find(texturePath);
-                if (loadedTextureIt != loadedTextures.end())
+                // prefer the block-compressed version produced offline by the texture compressor
+                std::filesystem::path compressedTexturePath = texturePath;
+                compressedTexturePath.replace_extension(".dds");
+                if (std::filesystem::exists(compressedTexturePath))
                 {
-                    meshTexture = loadedTextureIt->second;
+                    textureDirector.configureCompressedTextureBuilder(textureBuilder);
+                    textureBuilder.setDevice(m_device);
+                    textureBuilder.setTextureFilename(compressedTexturePath.string());
+                    textureBuilder.setName(texturePath.string() + " Model texture");
+
+                    meshTexture = textureBuilder.buildAndRestart();
                 }
-                else
+
+                if (!meshTexture)
                 {
-                    TextureBuilder textureBuilder;
                     textureDirector.configureSRGBTextureBuilder(textureBuilder);
                     textureBuilder.setDevice(m_device);
                     textureBuilder.setTextureFilename(texturePath.string());
                     textureBuilder.setName(texturePath.string() + " Model texture");
 
                     meshTexture = textureBuilder.buildAndRestart();
-                    loadedTextures.insert({texturePath, meshTexture});
                 }
 
-                mesh->setTexture(meshTexture);
+                if (meshTexture)
+                    textureMemorySize += meshTexture->getImageMemorySize();
+                loadedTextures.insert({texturePath, meshTexture});
             }
 
-            m_meshes.push_back(mesh);
+            mesh->setTexture(meshTexture);
         }
+
+        meshes->push_back(mesh);
     }
 
-    assert(m_meshes.size() > 0u);
-    m_product->m_meshes = m_meshes;
+    if (m_registry)
+        m_registry->recordLoadedTextures(static_cast<uint32_t>(loadedTextures.size()), textureMemorySize);
+
+    return meshes;
+}
+
+std::unique_ptr<Model> ModelBuilder::build()
+{
+    if (m_bLoadFromFile)
+    {
+        std::shared_ptr<std::vector<std::shared_ptr<Mesh>>> meshes =
+            m_registry ? m_registry->getOrLoad<std::vector<std::shared_ptr<Mesh>>>(
+                             m_modelFilename + ':' + std::to_string(m_importerFlags),
+                             [this]() { return loadMeshesFromFile(); })
+                       : loadMeshesFromFile();
+        if (!meshes)
+            return nullptr;
+
+        m_product->m_meshes = meshes;
+    }
+    else
+    {
+        m_product->m_meshes = std::make_shared<const std::vector<std::shared_ptr<Mesh>>>(m_meshes);
+    }
+
+    assert(m_product->m_meshes->size() > 0u);
     return std::move(m_product);
-}
\ No newline at end of file
+}
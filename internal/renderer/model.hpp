@@ -1,20 +1,35 @@
 #pragma once
 
+#include <cassert>
 #include <memory>
 #include <string>
 
 #include "engine/transform.hpp"
+#include "engine/transform_store.hpp"
 
 class Mesh;
 class Device;
+class ResourceRegistry;
 
 class Model
 {
     friend class ModelBuilder;
 
   private:
-    std::vector<std::shared_ptr<Mesh>> m_meshes;
+    /**
+     * @brief shared by the models loaded from the same file through the resource registry
+     *
+     */
+    std::shared_ptr<const std::vector<std::shared_ptr<Mesh>>> m_meshes =
+        std::make_shared<const std::vector<std::shared_ptr<Mesh>>>();
+    /**
+     * @brief used until the model is added to a transform store
+     *
+     */
     Transform m_transform;
+    std::shared_ptr<TransformStore> m_transformStore;
+    uint32_t m_transformIndex = 0u;
+
     std::string m_name = "default";
 
   public:
@@ -27,31 +42,70 @@ class Model
     Model &operator=(Model &&) = delete;
 
   public:
-    [[nodiscard]] const Transform &getTransform() const
+    [[nodiscard]] Transform getTransform() const
     {
+        if (m_transformStore)
+            return m_transformStore->get(m_transformIndex);
+
         return m_transform;
     }
+    /**
+     * @brief cached by the transform store, as of its last update
+     *
+     */
+    [[nodiscard]] glm::mat4 getWorldMatrix() const
+    {
+        if (m_transformStore)
+            return m_transformStore->getWorldMatrix(m_transformIndex);
+
+        return m_transform.getTransformMatrix();
+    }
+    [[nodiscard]] const std::shared_ptr<TransformStore> &getTransformStore() const
+    {
+        return m_transformStore;
+    }
+    [[nodiscard]] inline uint32_t getTransformIndex() const
+    {
+        return m_transformIndex;
+    }
     [[nodiscard]] const std::string &getName() const
     {
         return m_name;
     }
     [[nodiscard]] const std::shared_ptr<Mesh> getMesh(uint32_t meshIndex = 0u) const
     {
-        if (meshIndex > m_meshes.size())
+        if (meshIndex > m_meshes->size())
             return nullptr;
 
-        return m_meshes[meshIndex];
+        return (*m_meshes)[meshIndex];
     }
 
     [[nodiscard]] const std::vector<std::shared_ptr<Mesh>> &getMeshes() const
     {
-        return m_meshes;
+        return *m_meshes;
     }
 
   public:
     void setTransform(const Transform &transform)
     {
-        m_transform = transform;
+        if (m_transformStore)
+            m_transformStore->set(m_transformIndex, transform);
+        else
+            m_transform = transform;
+    }
+    /**
+     * @brief move the transform of the model to the store, a model is added to a single store
+     *
+     * @param parent model already added to the same store, its transform becomes the parent of this one
+     */
+    void addToTransformStore(const std::shared_ptr<TransformStore> &store, const Model *parent = nullptr)
+    {
+        assert(!m_transformStore);
+        assert(!parent || parent->m_transformStore == store);
+
+        m_transformIndex = store->add(m_transform, parent ? static_cast<int32_t>(parent->m_transformIndex)
+                                                          : TransformStore::s_noParent);
+        m_transformStore = store;
     }
 
     void setName(const std::string &name)
@@ -66,12 +120,15 @@ class ModelBuilder
     std::unique_ptr<Model> m_product;
     std::vector<std::shared_ptr<Mesh>> m_meshes;
     std::weak_ptr<Device> m_device;
+    ResourceRegistry *m_registry = nullptr;
 
     void restart()
     {
         m_product = std::unique_ptr<Model>(new Model);
     }
 
+    [[nodiscard]] std::shared_ptr<std::vector<std::shared_ptr<Mesh>>> loadMeshesFromFile() const;
+
     std::string m_modelFilename;
     bool m_bLoadFromFile = false;
 
@@ -95,6 +152,15 @@ class ModelBuilder
     {
         m_importerFlags = flags;
     }
+    /**
+     * @brief the meshes and textures of the file are shared with the other models loaded from it with the same flags
+     * the textures are streamed by the texture streamer of the registry
+     *
+     */
+    void setResourceRegistry(ResourceRegistry *registry)
+    {
+        m_registry = registry;
+    }
     void setMesh(const std::shared_ptr<Mesh> &mesh, uint32_t meshIndex = 0u);
     void setName(const std::string &name);
     std::unique_ptr<Model> build();
@@ -0,0 +1,266 @@
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#include <tracy/Tracy.hpp>
+
+#include "engine/probe_grid.hpp"
+
+#include "light.hpp"
+#include "texture.hpp"
+
+#include "probe_bake.hpp"
+
+namespace
+{
+struct FileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint32_t textureCount;
+    uint32_t pad;
+};
+
+struct TextureHeader
+{
+    uint32_t width;
+    uint32_t height;
+    uint32_t layerCount;
+    uint32_t format;
+    uint64_t byteCount;
+};
+
+/**
+ * @brief FNV-1a, stable between runs and platforms unlike std::hash
+ *
+ */
+class Hasher
+{
+  private:
+    uint64_t m_hash = 0xcbf29ce484222325ull;
+
+  public:
+    void add(const void *data, size_t size)
+    {
+        const unsigned char *bytes = static_cast<const unsigned char *>(data);
+        for (size_t i = 0; i < size; ++i)
+        {
+            m_hash ^= bytes[i];
+            m_hash *= 0x100000001b3ull;
+        }
+    }
+    template <typename TType> void add(const TType &value)
+    {
+        add(&value, sizeof(TType));
+    }
+
+    [[nodiscard]] inline uint64_t get() const
+    {
+        return m_hash;
+    }
+};
+
+TextureHeader makeTextureHeader(const Texture &texture)
+{
+    return TextureHeader{
+        .width = texture.getWidth(),
+        .height = texture.getHeight(),
+        .layerCount = texture.getLayerCount(),
+        .format = static_cast<uint32_t>(texture.getImageFormat()),
+        .byteCount = static_cast<uint64_t>(texture.getPixelDataSize()),
+    };
+}
+} // namespace
+
+bool ProbeBake::load()
+{
+    ZoneScoped;
+
+    const auto start = std::chrono::steady_clock::now();
+    m_statistics.loaded = false;
+
+    std::ifstream file(m_filename, std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    FileHeader header;
+    file.read(reinterpret_cast<char *>(&header), sizeof(FileHeader));
+    if (!file || header.magic != s_magic || header.version != s_version || header.key != m_key ||
+        header.textureCount != m_textures.size())
+    {
+        std::cout << "Probe bake " << m_filename << " is outdated, the probes are captured again" << std::endl;
+        return false;
+    }
+
+    // every texture is read before uploading anything so that a truncated file leaves the textures untouched
+    std::vector<std::vector<unsigned char>> pixels(m_textures.size());
+    uint64_t byteCount = sizeof(FileHeader);
+    for (size_t i = 0; i < m_textures.size(); ++i)
+    {
+        const TextureHeader expected = makeTextureHeader(*m_textures[i]);
+        TextureHeader stored;
+        file.read(reinterpret_cast<char *>(&stored), sizeof(TextureHeader));
+        if (!file || std::memcmp(&stored, &expected, sizeof(TextureHeader)) != 0)
+        {
+            std::cerr << "Probe bake " << m_filename << " does not match texture " << i << std::endl;
+            return false;
+        }
+
+        pixels[i].resize(stored.byteCount);
+        file.read(reinterpret_cast<char *>(pixels[i].data()), stored.byteCount);
+        if (!file)
+        {
+            std::cerr << "Probe bake " << m_filename << " is truncated" << std::endl;
+            return false;
+        }
+        byteCount += sizeof(TextureHeader) + stored.byteCount;
+    }
+
+    for (size_t i = 0; i < m_textures.size(); ++i)
+    {
+        if (!m_textures[i]->writePixels(pixels[i]))
+        {
+            std::cerr << "Failed to upload texture " << i << " of probe bake " << m_filename << std::endl;
+            return false;
+        }
+    }
+
+    m_statistics.loaded = true;
+    m_statistics.byteCount = byteCount;
+    m_statistics.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+bool ProbeBake::save()
+{
+    ZoneScoped;
+
+    const auto start = std::chrono::steady_clock::now();
+    m_statistics.saved = false;
+
+    const std::filesystem::path path = m_filename;
+    std::error_code error;
+    if (path.has_parent_path())
+        std::filesystem::create_directories(path.parent_path(), error);
+
+    // written next to the bake and renamed so that an interrupted save never leaves a partial file behind
+    std::filesystem::path temporaryPath = path;
+    temporaryPath += ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+        {
+            std::cerr << "Failed to open " << temporaryPath << std::endl;
+            return false;
+        }
+
+        const FileHeader header = {
+            .magic = s_magic,
+            .version = s_version,
+            .key = m_key,
+            .textureCount = static_cast<uint32_t>(m_textures.size()),
+            .pad = 0u,
+        };
+        file.write(reinterpret_cast<const char *>(&header), sizeof(FileHeader));
+
+        uint64_t byteCount = sizeof(FileHeader);
+        for (const std::shared_ptr<Texture> &texture : m_textures)
+        {
+            const TextureHeader textureHeader = makeTextureHeader(*texture);
+            const std::vector<unsigned char> pixels = texture->readPixels();
+            if (pixels.size() != textureHeader.byteCount)
+            {
+                std::cerr << "Failed to read back texture " << texture->getName() << std::endl;
+                return false;
+            }
+
+            file.write(reinterpret_cast<const char *>(&textureHeader), sizeof(TextureHeader));
+            file.write(reinterpret_cast<const char *>(pixels.data()), pixels.size());
+            byteCount += sizeof(TextureHeader) + pixels.size();
+        }
+
+        if (!file)
+        {
+            std::cerr << "Failed to write " << temporaryPath << std::endl;
+            return false;
+        }
+        m_statistics.byteCount = byteCount;
+    }
+
+    std::filesystem::rename(temporaryPath, path, error);
+    if (error)
+    {
+        std::cerr << "Failed to write " << m_filename << " : " << error.message() << std::endl;
+        return false;
+    }
+
+    m_statistics.saved = true;
+    m_statistics.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+std::unique_ptr<ProbeBake> ProbeBakeBuilder::build()
+{
+    if (m_product->m_filename.empty())
+    {
+        std::cerr << "Probe bake has no filename" << std::endl;
+        return nullptr;
+    }
+    if (!m_grid)
+    {
+        std::cerr << "Probe bake of " << m_product->m_filename << " has no probe grid" << std::endl;
+        return nullptr;
+    }
+
+    Hasher hasher;
+    hasher.add(ProbeBake::s_version);
+    hasher.add(m_sceneName.data(), m_sceneName.size());
+
+    hasher.add(m_grid->getDimensions());
+    hasher.add(m_grid->getExtent());
+    hasher.add(m_grid->getCornerPosition());
+    hasher.add(m_grid->getBrickSize());
+    const std::vector<int32_t> &brickProbeOffsets = m_grid->getBrickProbeOffsets();
+    hasher.add(brickProbeOffsets.data(), brickProbeOffsets.size() * sizeof(int32_t));
+    // the relocated positions and the enclosed probes depend on the geometry, which is not hashed itself
+    for (const std::unique_ptr<Probe> &probe : m_grid->getProbes())
+    {
+        hasher.add(probe->position);
+        hasher.add(probe->active);
+    }
+
+    for (const std::shared_ptr<Light> &light : m_lights)
+    {
+        hasher.add(light->type);
+        hasher.add(light->diffuseColor);
+        hasher.add(light->diffusePower);
+        hasher.add(light->specularColor);
+        hasher.add(light->specularPower);
+        switch (light->type)
+        {
+        case LightTypeE::POINT: {
+            const PointLight *pointLight = static_cast<const PointLight *>(light.get());
+            hasher.add(pointLight->position);
+            hasher.add(pointLight->attenuation);
+            break;
+        }
+        case LightTypeE::DIRECTIONAL:
+            hasher.add(static_cast<const DirectionalLight *>(light.get())->direction);
+            break;
+        }
+    }
+
+    for (const std::shared_ptr<Texture> &texture : m_product->m_textures)
+    {
+        const TextureHeader header = makeTextureHeader(*texture);
+        hasher.add(header);
+    }
+    m_product->m_key = hasher.get();
+
+    auto result = std::move(m_product);
+    restart();
+    return result;
+}
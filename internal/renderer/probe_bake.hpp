@@ -0,0 +1,144 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+class Texture;
+class Light;
+class ProbeGrid;
+class ProbeBakeBuilder;
+
+/**
+ * @brief final probe data of a scene stored on disk, uploaded at load instead of capturing the probes again
+ * the file holds the first mip level of every texture, in native byte order, behind a key hashed from the scene name,
+ * the probe grid, the lights and the textures, a file with another key is baked again
+ *
+ */
+class ProbeBake
+{
+    friend ProbeBakeBuilder;
+
+  public:
+    static constexpr uint32_t s_magic = 0x4b425250u;
+    /**
+     * @brief increased every time the layout of the file or of the baked textures changes
+     *
+     */
+    static constexpr uint32_t s_version = 2u;
+
+    struct Statistics
+    {
+        /**
+         * @brief the textures have been uploaded from the file
+         *
+         */
+        bool loaded = false;
+        /**
+         * @brief the last save succeeded
+         *
+         */
+        bool saved = false;
+        uint64_t byteCount = 0u;
+        /**
+         * @brief last load or save
+         *
+         */
+        double seconds = 0.0;
+    };
+
+  private:
+    std::string m_filename;
+    uint64_t m_key = 0u;
+
+    std::vector<std::shared_ptr<Texture>> m_textures;
+
+    Statistics m_statistics;
+
+    ProbeBake() = default;
+
+  public:
+    ProbeBake(const ProbeBake &) = delete;
+    ProbeBake &operator=(const ProbeBake &) = delete;
+    ProbeBake(ProbeBake &&) = delete;
+    ProbeBake &operator=(ProbeBake &&) = delete;
+
+    /**
+     * @brief upload the textures from the file
+     *
+     * @return false if there is no file or if it was baked with another key, nothing is uploaded then
+     */
+    bool load();
+    /**
+     * @brief read the textures back from the device and write them to the file
+     * the textures must have been filled and be in their shader read layout
+     *
+     */
+    bool save();
+
+  public:
+    [[nodiscard]] inline const std::string &getFilename() const
+    {
+        return m_filename;
+    }
+    [[nodiscard]] inline uint64_t getKey() const
+    {
+        return m_key;
+    }
+    [[nodiscard]] inline const Statistics &getStatistics() const
+    {
+        return m_statistics;
+    }
+};
+
+class ProbeBakeBuilder
+{
+  private:
+    std::unique_ptr<ProbeBake> m_product;
+
+    std::string m_sceneName;
+    std::shared_ptr<ProbeGrid> m_grid;
+    std::vector<std::shared_ptr<Light>> m_lights;
+
+    void restart()
+    {
+        m_product = std::unique_ptr<ProbeBake>(new ProbeBake);
+        m_sceneName.clear();
+        m_grid.reset();
+        m_lights.clear();
+    }
+
+  public:
+    ProbeBakeBuilder()
+    {
+        restart();
+    }
+
+    void setFilename(const std::string &filename)
+    {
+        m_product->m_filename = filename;
+    }
+    void setSceneName(const std::string &sceneName)
+    {
+        m_sceneName = sceneName;
+    }
+    void setProbeGrid(std::shared_ptr<ProbeGrid> grid)
+    {
+        m_grid = grid;
+    }
+    void setLights(const std::vector<std::shared_ptr<Light>> &lights)
+    {
+        m_lights = lights;
+    }
+    /**
+     * @brief texture baked, in the order they are stored in the file
+     *
+     */
+    void addTexture(std::shared_ptr<Texture> texture)
+    {
+        m_product->m_textures.push_back(texture);
+    }
+
+    std::unique_ptr<ProbeBake> build();
+};
@@ -1,15 +1,90 @@
 #include <cassert>
+#include <iostream>
 
 #include <tracy/Tracy.hpp>
 
 #include "engine/camera.hpp"
+#include "engine/frame_arena.hpp"
 #include "engine/probe_grid.hpp"
 
+#include "graphics/frame_allocator.hpp"
+
+#include "acceleration_structure_cache.hpp"
 #include "light.hpp"
+#include "render_graph_resources.hpp"
 #include "render_phase.hpp"
+#include "resource_registry.hpp"
+#include "scene_constants.hpp"
 
 #include "render_graph.hpp"
 
+RenderGraph::~RenderGraph() = default;
+
+void RenderGraph::createFrameResources(std::weak_ptr<Device> device, uint32_t frameInFlightCount,
+                                       ResourceRegistry *registry)
+{
+    m_frameInFlightCount = frameInFlightCount;
+
+    FrameAllocatorBuilder fab;
+    fab.setDevice(device);
+    fab.setFrameInFlightCount(frameInFlightCount);
+    m_frameAllocator = fab.build();
+
+    m_frameArena = std::make_unique<FrameArena>(frameInFlightCount, s_frameArenaRegionCapacity);
+
+    SceneConstantsBuilder scb;
+    scb.setDevice(device);
+    scb.setFrameInFlightCount(frameInFlightCount);
+    m_sceneConstants = scb.build();
+
+    RenderGraphResourcesBuilder rgrb;
+    rgrb.setDevice(device);
+    rgrb.setFrameArena(m_frameArena.get());
+    m_resources = rgrb.build();
+
+    if (registry)
+    {
+        m_accelerationStructures = registry->getAccelerationStructureCache();
+    }
+    else
+    {
+        AccelerationStructureCacheBuilder ascb;
+        ascb.setDevice(device);
+        ascb.setFrameInFlightCount(frameInFlightCount);
+        m_accelerationStructures = ascb.build();
+    }
+}
+
+void RenderGraph::linkPhaseSteps()
+{
+    // the graphs that have not declared their transient images yet are compiled now
+    if (!m_resources->compile())
+        std::cerr << "Failed to compile render graph resources" << std::endl;
+
+    // a semaphore can only be replaced by barriers between two phases that are submitted once
+    auto isSingleSubmission = [](const BasePhaseABC *phase) {
+        const RenderPhase *renderPhase = dynamic_cast<const RenderPhase *>(phase);
+        return renderPhase && renderPhase->getSingleFrameRenderCount() == 1 &&
+               renderPhase->getRenderPass()->getFramebufferPoolSize() == 1u;
+    };
+
+    uint32_t step = 0u;
+    for (std::vector<std::unique_ptr<BasePhaseABC>> *chain : {&m_oneTimeRenderPhases, &m_renderPhases})
+    {
+        for (size_t i = 0u; i < chain->size(); i++, step++)
+        {
+            (*chain)[i]->setGraphStep(m_resources.get(), step);
+            (*chain)[i]->setFrameArena(m_frameArena.get());
+
+            if (m_resources->hasBarrierOnlyDependency(step) &&
+                (i == 0u || !isSingleSubmission((*chain)[i - 1u].get()) || !isSingleSubmission((*chain)[i].get())))
+            {
+                m_resources->setBarrierOnlyDependency(step, false);
+            }
+        }
+    }
+}
+
 void RenderGraph::addOneTimeRenderPhase(std::unique_ptr<RenderPhase> renderPhase)
 {
     m_oneTimeRenderPhases.push_back(std::move(renderPhase));
@@ -20,13 +95,18 @@ void RenderGraph::addRenderPhase(std::unique_ptr<RenderPhase> renderPhase)
     m_renderPhases.push_back(std::move(renderPhase));
 }
 
+void RenderGraph::addOneTimePhase(std::unique_ptr<BasePhaseABC> phase)
+{
+    m_oneTimeRenderPhases.push_back(std::move(phase));
+}
+
 void RenderGraph::addPhase(std::unique_ptr<BasePhaseABC> phase)
 {
     m_renderPhases.push_back(std::move(phase));
 }
 
-void RenderGraph::processRenderPhaseChain(std::vector<std::unique_ptr<BasePhaseABC>> &toProcess, uint32_t imageIndex,
-                                          VkRect2D renderArea, const CameraABC &mainCamera,
+void RenderGraph::processRenderPhaseChain(std::vector<std::unique_ptr<BasePhaseABC>> &toProcess, uint32_t firstStep,
+                                          uint32_t imageIndex, VkRect2D renderArea, const CameraABC &mainCamera,
                                           const std::vector<std::shared_ptr<Light>> &lights,
                                           const std::shared_ptr<ProbeGrid> &probeGrid,
                                           const VkSemaphore *inWaitSemaphore, const VkSemaphore **outAcquireSemaphore)
@@ -36,6 +116,11 @@ void RenderGraph::processRenderPhaseChain(std::vector<std::unique_ptr<BasePhaseA
     const VkSemaphore *lastAcquireSemaphore = inWaitSemaphore;
     for (int i = 0; i < toProcess.size(); ++i)
     {
+        // phases ordered by barriers only do not wait for the previous phase, which does not signal them
+        const uint32_t step = firstStep + i;
+        const bool waitSemaphore = i == 0 || !m_resources->hasBarrierOnlyDependency(step);
+        const bool signalSemaphore = i + 1 == toProcess.size() || !m_resources->hasBarrierOnlyDependency(step + 1u);
+
         if (RenderPhase *currentPhase = dynamic_cast<RenderPhase *>(toProcess[i].get()))
         {
             for (uint32_t singleFrameRenderIndex = 0u;
@@ -44,10 +129,13 @@ void RenderGraph::processRenderPhaseChain(std::vector<std::unique_ptr<BasePhaseA
                 for (uint32_t poolIndex = 0u; poolIndex < currentPhase->getRenderPass()->getFramebufferPoolSize();
                      poolIndex++)
                 {
+                    if (currentPhase->isPooledFramebufferSkipped(poolIndex, probeGrid))
+                        continue;
+
                     currentPhase->recordBackBuffer(imageIndex, singleFrameRenderIndex, poolIndex, renderArea,
                                                    mainCamera, lights, probeGrid);
 
-                    currentPhase->submitBackBuffer(lastAcquireSemaphore, poolIndex);
+                    currentPhase->submitBackBuffer(lastAcquireSemaphore, poolIndex, waitSemaphore, signalSemaphore);
                     lastAcquireSemaphore = &currentPhase->getCurrentRenderSemaphore(poolIndex);
                 }
             }
@@ -56,8 +144,10 @@ void RenderGraph::processRenderPhaseChain(std::vector<std::unique_ptr<BasePhaseA
         {
             phase->recordBackBuffer();
 
+            // an async phase runs beside the chain, the phase reading its results waits for it
             phase->submitBackBuffer(lastAcquireSemaphore);
-            lastAcquireSemaphore = &phase->getCurrentRenderSemaphore();
+            if (!phase->isAsync())
+                lastAcquireSemaphore = &phase->getCurrentRenderSemaphore();
         }
     }
 
@@ -71,17 +161,30 @@ void RenderGraph::processRendering(uint32_t imageIndex, VkRect2D renderArea, con
 {
     ZoneScoped;
 
+    // the fences of the current back buffers, that used this region last, have been waited by the renderer
+    m_frameAllocator->beginFrame(m_backBufferIndex);
+    m_sceneConstants->update(lights, m_backBufferIndex);
+    m_accelerationStructures->update(m_backBufferIndex);
+
     const VkSemaphore *lastAcquireSemaphore = nullptr;
     if (m_shouldRenderOneTimePhases)
     {
-        processRenderPhaseChain(m_oneTimeRenderPhases, imageIndex, renderArea, mainCamera, lights, probeGrid, nullptr,
-                                &lastAcquireSemaphore);
+        processRenderPhaseChain(m_oneTimeRenderPhases, 0u, imageIndex, renderArea, mainCamera, lights, probeGrid,
+                                nullptr, &lastAcquireSemaphore);
 
         m_shouldRenderOneTimePhases = false;
     }
+    else if (!m_oneTimeResourcesReleased)
+    {
+        // the transient images of the one-time phases are not used anymore
+        std::pmr::vector<VkFence> fences = m_frameArena->makeVector<VkFence>(m_oneTimeRenderPhases.size());
+        appendPhaseChainCurrentFences(m_oneTimeRenderPhases, fences);
+        m_resources->releaseTransientImages(static_cast<uint32_t>(m_oneTimeRenderPhases.size()), fences);
+        m_oneTimeResourcesReleased = true;
+    }
 
-    processRenderPhaseChain(m_renderPhases, imageIndex, renderArea, mainCamera, lights, probeGrid, lastAcquireSemaphore,
-                            nullptr);
+    processRenderPhaseChain(m_renderPhases, static_cast<uint32_t>(m_oneTimeRenderPhases.size()), imageIndex,
+                            renderArea, mainCamera, lights, probeGrid, lastAcquireSemaphore, nullptr);
 }
 
 void RenderGraph::updateSwapchainOnRenderPhases(const SwapChain *swapchain)
@@ -97,6 +200,8 @@ void RenderGraph::swapAllRenderPhasesBackBuffers()
 {
     ZoneScoped;
 
+    m_backBufferIndex = (m_backBufferIndex + 1u) % m_frameInFlightCount;
+
     for (auto &phase : m_renderPhases)
     {
         if (RenderPhase *currentPhase = dynamic_cast<RenderPhase *>(phase.get()))
@@ -118,13 +223,26 @@ VkSemaphore RenderGraph::getFirstPhaseCurrentAcquireSemaphore() const
 {
     assert(m_renderPhases.size() != 0 || m_oneTimeRenderPhases.size() != 0);
 
+    // the async phases do not wait for the swapchain image
+    auto getFirstChainedPhase = [](const std::vector<std::unique_ptr<BasePhaseABC>> &phases) -> const BasePhaseABC * {
+        for (const std::unique_ptr<BasePhaseABC> &phase : phases)
+        {
+            const ComputePhase *computePhase = dynamic_cast<const ComputePhase *>(phase.get());
+            if (!computePhase || !computePhase->isAsync())
+                return phase.get();
+        }
+        return nullptr;
+    };
+
     if (m_shouldRenderOneTimePhases)
     {
-        if (m_oneTimeRenderPhases.size() > 0u)
-            return m_oneTimeRenderPhases.front()->getCurrentAcquireSemaphore(0u);
+        if (const BasePhaseABC *phase = getFirstChainedPhase(m_oneTimeRenderPhases))
+            return phase->getCurrentAcquireSemaphore(0u);
     }
 
-    return m_renderPhases.front()->getCurrentAcquireSemaphore(0u);
+    const BasePhaseABC *phase = getFirstChainedPhase(m_renderPhases);
+    assert(phase);
+    return phase->getCurrentAcquireSemaphore(0u);
 }
 
 VkSemaphore RenderGraph::getLastPhaseCurrentRenderSemaphore() const
@@ -138,30 +256,10 @@ VkSemaphore RenderGraph::getLastPhaseCurrentRenderSemaphore() const
     return m_renderPhases.back()->getCurrentRenderSemaphore(pooledFramebufferIndex);
 }
 
-std::vector<VkFence> RenderGraph::getAllCurrentFences() const
+void RenderGraph::appendPhaseChainCurrentFences(const std::vector<std::unique_ptr<BasePhaseABC>> &phases,
+                                                std::pmr::vector<VkFence> &fences)
 {
-    assert(m_renderPhases.size() != 0);
-    std::vector<VkFence> fences;
-    fences.reserve(m_renderPhases.size() + m_oneTimeRenderPhases.size());
-
-    if (m_shouldRenderOneTimePhases)
-    {
-        for (const auto &phase : m_oneTimeRenderPhases)
-        {
-            if (RenderPhase *currentPhase = dynamic_cast<RenderPhase *>(phase.get()))
-            {
-                if (currentPhase->getSingleFrameRenderCount() > 0u)
-                {
-                    for (uint32_t poolIndex = 0u; poolIndex < currentPhase->getRenderPass()->getFramebufferPoolSize();
-                         poolIndex++)
-                    {
-                        fences.push_back(currentPhase->getCurrentFence(poolIndex));
-                    }
-                }
-            }
-        }
-    }
-    for (const auto &phase : m_renderPhases)
+    for (const auto &phase : phases)
     {
         if (RenderPhase *currentPhase = dynamic_cast<RenderPhase *>(phase.get()))
         {
@@ -175,5 +273,28 @@ std::vector<VkFence> RenderGraph::getAllCurrentFences() const
             }
         }
     }
+}
+
+std::pmr::vector<VkFence> RenderGraph::getAllCurrentFences() const
+{
+    assert(m_renderPhases.size() != 0);
+    std::pmr::vector<VkFence> fences =
+        m_frameArena->makeVector<VkFence>(m_renderPhases.size() + m_oneTimeRenderPhases.size());
+
+    if (m_shouldRenderOneTimePhases)
+        appendPhaseChainCurrentFences(m_oneTimeRenderPhases, fences);
+    appendPhaseChainCurrentFences(m_renderPhases, fences);
     return fences;
 }
+
+std::pmr::vector<const TimestampQuery *> RenderGraph::getTimestampQueries() const
+{
+    std::pmr::vector<const TimestampQuery *> queries =
+        m_frameArena->makeVector<const TimestampQuery *>(m_renderPhases.size());
+    for (const std::unique_ptr<BasePhaseABC> &phase : m_renderPhases)
+    {
+        if (const TimestampQuery *query = phase->getTimestampQuery())
+            queries.push_back(query);
+    }
+    return queries;
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <memory_resource>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -15,6 +16,13 @@ class SwapChain;
 class BasePhaseABC;
 class Device;
 class WindowGLFW;
+class FrameAllocator;
+class FrameArena;
+class SceneConstants;
+class RenderGraphResources;
+class AccelerationStructureCache;
+class ResourceRegistry;
+class TimestampQuery;
 
 class RenderGraphLoader;
 
@@ -28,6 +36,45 @@ class RenderGraph
 
   protected:
     bool m_shouldRenderOneTimePhases = true;
+
+    uint32_t m_frameInFlightCount = 1u;
+    /**
+     * @brief back buffer of the phases used by the current frame, the per frame resources of the graph use the region
+     * of the same index so that they are guarded by the same fences
+     *
+     */
+    uint32_t m_backBufferIndex = 0u;
+
+    /**
+     * @brief per frame uniform and storage data of the render states
+     * declared before the phases so that it is destroyed after their states
+     *
+     */
+    std::unique_ptr<FrameAllocator> m_frameAllocator;
+    static constexpr size_t s_frameArenaRegionCapacity = 64u * 1024u;
+    /**
+     * @brief temporary containers of the frame loop, so that rendering a frame does not allocate on the heap
+     *
+     */
+    std::unique_ptr<FrameArena> m_frameArena;
+    /**
+     * @brief lights and probes shared by every render state
+     *
+     */
+    std::unique_ptr<SceneConstants> m_sceneConstants;
+    /**
+     * @brief transient images and barriers between the phases
+     *
+     */
+    std::unique_ptr<RenderGraphResources> m_resources;
+    bool m_oneTimeResourcesReleased = false;
+    /**
+     * @brief acceleration structures shared by the ray tracing phases, and by the graphs of the other scenes if they
+     * come from the resource registry
+     *
+     */
+    std::shared_ptr<AccelerationStructureCache> m_accelerationStructures;
+
     /**
      * @brief phases that are called once at the begining of the processing
      *
@@ -48,6 +95,18 @@ class RenderGraph
      */
     [[deprecated]] std::unordered_map<std::string, BasePhaseABC *> m_phasePtrs;
 
+    /**
+     * @brief
+     *
+     * @param registry gives the acceleration structure cache shared by the scenes, the graph builds its own if null
+     */
+    void createFrameResources(std::weak_ptr<Device> device, uint32_t frameInFlightCount, ResourceRegistry *registry);
+    /**
+     * @brief give each phase its step in the graph resources, the one-time phases come first
+     *
+     */
+    void linkPhaseSteps();
+
     /**
      * @brief RenderGraphs can be created using a unique_ptr or whatever data structure
      * It can also be loaded by a function from a derived class
@@ -59,7 +118,7 @@ class RenderGraph
     }
 
   public:
-    virtual ~RenderGraph() = default;
+    virtual ~RenderGraph();
 
     RenderGraph() = default;
     RenderGraph(const RenderGraph &) = delete;
@@ -69,10 +128,20 @@ class RenderGraph
 
     [[deprecated]] void addOneTimeRenderPhase(std::unique_ptr<RenderPhase> renderPhase);
     [[deprecated]] void addRenderPhase(std::unique_ptr<RenderPhase> renderPhase);
+    void addOneTimePhase(std::unique_ptr<BasePhaseABC> phase);
     void addPhase(std::unique_ptr<BasePhaseABC> phase);
+    /**
+     * @brief the one-time phases are never processed, their results have been restored some other way
+     * their transient images are released at the first frame
+     *
+     */
+    inline void skipOneTimePhases()
+    {
+        m_shouldRenderOneTimePhases = false;
+    }
 
-    void processRenderPhaseChain(std::vector<std::unique_ptr<BasePhaseABC>> &toProcess, uint32_t imageIndex,
-                                 VkRect2D renderArea, const CameraABC &mainCamera,
+    void processRenderPhaseChain(std::vector<std::unique_ptr<BasePhaseABC>> &toProcess, uint32_t firstStep,
+                                 uint32_t imageIndex, VkRect2D renderArea, const CameraABC &mainCamera,
                                  const std::vector<std::shared_ptr<Light>> &lights,
                                  const std::shared_ptr<ProbeGrid> &probeGrid, const VkSemaphore *inWaitSemaphore,
                                  const VkSemaphore **outAcquireSemaphore);
@@ -81,6 +150,11 @@ class RenderGraph
                           const std::vector<std::shared_ptr<Light>> &lights,
                           const std::shared_ptr<ProbeGrid> &probeGrid);
 
+    /**
+     * @brief move on to the next back buffer, called once the frame has been submitted even if it could not be
+     * presented
+     *
+     */
     void swapAllRenderPhasesBackBuffers();
 
     void updateSwapchainOnRenderPhases(const SwapChain *swapchain);
@@ -88,7 +162,40 @@ class RenderGraph
   public:
     [[nodiscard]] VkSemaphore getFirstPhaseCurrentAcquireSemaphore() const;
     [[nodiscard]] VkSemaphore getLastPhaseCurrentRenderSemaphore() const;
-    [[nodiscard]] std::vector<VkFence> getAllCurrentFences() const;
+    /**
+     * @brief allocated in the frame arena, valid for the current frame
+     *
+     */
+    [[nodiscard]] std::pmr::vector<VkFence> getAllCurrentFences() const;
+    static void appendPhaseChainCurrentFences(const std::vector<std::unique_ptr<BasePhaseABC>> &phases,
+                                              std::pmr::vector<VkFence> &fences);
+    /**
+     * @brief GPU durations of the per frame phases that enabled their timestamps, in submission order
+     * allocated in the frame arena, valid for the current frame
+     *
+     */
+    [[nodiscard]] std::pmr::vector<const TimestampQuery *> getTimestampQueries() const;
+
+    [[nodiscard]] inline FrameAllocator *getFrameAllocator() const
+    {
+        return m_frameAllocator.get();
+    }
+    [[nodiscard]] inline FrameArena *getFrameArena() const
+    {
+        return m_frameArena.get();
+    }
+    [[nodiscard]] inline SceneConstants *getSceneConstants() const
+    {
+        return m_sceneConstants.get();
+    }
+    [[nodiscard]] inline const RenderGraphResources *getResources() const
+    {
+        return m_resources.get();
+    }
+    [[nodiscard]] inline AccelerationStructureCache *getAccelerationStructureCache() const
+    {
+        return m_accelerationStructures.get();
+    }
 };
 
 class RenderGraphLoader
@@ -96,11 +203,14 @@ class RenderGraphLoader
   public:
     template <typename TGraph>
     static std::unique_ptr<RenderGraph> load(std::weak_ptr<Device> device, WindowGLFW *window,
-                                             uint32_t frameInFlightCount, uint32_t maxProbeCount)
+                                             uint32_t frameInFlightCount, uint32_t maxProbeCount,
+                                             ResourceRegistry *registry = nullptr)
     {
         static_assert(std::is_base_of_v<RenderGraph, TGraph> == true);
         std::unique_ptr<RenderGraph> out = std::make_unique<TGraph>();
+        out->createFrameResources(device, frameInFlightCount, registry);
         out->load(device, window, frameInFlightCount, maxProbeCount);
+        out->linkPhaseSteps();
         return std::move(out);
     }
 };
\ No newline at end of file
@@ -0,0 +1,509 @@
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <iterator>
+
+#include <tracy/Tracy.hpp>
+
+#include "engine/frame_arena.hpp"
+
+#include "graphics/device.hpp"
+#include "graphics/image.hpp"
+
+#include "render_graph_resources.hpp"
+
+namespace
+{
+constexpr VkAccessFlags writeAccessMask =
+    VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT |
+    VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+
+VkImageLayout getLayoutAfter(const ImageAccess &access)
+{
+    return access.finalLayout != VK_IMAGE_LAYOUT_UNDEFINED ? access.finalLayout : access.layout;
+}
+} // namespace
+
+RenderGraphResources::~RenderGraphResources()
+{
+    if (m_device.expired())
+        return;
+
+    auto devicePtr = m_device.lock();
+    auto deviceHandle = devicePtr->getHandle();
+
+    for (ImageResource &resource : m_images)
+    {
+        if (resource.imageView != VK_NULL_HANDLE)
+            vkDestroyImageView(deviceHandle, resource.imageView, nullptr);
+        resource.image.reset();
+    }
+
+    for (const MemoryBlock &block : m_memoryBlocks)
+    {
+        if (!block.released)
+            vmaFreeMemory(devicePtr->getAllocator(), block.allocation);
+    }
+}
+
+RenderGraphResources::Step &RenderGraphResources::getStep(uint32_t step)
+{
+    if (step >= m_steps.size())
+        m_steps.resize(step + 1u);
+
+    return m_steps[step];
+}
+
+RenderGraphResources::ResourceId RenderGraphResources::declareTransientImage(const TransientImageDesc &desc)
+{
+    assert(!m_compiled);
+
+    ImageResource resource;
+    resource.name = desc.name;
+    resource.transient = true;
+    resource.transientDesc = desc;
+    resource.aspectFlags = desc.aspectFlags;
+    resource.layerCount = desc.cube ? 6u : 1u;
+    m_images.push_back(std::move(resource));
+
+    return static_cast<ResourceId>(m_images.size() - 1u);
+}
+
+RenderGraphResources::ResourceId RenderGraphResources::declareExternalImage(
+    const std::string &name, std::function<VkImage(uint32_t imageIndex)> getImage, VkImageAspectFlags aspectFlags,
+    uint32_t layerCount)
+{
+    assert(!m_compiled);
+
+    ImageResource resource;
+    resource.name = name;
+    resource.getExternalImage = getImage;
+    resource.aspectFlags = aspectFlags;
+    resource.layerCount = layerCount;
+    m_images.push_back(std::move(resource));
+
+    return static_cast<ResourceId>(m_images.size() - 1u);
+}
+
+void RenderGraphResources::declareAccess(ResourceId resource, uint32_t step, const ImageAccess &access)
+{
+    assert(!m_compiled);
+    assert(resource < m_images.size());
+
+    m_images[resource].accesses.emplace_back(step, access);
+    getStep(step);
+}
+
+void RenderGraphResources::setFirstPerFrameStep(uint32_t step)
+{
+    assert(!m_compiled);
+
+    m_firstPerFrameStep = step;
+}
+
+void RenderGraphResources::setBarrierOnlyDependency(uint32_t step, bool enable)
+{
+    getStep(step).barrierOnlyDependency = enable;
+}
+
+void RenderGraphResources::configureTransientImageBuilder(ImageBuilder &builder, const TransientImageDesc &desc) const
+{
+    ImageDirector id;
+    if (desc.cube)
+        id.configureImageCubeBuilder(builder);
+    else
+        id.configureImage2DBuilder(builder);
+    builder.setDevice(m_device);
+    builder.setFormat(desc.format);
+    builder.setWidth(desc.extent.width);
+    builder.setHeight(desc.extent.height);
+    builder.setTiling(VK_IMAGE_TILING_OPTIMAL);
+    builder.setUsage(desc.usage);
+    builder.setProperties(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    builder.setAspectFlags(desc.aspectFlags);
+    builder.setName(desc.name);
+}
+
+bool RenderGraphResources::compile()
+{
+    ZoneScoped;
+
+    if (m_compiled)
+        return true;
+
+    for (ImageResource &resource : m_images)
+    {
+        std::stable_sort(resource.accesses.begin(), resource.accesses.end(),
+                         [](const auto &a, const auto &b) { return a.first < b.first; });
+
+        // an image that is never used lives as long as the graph
+        if (!resource.accesses.empty())
+        {
+            resource.firstStep = resource.accesses.front().first;
+            resource.lastStep = resource.accesses.back().first;
+        }
+    }
+
+    if (!allocateTransientImages())
+        return false;
+
+    deriveBarriers();
+
+    m_compiled = true;
+    return true;
+}
+
+bool RenderGraphResources::allocateTransientImages()
+{
+    auto devicePtr = m_device.lock();
+
+    std::vector<ResourceId> transientImages;
+    for (ResourceId i = 0u; i < m_images.size(); i++)
+    {
+        ImageResource &resource = m_images[i];
+        if (!resource.transient)
+            continue;
+
+        ImageBuilder ib;
+        configureTransientImageBuilder(ib, resource.transientDesc);
+        resource.memoryRequirements = ib.getMemoryRequirements();
+        transientImages.push_back(i);
+
+        m_statistics.transientImageCount++;
+        m_statistics.requestedBytes += resource.memoryRequirements.size;
+    }
+
+    // the biggest images are placed first so that the smaller ones fit in their blocks
+    std::stable_sort(transientImages.begin(), transientImages.end(), [this](ResourceId a, ResourceId b) {
+        return m_images[a].memoryRequirements.size > m_images[b].memoryRequirements.size;
+    });
+
+    for (ResourceId id : transientImages)
+    {
+        ImageResource &resource = m_images[id];
+
+        for (uint32_t blockIndex = 0u; blockIndex < m_memoryBlocks.size(); blockIndex++)
+        {
+            MemoryBlock &block = m_memoryBlocks[blockIndex];
+            if ((block.memoryRequirements.memoryTypeBits & resource.memoryRequirements.memoryTypeBits) == 0u)
+                continue;
+
+            const bool overlaps = std::any_of(block.images.begin(), block.images.end(), [&](ResourceId other) {
+                return resource.firstStep <= m_images[other].lastStep && m_images[other].firstStep <= resource.lastStep;
+            });
+            if (overlaps)
+                continue;
+
+            block.memoryRequirements.size = std::max(block.memoryRequirements.size, resource.memoryRequirements.size);
+            block.memoryRequirements.alignment =
+                std::max(block.memoryRequirements.alignment, resource.memoryRequirements.alignment);
+            block.memoryRequirements.memoryTypeBits &= resource.memoryRequirements.memoryTypeBits;
+            block.images.push_back(id);
+            block.lastStep = std::max(block.lastStep, resource.lastStep);
+            resource.memoryBlock = blockIndex;
+            break;
+        }
+
+        if (resource.memoryBlock == UINT32_MAX)
+        {
+            resource.memoryBlock = static_cast<uint32_t>(m_memoryBlocks.size());
+            m_memoryBlocks.push_back(MemoryBlock{
+                .memoryRequirements = resource.memoryRequirements,
+                .images = {id},
+                .lastStep = resource.lastStep,
+            });
+        }
+    }
+
+    for (MemoryBlock &block : m_memoryBlocks)
+    {
+        VmaAllocationCreateInfo allocInfo = {
+            .requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        };
+        VkResult res = vmaAllocateMemory(devicePtr->getAllocator(), &block.memoryRequirements, &allocInfo,
+                                         &block.allocation, nullptr);
+        if (res != VK_SUCCESS)
+        {
+            std::cerr << "Failed to allocate transient image memory : " << res << std::endl;
+            return false;
+        }
+
+        // images of the same block are used in order, the first one to be used is the first one in the block
+        std::sort(block.images.begin(), block.images.end(),
+                  [this](ResourceId a, ResourceId b) { return m_images[a].firstStep < m_images[b].firstStep; });
+
+        for (ResourceId id : block.images)
+        {
+            ImageResource &resource = m_images[id];
+
+            ImageBuilder ib;
+            configureTransientImageBuilder(ib, resource.transientDesc);
+            ib.setAliasedAllocation(block.allocation, 0u);
+            resource.image = ib.build();
+            if (!resource.image)
+                return false;
+
+            resource.imageView = resource.transientDesc.cube ? resource.image->createImageViewCube()
+                                                             : resource.image->createImageView2D();
+        }
+
+        m_statistics.memoryBlockCount++;
+        m_statistics.allocatedBytes += block.memoryRequirements.size;
+    }
+
+    return true;
+}
+
+void RenderGraphResources::deriveBarriers()
+{
+    for (ResourceId id = 0u; id < m_images.size(); id++)
+    {
+        const ImageResource &resource = m_images[id];
+        if (resource.accesses.empty())
+            continue;
+
+        // the first use of an aliased image waits for the last use of the image that held the memory before it
+        const ImageAccess *previousAccess = nullptr;
+        ImageAccess aliasedAccess;
+        const ImageAccess *lastBlockAccess = nullptr;
+        if (resource.transient)
+        {
+            const MemoryBlock &block = m_memoryBlocks[resource.memoryBlock];
+            auto it = std::find(block.images.begin(), block.images.end(), id);
+            if (it != block.images.begin())
+            {
+                aliasedAccess = m_images[*std::prev(it)].accesses.back().second;
+                aliasedAccess.finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                aliasedAccess.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+                previousAccess = &aliasedAccess;
+            }
+            lastBlockAccess = &m_images[block.images.back()].accesses.back().second;
+        }
+
+        // the per frame accesses are replayed every frame, the first one follows the last one of the previous frame
+        const auto firstPerFrameAccess =
+            std::find_if(resource.accesses.begin(), resource.accesses.end(),
+                         [this](const auto &stepAccess) { return stepAccess.first >= m_firstPerFrameStep; });
+        const bool oneTimeAccess = firstPerFrameAccess != resource.accesses.begin();
+        ImageAccess wrappedAccess;
+
+        for (auto accessIt = resource.accesses.begin(); accessIt != resource.accesses.end(); ++accessIt)
+        {
+            const auto &[stepIndex, access] = *accessIt;
+            Step &step = m_steps[stepIndex];
+
+            if (accessIt == firstPerFrameAccess)
+            {
+                const ImageAccess &lastAccess = resource.accesses.back().second;
+                wrappedAccess = lastAccess;
+                wrappedAccess.finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                // the content of a transient image only used per frame does not outlive the frame
+                wrappedAccess.layout =
+                    resource.transient && !oneTimeAccess ? VK_IMAGE_LAYOUT_UNDEFINED : getLayoutAfter(lastAccess);
+
+                // the memory of the image may have been used by the last image aliasing it in the previous frame
+                if (lastBlockAccess)
+                {
+                    wrappedAccess.stageMask |= lastBlockAccess->stageMask;
+                    wrappedAccess.accessMask |= lastBlockAccess->accessMask;
+                }
+
+                // on the first frame it follows the one-time steps instead, a single barrier covers both cases
+                if (previousAccess)
+                {
+                    if (oneTimeAccess && getLayoutAfter(*previousAccess) != wrappedAccess.layout)
+                    {
+                        std::cerr << "Render graph image " << resource.name
+                                  << " is left in different layouts by the one-time and per frame steps" << std::endl;
+                    }
+                    wrappedAccess.stageMask |= previousAccess->stageMask;
+                    wrappedAccess.accessMask |= previousAccess->accessMask;
+                }
+
+                previousAccess = &wrappedAccess;
+            }
+
+            if (!previousAccess)
+            {
+                // the swapchain images are ordered by the acquire semaphore
+                // the transient images start undefined, the render pass of the step takes care of them if it clears
+                if (resource.transient && access.layout != VK_IMAGE_LAYOUT_UNDEFINED)
+                {
+                    step.barriers.push_back(StepBarrier{
+                        .resource = id,
+                        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+                        .newLayout = access.layout,
+                        .srcAccessMask = VK_ACCESS_NONE,
+                        .dstAccessMask = access.accessMask,
+                    });
+                    step.srcStageMask |= VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+                    step.dstStageMask |= access.stageMask;
+                }
+
+                previousAccess = &access;
+                continue;
+            }
+
+            const VkImageLayout currentLayout = getLayoutAfter(*previousAccess);
+            const bool layoutChange = access.layout != VK_IMAGE_LAYOUT_UNDEFINED && access.layout != currentLayout;
+            const bool writeHazard =
+                (previousAccess->accessMask & writeAccessMask) != 0u || (access.accessMask & writeAccessMask) != 0u;
+
+            if (!layoutChange && !writeHazard)
+            {
+                m_statistics.skippedBarrierCount++;
+                previousAccess = &access;
+                continue;
+            }
+
+            // an image with no defined content cannot be the target of a layout transition, and an image whose content
+            // is discarded is transitioned by the render pass of the step, a memory barrier orders them
+            const VkImageLayout newLayout = layoutChange ? access.layout : currentLayout;
+            if (newLayout == VK_IMAGE_LAYOUT_UNDEFINED || access.layout == VK_IMAGE_LAYOUT_UNDEFINED)
+            {
+                step.memoryBarrier = true;
+                step.memorySrcAccessMask |= previousAccess->accessMask & writeAccessMask;
+                step.memoryDstAccessMask |= access.accessMask;
+            }
+            else
+            {
+                step.barriers.push_back(StepBarrier{
+                    .resource = id,
+                    .oldLayout = currentLayout,
+                    .newLayout = newLayout,
+                    .srcAccessMask = previousAccess->accessMask & writeAccessMask,
+                    .dstAccessMask = access.accessMask,
+                });
+            }
+            step.srcStageMask |= previousAccess->stageMask;
+            step.dstStageMask |= access.stageMask;
+
+            previousAccess = &access;
+        }
+    }
+
+    for (const Step &step : m_steps)
+        m_statistics.barrierCount += static_cast<uint32_t>(step.barriers.size()) + (step.memoryBarrier ? 1u : 0u);
+}
+
+void RenderGraphResources::recordBarriers(VkCommandBuffer commandBuffer, uint32_t step, uint32_t imageIndex) const
+{
+    assert(m_compiled);
+
+    if (step >= m_steps.size() || (m_steps[step].barriers.empty() && !m_steps[step].memoryBarrier))
+        return;
+
+    const Step &currentStep = m_steps[step];
+
+    std::pmr::vector<VkImageMemoryBarrier> barriers =
+        m_frameArena->makeVector<VkImageMemoryBarrier>(currentStep.barriers.size());
+    for (const StepBarrier &stepBarrier : currentStep.barriers)
+    {
+        const ImageResource &resource = m_images[stepBarrier.resource];
+
+        VkImage image = VK_NULL_HANDLE;
+        if (resource.transient)
+            image = resource.image ? resource.image->getHandle() : VK_NULL_HANDLE;
+        else
+            image = resource.getExternalImage(imageIndex);
+
+        // released
+        if (image == VK_NULL_HANDLE)
+            continue;
+
+        barriers.push_back(VkImageMemoryBarrier{
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = stepBarrier.srcAccessMask,
+            .dstAccessMask = stepBarrier.dstAccessMask,
+            .oldLayout = stepBarrier.oldLayout,
+            .newLayout = stepBarrier.newLayout,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = image,
+            .subresourceRange =
+                {
+                    .aspectMask = resource.aspectFlags,
+                    .baseMipLevel = 0,
+                    .levelCount = VK_REMAINING_MIP_LEVELS,
+                    .baseArrayLayer = 0,
+                    .layerCount = resource.layerCount,
+                },
+        });
+    }
+
+    const VkMemoryBarrier memoryBarrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = currentStep.memorySrcAccessMask,
+        .dstAccessMask = currentStep.memoryDstAccessMask,
+    };
+    const uint32_t memoryBarrierCount = currentStep.memoryBarrier ? 1u : 0u;
+
+    if (barriers.empty() && memoryBarrierCount == 0u)
+        return;
+
+    vkCmdPipelineBarrier(commandBuffer, currentStep.srcStageMask, currentStep.dstStageMask, 0, memoryBarrierCount,
+                         &memoryBarrier, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+}
+
+void RenderGraphResources::releaseTransientImages(uint32_t stepCount, std::span<const VkFence> fences)
+{
+    ZoneScoped;
+
+    auto devicePtr = m_device.lock();
+    auto deviceHandle = devicePtr->getHandle();
+
+    bool fencesWaited = false;
+    for (MemoryBlock &block : m_memoryBlocks)
+    {
+        if (block.released || block.lastStep >= stepCount)
+            continue;
+
+        if (!fencesWaited && !fences.empty())
+        {
+            VkResult res = vkWaitForFences(deviceHandle, static_cast<uint32_t>(fences.size()), fences.data(), VK_TRUE,
+                                           UINT64_MAX);
+            assert(res != VK_TIMEOUT);
+            fencesWaited = true;
+        }
+
+        for (ResourceId id : block.images)
+        {
+            ImageResource &resource = m_images[id];
+            vkDestroyImageView(deviceHandle, resource.imageView, nullptr);
+            resource.imageView = VK_NULL_HANDLE;
+            resource.image.reset();
+        }
+
+        vmaFreeMemory(devicePtr->getAllocator(), block.allocation);
+        block.allocation = VK_NULL_HANDLE;
+        block.released = true;
+
+        m_statistics.releasedBytes += block.memoryRequirements.size;
+    }
+}
+
+VkImageView RenderGraphResources::getImageView(ResourceId resource) const
+{
+    assert(m_compiled);
+    assert(resource < m_images.size());
+
+    return m_images[resource].imageView;
+}
+
+RenderGraphResources::Statistics RenderGraphResources::getStatistics() const
+{
+    Statistics statistics = m_statistics;
+    statistics.elidedSemaphoreCount = static_cast<uint32_t>(
+        std::count_if(m_steps.begin(), m_steps.end(), [](const Step &step) { return step.barrierOnlyDependency; }));
+    return statistics;
+}
+
+std::unique_ptr<RenderGraphResources> RenderGraphResourcesBuilder::build()
+{
+    assert(m_product->m_device.lock());
+
+    auto result = std::move(m_product);
+    restart();
+    return result;
+}
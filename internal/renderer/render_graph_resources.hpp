@@ -0,0 +1,292 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include <vk_mem_alloc.h>
+
+class Device;
+class Image;
+class ImageBuilder;
+class RenderGraphResourcesBuilder;
+class FrameArena;
+
+/**
+ * @brief how a step of the render graph uses an image
+ *
+ */
+struct ImageAccess
+{
+    /**
+     * @brief layout the image must be in when the step starts
+     * undefined if the step discards the content and makes its own transition (render pass clear)
+     *
+     */
+    VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    /**
+     * @brief layout the image is left in by the step (render pass final layout)
+     *
+     */
+    VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VkPipelineStageFlags stageMask = VK_PIPELINE_STAGE_NONE;
+    VkAccessFlags accessMask = VK_ACCESS_NONE;
+};
+
+/**
+ * @brief image created and owned by the render graph, only alive between its first and last use
+ *
+ */
+struct TransientImageDesc
+{
+    std::string name = "Transient";
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    VkExtent2D extent = {};
+    bool cube = false;
+    VkImageUsageFlags usage = 0;
+    VkImageAspectFlags aspectFlags = VK_IMAGE_ASPECT_COLOR_BIT;
+};
+
+/**
+ * @brief images read and written by the phases of a render graph
+ * each phase is a step, the one-time phases come first and the per frame phases follow
+ * the steps declare how they use the images, from which the graph derives :
+ * - the lifetime of the transient images, the ones that are never used at the same time share the same memory
+ * - the barriers recorded at the start of each step, a barrier is only emitted on a layout change or a write hazard
+ * the first use of an image by the per frame steps is ordered after its last use by the per frame steps of the previous
+ * frame, and after the one-time steps on the first frame
+ *
+ */
+class RenderGraphResources
+{
+    friend RenderGraphResourcesBuilder;
+
+  public:
+    using ResourceId = uint32_t;
+
+    struct Statistics
+    {
+        uint32_t transientImageCount = 0u;
+        uint32_t memoryBlockCount = 0u;
+        /**
+         * @brief memory the transient images would use with one allocation each
+         *
+         */
+        VkDeviceSize requestedBytes = 0u;
+        VkDeviceSize allocatedBytes = 0u;
+        /**
+         * @brief memory given back once the steps using it were completed
+         *
+         */
+        VkDeviceSize releasedBytes = 0u;
+        uint32_t barrierCount = 0u;
+        /**
+         * @brief consecutive uses of an image that did not need a barrier
+         *
+         */
+        uint32_t skippedBarrierCount = 0u;
+        /**
+         * @brief semaphores between two steps replaced by the barriers of the second one
+         *
+         */
+        uint32_t elidedSemaphoreCount = 0u;
+    };
+
+  private:
+    struct ImageResource
+    {
+        std::string name;
+
+        bool transient = false;
+        TransientImageDesc transientDesc;
+        std::unique_ptr<Image> image;
+        VkImageView imageView = VK_NULL_HANDLE;
+        VkMemoryRequirements memoryRequirements = {};
+        uint32_t memoryBlock = UINT32_MAX;
+
+        std::function<VkImage(uint32_t imageIndex)> getExternalImage;
+
+        VkImageAspectFlags aspectFlags = VK_IMAGE_ASPECT_COLOR_BIT;
+        uint32_t layerCount = 1u;
+
+        /**
+         * @brief sorted by step once compiled
+         *
+         */
+        std::vector<std::pair<uint32_t, ImageAccess>> accesses;
+        uint32_t firstStep = 0u;
+        uint32_t lastStep = UINT32_MAX;
+    };
+
+    struct MemoryBlock
+    {
+        VmaAllocation allocation = VK_NULL_HANDLE;
+        VkMemoryRequirements memoryRequirements = {};
+        std::vector<ResourceId> images;
+        uint32_t lastStep = 0u;
+        bool released = false;
+    };
+
+    struct StepBarrier
+    {
+        ResourceId resource;
+        VkImageLayout oldLayout;
+        VkImageLayout newLayout;
+        VkAccessFlags srcAccessMask;
+        VkAccessFlags dstAccessMask;
+    };
+
+    struct Step
+    {
+        std::vector<StepBarrier> barriers;
+        VkPipelineStageFlags srcStageMask = VK_PIPELINE_STAGE_NONE;
+        VkPipelineStageFlags dstStageMask = VK_PIPELINE_STAGE_NONE;
+
+        /**
+         * @brief global barrier for the images whose content is discarded by the step
+         *
+         */
+        bool memoryBarrier = false;
+        VkAccessFlags memorySrcAccessMask = VK_ACCESS_NONE;
+        VkAccessFlags memoryDstAccessMask = VK_ACCESS_NONE;
+
+        /**
+         * @brief this step is ordered after the previous one by its barriers only, no semaphore is used between them
+         *
+         */
+        bool barrierOnlyDependency = false;
+    };
+
+    std::weak_ptr<Device> m_device;
+    /**
+     * @brief temporary containers of the frame, owned by the graph
+     *
+     */
+    FrameArena *m_frameArena = nullptr;
+
+    std::vector<ImageResource> m_images;
+    std::vector<MemoryBlock> m_memoryBlocks;
+    std::vector<Step> m_steps;
+
+    /**
+     * @brief the steps from this one on are processed every frame, every step is one-time if not set
+     *
+     */
+    uint32_t m_firstPerFrameStep = UINT32_MAX;
+
+    bool m_compiled = false;
+    Statistics m_statistics;
+
+    RenderGraphResources() = default;
+
+    [[nodiscard]] Step &getStep(uint32_t step);
+
+    void configureTransientImageBuilder(ImageBuilder &builder, const TransientImageDesc &desc) const;
+    [[nodiscard]] bool allocateTransientImages();
+    void deriveBarriers();
+
+  public:
+    ~RenderGraphResources();
+
+    RenderGraphResources(const RenderGraphResources &) = delete;
+    RenderGraphResources &operator=(const RenderGraphResources &) = delete;
+    RenderGraphResources(RenderGraphResources &&) = delete;
+    RenderGraphResources &operator=(RenderGraphResources &&) = delete;
+
+    ResourceId declareTransientImage(const TransientImageDesc &desc);
+    /**
+     * @brief image owned by someone else (swapchain), fetched when the barriers are recorded
+     *
+     * @param name
+     * @param getImage returns the image for the given swapchain image index
+     * @param aspectFlags
+     * @param layerCount
+     */
+    ResourceId declareExternalImage(const std::string &name, std::function<VkImage(uint32_t imageIndex)> getImage,
+                                    VkImageAspectFlags aspectFlags, uint32_t layerCount = 1u);
+    /**
+     * @brief declare how a step uses an image, at most once per step and per image
+     *
+     */
+    void declareAccess(ResourceId resource, uint32_t step, const ImageAccess &access);
+
+    /**
+     * @brief the steps from the given one on are processed every frame, the first access of an image among them depends
+     * on its last access of the previous frame
+     *
+     */
+    void setFirstPerFrameStep(uint32_t step);
+
+    /**
+     * @brief replace the semaphore between a step and the previous one by the barriers of the step
+     * only valid if every dependency between the two steps has been declared
+     *
+     */
+    void setBarrierOnlyDependency(uint32_t step, bool enable);
+
+    /**
+     * @brief compute the lifetimes, allocate the transient images and derive the barriers
+     * the transient image views are available once compiled
+     *
+     * @return false if the memory could not be allocated
+     */
+    bool compile();
+
+    /**
+     * @brief record the barriers that must happen before the commands of a step
+     *
+     */
+    void recordBarriers(VkCommandBuffer commandBuffer, uint32_t step, uint32_t imageIndex) const;
+
+    /**
+     * @brief give back the memory of the transient images that are not used after the given number of steps
+     *
+     * @param stepCount
+     * @param fences signaled once the steps are completed
+     */
+    void releaseTransientImages(uint32_t stepCount, std::span<const VkFence> fences);
+
+  public:
+    [[nodiscard]] VkImageView getImageView(ResourceId resource) const;
+
+    [[nodiscard]] inline bool hasBarrierOnlyDependency(uint32_t step) const
+    {
+        return step < m_steps.size() && m_steps[step].barrierOnlyDependency;
+    }
+
+    [[nodiscard]] Statistics getStatistics() const;
+};
+
+class RenderGraphResourcesBuilder
+{
+  private:
+    std::unique_ptr<RenderGraphResources> m_product;
+
+    void restart()
+    {
+        m_product = std::unique_ptr<RenderGraphResources>(new RenderGraphResources);
+    }
+
+  public:
+    RenderGraphResourcesBuilder()
+    {
+        restart();
+    }
+
+    void setDevice(std::weak_ptr<Device> device)
+    {
+        m_product->m_device = device;
+    }
+
+    void setFrameArena(FrameArena *frameArena)
+    {
+        m_product->m_frameArena = frameArena;
+    }
+
+    std::unique_ptr<RenderGraphResources> build();
+};
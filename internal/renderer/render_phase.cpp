@@ -1,3 +1,4 @@
+#include <array>
 #include <iostream>
 
 #include <glm/gtc/matrix_transform.hpp>
@@ -13,9 +14,12 @@
 #include "texture.hpp"
 
 #include "engine/camera.hpp"
+#include "engine/frame_arena.hpp"
 #include "engine/probe_grid.hpp"
 #include "engine/uniform.hpp"
 
+#include "acceleration_structure_cache.hpp"
+#include "render_graph_resources.hpp"
 #include "render_state.hpp"
 
 #include "render_phase.hpp"
@@ -58,6 +62,8 @@ void RenderPhase::registerRenderStateToAllPool(std::shared_ptr<RenderStateABC> r
 
         m_pooledRenderStates[poolIndex].push_back(renderState);
     }
+
+    invalidateRecordedCommands();
 }
 
 void RenderPhase::registerRenderStateToSpecificPool(std::shared_ptr<RenderStateABC> renderState,
@@ -78,6 +84,8 @@ void RenderPhase::registerRenderStateToSpecificPool(std::shared_ptr<RenderStateA
     }
 
     m_pooledRenderStates[pooledFramebufferIndex].push_back(renderState);
+
+    invalidateRecordedCommands();
 }
 
 void RenderPhase::recordBackBuffer(uint32_t imageIndex, uint32_t singleFrameRenderIndex,
@@ -95,7 +103,46 @@ void RenderPhase::recordBackBuffer(uint32_t imageIndex, uint32_t singleFrameRend
         vkResetFences(m_device.lock()->getHandle(), 1, &currentFence);
     }
 
-    const VkCommandBuffer &commandBuffer = getCurrentBackBuffer(pooledFramebufferIndex).commandBuffer;
+    const auto &renderStates = m_pooledRenderStates[pooledFramebufferIndex];
+    for (int i = 0; i < renderStates.size(); ++i)
+    {
+        renderStates[i]->updateUniformBuffers(m_backBufferIndex, singleFrameRenderIndex, pooledFramebufferIndex,
+                                              camera, lights, probeGrid, m_isCapturePhase);
+    }
+
+    assert(m_renderPass.has_value());
+    renderArea.extent.width =
+        std::min(renderArea.extent.width - renderArea.offset.x, m_renderPass.value()->getMinRenderArea().extent.width);
+    renderArea.extent.height = std::min(renderArea.extent.height - renderArea.offset.y,
+                                        m_renderPass.value()->getMinRenderArea().extent.height);
+    const VkFramebuffer framebuffer = m_renderPass.value()->getFramebuffer(pooledFramebufferIndex, imageIndex);
+
+    // keep track of this newly rendered image
+    m_lastFramebuffer = std::optional<VkFramebuffer>(framebuffer);
+    m_lastFramebufferImageResource = m_renderPass.value()->getImageResource(imageIndex);
+    m_lastFramebufferImageView =
+        std::optional<VkImageView>(m_renderPass.value()->getImageView(pooledFramebufferIndex, imageIndex));
+
+    // only the first render of the first pooled framebuffer is timed, the capture phases render many of them
+    const bool timestampEnable = m_timestampQuery && singleFrameRenderIndex == 0u && pooledFramebufferIndex == 0u;
+    if (timestampEnable)
+        m_timestampQuery->readResults(m_backBufferIndex);
+
+    // dependencies on the previous steps of the graph, the first pooled framebuffer is submitted first
+    const bool graphBarriersEnable = m_graphResources && singleFrameRenderIndex == 0u &&
+                                     pooledFramebufferIndex == getFirstPooledFramebufferIndex(probeGrid);
+
+    BackBufferT &backBuffer = m_pooledBackBuffers[pooledFramebufferIndex][m_backBufferIndex];
+    recordFrameCommandBuffers(backBuffer, timestampEnable, graphBarriersEnable, imageIndex);
+
+    // the command buffer already holds these exact commands, it only needs to be submitted again
+    const std::optional<uint64_t> recordKey = getRecordKey(pooledFramebufferIndex, framebuffer, renderArea, camera);
+    if (recordKey.has_value() && recordKey == backBuffer.recordKey)
+        return;
+
+    backBuffer.recordKey.reset();
+
+    const VkCommandBuffer &commandBuffer = backBuffer.commandBuffer;
 
     vkResetCommandBuffer(commandBuffer, 0);
 
@@ -112,35 +159,26 @@ void RenderPhase::recordBackBuffer(uint32_t imageIndex, uint32_t singleFrameRend
     }
 
     VkClearValue clearColor = {
-        .color = {0.05f, 0.05f, 0.05f, 0.f},
+        .color = m_clearColor,
     };
     VkClearValue clearDepth = {
         .depthStencil = {1.f, 0},
     };
     std::array<VkClearValue, 2> clearValues = {clearColor, clearDepth};
 
-    assert(m_renderPass.has_value());
-    renderArea.extent.width =
-        std::min(renderArea.extent.width - renderArea.offset.x, m_renderPass.value()->getMinRenderArea().extent.width);
-    renderArea.extent.height = std::min(renderArea.extent.height - renderArea.offset.y,
-                                        m_renderPass.value()->getMinRenderArea().extent.height);
-
     VkRenderPassBeginInfo renderPassBeginInfo = {
         .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
         .renderPass = m_renderPass.value()->getHandle(),
-        .framebuffer = m_renderPass.value()->getFramebuffer(pooledFramebufferIndex, imageIndex),
+        .framebuffer = framebuffer,
         .renderArea = renderArea,
         .clearValueCount = static_cast<uint32_t>(clearValues.size()),
         .pClearValues = clearValues.data(),
     };
 
-    const auto &renderStates = m_pooledRenderStates[pooledFramebufferIndex];
     for (int i = 0; i < renderStates.size(); ++i)
     {
         RenderStateABC *renderState = renderStates[i].get();
         renderState->updatePushConstants(commandBuffer, singleFrameRenderIndex, camera, lights);
-        renderState->updateUniformBuffers(m_backBufferIndex, singleFrameRenderIndex, pooledFramebufferIndex, camera,
-                                          lights, probeGrid, m_isCapturePhase);
         renderState->updateDescriptorSetsPerFrame(m_parentPhase, commandBuffer, m_backBufferIndex,
                                                   pooledFramebufferIndex);
     }
@@ -168,32 +206,146 @@ void RenderPhase::recordBackBuffer(uint32_t imageIndex, uint32_t singleFrameRend
 
     res = vkEndCommandBuffer(commandBuffer);
     if (res != VK_SUCCESS)
+    {
         std::cerr << "Failed to record command buffer : " << res << std::endl;
+        return;
+    }
 
-    // keep track of this newly rendered image
-    m_lastFramebuffer = std::optional<VkFramebuffer>(renderPassBeginInfo.framebuffer);
-    m_lastFramebufferImageResource = m_renderPass.value()->getImageResource(imageIndex);
-    m_lastFramebufferImageView =
-        std::optional<VkImageView>(m_renderPass.value()->getImageView(pooledFramebufferIndex, imageIndex));
+    backBuffer.recordKey = recordKey;
+}
+
+std::optional<uint64_t> RenderPhase::getRecordKey(uint32_t pooledFramebufferIndex, VkFramebuffer framebuffer,
+                                                  VkRect2D renderArea, const CameraABC &camera) const
+{
+    RecordKey key;
+    key.add(framebuffer);
+    key.add(renderArea);
+
+    for (const std::shared_ptr<RenderStateABC> &renderState : m_pooledRenderStates[pooledFramebufferIndex])
+    {
+        if (!renderState->addToRecordKey(key, m_backBufferIndex, camera))
+            return std::nullopt;
+    }
+
+    return key.value;
+}
+
+bool RenderPhase::isPooledFramebufferSkipped(uint32_t pooledFramebufferIndex,
+                                             const std::shared_ptr<ProbeGrid> &probeGrid) const
+{
+    return m_isCapturePhase && probeGrid && !probeGrid->isProbeActive(pooledFramebufferIndex);
+}
+
+uint32_t RenderPhase::getFirstPooledFramebufferIndex(const std::shared_ptr<ProbeGrid> &probeGrid) const
+{
+    uint32_t poolIndex = 0u;
+    while (isPooledFramebufferSkipped(poolIndex, probeGrid) &&
+           poolIndex + 1u < m_renderPass.value()->getFramebufferPoolSize())
+    {
+        poolIndex++;
+    }
+    return poolIndex;
+}
+
+void RenderPhase::recordFrameCommandBuffers(BackBufferT &backBuffer, bool timestampEnable, bool graphBarriersEnable,
+                                            uint32_t imageIndex)
+{
+    backBuffer.frameBeginEnable = timestampEnable || graphBarriersEnable || m_asyncComputePhase;
+    backBuffer.frameEndEnable = timestampEnable || m_asyncComputePhase;
+
+    VkCommandBufferBeginInfo commandBufferBeginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        .pInheritanceInfo = nullptr,
+    };
+
+    if (backBuffer.frameBeginEnable)
+    {
+        const VkCommandBuffer &commandBuffer = backBuffer.frameBeginCommandBuffer;
+        vkResetCommandBuffer(commandBuffer, 0);
+        vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
+
+        if (timestampEnable)
+            m_timestampQuery->recordBegin(commandBuffer, m_backBufferIndex);
+
+        if (graphBarriersEnable)
+            m_graphResources->recordBarriers(commandBuffer, m_graphStep, imageIndex);
+
+        if (m_asyncComputePhase)
+            m_asyncComputePhase->recordGraphicsQueueAcquire(commandBuffer, m_backBufferIndex);
+
+        VkResult res = vkEndCommandBuffer(commandBuffer);
+        if (res != VK_SUCCESS)
+            std::cerr << "Failed to record frame begin command buffer : " << res << std::endl;
+    }
+
+    if (backBuffer.frameEndEnable)
+    {
+        const VkCommandBuffer &commandBuffer = backBuffer.frameEndCommandBuffer;
+        vkResetCommandBuffer(commandBuffer, 0);
+        vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
+
+        if (m_asyncComputePhase)
+            m_asyncComputePhase->recordGraphicsQueueRelease(commandBuffer, m_backBufferIndex);
+
+        if (timestampEnable)
+            m_timestampQuery->recordEnd(commandBuffer, m_backBufferIndex);
+
+        VkResult res = vkEndCommandBuffer(commandBuffer);
+        if (res != VK_SUCCESS)
+            std::cerr << "Failed to record frame end command buffer : " << res << std::endl;
+    }
+}
+
+void RenderPhase::invalidateRecordedCommands()
+{
+    for (std::vector<BackBufferT> &backBuffers : m_pooledBackBuffers)
+    {
+        for (BackBufferT &backBuffer : backBuffers)
+            backBuffer.recordKey.reset();
+    }
 }
 
-void RenderPhase::submitBackBuffer(const VkSemaphore *waitSemaphoreOverride, uint32_t pooledFramebufferIndex) const
+void RenderPhase::submitBackBuffer(const VkSemaphore *waitSemaphoreOverride, uint32_t pooledFramebufferIndex,
+                                   bool waitSemaphoreEnable, bool signalSemaphoreEnable) const
 {
     ZoneScoped;
 
     const BackBufferT &currentBackBuffer = getCurrentBackBuffer(pooledFramebufferIndex);
-    VkSemaphore waitSemaphores[] = {waitSemaphoreOverride ? *waitSemaphoreOverride
-                                                          : currentBackBuffer.acquireSemaphore};
-    VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+    // the previous phase or the swapchain image, and the async compute phase
+    std::array<VkSemaphore, 2> waitSemaphores;
+    std::array<VkPipelineStageFlags, 2> waitStages;
+    uint32_t waitSemaphoreCount = 0u;
+    if (waitSemaphoreEnable)
+    {
+        waitSemaphores[waitSemaphoreCount] =
+            waitSemaphoreOverride ? *waitSemaphoreOverride : currentBackBuffer.acquireSemaphore;
+        waitStages[waitSemaphoreCount++] = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    }
+    // the async compute phase of the frame joins the graphics queue here
+    if (m_asyncComputePhase)
+    {
+        waitSemaphores[waitSemaphoreCount] = m_asyncComputePhase->getCurrentRenderSemaphore();
+        waitStages[waitSemaphoreCount++] = ComputePhase::s_graphicsWaitStages;
+    }
+    // the re-submitted commands between the ones recorded for this frame
+    std::array<VkCommandBuffer, 3> commandBuffers;
+    uint32_t commandBufferCount = 0u;
+    if (currentBackBuffer.frameBeginEnable)
+        commandBuffers[commandBufferCount++] = currentBackBuffer.frameBeginCommandBuffer;
+    commandBuffers[commandBufferCount++] = currentBackBuffer.commandBuffer;
+    if (currentBackBuffer.frameEndEnable)
+        commandBuffers[commandBufferCount++] = currentBackBuffer.frameEndCommandBuffer;
+
     VkSemaphore signalSemaphores[] = {getCurrentRenderSemaphore(pooledFramebufferIndex)};
     VkSubmitInfo submitInfo = {
         .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .waitSemaphoreCount = 1,
-        .pWaitSemaphores = waitSemaphores,
-        .pWaitDstStageMask = waitStages,
-        .commandBufferCount = 1,
-        .pCommandBuffers = &currentBackBuffer.commandBuffer,
-        .signalSemaphoreCount = 1,
+        .waitSemaphoreCount = waitSemaphoreCount,
+        .pWaitSemaphores = waitSemaphores.data(),
+        .pWaitDstStageMask = waitStages.data(),
+        .commandBufferCount = commandBufferCount,
+        .pCommandBuffers = commandBuffers.data(),
+        .signalSemaphoreCount = signalSemaphoreEnable ? 1u : 0u,
         .pSignalSemaphores = signalSemaphores,
     };
 
@@ -224,6 +376,9 @@ std::unique_ptr<RenderPhase> RenderPhaseBuilder<RenderTypeE::RASTER>::build()
     if (m_product->m_renderPass.has_value())
         poolSize = m_product->m_renderPass.value()->getFramebufferPoolSize();
 
+    // the render semaphore of the async compute phase is signaled once per frame
+    assert(!m_product->m_asyncComputePhase || (poolSize == 1u && m_product->m_singleFrameRenderCount == 1u));
+
     m_product->m_pooledRenderStates.resize(poolSize);
     m_product->m_pooledBackBuffers.resize(poolSize);
     for (uint32_t poolIndex = 0u; poolIndex < poolSize; poolIndex++)
@@ -259,6 +414,19 @@ std::unique_ptr<RenderPhase> RenderPhaseBuilder<RenderTypeE::RASTER>::build()
                 .objectHandle = (uint64_t)(backBuffers[i].commandBuffer),
                 .pObjectName = std::string(m_phaseName + " " + phaseType + " : " + std::to_string(i)).c_str(),
             });
+
+            // frame begin and end commands
+            std::array<VkCommandBuffer, 2> frameCommandBuffers;
+            VkCommandBufferAllocateInfo frameCommandBufferAllocInfo = commandBufferAllocInfo;
+            frameCommandBufferAllocInfo.commandBufferCount = static_cast<uint32_t>(frameCommandBuffers.size());
+            res = vkAllocateCommandBuffers(deviceHandle, &frameCommandBufferAllocInfo, frameCommandBuffers.data());
+            if (res != VK_SUCCESS)
+            {
+                std::cerr << "Failed to allocate command buffers : " << res << std::endl;
+                return nullptr;
+            }
+            backBuffers[i].frameBeginCommandBuffer = frameCommandBuffers[0];
+            backBuffers[i].frameEndCommandBuffer = frameCommandBuffers[1];
         }
 
         // synchronization
@@ -314,6 +482,8 @@ std::unique_ptr<RenderPhase> RenderPhaseBuilder<RenderTypeE::RASTER>::build()
         }
     }
 
+    m_product->m_timestampQuery = buildTimestampQuery(m_device, m_bufferingType);
+
     return std::move(m_product);
 }
 
@@ -322,6 +492,8 @@ void RenderPhase::updateSwapchainOnRenderPass(const SwapChain *newSwapchain)
     if (!m_renderPass.has_value())
         return;
 
+    invalidateRecordedCommands();
+
     const std::vector<std::vector<VkImageView>> &imageViewPool = {newSwapchain->getImageViews()};
     const std::vector<VkImageView> &depthImageViewPool = {newSwapchain->getDepthImageView()};
     if (m_renderPass.value()->getHasDepthAttachment())
@@ -340,7 +512,7 @@ ComputePhase::~ComputePhase()
     auto devicePtr = m_device.lock();
     auto deviceHandle = devicePtr->getHandle();
 
-    vkQueueWaitIdle(devicePtr->getComputeQueue());
+    vkQueueWaitIdle(getQueue());
 
     for (uint32_t j = 0u; j < m_backBuffers.size(); j++)
     {
@@ -360,6 +532,9 @@ void ComputePhase::recordBackBuffer() const
     assert(res != VK_TIMEOUT);
     vkResetFences(m_device.lock()->getHandle(), 1, &currentFence);
 
+    if (m_timestampQuery)
+        m_timestampQuery->readResults(m_backBufferIndex);
+
     const VkCommandBuffer &commandBuffer = getCurrentBackBuffer().commandBuffer;
 
     vkResetCommandBuffer(commandBuffer, 0);
@@ -376,6 +551,17 @@ void ComputePhase::recordBackBuffer() const
         return;
     }
 
+    if (m_timestampQuery)
+        m_timestampQuery->recordBegin(commandBuffer, m_backBufferIndex);
+
+    // the graphics queue has released the buffers of the previous frame after reading them
+    if (m_frameCount > 0u)
+    {
+        const uint32_t previousIndex = (m_backBufferIndex + m_backBuffers.size() - 1u) % m_backBuffers.size();
+        recordQueueTransfer(commandBuffer, previousIndex, false, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, true);
+    }
+
     for (int i = 0; i < m_computeStates.size(); ++i)
     {
         ComputeState *computeState = m_computeStates[i].get();
@@ -390,7 +576,12 @@ void ComputePhase::recordBackBuffer() const
         computeState->updateUniformBuffers(0);
         computeState->recordBackBufferComputeCommands(commandBuffer, m_backBufferIndex);
     }
-    std::vector<VkDescriptorSet> descriptorSets;
+
+    recordQueueTransfer(commandBuffer, m_backBufferIndex, true, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, false);
+
+    if (m_timestampQuery)
+        m_timestampQuery->recordEnd(commandBuffer, m_backBufferIndex);
 
     res = vkEndCommandBuffer(commandBuffer);
     if (res != VK_SUCCESS)
@@ -402,9 +593,30 @@ void ComputePhase::submitBackBuffer(const VkSemaphore *waitSemaphoreOverride) co
     ZoneScoped;
 
     const BackBufferT &currentBackBuffer = getCurrentBackBuffer();
-    VkSemaphore waitSemaphores[] = {waitSemaphoreOverride ? *waitSemaphoreOverride
-                                                          : currentBackBuffer.acquireSemaphore};
-    VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT};
+
+    if (m_isAsync)
+    {
+        // empty submission, its semaphore starts the dispatches once the graphics work submitted before has completed
+        // (acceleration structure updates, previous frames)
+        VkSubmitInfo forkInfo = {
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .signalSemaphoreCount = 1,
+            .pSignalSemaphores = &currentBackBuffer.acquireSemaphore,
+        };
+        VkResult res = vkQueueSubmit(m_device.lock()->getGraphicsQueue(), 1, &forkInfo, VK_NULL_HANDLE);
+        if (res != VK_SUCCESS)
+        {
+            std::cerr << "Failed to submit async compute fork : " << res << std::endl;
+            assert(false);
+            abort();
+        }
+    }
+
+    VkSemaphore waitSemaphores[] = {waitSemaphoreOverride && !m_isAsync ? *waitSemaphoreOverride
+                                                                        : currentBackBuffer.acquireSemaphore};
+    // the timestamps of an async phase do not count the wait for the graphics queue
+    VkPipelineStageFlags waitStages[] = {m_isAsync ? VK_PIPELINE_STAGE_ALL_COMMANDS_BIT
+                                                   : VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT};
     VkSemaphore signalSemaphores[] = {getCurrentRenderSemaphore()};
     VkSubmitInfo submitInfo = {
         .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
@@ -417,7 +629,7 @@ void ComputePhase::submitBackBuffer(const VkSemaphore *waitSemaphoreOverride) co
         .pSignalSemaphores = signalSemaphores,
     };
 
-    VkResult res = vkQueueSubmit(m_device.lock()->getGraphicsQueue(), 1, &submitInfo, getCurrentFence());
+    VkResult res = vkQueueSubmit(getQueue(), 1, &submitInfo, getCurrentFence());
     if (res != VK_SUCCESS)
     {
         std::cerr << "Failed to submit dispatch (compute) command buffer : " << res << std::endl;
@@ -428,12 +640,71 @@ void ComputePhase::submitBackBuffer(const VkSemaphore *waitSemaphoreOverride) co
 
 void ComputePhase::wait() const
 {
-    vkQueueWaitIdle(m_device.lock()->getComputeQueue());
+    vkQueueWaitIdle(getQueue());
 }
 
 void ComputePhase::swapBackBuffers()
 {
     m_backBufferIndex = (m_backBufferIndex + 1) % m_backBuffers.size();
+    m_frameCount++;
+}
+
+const VkQueue &ComputePhase::getQueue() const
+{
+    auto devicePtr = m_device.lock();
+    return m_isAsync ? devicePtr->getComputeQueue() : devicePtr->getGraphicsQueue();
+}
+
+void ComputePhase::recordQueueTransfer(VkCommandBuffer commandBuffer, uint32_t backBufferIndex, bool toGraphicsQueue,
+                                       VkPipelineStageFlags srcStageMask, VkAccessFlags srcAccessMask,
+                                       VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask,
+                                       bool readBackOnly) const
+{
+    auto devicePtr = m_device.lock();
+    if (!m_isAsync || !m_queueTransferBuffersPred || !devicePtr->isAsyncComputeSupported())
+        return;
+
+    const uint32_t graphicsFamilyIndex = devicePtr->getGraphicsFamilyIndex().value();
+    const uint32_t computeFamilyIndex = devicePtr->getComputeFamilyIndex().value();
+
+    std::pmr::vector<QueueTransferBufferT> buffers = m_frameArena->makeVector<QueueTransferBufferT>();
+    m_queueTransferBuffersPred(backBufferIndex, buffers);
+
+    std::pmr::vector<VkBufferMemoryBarrier> barriers = m_frameArena->makeVector<VkBufferMemoryBarrier>(buffers.size());
+    for (const QueueTransferBufferT &buffer : buffers)
+    {
+        if (readBackOnly && !buffer.readBack)
+            continue;
+
+        barriers.push_back(VkBufferMemoryBarrier{
+            .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+            .srcAccessMask = srcAccessMask,
+            .dstAccessMask = dstAccessMask,
+            .srcQueueFamilyIndex = toGraphicsQueue ? computeFamilyIndex : graphicsFamilyIndex,
+            .dstQueueFamilyIndex = toGraphicsQueue ? graphicsFamilyIndex : computeFamilyIndex,
+            .buffer = buffer.handle,
+            .offset = 0,
+            .size = VK_WHOLE_SIZE,
+        });
+    }
+    if (barriers.empty())
+        return;
+
+    vkCmdPipelineBarrier(commandBuffer, srcStageMask, dstStageMask, 0, 0, nullptr,
+                         static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+}
+
+void ComputePhase::recordGraphicsQueueAcquire(VkCommandBuffer commandBuffer, uint32_t backBufferIndex) const
+{
+    recordQueueTransfer(commandBuffer, backBufferIndex, true, s_graphicsWaitStages, 0, s_graphicsWaitStages,
+                        VK_ACCESS_SHADER_READ_BIT, false);
+}
+
+void ComputePhase::recordGraphicsQueueRelease(VkCommandBuffer commandBuffer, uint32_t backBufferIndex) const
+{
+    // the dispatches of the next frame read the buffers again
+    recordQueueTransfer(commandBuffer, backBufferIndex, false, s_graphicsWaitStages, 0,
+                        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, true);
 }
 
 std::unique_ptr<ComputePhase> ComputePhaseBuilder::build()
@@ -450,7 +721,8 @@ std::unique_ptr<ComputePhase> ComputePhaseBuilder::build()
         {
             VkCommandBufferAllocateInfo commandBufferAllocInfo = {
                 .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-                .commandPool = devicePtr->getCommandPool(),
+                .commandPool =
+                    m_product->m_isAsync ? devicePtr->getComputeCommandPool() : devicePtr->getCommandPool(),
                 .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
                 .commandBufferCount = 1U,
             };
@@ -521,6 +793,10 @@ std::unique_ptr<ComputePhase> ComputePhaseBuilder::build()
         });
     }
 
+    const std::optional<uint32_t> queueFamilyIndex =
+        m_product->m_isAsync ? devicePtr->getComputeFamilyIndex() : devicePtr->getGraphicsFamilyIndex();
+    m_product->m_timestampQuery = buildTimestampQuery(m_device, m_bufferingType, queueFamilyIndex);
+
     return std::move(m_product);
 }
 
@@ -549,7 +825,49 @@ void RayTracePhase::recordBackBuffer(uint32_t imageIndex, uint32_t singleFrameRe
         vkResetFences(m_device.lock()->getHandle(), 1, &currentFence);
     }
 
-    const VkCommandBuffer &commandBuffer = getCurrentBackBuffer(pooledFramebufferIndex).commandBuffer;
+    const auto &renderStates = m_pooledRenderStates[pooledFramebufferIndex];
+    for (int i = 0; i < renderStates.size(); ++i)
+    {
+        renderStates[i]->updateUniformBuffers(m_backBufferIndex, singleFrameRenderIndex, pooledFramebufferIndex,
+                                              camera, lights, probeGrid, m_isCapturePhase);
+    }
+
+    VkFramebuffer framebuffer = VK_NULL_HANDLE;
+    if (m_renderPass.has_value())
+    {
+        auto &rp = m_renderPass.value();
+        renderArea.extent.width =
+            std::min(renderArea.extent.width - renderArea.offset.x, rp->getMinRenderArea().extent.width);
+        renderArea.extent.height =
+            std::min(renderArea.extent.height - renderArea.offset.y, rp->getMinRenderArea().extent.height);
+        framebuffer = rp->getFramebuffer(pooledFramebufferIndex, imageIndex);
+
+        // keep track of this newly rendered image
+        m_lastFramebuffer = std::optional<VkFramebuffer>(framebuffer);
+        m_lastFramebufferImageResource = rp->getImageResource(imageIndex);
+        m_lastFramebufferImageView = std::optional<VkImageView>(rp->getImageView(pooledFramebufferIndex, imageIndex));
+    }
+
+    // only the first render of the first pooled framebuffer is timed, the capture phases render many of them
+    const bool timestampEnable = m_timestampQuery && singleFrameRenderIndex == 0u && pooledFramebufferIndex == 0u;
+    if (timestampEnable)
+        m_timestampQuery->readResults(m_backBufferIndex);
+
+    // dependencies on the previous steps of the graph, the first pooled framebuffer is submitted first
+    const bool graphBarriersEnable = m_graphResources && singleFrameRenderIndex == 0u &&
+                                     pooledFramebufferIndex == getFirstPooledFramebufferIndex(probeGrid);
+
+    BackBufferT &backBuffer = m_pooledBackBuffers[pooledFramebufferIndex][m_backBufferIndex];
+    recordFrameCommandBuffers(backBuffer, timestampEnable, graphBarriersEnable, imageIndex);
+
+    // the command buffer already holds these exact commands, it only needs to be submitted again
+    const std::optional<uint64_t> recordKey = getRecordKey(pooledFramebufferIndex, framebuffer, renderArea, camera);
+    if (recordKey.has_value() && recordKey == backBuffer.recordKey)
+        return;
+
+    backBuffer.recordKey.reset();
+
+    const VkCommandBuffer &commandBuffer = backBuffer.commandBuffer;
 
     vkResetCommandBuffer(commandBuffer, 0);
 
@@ -565,28 +883,25 @@ void RayTracePhase::recordBackBuffer(uint32_t imageIndex, uint32_t singleFrameRe
         return;
     }
 
-    const auto &renderStates = m_pooledRenderStates[pooledFramebufferIndex];
     for (int i = 0; i < renderStates.size(); ++i)
     {
         RenderStateABC *renderState = renderStates[i].get();
         renderState->updatePushConstants(commandBuffer, singleFrameRenderIndex, camera, lights);
-        renderState->updateUniformBuffers(m_backBufferIndex, singleFrameRenderIndex, pooledFramebufferIndex, camera,
-                                          lights, probeGrid, m_isCapturePhase);
         renderState->updateDescriptorSetsPerFrame(m_parentPhase, commandBuffer, m_backBufferIndex,
                                                   pooledFramebufferIndex);
     }
 
-    VkRenderPassBeginInfo renderPassBeginInfo;
     if (m_renderPass.has_value())
     {
         auto &rp = m_renderPass.value();
         VkClearValue clearColor = {
-            .color = {0.05f, 0.05f, 0.05f, 0.f},
+            .color = m_clearColor,
         };
         VkClearValue clearDepth = {
             .depthStencil = {1.f, 0},
         };
-        std::vector<VkClearValue> clearValues(rp->getColorAttachmentCount() + (int)rp->getHasDepthAttachment());
+        std::pmr::vector<VkClearValue> clearValues(rp->getColorAttachmentCount() + (int)rp->getHasDepthAttachment(),
+                                                   m_frameArena);
         for (int i = 0; i < clearValues.size(); ++i)
         {
             clearValues[i] = clearColor;
@@ -594,15 +909,10 @@ void RayTracePhase::recordBackBuffer(uint32_t imageIndex, uint32_t singleFrameRe
         if (rp->getHasDepthAttachment())
             clearValues.back() = clearDepth;
 
-        renderArea.extent.width =
-            std::min(renderArea.extent.width - renderArea.offset.x, rp->getMinRenderArea().extent.width);
-        renderArea.extent.height =
-            std::min(renderArea.extent.height - renderArea.offset.y, rp->getMinRenderArea().extent.height);
-
         VkRenderPassBeginInfo renderPassBeginInfo = {
             .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
             .renderPass = rp->getHandle(),
-            .framebuffer = rp->getFramebuffer(pooledFramebufferIndex, imageIndex),
+            .framebuffer = framebuffer,
             .renderArea = renderArea,
             .clearValueCount = static_cast<uint32_t>(clearValues.size()),
             .pClearValues = clearValues.data(),
@@ -632,56 +942,17 @@ void RayTracePhase::recordBackBuffer(uint32_t imageIndex, uint32_t singleFrameRe
 
     res = vkEndCommandBuffer(commandBuffer);
     if (res != VK_SUCCESS)
-        std::cerr << "Failed to record command buffer : " << res << std::endl;
-
-    if (m_renderPass.has_value())
     {
-        // keep track of this newly rendered image
-        m_lastFramebuffer = std::optional<VkFramebuffer>(renderPassBeginInfo.framebuffer);
-        m_lastFramebufferImageResource = m_renderPass.value()->getImageResource(imageIndex);
-        m_lastFramebufferImageView =
-            std::optional<VkImageView>(m_renderPass.value()->getImageView(pooledFramebufferIndex, imageIndex));
+        std::cerr << "Failed to record command buffer : " << res << std::endl;
+        return;
     }
+
+    backBuffer.recordKey = recordKey;
 }
 
 RayTracePhase::AsGeom RayTracePhase::getAsGeometry(std::shared_ptr<Mesh> mesh) const
 {
-    // from
-    // https://nvpro-samples.github.io/vk_raytracing_tutorial_KHR/vkrt_tutorial.md.html#accelerationstructure/bottom-levelaccelerationstructure
-
-    // BLAS builder requires raw device addresses.
-    VkDeviceAddress vertexAddress = mesh->getVertexBuffer()->getDeviceAddress();
-    VkDeviceAddress indexAddress = mesh->getIndexBuffer()->getDeviceAddress();
-
-    uint32_t maxPrimitiveCount = mesh->getPrimitiveCount();
-
-    // Describe buffer as array of VertexObj.
-    VkAccelerationStructureGeometryTrianglesDataKHR triangles{
-        VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR};
-    triangles.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT; // vec3 vertex position data.
-    triangles.vertexData.deviceAddress = vertexAddress;
-    triangles.vertexStride = sizeof(Vertex);
-    // Describe index data (16-bit unsigned int)
-    triangles.indexType = VK_INDEX_TYPE_UINT16;
-    triangles.indexData.deviceAddress = indexAddress;
-    // Indicate identity transform by setting transformData to null device pointer.
-    // triangles.transformData = {};
-    triangles.maxVertex = mesh->getVertexCount() - 1;
-
-    // Identify the above data as containing opaque triangles.
-    VkAccelerationStructureGeometryKHR asGeom{VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR};
-    asGeom.geometryType = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
-    asGeom.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
-    asGeom.geometry.triangles = triangles;
-
-    // The entire array will be used to build the BLAS.
-    VkAccelerationStructureBuildRangeInfoKHR offset;
-    offset.firstVertex = 0;
-    offset.primitiveCount = maxPrimitiveCount;
-    offset.primitiveOffset = 0;
-    offset.transformOffset = 0;
-
-    return AsGeom(asGeom, offset);
+    return AccelerationStructureCache::getMeshGeometry(*mesh);
 }
 
 #ifdef USE_NV_PRO_CORE
@@ -696,6 +967,10 @@ std::unique_ptr<RenderPhase> RenderPhaseBuilder<RenderTypeE::RAYTRACE>::build()
 
     auto product = static_cast<RayTracePhase *>(m_product.get());
 
+    // the shared cache builds the structures with the device of the application
+    if (product->m_asCache)
+        return std::move(m_product);
+
     uint32_t count = devicePtr->getContext()->getInstanceExtensionCount();
     auto reqExtensions = devicePtr->getContext()->getInstanceExtensions();
 
@@ -736,11 +1011,15 @@ std::unique_ptr<RenderPhase> RenderPhaseBuilder<RenderTypeE::RAYTRACE>::build()
 
 void RayTracePhase::updateDescriptorSets()
 {
+    invalidateRecordedCommands();
 }
 
 RayTracePhase::~RayTracePhase()
 {
 #ifdef USE_NV_PRO_CORE
+    if (m_asCache)
+        return;
+
     m_rtBuilder.destroy();
     m_alloc.deinit();
 #endif
@@ -795,6 +1074,20 @@ void RayTracePhase::generateBottomLevelAS()
     // from
     // https://nvpro-samples.github.io/vk_raytracing_tutorial_KHR/vkrt_tutorial.md.html#accelerationstructure/bottom-levelaccelerationstructure/helperdetails:raytracingbuilder::buildblas()
 
+    if (m_asCache)
+    {
+        std::vector<std::shared_ptr<Mesh>> meshes;
+        for (const std::shared_ptr<RenderStateABC> &renderState : m_pooledRenderStates[0])
+        {
+            auto state = std::dynamic_pointer_cast<ModelRenderState>(renderState);
+            assert(state);
+            const auto &stateMeshes = state->getModel()->getMeshes();
+            meshes.insert(meshes.end(), stateMeshes.begin(), stateMeshes.end());
+        }
+        m_asCache->buildBottomLevel(meshes);
+        return;
+    }
+
 #ifdef USE_NV_PRO_CORE
     // BLAS - Storing each primitive in a geometry
     std::vector<nvvk::RaytracingBuilderKHR::BlasInput> allBlas;
@@ -928,6 +1221,7 @@ void RayTracePhase::generateBottomLevelAS()
         bb.setName("blas buffer");
         bb.setProperties(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
         bb.setUsage(VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+        bb.setComputeSharingEnable(true);
         bb.setSize(alignup(sizeInfos[i].accelerationStructureSize, minAlignment));
         m_blasBuffers.push_back(bb.build());
 
@@ -975,6 +1269,26 @@ void RayTracePhase::generateBottomLevelAS()
 
 void RayTracePhase::generateTopLevelAS()
 {
+    if (m_asCache)
+    {
+        std::vector<AccelerationStructureCache::Instance> instances;
+        for (const std::shared_ptr<RenderStateABC> &renderState : m_pooledRenderStates[0])
+        {
+            auto state = std::dynamic_pointer_cast<ModelRenderState>(renderState);
+            assert(state);
+            for (const std::shared_ptr<Mesh> &mesh : state->getModel()->getMeshes())
+            {
+                instances.push_back(AccelerationStructureCache::Instance{
+                    .mesh = mesh,
+                    .model = state->getModelReference(),
+                });
+            }
+        }
+        m_sharedTlas = m_asCache->getTopLevel(instances);
+        updateDescriptorSets();
+        return;
+    }
+
 #ifdef USE_NV_PRO_CORE
     std::vector<VkAccelerationStructureInstanceKHR> tlas;
     int offset = 0;
@@ -988,7 +1302,7 @@ void RayTracePhase::generateTopLevelAS()
                 int blasIndex = j + offset;
                 VkAccelerationStructureInstanceKHR rayInst{};
                 rayInst.transform = nvvk::toTransformMatrixKHR(
-                    state->getModel()->getTransform().getTransformMatrix()); // Position of the instance
+                    state->getModel()->getWorldMatrix()); // Position of the instance
                 rayInst.instanceCustomIndex = blasIndex;                     // gl_InstanceCustomIndexEXT
                 rayInst.accelerationStructureReference = m_rtBuilder.getBlasDeviceAddress(blasIndex);
                 rayInst.flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
@@ -1004,6 +1318,7 @@ void RayTracePhase::generateTopLevelAS()
         }
     }
     m_rtBuilder.buildTlas(tlas, VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR);
+    m_tlas = m_rtBuilder.getAccelerationStructure();
 #else
     // TODO : fix the custom implementation of the top level acceleration structures
     
@@ -1048,7 +1363,7 @@ void RayTracePhase::generateTopLevelAS()
                 .accelerationStructure = m_blas[i],
             };
 
-            auto trs = state->getModel()->getTransform().getTransformMatrix();
+            auto trs = state->getModel()->getWorldMatrix();
             trs = glm::transpose(trs);
             VkTransformMatrixKHR matrix;
             memcpy(&matrix, &trs, sizeof(VkTransformMatrixKHR));
@@ -1160,6 +1475,7 @@ void RayTracePhase::generateTopLevelAS()
         bb.setName("tlas buffer");
         bb.setProperties(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
         bb.setUsage(VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+        bb.setComputeSharingEnable(true);
         bb.setSize(alignup(sizeInfos[i].accelerationStructureSize, minAlignment));
         m_tlasBuffers.push_back(bb.build());
 
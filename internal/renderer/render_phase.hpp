@@ -1,13 +1,18 @@
 #pragma once
 
 #include <cassert>
+#include <functional>
 #include <memory>
+#include <memory_resource>
+#include <optional>
+#include <span>
 #include <string>
 
 #include <vulkan/vulkan.hpp>
 
 #include "graphics/buffer.hpp"
 #include "graphics/render_pass.hpp"
+#include "graphics/timestamp_query.hpp"
 
 class Device;
 class RenderPass;
@@ -20,6 +25,10 @@ class Texture;
 class CameraABC;
 class RenderStateABC;
 class ComputeState;
+class ComputePhase;
+class RenderGraphResources;
+class AccelerationStructureCache;
+class FrameArena;
 
 enum class RenderTypeE
 {
@@ -32,11 +41,26 @@ enum class RenderTypeE
 struct BackBufferT
 {
     VkCommandBuffer commandBuffer;
+    /**
+     * @brief commands recorded again on every use, submitted before and after the command buffer : the timestamps, the
+     * barriers of the graph step and the queue ownership transfers, which must not be replayed with its commands
+     *
+     */
+    VkCommandBuffer frameBeginCommandBuffer = VK_NULL_HANDLE;
+    VkCommandBuffer frameEndCommandBuffer = VK_NULL_HANDLE;
+    bool frameBeginEnable = false;
+    bool frameEndEnable = false;
 
     // TODO : make acquire semaphore optional (first phase may not need one)
     VkSemaphore acquireSemaphore;
     VkSemaphore renderSemaphore;
     VkFence inFlightFence;
+
+    /**
+     * @brief key of the commands held by the command buffer, empty if they must be recorded again
+     *
+     */
+    std::optional<uint64_t> recordKey;
 };
 
 template <RenderTypeE TType> class RenderPhaseBuilder;
@@ -49,6 +73,25 @@ class BasePhaseABC
   protected:
     std::weak_ptr<Device> m_device;
 
+    /**
+     * @brief resources of the graph this phase belongs to, the barriers of its step are recorded before its commands
+     *
+     */
+    const RenderGraphResources *m_graphResources = nullptr;
+    uint32_t m_graphStep = 0u;
+
+    /**
+     * @brief temporary containers of the frame, owned by the graph
+     *
+     */
+    FrameArena *m_frameArena = nullptr;
+
+    /**
+     * @brief GPU duration of the commands of the phase, null if the timestamps are disabled
+     *
+     */
+    std::unique_ptr<TimestampQuery> m_timestampQuery;
+
     BasePhaseABC() = default;
 
   public:
@@ -70,10 +113,26 @@ class BasePhaseABC
 
     virtual void swapBackBuffers() = 0;
 
+    void setGraphStep(const RenderGraphResources *graphResources, uint32_t step)
+    {
+        m_graphResources = graphResources;
+        m_graphStep = step;
+    }
+
+    void setFrameArena(FrameArena *frameArena)
+    {
+        m_frameArena = frameArena;
+    }
+
   public:
     [[nodiscard]] virtual const VkSemaphore &getCurrentAcquireSemaphore(uint32_t pooledFramebufferIndex) const = 0;
     [[nodiscard]] virtual const VkSemaphore &getCurrentRenderSemaphore(uint32_t pooledFramebufferIndex) const = 0;
     [[nodiscard]] virtual const VkFence &getCurrentFence(uint32_t pooledFramebufferIndex) const = 0;
+
+    [[nodiscard]] inline const TimestampQuery *getTimestampQuery() const
+    {
+        return m_timestampQuery.get();
+    }
 };
 
 /**
@@ -111,6 +170,19 @@ class RenderPhase : public BasePhaseABC
 
     bool m_isCapturePhase = false;
 
+    /**
+     * @brief async compute phase whose results are read by this phase, its render semaphore is waited for and the
+     * buffers it shares are acquired from the compute queue before the render pass and released after it
+     *
+     */
+    const ComputePhase *m_asyncComputePhase = nullptr;
+
+    /**
+     * @brief value of the color attachments cleared when the render pass begins
+     *
+     */
+    VkClearColorValue m_clearColor = {{0.05f, 0.05f, 0.05f, 0.f}};
+
     /**
      * @brief the most recent frame buffer in which a render was made
      *
@@ -132,6 +204,30 @@ class RenderPhase : public BasePhaseABC
         return m_pooledBackBuffers[pooledFramebufferIndex][m_backBufferIndex];
     }
 
+    /**
+     * @brief gather the key of the commands recorded for a pooled framebuffer, the uniform buffers must be up to date
+     *
+     * @param pooledFramebufferIndex
+     * @param framebuffer
+     * @param renderArea
+     * @param camera
+     * @return std::optional<uint64_t> empty if one of the states cannot re-submit its commands
+     */
+    [[nodiscard]] std::optional<uint64_t> getRecordKey(uint32_t pooledFramebufferIndex, VkFramebuffer framebuffer,
+                                                       VkRect2D renderArea, const CameraABC &camera) const;
+
+    /**
+     * @brief record the commands submitted around the ones of the back buffer, they depend on the render of the frame
+     * rather than on the render states
+     *
+     * @param backBuffer
+     * @param timestampEnable
+     * @param graphBarriersEnable
+     * @param imageIndex
+     */
+    void recordFrameCommandBuffers(BackBufferT &backBuffer, bool timestampEnable, bool graphBarriersEnable,
+                                   uint32_t imageIndex);
+
     RenderPhase() = default;
 
   public:
@@ -194,12 +290,40 @@ class RenderPhase : public BasePhaseABC
                                   VkRect2D renderArea, const CameraABC &camera,
                                   const std::vector<std::shared_ptr<Light>> &lights,
                                   const std::shared_ptr<ProbeGrid> &probeGrid);
-    void submitBackBuffer(const VkSemaphore *acquireSemaphoreOverride, uint32_t pooledFramebufferIndex) const;
+    /**
+     * @brief submit the commands of a pooled framebuffer
+     *
+     * @param acquireSemaphoreOverride
+     * @param pooledFramebufferIndex
+     * @param waitSemaphoreEnable false if the phase is ordered after the previous one by barriers only
+     * @param signalSemaphoreEnable false if the next phase is ordered after this one by barriers only
+     */
+    void submitBackBuffer(const VkSemaphore *acquireSemaphoreOverride, uint32_t pooledFramebufferIndex,
+                          bool waitSemaphoreEnable = true, bool signalSemaphoreEnable = true) const;
 
     void swapBackBuffers(uint32_t pooledFramebufferIndex);
 
     void updateSwapchainOnRenderPass(const SwapChain *newSwapchain);
 
+    /**
+     * @brief a capture phase renders one pooled framebuffer per probe, the inactive probes are not captured
+     *
+     */
+    [[nodiscard]] bool isPooledFramebufferSkipped(uint32_t pooledFramebufferIndex,
+                                                  const std::shared_ptr<ProbeGrid> &probeGrid) const;
+    /**
+     * @brief first pooled framebuffer that is not skipped, its commands hold the barriers of the phase
+     *
+     */
+    [[nodiscard]] uint32_t getFirstPooledFramebufferIndex(const std::shared_ptr<ProbeGrid> &probeGrid) const;
+
+    /**
+     * @brief force every command buffer to be recorded again on its next use
+     * must be called when a descriptor set referenced by the recorded commands is written
+     *
+     */
+    void invalidateRecordedCommands();
+
   public:
     [[nodiscard]] const int getSingleFrameRenderCount() const
     {
@@ -249,6 +373,11 @@ class RayTracePhase final : public RenderPhase
 
     nvvk::ResourceAllocatorDma m_alloc;
     nvvk::RaytracingBuilderKHR m_rtBuilder;
+    /**
+     * @brief top level structure of the builder, kept so that it can be bound without a copy
+     *
+     */
+    VkAccelerationStructureKHR m_tlas = VK_NULL_HANDLE;
 #else
     std::vector<VkAccelerationStructureKHR> m_blas;
     std::vector<std::unique_ptr<Buffer>> m_blasBuffers;
@@ -257,6 +386,14 @@ class RayTracePhase final : public RenderPhase
     std::vector<std::unique_ptr<Buffer>> m_tlasBuffers;
 #endif
 
+    /**
+     * @brief acceleration structures shared with the other phases of the graph
+     * if set, the phase does not build structures of its own
+     *
+     */
+    AccelerationStructureCache *m_asCache = nullptr;
+    VkAccelerationStructureKHR m_sharedTlas = VK_NULL_HANDLE;
+
     /**
      * @brief combination of Vulkan structures representing a mesh as a ray traceable geometry
      *
@@ -297,10 +434,16 @@ class RayTracePhase final : public RenderPhase
                           const std::shared_ptr<ProbeGrid> &probeGrid) override;
 
   public:
-    [[nodiscard]] inline const std::vector<VkAccelerationStructureKHR> getTLAS() const
+    /**
+     * @brief bound by the descriptor updates of every frame, does not allocate
+     *
+     */
+    [[nodiscard]] inline std::span<const VkAccelerationStructureKHR> getTLAS() const
     {
+        if (m_asCache)
+            return std::span<const VkAccelerationStructureKHR>(&m_sharedTlas, 1u);
 #ifdef USE_NV_PRO_CORE
-        return std::vector<VkAccelerationStructureKHR>{m_rtBuilder.getAccelerationStructure()};
+        return std::span<const VkAccelerationStructureKHR>(&m_tlas, 1u);
 #else
         return m_tlas;
 #endif
@@ -312,6 +455,28 @@ class PhaseBuilderABC
   protected:
     std::string m_phaseName = "Unnamed";
 
+    bool m_timestampEnable = false;
+
+    /**
+     * @brief one pair of queries per back buffer
+     *
+     * @param queueFamilyIndex family of the queue the phase is submitted to, the graphics family if not set
+     * @return std::unique_ptr<TimestampQuery> null if the timestamps are disabled or not supported
+     */
+    std::unique_ptr<TimestampQuery> buildTimestampQuery(std::weak_ptr<Device> device, uint32_t bufferingType,
+                                                        std::optional<uint32_t> queueFamilyIndex = std::nullopt) const
+    {
+        if (!m_timestampEnable)
+            return nullptr;
+
+        TimestampQueryBuilder tqb;
+        tqb.setDevice(device);
+        tqb.setFrameInFlightCount(bufferingType);
+        tqb.setQueueFamilyIndex(queueFamilyIndex);
+        tqb.setName(m_phaseName);
+        return tqb.build();
+    }
+
   public:
     virtual ~PhaseBuilderABC() = default;
 
@@ -325,6 +490,14 @@ class PhaseBuilderABC
     {
         m_phaseName = name;
     }
+    /**
+     * @brief measure the GPU duration of the phase with timestamp queries
+     *
+     */
+    inline void setTimestampEnable(bool enable)
+    {
+        m_timestampEnable = enable;
+    }
 };
 
 template <RenderTypeE TType> class RenderPhaseBuilder final : public PhaseBuilderABC
@@ -385,6 +558,19 @@ template <> class RenderPhaseBuilder<RenderTypeE::RASTER> : public PhaseBuilderA
     {
         m_product->m_isCapturePhase = enable;
     }
+    void setClearColor(VkClearColorValue color)
+    {
+        m_product->m_clearColor = color;
+    }
+    /**
+     * @brief the phase reads the results of an async compute phase of the same frame
+     * the phase must be submitted once per frame
+     *
+     */
+    void setAsyncComputeWait(const ComputePhase *phase)
+    {
+        m_product->m_asyncComputePhase = phase;
+    }
 
     /**
      * @brief this build function is used for the rasterizer phase but used for the raytracing phase as well
@@ -410,6 +596,15 @@ template <> class RenderPhaseBuilder<RenderTypeE::RAYTRACE> final : public Rende
         restart();
     }
 
+    /**
+     * @brief build the acceleration structures through a cache shared with the other phases of the graph
+     *
+     */
+    void setAccelerationStructureCache(AccelerationStructureCache *cache)
+    {
+        static_cast<RayTracePhase *>(m_product.get())->m_asCache = cache;
+    }
+
 #ifdef USE_NV_PRO_CORE
     std::unique_ptr<RenderPhase> build() override;
 #endif
@@ -417,6 +612,21 @@ template <> class RenderPhaseBuilder<RenderTypeE::RAYTRACE> final : public Rende
 
 class ComputePhaseBuilder;
 
+/**
+ * @brief buffer written by an async compute phase and read by the graphics queue
+ *
+ */
+struct QueueTransferBufferT
+{
+    VkBuffer handle;
+    /**
+     * @brief the dispatches of the next frame read the buffer again, the graphics queue gives it back after reading it
+     * the other buffers are entirely written every frame, their previous content is discarded
+     *
+     */
+    bool readBack;
+};
+
 /**
  * @brief manages the command buffers for the compute shader
  *
@@ -425,12 +635,34 @@ class ComputePhase final : public BasePhaseABC
 {
     friend ComputePhaseBuilder;
 
+  public:
+    /**
+     * @brief stages of the graphics queue that wait for the async compute phase
+     *
+     */
+    static constexpr VkPipelineStageFlags s_graphicsWaitStages =
+        VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
   private:
     int m_backBufferIndex = 0;
     std::vector<BackBufferT> m_backBuffers;
 
     std::vector<std::shared_ptr<ComputeState>> m_computeStates;
 
+    /**
+     * @brief submitted to the compute queue, see ComputePhaseBuilder::setAsyncEnable
+     *
+     */
+    bool m_isAsync = false;
+    std::function<void(uint32_t backBufferIndex, std::pmr::vector<QueueTransferBufferT> &buffers)>
+        m_queueTransferBuffersPred;
+    /**
+     * @brief frames submitted since the phase has been built, the first one has nothing to acquire from the graphics
+     * queue
+     *
+     */
+    uint32_t m_frameCount = 0u;
+
     ComputePhase() = default;
 
     [[nodiscard]] const BackBufferT &getCurrentBackBuffer(uint32_t pooledFramebufferIndex = -1) const override
@@ -438,6 +670,18 @@ class ComputePhase final : public BasePhaseABC
         return m_backBuffers[m_backBufferIndex];
     }
 
+    [[nodiscard]] const VkQueue &getQueue() const;
+
+    /**
+     * @brief ownership transfer of the shared buffers of a back buffer, nothing is recorded if the phase is not async
+     * or if the compute and graphics queues belong to the same family
+     *
+     * @param readBackOnly only the buffers that the dispatches read again
+     */
+    void recordQueueTransfer(VkCommandBuffer commandBuffer, uint32_t backBufferIndex, bool toGraphicsQueue,
+                             VkPipelineStageFlags srcStageMask, VkAccessFlags srcAccessMask,
+                             VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask, bool readBackOnly) const;
+
   public:
     ~ComputePhase();
 
@@ -447,6 +691,16 @@ class ComputePhase final : public BasePhaseABC
     ComputePhase &operator=(ComputePhase &&) = delete;
 
     void registerComputeState(std::shared_ptr<ComputeState> state);
+    /**
+     * @brief buffers transferred between the compute and graphics queue families every frame if the phase is async
+     * the predicate appends them to a vector of the frame arena
+     *
+     */
+    void setQueueTransferBuffersPred(
+        std::function<void(uint32_t backBufferIndex, std::pmr::vector<QueueTransferBufferT> &buffers)> pred)
+    {
+        m_queueTransferBuffersPred = pred;
+    }
 
     void recordBackBuffer() const override;
     void submitBackBuffer(const VkSemaphore *acquireSemaphoreOverride) const override;
@@ -459,7 +713,19 @@ class ComputePhase final : public BasePhaseABC
 
     void swapBackBuffers() override;
 
+    /**
+     * @brief recorded by the graphics phase that reads the results of the async phase, before and after reading them
+     *
+     */
+    void recordGraphicsQueueAcquire(VkCommandBuffer commandBuffer, uint32_t backBufferIndex) const;
+    void recordGraphicsQueueRelease(VkCommandBuffer commandBuffer, uint32_t backBufferIndex) const;
+
   public:
+    [[nodiscard]] inline bool isAsync() const
+    {
+        return m_isAsync;
+    }
+
     [[nodiscard]] const VkSemaphore &getCurrentAcquireSemaphore(uint32_t pooledFramebufferIndex = -1) const override
     {
         return getCurrentBackBuffer().acquireSemaphore;
@@ -503,6 +769,17 @@ class ComputePhaseBuilder final : public PhaseBuilderABC
     {
         m_bufferingType = type;
     }
+    /**
+     * @brief submit the dispatches to the compute queue so that they overlap the rendering of the frame
+     * the dispatches start once the graphics work submitted before them has completed, the render graph does not
+     * chain the phase with the others and the phase reading its results waits for it with
+     * RenderPhaseBuilder::setAsyncComputeWait
+     *
+     */
+    void setAsyncEnable(bool enable)
+    {
+        m_product->m_isAsync = enable;
+    }
 
     std::unique_ptr<ComputePhase> build();
 };
@@ -13,6 +13,7 @@
 
 #include "graphics/buffer.hpp"
 #include "graphics/device.hpp"
+#include "graphics/frame_allocator.hpp"
 #include "graphics/pipeline.hpp"
 #include "graphics/render_pass.hpp"
 
@@ -20,6 +21,7 @@
 #include "mesh.hpp"
 #include "model.hpp"
 #include "render_phase.hpp"
+#include "scene_constants.hpp"
 #include "skybox.hpp"
 #include "texture.hpp"
 
@@ -61,110 +63,66 @@ void RenderStateABC::updateUniformBuffers(uint32_t backBufferIndex, uint32_t sin
                                           const std::vector<std::shared_ptr<Light>> &lights,
                                           const std::shared_ptr<ProbeGrid> &probeGrid, bool captureModeEnabled)
 {
-    if (m_poolMVPUniformBuffersMapped.size() > 0)
-    {
-        if (m_poolMVPUniformBuffersMapped[pooledFramebufferIndex].size() > 0)
-        {
-            MVP *mvpData = static_cast<MVP *>(m_poolMVPUniformBuffersMapped[pooledFramebufferIndex][backBufferIndex]);
-            mvpData->model = glm::identity<glm::mat4>();
+    writeMVP(pooledFramebufferIndex, camera, probeGrid, captureModeEnabled);
+}
 
-            if (!captureModeEnabled)
-            {
-                mvpData->proj = camera.getProjectionMatrix();
-                mvpData->views[0] = camera.getViewMatrix();
-            }
-            else
-            {
-                const glm::vec3 &probePosition = probeGrid->getProbeAtIndex(pooledFramebufferIndex)->position;
+RenderStateABC::MVP *RenderStateABC::writeMVP(uint32_t pooledFramebufferIndex, const CameraABC &camera,
+                                              const std::shared_ptr<ProbeGrid> &probeGrid, bool captureModeEnabled)
+{
+    if (!m_mvpDynamicEnable)
+        return nullptr;
 
-                mvpData->proj = capturePartialProj;
-                mvpData->proj[1][1] *= -1;
+    MVP *mvpData = m_frameAllocator->allocate<MVP>(m_mvpDynamicOffset);
+    if (!mvpData)
+        return nullptr;
 
-                for (int i = 0; i < 6; i++)
-                    mvpData->views[i] =
-                        glm::lookAt(probePosition, probePosition + captureViewCenter[i], captureViewUp[i]);
-            }
-        }
-    }
+    mvpData->model = glm::identity<glm::mat4>();
 
-    if (m_probeStorageBuffersMapped.size() > 0)
+    if (!captureModeEnabled)
+    {
+        mvpData->proj = camera.getProjectionMatrix();
+        mvpData->views[0] = camera.getViewMatrix();
+    }
+    else
     {
-        const std::vector<std::unique_ptr<Probe>> &probes = probeGrid->getProbes();
-        ProbeContainer *probeContainer = static_cast<ProbeContainer *>(m_probeStorageBuffersMapped[backBufferIndex]);
+        const glm::vec3 &probePosition = probeGrid->getProbeAtIndex(pooledFramebufferIndex)->position;
 
-        for (int i = 0; i < probes.size(); i++)
-        {
-            const Probe *probe = probes[i].get();
+        mvpData->proj = capturePartialProj;
+        mvpData->proj[1][1] *= -1;
 
-            ProbeContainer::Probe probeData{
-                .position = probe->position,
-            };
+        for (int i = 0; i < 6; i++)
+            mvpData->views[i] = glm::lookAt(probePosition, probePosition + captureViewCenter[i], captureViewUp[i]);
+    }
 
-            probeContainer->probes[i] = probeData;
-        }
+    return mvpData;
+}
 
-        probeContainer->dimensions = probeGrid->getDimensions();
-        probeContainer->extent = probeGrid->getExtent();
-        probeContainer->cornerPosition = probeGrid->getCornerPosition();
-    }
+void RenderStateABC::writeProbes(const ProbeGrid &probeGrid)
+{
+    FrameAllocator::Allocation allocation =
+        m_frameAllocator->allocate(ProbeContainer::getSize(probeGrid.getProbes().size()));
+    m_probeDynamicOffset = allocation.dynamicOffset;
+    if (allocation.data)
+        SceneConstants::packProbes(probeGrid, *static_cast<ProbeContainer *>(allocation.data));
+}
 
-    PointLightContainer *pointLightContainer = nullptr;
-    if (m_pointLightStorageBuffersMapped.size() > 0)
-        pointLightContainer = static_cast<PointLightContainer *>(m_pointLightStorageBuffersMapped[backBufferIndex]);
+uint32_t RenderStateABC::getDynamicOffsets(uint32_t *dynamicOffsets) const
+{
+    uint32_t dynamicOffsetCount = 0u;
 
-    DirectionalLightContainer *directionalLightContainer = nullptr;
-    if (m_directionalLightStorageBuffersMapped.size() > 0)
-        directionalLightContainer =
-            static_cast<DirectionalLightContainer *>(m_directionalLightStorageBuffersMapped[backBufferIndex]);
+    if (m_mvpDynamicEnable)
+        dynamicOffsets[dynamicOffsetCount++] = m_mvpDynamicOffset;
 
-    int pointLightCount = 0;
-    int directionalLightCount = 0;
-    for (int i = 0; i < lights.size(); i++)
+    if (m_lightDynamicEnable)
     {
-        const Light *light = lights[i].get();
-        if (pointLightContainer)
-        {
-            if (const PointLight *pointLight = dynamic_cast<const PointLight *>(light))
-            {
-                PointLightContainer::PointLight pointLightData{
-                    .diffuseColor = pointLight->diffuseColor,
-                    .diffusePower = pointLight->diffusePower,
-                    .specularColor = pointLight->specularColor,
-                    .specularPower = pointLight->specularPower,
-                    .position = pointLight->position,
-                    .attenuation = pointLight->attenuation,
-                };
-
-                pointLightContainer->pointLights[pointLightCount] = pointLightData;
-                pointLightCount++;
-                continue;
-            }
-        }
-
-        if (pointLightContainer)
-        {
-            if (const DirectionalLight *directionalLight = dynamic_cast<const DirectionalLight *>(light))
-            {
-                DirectionalLightContainer::DirectionalLight directionalLightData{
-                    .diffuseColor = directionalLight->diffuseColor,
-                    .diffusePower = directionalLight->diffusePower,
-                    .specularColor = directionalLight->specularColor,
-                    .specularPower = directionalLight->specularPower,
-                    .direction = directionalLight->direction,
-                };
-
-                directionalLightContainer->directionalLights[directionalLightCount] = directionalLightData;
-                directionalLightCount++;
-                continue;
-            }
-        }
+        dynamicOffsets[dynamicOffsetCount++] = m_sceneConstants->getPointLightDynamicOffset();
+        dynamicOffsets[dynamicOffsetCount++] = m_sceneConstants->getDirectionalLightDynamicOffset();
     }
 
-    if (pointLightContainer)
-        pointLightContainer->pointLightCount = pointLightCount;
+    if (m_probeDynamicEnable)
+        dynamicOffsets[dynamicOffsetCount++] = m_probeDynamicOffset;
 
-    if (directionalLightCount)
-        directionalLightContainer->directionalLightCount = directionalLightCount;
+    return dynamicOffsetCount;
 }
 
 void RenderStateABC::updateDescriptorSetsPerFrame(const RenderPhase *parentPhase, VkCommandBuffer cmd,
@@ -172,8 +130,7 @@ void RenderStateABC::updateDescriptorSetsPerFrame(const RenderPhase *parentPhase
 {
     if (m_instanceDescriptorSetUpdatePredPerFrame)
     {
-        m_instanceDescriptorSetUpdatePredPerFrame(parentPhase, cmd, this,
-                                                  m_poolInstanceDescriptorSets[pooledFramebufferIndex][backBufferIndex],
+        m_instanceDescriptorSetUpdatePredPerFrame(parentPhase, cmd, this, m_instanceDescriptorSets[backBufferIndex],
                                                   backBufferIndex);
     }
 
@@ -220,7 +177,7 @@ void RenderStateABC::updateDescriptorSets(const RenderPhase *parentPhase, uint32
 {
     if (m_instanceDescriptorSetUpdatePred)
     {
-        for (const auto &set : m_poolInstanceDescriptorSets[pooledFramebufferIndex])
+        for (const auto &set : m_instanceDescriptorSets)
         {
             m_instanceDescriptorSetUpdatePred(parentPhase, set, backBufferIndex);
         }
@@ -228,7 +185,7 @@ void RenderStateABC::updateDescriptorSets(const RenderPhase *parentPhase, uint32
 
     if (m_materialDescriptorSetUpdatePred)
     {
-        for (const auto &set : m_poolInstanceDescriptorSets[pooledFramebufferIndex])
+        for (const auto &set : m_instanceDescriptorSets)
         {
             m_materialDescriptorSetUpdatePred(parentPhase, set, backBufferIndex);
         }
@@ -239,16 +196,18 @@ void RenderStateABC::recordBackBufferDescriptorSetsCommands(const VkCommandBuffe
                                                             uint32_t subObjectIndex, uint32_t backBufferIndex,
                                                             uint32_t pooledFramebufferIndex)
 {
-    std::vector<VkDescriptorSet> descriptorSets;
+    VkDescriptorSet descriptorSets[2];
+    uint32_t descriptorSetCount = 0u;
+
+    uint32_t dynamicOffsets[4];
+    uint32_t dynamicOffsetCount = 0u;
 
     if (m_instanceDescriptorSetEnable)
     {
-        if (pooledFramebufferIndex < m_poolInstanceDescriptorSets.size())
+        if (backBufferIndex < m_instanceDescriptorSets.size())
         {
-            if (backBufferIndex < m_poolInstanceDescriptorSets[pooledFramebufferIndex].size())
-            {
-                descriptorSets.push_back(m_poolInstanceDescriptorSets[pooledFramebufferIndex][backBufferIndex]);
-            }
+            descriptorSets[descriptorSetCount++] = m_instanceDescriptorSets[backBufferIndex];
+            dynamicOffsetCount = getDynamicOffsets(dynamicOffsets);
         }
     }
 
@@ -257,15 +216,45 @@ void RenderStateABC::recordBackBufferDescriptorSetsCommands(const VkCommandBuffe
         if (m_materialDescriptorSetEnable &&
             backBufferIndex < m_materialDescriptorSetsPerSubObject[subObjectIndex].size())
         {
-            descriptorSets.push_back(m_materialDescriptorSetsPerSubObject[subObjectIndex][backBufferIndex]);
+            descriptorSets[descriptorSetCount++] = m_materialDescriptorSetsPerSubObject[subObjectIndex][backBufferIndex];
         }
     }
 
-    if (descriptorSets.size() == 0u)
+    if (descriptorSetCount == 0u)
         return;
 
     vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline->getPipelineLayout(), 0,
-                            descriptorSets.size(), descriptorSets.data(), 0, nullptr);
+                            descriptorSetCount, descriptorSets, dynamicOffsetCount, dynamicOffsets);
+}
+
+bool RenderStateABC::addToRecordKey(RecordKey &key, uint32_t backBufferIndex, const CameraABC &camera) const
+{
+    // the predicates may write the descriptor sets or record commands, which invalidates the previous recording
+    if (m_instanceDescriptorSetUpdatePredPerFrame || m_materialDescriptorSetUpdatePredPerFrame)
+        return false;
+
+    key.add(m_pipeline.get());
+    key.add(getSubObjectCount());
+
+    if (m_instanceDescriptorSetEnable && backBufferIndex < m_instanceDescriptorSets.size())
+    {
+        key.add(m_instanceDescriptorSets[backBufferIndex]);
+
+        uint32_t dynamicOffsets[4];
+        const uint32_t dynamicOffsetCount = getDynamicOffsets(dynamicOffsets);
+        key.add(dynamicOffsets, dynamicOffsetCount * sizeof(uint32_t));
+    }
+
+    if (m_materialDescriptorSetEnable)
+    {
+        for (const std::vector<VkDescriptorSet> &materialSets : m_materialDescriptorSetsPerSubObject)
+        {
+            if (backBufferIndex < materialSets.size())
+                key.add(materialSets[backBufferIndex]);
+        }
+    }
+
+    return true;
 }
 
 void ModelRenderStateBuilder::setPipeline(std::shared_ptr<Pipeline> pipeline)
@@ -284,6 +273,8 @@ void ModelRenderStateBuilder::setModel(std::shared_ptr<Model> model)
 {
     m_modelName = model->getName();
     m_product->m_model = model;
+    m_product->m_transforms = model->getTransformStore();
+    m_product->m_transformIndex = model->getTransformIndex();
 }
 
 std::unique_ptr<GPUStateI> ModelRenderStateBuilder::build()
@@ -295,8 +286,8 @@ std::unique_ptr<GPUStateI> ModelRenderStateBuilder::build()
     // descriptor pool
     VkDescriptorPoolCreateInfo createInfo = {
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-        // FrameInFlight * (instanceDescriptor * captureCount +  materialDescriptor * submeshCount)
-        .maxSets = m_frameInFlightCount * (1u * m_captureCount + 1u * m_product->getSubObjectCount()),
+        // FrameInFlight * (instanceDescriptor +  materialDescriptor * submeshCount)
+        .maxSets = m_frameInFlightCount * (1u + 1u * m_product->getSubObjectCount()),
         .poolSizeCount = static_cast<uint32_t>(m_poolSizes.size()),
         .pPoolSizes = m_poolSizes.data(),
     };
@@ -308,31 +299,26 @@ std::unique_ptr<GPUStateI> ModelRenderStateBuilder::build()
     }
 
     // descriptor set
-    m_product->m_poolInstanceDescriptorSets.resize(m_captureCount);
-    for (int captureIdx = 0; captureIdx < m_captureCount; captureIdx++)
-    {
-        auto &instanceDescriptorSets = m_product->m_poolInstanceDescriptorSets[captureIdx];
-        std::optional<VkDescriptorSetLayout> instanceDescriptorSetLayout =
-            m_product->m_pipeline->getDescriptorSetLayoutAtIndex(0u);
+    std::optional<VkDescriptorSetLayout> instanceDescriptorSetLayout =
+        m_product->m_pipeline->getDescriptorSetLayoutAtIndex(0u);
 
-        if (instanceDescriptorSetLayout.has_value())
+    if (instanceDescriptorSetLayout.has_value())
+    {
+        std::vector<VkDescriptorSetLayout> instanceSetLayouts(m_frameInFlightCount,
+                                                              instanceDescriptorSetLayout.value());
+        VkDescriptorSetAllocateInfo instanceDescriptorSetAllocInfo = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .descriptorPool = m_product->m_descriptorPool,
+            .descriptorSetCount = m_frameInFlightCount,
+            .pSetLayouts = instanceSetLayouts.data(),
+        };
+        m_product->m_instanceDescriptorSets.resize(m_frameInFlightCount);
+        res = vkAllocateDescriptorSets(deviceHandle, &instanceDescriptorSetAllocInfo,
+                                       m_product->m_instanceDescriptorSets.data());
+        if (res != VK_SUCCESS)
         {
-            std::vector<VkDescriptorSetLayout> instanceSetLayouts(m_frameInFlightCount,
-                                                                  instanceDescriptorSetLayout.value());
-            VkDescriptorSetAllocateInfo instanceDescriptorSetAllocInfo = {
-                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-                .descriptorPool = m_product->m_descriptorPool,
-                .descriptorSetCount = m_frameInFlightCount,
-                .pSetLayouts = instanceSetLayouts.data(),
-            };
-            instanceDescriptorSets.resize(m_frameInFlightCount);
-            res =
-                vkAllocateDescriptorSets(deviceHandle, &instanceDescriptorSetAllocInfo, instanceDescriptorSets.data());
-            if (res != VK_SUCCESS)
-            {
-                std::cerr << "Failed to allocate instance descriptor sets : " << res << std::endl;
-                return nullptr;
-            }
+            std::cerr << "Failed to allocate instance descriptor sets : " << res << std::endl;
+            return nullptr;
         }
     }
 
@@ -371,200 +357,160 @@ std::unique_ptr<GPUStateI> ModelRenderStateBuilder::build()
 
     if (m_mvpDescriptorEnable)
     {
-        m_product->m_poolMVPUniformBuffers.resize(m_captureCount);
-        m_product->m_poolMVPUniformBuffersMapped.resize(m_captureCount);
-        for (int captureIdx = 0; captureIdx < m_captureCount; captureIdx++)
-        {
-            auto &mvpUniformBuffers = m_product->m_poolMVPUniformBuffers[captureIdx];
-            auto &mvpUniformBuffersMapped = m_product->m_poolMVPUniformBuffersMapped[captureIdx];
-            mvpUniformBuffers.resize(m_frameInFlightCount);
-            mvpUniformBuffersMapped.resize(m_frameInFlightCount);
-            for (int backBufferIdx = 0; backBufferIdx < mvpUniformBuffers.size(); ++backBufferIdx)
-            {
-                BufferBuilder bb;
-                BufferDirector bd;
-                bd.configureUniformBufferBuilder(bb);
-                bb.setSize(sizeof(RenderStateABC::MVP));
-                bb.setDevice(m_device);
-                bb.setName(std::to_string((uintptr_t)this) + " " + m_modelName + " Model MVP Uniform Buffer");
-                mvpUniformBuffers[backBufferIdx] = bb.build();
-
-                mvpUniformBuffers[backBufferIdx]->mapMemory(&mvpUniformBuffersMapped[backBufferIdx]);
-            }
-        }
-
-        if (m_probeDescriptorEnable)
-        {
-            m_product->m_probeStorageBuffers.resize(m_frameInFlightCount);
-            m_product->m_probeStorageBuffersMapped.resize(m_frameInFlightCount);
-
-            for (int i = 0; i < m_product->m_probeStorageBuffers.size(); ++i)
-            {
-                BufferBuilder bb;
-                BufferDirector bd;
-                bd.configureStorageBufferBuilder(bb);
-                bb.setSize(sizeof(RenderStateABC::ProbeContainer));
-                bb.setDevice(m_device);
-                bb.setName(std::to_string((uintptr_t)this) + " " + m_modelName +
-                           " Model Probe Container Uniform Buffer");
-                m_product->m_probeStorageBuffers[i] = bb.build();
-
-                m_product->m_probeStorageBuffers[i]->mapMemory(&m_product->m_probeStorageBuffersMapped[i]);
-            }
-        }
-
-        if (m_lightDescriptorEnable)
-        {
-            m_product->m_pointLightStorageBuffers.resize(m_frameInFlightCount);
-            m_product->m_pointLightStorageBuffersMapped.resize(m_frameInFlightCount);
-            for (int i = 0; i < m_product->m_pointLightStorageBuffers.size(); ++i)
-            {
-                BufferBuilder bb;
-                BufferDirector bd;
-                bd.configureStorageBufferBuilder(bb);
-                bb.setSize(sizeof(RenderStateABC::PointLightContainer));
-                bb.setDevice(m_device);
-                bb.setName(std::to_string((uintptr_t)this) + " " + m_modelName +
-                           " Model Point Light Container Uniform Buffer");
-                m_product->m_pointLightStorageBuffers[i] = bb.build();
-
-                m_product->m_pointLightStorageBuffers[i]->mapMemory(&m_product->m_pointLightStorageBuffersMapped[i]);
-            }
-
-            m_product->m_directionalLightStorageBuffers.resize(m_frameInFlightCount);
-            m_product->m_directionalLightStorageBuffersMapped.resize(m_frameInFlightCount);
-            for (int i = 0; i < m_product->m_directionalLightStorageBuffers.size(); ++i)
-            {
-                BufferBuilder bb;
-                BufferDirector bd;
-                bd.configureStorageBufferBuilder(bb);
-                bb.setSize(sizeof(RenderStateABC::DirectionalLightContainer));
-                bb.setDevice(m_device);
-                bb.setName(std::to_string((uintptr_t)this) + " " + m_modelName +
-                           " Model Directional Light Container Uniform Buffer");
-                m_product->m_directionalLightStorageBuffers[i] = bb.build();
-
-                m_product->m_directionalLightStorageBuffers[i]->mapMemory(
-                    &m_product->m_directionalLightStorageBuffersMapped[i]);
-            }
-        }
+        assert(m_product->m_frameAllocator);
+        assert(m_product->m_sceneConstants || (!m_probeDescriptorEnable && !m_lightDescriptorEnable));
 
-        std::vector<VkDescriptorBufferInfo> mvpBufferInfos;
-        mvpBufferInfos.reserve(m_frameInFlightCount * m_captureCount);
+        m_product->m_mvpDynamicEnable = true;
+        m_product->m_lightDynamicEnable = m_lightDescriptorEnable;
 
-        std::vector<VkDescriptorBufferInfo> probeBufferInfos;
-        probeBufferInfos.reserve(m_frameInFlightCount * m_captureCount);
-
-        std::vector<VkDescriptorBufferInfo> pointLightBufferInfos;
-        std::vector<VkDescriptorBufferInfo> directionalLightBufferInfos;
-        pointLightBufferInfos.reserve(m_frameInFlightCount * m_captureCount);
-        directionalLightBufferInfos.reserve(m_frameInFlightCount * m_captureCount);
+        const VkDescriptorBufferInfo mvpBufferInfo = {
+            .buffer = m_product->m_frameAllocator->getHandle(),
+            .offset = 0,
+            .range = sizeof(RenderStateABC::MVP),
+        };
+        const VkBuffer sceneBuffer =
+            m_product->m_sceneConstants ? m_product->m_sceneConstants->getHandle() : VK_NULL_HANDLE;
+        const VkBuffer probeTableBuffer =
+            m_product->m_sceneConstants ? m_product->m_sceneConstants->getProbeTableHandle() : VK_NULL_HANDLE;
+        const VkDescriptorBufferInfo probeBufferInfo = {
+            .buffer = probeTableBuffer,
+            .offset = 0,
+            .range = m_product->m_sceneConstants ? m_product->m_sceneConstants->getProbeRange() : 0u,
+        };
+        const VkDescriptorBufferInfo probeBrickBufferInfo = {
+            .buffer = probeTableBuffer,
+            .offset = m_product->m_sceneConstants ? m_product->m_sceneConstants->getProbeBrickOffset() : 0u,
+            .range = m_product->m_sceneConstants ? m_product->m_sceneConstants->getProbeBrickRange() : 0u,
+        };
+        const VkDescriptorBufferInfo pointLightBufferInfo = {
+            .buffer = sceneBuffer,
+            .offset = 0,
+            .range = sizeof(RenderStateABC::PointLightContainer),
+        };
+        const VkDescriptorBufferInfo directionalLightBufferInfo = {
+            .buffer = sceneBuffer,
+            .offset = 0,
+            .range = sizeof(RenderStateABC::DirectionalLightContainer),
+        };
 
         std::vector<std::vector<VkDescriptorImageInfo>> envMapImageInfos;
-        envMapImageInfos.reserve(m_frameInFlightCount * m_captureCount);
+        envMapImageInfos.reserve(m_frameInFlightCount);
+        std::vector<VkDescriptorImageInfo> visibilityAtlasImageInfos;
+        visibilityAtlasImageInfos.reserve(m_frameInFlightCount);
 
         std::vector<VkDescriptorImageInfo> diffuseImageInfos;
         diffuseImageInfos.reserve(m_product->getSubObjectCount() * m_frameInFlightCount);
 
         UniformDescriptorBuilder udb;
-        for (int captureIdx = 0; captureIdx < m_captureCount; captureIdx++)
+        for (const VkDescriptorSet &instanceDescriptorSet : m_product->m_instanceDescriptorSets)
         {
-            const auto &instanceDescriptorSets = m_product->m_poolInstanceDescriptorSets[captureIdx];
-            for (uint32_t i = 0u; i < instanceDescriptorSets.size(); ++i)
+            udb.addSetWrites(VkWriteDescriptorSet{
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = instanceDescriptorSet,
+                .dstBinding = 0,
+                .dstArrayElement = 0,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+                .pBufferInfo = &mvpBufferInfo,
+            });
+
+            if (m_probeDescriptorEnable)
             {
-                if (m_mvpDescriptorEnable)
-                {
-                    VkDescriptorBufferInfo &mvpBufferInfo = mvpBufferInfos.emplace_back();
-                    mvpBufferInfo.buffer = m_product->m_poolMVPUniformBuffers[captureIdx][i]->getHandle();
-                    mvpBufferInfo.offset = 0;
-                    mvpBufferInfo.range = sizeof(RenderStateABC::MVP);
-                    udb.addSetWrites(VkWriteDescriptorSet{
-                        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-                        .dstSet = instanceDescriptorSets[i],
-                        .dstBinding = 0,
-                        .dstArrayElement = 0,
-                        .descriptorCount = 1,
-                        .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-                        .pBufferInfo = &mvpBufferInfo,
-                    });
-                }
+                udb.addSetWrites(VkWriteDescriptorSet{
+                    .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                    .dstSet = instanceDescriptorSet,
+                    .dstBinding = 5,
+                    .dstArrayElement = 0,
+                    .descriptorCount = 1,
+                    .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                    .pBufferInfo = &probeBufferInfo,
+                });
 
-                if (m_probeDescriptorEnable)
-                {
-                    VkDescriptorBufferInfo &probeBufferInfo = probeBufferInfos.emplace_back();
-                    probeBufferInfo.buffer = m_product->m_probeStorageBuffers[i]->getHandle();
-                    probeBufferInfo.offset = 0;
-                    probeBufferInfo.range = sizeof(RenderStateABC::ProbeContainer);
-                    udb.addSetWrites(VkWriteDescriptorSet{
-                        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-                        .dstSet = instanceDescriptorSets[i],
-                        .dstBinding = 5,
-                        .dstArrayElement = 0,
-                        .descriptorCount = 1,
-                        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-                        .pBufferInfo = &probeBufferInfo,
-                    });
-                }
+                udb.addSetWrites(VkWriteDescriptorSet{
+                    .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                    .dstSet = instanceDescriptorSet,
+                    .dstBinding = 7,
+                    .dstArrayElement = 0,
+                    .descriptorCount = 1,
+                    .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                    .pBufferInfo = &probeBrickBufferInfo,
+                });
+            }
 
-                if (m_lightDescriptorEnable)
+            if (m_lightDescriptorEnable)
+            {
+                udb.addSetWrites(VkWriteDescriptorSet{
+                    .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                    .dstSet = instanceDescriptorSet,
+                    .dstBinding = 2,
+                    .dstArrayElement = 0,
+                    .descriptorCount = 1,
+                    .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+                    .pBufferInfo = &pointLightBufferInfo,
+                });
+
+                udb.addSetWrites(VkWriteDescriptorSet{
+                    .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                    .dstSet = instanceDescriptorSet,
+                    .dstBinding = 3,
+                    .dstArrayElement = 0,
+                    .descriptorCount = 1,
+                    .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+                    .pBufferInfo = &directionalLightBufferInfo,
+                });
+            }
+
+            if (m_environmentMaps.size() > 0)
+            {
+                auto &envMapImageArrayInfos = envMapImageInfos.emplace_back();
+                envMapImageArrayInfos.reserve(m_environmentMaps.size());
+                // Max probe count per draw (may be higher)
+                for (uint32_t i = 0u; i < m_environmentMaps.size(); i++)
                 {
-                    VkDescriptorBufferInfo &pointLightBufferInfo = pointLightBufferInfos.emplace_back();
-                    pointLightBufferInfo.buffer = m_product->m_pointLightStorageBuffers[i]->getHandle();
-                    pointLightBufferInfo.offset = 0;
-                    pointLightBufferInfo.range = sizeof(RenderStateABC::PointLightContainer);
-                    udb.addSetWrites(VkWriteDescriptorSet{
-                        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-                        .dstSet = instanceDescriptorSets[i],
-                        .dstBinding = 2,
-                        .dstArrayElement = 0,
-                        .descriptorCount = 1,
-                        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-                        .pBufferInfo = &pointLightBufferInfo,
-                    });
-
-                    VkDescriptorBufferInfo &directionalLightBufferInfo = directionalLightBufferInfos.emplace_back();
-                    directionalLightBufferInfo.buffer = m_product->m_directionalLightStorageBuffers[i]->getHandle();
-                    directionalLightBufferInfo.offset = 0;
-                    directionalLightBufferInfo.range = sizeof(RenderStateABC::DirectionalLightContainer);
-                    udb.addSetWrites(VkWriteDescriptorSet{
-                        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-                        .dstSet = instanceDescriptorSets[i],
-                        .dstBinding = 3,
-                        .dstArrayElement = 0,
-                        .descriptorCount = 1,
-                        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-                        .pBufferInfo = &directionalLightBufferInfo,
-                    });
+                    std::shared_ptr<Texture> texPtr = m_environmentMaps[i].lock();
+
+                    VkDescriptorImageInfo &envMapImageInfo = envMapImageArrayInfos.emplace_back();
+                    envMapImageInfo.sampler = *texPtr->getSampler();
+                    envMapImageInfo.imageView = texPtr->getImageView();
+                    envMapImageInfo.imageLayout = texPtr->getShaderReadLayout();
                 }
 
-                if (m_environmentMaps.size() > 0)
-                {
-                    auto &envMapImageArrayInfos = envMapImageInfos.emplace_back();
-                    envMapImageArrayInfos.reserve(m_environmentMaps.size());
-                    // Max probe count per draw (may be higher)
-                    for (uint32_t i = 0u; i < m_environmentMaps.size(); i++)
-                    {
-                        std::shared_ptr<Texture> texPtr = m_environmentMaps[i].lock();
+                udb.addSetWrites(VkWriteDescriptorSet{
+                    .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                    .dstSet = instanceDescriptorSet,
+                    .dstBinding = 4,
+                    .dstArrayElement = 0,
+                    .descriptorCount = static_cast<uint32_t>(envMapImageArrayInfos.size()),
+                    .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                    .pImageInfo = envMapImageArrayInfos.data(),
+                });
+            }
 
-                        VkDescriptorImageInfo &envMapImageInfo = envMapImageArrayInfos.emplace_back();
-                        envMapImageInfo.sampler = *texPtr->getSampler();
-                        envMapImageInfo.imageView = texPtr->getImageView();
-                        envMapImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-                    }
+            if (std::shared_ptr<Texture> texPtr = m_visibilityAtlas.lock())
+            {
+                VkDescriptorImageInfo &visibilityAtlasImageInfo = visibilityAtlasImageInfos.emplace_back();
+                visibilityAtlasImageInfo.sampler = *texPtr->getSampler();
+                visibilityAtlasImageInfo.imageView = texPtr->getImageView();
+                visibilityAtlasImageInfo.imageLayout = texPtr->getShaderReadLayout();
 
-                    udb.addSetWrites(VkWriteDescriptorSet{
-                        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-                        .dstSet = instanceDescriptorSets[i],
-                        .dstBinding = 4,
-                        .dstArrayElement = 0,
-                        .descriptorCount = static_cast<uint32_t>(envMapImageArrayInfos.size()),
-                        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                        .pImageInfo = envMapImageArrayInfos.data(),
-                    });
-                }
+                udb.addSetWrites(VkWriteDescriptorSet{
+                    .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                    .dstSet = instanceDescriptorSet,
+                    .dstBinding = 6,
+                    .dstArrayElement = 0,
+                    .descriptorCount = 1,
+                    .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                    .pImageInfo = &visibilityAtlasImageInfo,
+                });
             }
         }
 
+        if (m_textureDescriptorEnable)
+        {
+            m_product->m_materialTextures.resize(m_product->m_materialDescriptorSetsPerSubObject.size());
+            m_product->m_materialImageGenerations.resize(m_product->m_materialDescriptorSetsPerSubObject.size());
+        }
+
         for (uint32_t i = 0u; i < m_product->m_materialDescriptorSetsPerSubObject.size(); ++i)
         {
             auto &materialDescriptorSets = m_product->m_materialDescriptorSetsPerSubObject[i];
@@ -584,6 +530,10 @@ std::unique_ptr<GPUStateI> ModelRenderStateBuilder::build()
                     {
                         std::shared_ptr<Texture> texPtr = currentTexture.lock();
 
+                        m_product->m_materialTextures[i] = currentTexture;
+                        m_product->m_materialImageGenerations[i].resize(materialDescriptorSets.size());
+                        m_product->m_materialImageGenerations[i][j] = texPtr->getImageGeneration();
+
                         VkDescriptorImageInfo &diffuseImageInfo = diffuseImageInfos.emplace_back();
                         diffuseImageInfo.sampler = *texPtr->getSampler();
                         diffuseImageInfo.imageView = texPtr->getImageView();
@@ -634,7 +584,7 @@ void ModelRenderState::recordBackBufferDrawObjectCommands(const VkCommandBuffer
     VkDeviceSize offsets[] = {0};
     vkCmdBindVertexBuffers(commandBuffer, 0, 1, vbos, offsets);
     vkCmdBindIndexBuffer(commandBuffer, meshPtr->getIndexBufferHandle(), 0, VK_INDEX_TYPE_UINT16);
-    vkCmdDrawIndexed(commandBuffer, meshPtr->getIndexCount(), 1, 0, 0, 0);
+    vkCmdDrawIndexed(commandBuffer, meshPtr->getIndexCount(), m_instanceCount, 0, 0, 0);
 }
 
 void ModelRenderState::updateUniformBuffers(uint32_t backBufferIndex, uint32_t singleFrameRenderIndex,
@@ -642,22 +592,75 @@ void ModelRenderState::updateUniformBuffers(uint32_t backBufferIndex, uint32_t s
                                             const std::vector<std::shared_ptr<Light>> &lights,
                                             const std::shared_ptr<ProbeGrid> &probeGrid, bool captureModeEnabled)
 {
-    RenderStateABC::updateUniformBuffers(backBufferIndex, singleFrameRenderIndex, pooledFramebufferIndex, camera,
-                                         lights, probeGrid, captureModeEnabled);
+    MVP *mvpData = writeMVP(pooledFramebufferIndex, camera, probeGrid, captureModeEnabled);
+    if (!mvpData)
+        return;
+
+    if (m_transforms)
+        mvpData->model = m_transforms->getWorldMatrix(m_transformIndex);
+    else
+        mvpData->model = m_model.lock()->getWorldMatrix();
+}
+
+void ModelRenderState::updateDescriptorSetsPerFrame(const RenderPhase *parentPhase, VkCommandBuffer cmd,
+                                                    uint32_t backBufferIndex, uint32_t pooledFramebufferIndex)
+{
+    RenderStateABC::updateDescriptorSetsPerFrame(parentPhase, cmd, backBufferIndex, pooledFramebufferIndex);
 
-    if (m_poolMVPUniformBuffersMapped.size() > 0)
+    // the frame that last used the sets of this back buffer has completed, the previous image may be gone
+    for (uint32_t i = 0u; i < m_materialTextures.size(); ++i)
     {
-        const auto &mvpUniformBuffersMapped = m_poolMVPUniformBuffersMapped[pooledFramebufferIndex];
-        if (mvpUniformBuffersMapped.size() > 0)
-        {
-            MVP *mvpData = static_cast<MVP *>(mvpUniformBuffersMapped[backBufferIndex]);
-            auto modelPtr = m_model.lock();
+        const std::shared_ptr<Texture> texPtr = m_materialTextures[i].lock();
+        if (!texPtr || backBufferIndex >= m_materialImageGenerations[i].size() ||
+            m_materialImageGenerations[i][backBufferIndex] == texPtr->getImageGeneration())
+            continue;
+
+        const VkDescriptorImageInfo diffuseImageInfo = {
+            .sampler = *texPtr->getSampler(),
+            .imageView = texPtr->getImageView(),
+            .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        };
+        const VkWriteDescriptorSet write = {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = m_materialDescriptorSetsPerSubObject[i][backBufferIndex],
+            .dstBinding = 1,
+            .dstArrayElement = 0,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .pImageInfo = &diffuseImageInfo,
+        };
+        vkUpdateDescriptorSets(m_device.lock()->getHandle(), 1, &write, 0, nullptr);
 
-            mvpData->model = modelPtr->getTransform().getTransformMatrix();
-        }
+        m_materialImageGenerations[i][backBufferIndex] = texPtr->getImageGeneration();
     }
 }
 
+bool ModelRenderState::addToRecordKey(RecordKey &key, uint32_t backBufferIndex, const CameraABC &camera) const
+{
+    if (!RenderStateABC::addToRecordKey(key, backBufferIndex, camera))
+        return false;
+
+    // a streamed texture that changed its image has its sets written again, which needs a new recording
+    for (const std::weak_ptr<Texture> &texture : m_materialTextures)
+    {
+        if (const std::shared_ptr<Texture> texPtr = texture.lock())
+            key.add(texPtr->getImageGeneration());
+    }
+
+    if (m_pushViewPosition)
+        key.add(camera.getTransform().position);
+
+    key.add(m_instanceCount);
+    for (const std::shared_ptr<Mesh> &mesh : m_model.lock()->getMeshes())
+    {
+        key.add(mesh->getVertexBufferHandle());
+        key.add(mesh->getIndexBufferHandle());
+        key.add(mesh->getIndexCount());
+    }
+
+    return true;
+}
+
 uint32_t ModelRenderState::getSubObjectCount() const
 {
     return m_model.lock()->getMeshes().size();
@@ -730,7 +733,7 @@ std::unique_ptr<GPUStateI> SkyboxRenderStateBuilder::build()
     // descriptor pool
     VkDescriptorPoolCreateInfo createInfo = {
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-        .maxSets = m_frameInFlightCount * m_captureCount,
+        .maxSets = m_frameInFlightCount * (1u + 1u * m_product->getSubObjectCount()),
         .poolSizeCount = static_cast<uint32_t>(m_poolSizes.size()),
         .pPoolSizes = m_poolSizes.data(),
     };
@@ -742,31 +745,26 @@ std::unique_ptr<GPUStateI> SkyboxRenderStateBuilder::build()
     }
 
     // descriptor set
-    m_product->m_poolInstanceDescriptorSets.resize(m_captureCount);
-    for (int captureIdx = 0; captureIdx < m_captureCount; captureIdx++)
-    {
-        auto &instanceDescriptorSets = m_product->m_poolInstanceDescriptorSets[captureIdx];
-        std::optional<VkDescriptorSetLayout> instanceDescriptorSetLayout =
-            m_product->m_pipeline->getDescriptorSetLayoutAtIndex(0u);
+    std::optional<VkDescriptorSetLayout> instanceDescriptorSetLayout =
+        m_product->m_pipeline->getDescriptorSetLayoutAtIndex(0u);
 
-        if (instanceDescriptorSetLayout.has_value())
+    if (instanceDescriptorSetLayout.has_value())
+    {
+        std::vector<VkDescriptorSetLayout> instanceSetLayouts(m_frameInFlightCount,
+                                                              instanceDescriptorSetLayout.value());
+        VkDescriptorSetAllocateInfo instanceDescriptorSetAllocInfo = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .descriptorPool = m_product->m_descriptorPool,
+            .descriptorSetCount = m_frameInFlightCount,
+            .pSetLayouts = instanceSetLayouts.data(),
+        };
+        m_product->m_instanceDescriptorSets.resize(m_frameInFlightCount);
+        res = vkAllocateDescriptorSets(deviceHandle, &instanceDescriptorSetAllocInfo,
+                                       m_product->m_instanceDescriptorSets.data());
+        if (res != VK_SUCCESS)
         {
-            std::vector<VkDescriptorSetLayout> instanceSetLayouts(m_frameInFlightCount,
-                                                                  instanceDescriptorSetLayout.value());
-            VkDescriptorSetAllocateInfo instanceDescriptorSetAllocInfo = {
-                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-                .descriptorPool = m_product->m_descriptorPool,
-                .descriptorSetCount = m_frameInFlightCount,
-                .pSetLayouts = instanceSetLayouts.data(),
-            };
-            instanceDescriptorSets.resize(m_frameInFlightCount);
-            res =
-                vkAllocateDescriptorSets(deviceHandle, &instanceDescriptorSetAllocInfo, instanceDescriptorSets.data());
-            if (res != VK_SUCCESS)
-            {
-                std::cerr << "Failed to allocate instance descriptor sets : " << res << std::endl;
-                return nullptr;
-            }
+            std::cerr << "Failed to allocate instance descriptor sets : " << res << std::endl;
+            return nullptr;
         }
     }
 
@@ -803,78 +801,56 @@ std::unique_ptr<GPUStateI> SkyboxRenderStateBuilder::build()
 
     // uniform buffers
 
-    m_product->m_poolMVPUniformBuffers.resize(m_captureCount);
-    m_product->m_poolMVPUniformBuffersMapped.resize(m_captureCount);
-    for (int captureIdx = 0; captureIdx < m_captureCount; captureIdx++)
+    assert(m_product->m_frameAllocator);
+    m_product->m_mvpDynamicEnable = true;
+
+    const VkDescriptorBufferInfo mvpBufferInfo = {
+        .buffer = m_product->m_frameAllocator->getHandle(),
+        .offset = 0,
+        .range = sizeof(RenderStateABC::MVP),
+    };
+
+    VkDescriptorImageInfo imageInfo = {
+        .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+    };
+    if (m_texture.lock())
     {
-        auto &mvpUniformBuffers = m_product->m_poolMVPUniformBuffers[captureIdx];
-        auto &mvpUniformBuffersMapped = m_product->m_poolMVPUniformBuffersMapped[captureIdx];
-        mvpUniformBuffers.resize(m_frameInFlightCount);
-        mvpUniformBuffersMapped.resize(m_frameInFlightCount);
-        for (int backBufferIdx = 0; backBufferIdx < mvpUniformBuffers.size(); ++backBufferIdx)
-        {
-            BufferBuilder bb;
-            BufferDirector bd;
-            bd.configureUniformBufferBuilder(bb);
-            bb.setSize(sizeof(RenderStateABC::MVP));
-            bb.setDevice(m_device);
-            bb.setName(std::to_string((uintptr_t)this) + " Skybox MVP Uniform Buffer");
-            mvpUniformBuffers[backBufferIdx] = bb.build();
-
-            mvpUniformBuffers[backBufferIdx]->mapMemory(&mvpUniformBuffersMapped[backBufferIdx]);
-        }
+        auto texPtr = m_texture.lock();
+        imageInfo.sampler = *texPtr->getSampler();
+        imageInfo.imageView = texPtr->getImageView();
     }
 
-    std::vector<VkDescriptorBufferInfo> mvpBufferInfos;
-    mvpBufferInfos.resize(m_frameInFlightCount * m_captureCount);
-
     UniformDescriptorBuilder udb;
-    for (int captureIdx = 0; captureIdx < m_captureCount; captureIdx++)
+    for (const VkDescriptorSet &instanceDescriptorSet : m_product->m_instanceDescriptorSets)
     {
-        const auto &instanceDescriptorSets = m_product->m_poolInstanceDescriptorSets[captureIdx];
-        for (uint32_t i = 0u; i < instanceDescriptorSets.size(); ++i)
+        udb.addSetWrites(VkWriteDescriptorSet{
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = instanceDescriptorSet,
+            .dstBinding = 0,
+            .dstArrayElement = 0,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+            .pBufferInfo = &mvpBufferInfo,
+        });
+
+        if (m_textureDescriptorEnable)
         {
-            VkDescriptorBufferInfo &mvpBufferInfo = mvpBufferInfos.emplace_back();
-            mvpBufferInfo.buffer = m_product->m_poolMVPUniformBuffers[captureIdx][i]->getHandle();
-            mvpBufferInfo.offset = 0;
-            mvpBufferInfo.range = sizeof(RenderStateABC::MVP);
             udb.addSetWrites(VkWriteDescriptorSet{
                 .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-                .dstSet = instanceDescriptorSets[i],
-                .dstBinding = 0,
+                .dstSet = instanceDescriptorSet,
+                .dstBinding = 1,
                 .dstArrayElement = 0,
                 .descriptorCount = 1,
-                .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-                .pBufferInfo = &mvpBufferInfo,
+                .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .pImageInfo = &imageInfo,
             });
-
-            if (m_textureDescriptorEnable)
-            {
-                VkDescriptorImageInfo imageInfo = {
-                    .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-                };
-                if (m_texture.lock())
-                {
-                    auto texPtr = m_texture.lock();
-                    imageInfo.sampler = *texPtr->getSampler();
-                    imageInfo.imageView = texPtr->getImageView();
-                }
-                udb.addSetWrites(VkWriteDescriptorSet{
-                    .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-                    .dstSet = instanceDescriptorSets[i],
-                    .dstBinding = 1,
-                    .dstArrayElement = 0,
-                    .descriptorCount = 1,
-                    .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                    .pImageInfo = &imageInfo,
-                });
-            }
-
-            std::vector<VkWriteDescriptorSet> writes = udb.buildAndRestart()->getSetWrites();
-            vkUpdateDescriptorSets(deviceHandle, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
         }
     }
 
+    std::vector<VkWriteDescriptorSet> writes = udb.buildAndRestart()->getSetWrites();
+    if (!writes.empty())
+        vkUpdateDescriptorSets(deviceHandle, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
     return std::move(m_product);
 }
 
@@ -883,24 +859,7 @@ void SkyboxRenderState::updateUniformBuffers(uint32_t backBufferIndex, uint32_t
                                              const std::vector<std::shared_ptr<Light>> &lights,
                                              const std::shared_ptr<ProbeGrid> &probeGrid, bool captureModeEnabled)
 {
-    MVP *mvpData = static_cast<MVP *>(m_poolMVPUniformBuffersMapped[pooledFramebufferIndex][backBufferIndex]);
-    mvpData->model = glm::identity<glm::mat4>();
-
-    if (!captureModeEnabled)
-    {
-        mvpData->proj = camera.getProjectionMatrix();
-        mvpData->views[0] = camera.getViewMatrix();
-    }
-    else
-    {
-        const glm::vec3 &probePosition = probeGrid->getProbeAtIndex(pooledFramebufferIndex)->position;
-
-        mvpData->proj = capturePartialProj;
-        mvpData->proj[1][1] *= -1;
-
-        for (int i = 0; i < 6; i++)
-            mvpData->views[i] = glm::lookAt(probePosition, probePosition + captureViewCenter[i], captureViewUp[i]);
-    }
+    writeMVP(pooledFramebufferIndex, camera, probeGrid, captureModeEnabled);
 }
 
 void SkyboxRenderState::recordBackBufferDrawObjectCommands(const VkCommandBuffer &commandBuffer,
@@ -914,6 +873,15 @@ void SkyboxRenderState::recordBackBufferDrawObjectCommands(const VkCommandBuffer
     vkCmdDraw(commandBuffer, skyboxPtr->getVertexCount(), 1, 0, 0);
 }
 
+bool SkyboxRenderState::addToRecordKey(RecordKey &key, uint32_t backBufferIndex, const CameraABC &camera) const
+{
+    if (!RenderStateABC::addToRecordKey(key, backBufferIndex, camera))
+        return false;
+
+    key.add(m_skybox.lock()->getVertexBufferHandle());
+    return true;
+}
+
 void EnvironmentCaptureRenderStateBuilder::setPipeline(std::shared_ptr<Pipeline> pipeline)
 {
     m_product->m_pipeline = pipeline;
@@ -935,7 +903,7 @@ std::unique_ptr<GPUStateI> EnvironmentCaptureRenderStateBuilder::build()
     // descriptor pool
     VkDescriptorPoolCreateInfo createInfo = {
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-        .maxSets = m_frameInFlightCount * m_captureCount,
+        .maxSets = m_frameInFlightCount * (1u + 1u * m_product->getSubObjectCount()),
         .poolSizeCount = static_cast<uint32_t>(m_poolSizes.size()),
         .pPoolSizes = m_poolSizes.data(),
     };
@@ -947,31 +915,26 @@ std::unique_ptr<GPUStateI> EnvironmentCaptureRenderStateBuilder::build()
     }
 
     // descriptor set
-    m_product->m_poolInstanceDescriptorSets.resize(m_captureCount);
-    for (int captureIdx = 0; captureIdx < m_captureCount; captureIdx++)
-    {
-        auto &instanceDescriptorSets = m_product->m_poolInstanceDescriptorSets[captureIdx];
-        std::optional<VkDescriptorSetLayout> instanceDescriptorSetLayout =
-            m_product->m_pipeline->getDescriptorSetLayoutAtIndex(0u);
+    std::optional<VkDescriptorSetLayout> instanceDescriptorSetLayout =
+        m_product->m_pipeline->getDescriptorSetLayoutAtIndex(0u);
 
-        if (instanceDescriptorSetLayout.has_value())
+    if (instanceDescriptorSetLayout.has_value())
+    {
+        std::vector<VkDescriptorSetLayout> instanceSetLayouts(m_frameInFlightCount,
+                                                              instanceDescriptorSetLayout.value());
+        VkDescriptorSetAllocateInfo instanceDescriptorSetAllocInfo = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .descriptorPool = m_product->m_descriptorPool,
+            .descriptorSetCount = m_frameInFlightCount,
+            .pSetLayouts = instanceSetLayouts.data(),
+        };
+        m_product->m_instanceDescriptorSets.resize(m_frameInFlightCount);
+        res = vkAllocateDescriptorSets(deviceHandle, &instanceDescriptorSetAllocInfo,
+                                       m_product->m_instanceDescriptorSets.data());
+        if (res != VK_SUCCESS)
         {
-            std::vector<VkDescriptorSetLayout> instanceSetLayouts(m_frameInFlightCount,
-                                                                  instanceDescriptorSetLayout.value());
-            VkDescriptorSetAllocateInfo instanceDescriptorSetAllocInfo = {
-                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-                .descriptorPool = m_product->m_descriptorPool,
-                .descriptorSetCount = m_frameInFlightCount,
-                .pSetLayouts = instanceSetLayouts.data(),
-            };
-            instanceDescriptorSets.resize(m_frameInFlightCount);
-            res =
-                vkAllocateDescriptorSets(deviceHandle, &instanceDescriptorSetAllocInfo, instanceDescriptorSets.data());
-            if (res != VK_SUCCESS)
-            {
-                std::cerr << "Failed to allocate instance descriptor sets : " << res << std::endl;
-                return nullptr;
-            }
+            std::cerr << "Failed to allocate instance descriptor sets : " << res << std::endl;
+            return nullptr;
         }
     }
 
@@ -1008,81 +971,56 @@ std::unique_ptr<GPUStateI> EnvironmentCaptureRenderStateBuilder::build()
 
     // uniform buffers
 
-    m_product->m_poolMVPUniformBuffers.resize(m_captureCount);
-    m_product->m_poolMVPUniformBuffersMapped.resize(m_captureCount);
-    for (int captureIdx = 0; captureIdx < m_captureCount; captureIdx++)
-    {
-        auto &mvpUniformBuffers = m_product->m_poolMVPUniformBuffers[captureIdx];
-        auto &mvpUniformBuffersMapped = m_product->m_poolMVPUniformBuffersMapped[captureIdx];
-        mvpUniformBuffers.resize(m_frameInFlightCount);
-        mvpUniformBuffersMapped.resize(m_frameInFlightCount);
-        for (int backBufferIdx = 0; backBufferIdx < mvpUniformBuffers.size(); ++backBufferIdx)
-        {
-            BufferBuilder bb;
-            BufferDirector bd;
-            bd.configureUniformBufferBuilder(bb);
-            bb.setSize(sizeof(RenderStateABC::MVP));
-            bb.setDevice(m_device);
-            bb.setName(std::to_string((uintptr_t)this) + " Environment Capture MVP Uniform Buffer");
-            mvpUniformBuffers[backBufferIdx] = bb.build();
-
-            mvpUniformBuffers[backBufferIdx]->mapMemory(&mvpUniformBuffersMapped[backBufferIdx]);
-        }
-    }
+    assert(m_product->m_frameAllocator);
+    m_product->m_mvpDynamicEnable = true;
 
-    std::vector<VkDescriptorBufferInfo> mvpBufferInfos;
-    mvpBufferInfos.resize(m_frameInFlightCount * m_captureCount);
+    const VkDescriptorBufferInfo mvpBufferInfo = {
+        .buffer = m_product->m_frameAllocator->getHandle(),
+        .offset = 0,
+        .range = sizeof(RenderStateABC::MVP),
+    };
 
-    std::vector<VkDescriptorImageInfo> envMapImageInfos;
-    envMapImageInfos.reserve(m_frameInFlightCount * m_captureCount);
+    VkDescriptorImageInfo imageInfo = {
+        .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+    };
+    if (m_texture.lock())
+    {
+        auto texPtr = m_texture.lock();
+        imageInfo.sampler = *texPtr->getSampler();
+        imageInfo.imageView = texPtr->getImageView();
+    }
 
     UniformDescriptorBuilder udb;
-    for (int captureIdx = 0; captureIdx < m_captureCount; captureIdx++)
+    for (const VkDescriptorSet &instanceDescriptorSet : m_product->m_instanceDescriptorSets)
     {
-        const auto &instanceDescriptorSets = m_product->m_poolInstanceDescriptorSets[captureIdx];
-        for (int i = 0; i < instanceDescriptorSets.size(); ++i)
+        udb.addSetWrites(VkWriteDescriptorSet{
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = instanceDescriptorSet,
+            .dstBinding = 0,
+            .dstArrayElement = 0,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+            .pBufferInfo = &mvpBufferInfo,
+        });
+
+        if (m_textureDescriptorEnable)
         {
-            VkDescriptorBufferInfo &mvpBufferInfo = mvpBufferInfos.emplace_back();
-            mvpBufferInfo.buffer = m_product->m_poolMVPUniformBuffers[captureIdx][i]->getHandle();
-            mvpBufferInfo.offset = 0;
-            mvpBufferInfo.range = sizeof(RenderStateABC::MVP);
             udb.addSetWrites(VkWriteDescriptorSet{
                 .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-                .dstSet = instanceDescriptorSets[i],
-                .dstBinding = 0,
+                .dstSet = instanceDescriptorSet,
+                .dstBinding = 1,
                 .dstArrayElement = 0,
                 .descriptorCount = 1,
-                .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-                .pBufferInfo = &mvpBufferInfo,
+                .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .pImageInfo = &imageInfo,
             });
-
-            if (m_textureDescriptorEnable)
-            {
-                VkDescriptorImageInfo &imageInfo = envMapImageInfos.emplace_back();
-                imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-                if (m_texture.lock())
-                {
-                    auto texPtr = m_texture.lock();
-                    imageInfo.sampler = *texPtr->getSampler();
-                    imageInfo.imageView = texPtr->getImageView();
-                }
-                udb.addSetWrites(VkWriteDescriptorSet{
-                    .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-                    .dstSet = instanceDescriptorSets[i],
-                    .dstBinding = 1,
-                    .dstArrayElement = 0,
-                    .descriptorCount = 1,
-                    .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                    .pImageInfo = &imageInfo,
-                });
-            }
-
-            std::vector<VkWriteDescriptorSet> writes = udb.buildAndRestart()->getSetWrites();
-            vkUpdateDescriptorSets(deviceHandle, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
         }
     }
 
+    std::vector<VkWriteDescriptorSet> writes = udb.buildAndRestart()->getSetWrites();
+    if (!writes.empty())
+        vkUpdateDescriptorSets(deviceHandle, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
     return std::move(m_product);
 }
 
@@ -1092,26 +1030,7 @@ void EnvironmentCaptureRenderState::updateUniformBuffers(uint32_t backBufferInde
                                                          const std::shared_ptr<ProbeGrid> &probeGrid,
                                                          bool captureModeEnabled)
 {
-    uint32_t bufferIndex = std::min(m_poolMVPUniformBuffersMapped[0].size() - 1, (size_t)backBufferIndex);
-
-    MVP *mvpData = static_cast<MVP *>(m_poolMVPUniformBuffersMapped[0][bufferIndex]);
-    mvpData->model = glm::identity<glm::mat4>();
-
-    if (!captureModeEnabled)
-    {
-        mvpData->proj = camera.getProjectionMatrix();
-        mvpData->views[0] = camera.getViewMatrix();
-    }
-    else
-    {
-        const glm::vec3 &probePosition = probeGrid->getProbeAtIndex(pooledFramebufferIndex)->position;
-
-        mvpData->proj = capturePartialProj;
-        mvpData->proj[1][1] *= -1;
-
-        for (int i = 0; i < 6; i++)
-            mvpData->views[i] = glm::lookAt(probePosition, probePosition + captureViewCenter[i], captureViewUp[i]);
-    }
+    writeMVP(pooledFramebufferIndex, camera, probeGrid, captureModeEnabled);
 }
 
 void EnvironmentCaptureRenderState::recordBackBufferDescriptorSetsCommands(const VkCommandBuffer &commandBuffer,
@@ -1119,22 +1038,24 @@ void EnvironmentCaptureRenderState::recordBackBufferDescriptorSetsCommands(const
                                                                            uint32_t backBufferIndex,
                                                                            uint32_t pooledFramebufferIndex)
 {
-    std::vector<VkDescriptorSet> descriptorSets;
+    if (!m_instanceDescriptorSetEnable || backBufferIndex >= m_instanceDescriptorSets.size())
+        return;
 
-    if (m_instanceDescriptorSetEnable)
-    {
-        const auto &instanceDescriptorSets = m_poolInstanceDescriptorSets.front();
-        if (backBufferIndex < instanceDescriptorSets.size())
-        {
-            descriptorSets.push_back(instanceDescriptorSets[backBufferIndex]);
-        }
-    }
+    uint32_t dynamicOffsets[4];
+    const uint32_t dynamicOffsetCount = getDynamicOffsets(dynamicOffsets);
 
-    if (descriptorSets.size() == 0u)
-        return;
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline->getPipelineLayout(), 0, 1,
+                            &m_instanceDescriptorSets[backBufferIndex], dynamicOffsetCount, dynamicOffsets);
+}
 
-    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline->getPipelineLayout(), 0,
-                            descriptorSets.size(), descriptorSets.data(), 0, nullptr);
+bool EnvironmentCaptureRenderState::addToRecordKey(RecordKey &key, uint32_t backBufferIndex,
+                                                   const CameraABC &camera) const
+{
+    if (!RenderStateABC::addToRecordKey(key, backBufferIndex, camera))
+        return false;
+
+    key.add(m_skybox.lock()->getVertexBufferHandle());
+    return true;
 }
 
 void EnvironmentCaptureRenderState::recordBackBufferDrawObjectCommands(const VkCommandBuffer &commandBuffer,
@@ -1169,7 +1090,7 @@ std::unique_ptr<GPUStateI> ProbeGridRenderStateBuilder::build()
     // descriptor pool
     VkDescriptorPoolCreateInfo createInfo = {
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-        .maxSets = m_frameInFlightCount * (1u * m_captureCount + 1u * m_product->getSubObjectCount()),
+        .maxSets = m_frameInFlightCount * (1u + 1u * m_product->getSubObjectCount()),
         .poolSizeCount = static_cast<uint32_t>(m_poolSizes.size()),
         .pPoolSizes = m_poolSizes.data(),
     };
@@ -1183,149 +1104,106 @@ std::unique_ptr<GPUStateI> ProbeGridRenderStateBuilder::build()
     m_product->m_materialDescriptorSetEnable = false;
 
     // descriptor set
-    m_product->m_poolInstanceDescriptorSets.resize(m_captureCount);
-    for (int captureIdx = 0; captureIdx < m_captureCount; captureIdx++)
-    {
-        auto &instanceDescriptorSets = m_product->m_poolInstanceDescriptorSets[captureIdx];
-        std::optional<VkDescriptorSetLayout> instanceDescriptorSetLayout =
-            m_product->m_pipeline->getDescriptorSetLayoutAtIndex(0u);
+    std::optional<VkDescriptorSetLayout> instanceDescriptorSetLayout =
+        m_product->m_pipeline->getDescriptorSetLayoutAtIndex(0u);
 
-        if (instanceDescriptorSetLayout.has_value())
+    if (instanceDescriptorSetLayout.has_value())
+    {
+        std::vector<VkDescriptorSetLayout> instanceSetLayouts(m_frameInFlightCount,
+                                                              instanceDescriptorSetLayout.value());
+        VkDescriptorSetAllocateInfo instanceDescriptorSetAllocInfo = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .descriptorPool = m_product->m_descriptorPool,
+            .descriptorSetCount = m_frameInFlightCount,
+            .pSetLayouts = instanceSetLayouts.data(),
+        };
+        m_product->m_instanceDescriptorSets.resize(m_frameInFlightCount);
+        res = vkAllocateDescriptorSets(deviceHandle, &instanceDescriptorSetAllocInfo,
+                                       m_product->m_instanceDescriptorSets.data());
+        if (res != VK_SUCCESS)
         {
-            std::vector<VkDescriptorSetLayout> instanceSetLayouts(m_frameInFlightCount,
-                                                                  instanceDescriptorSetLayout.value());
-            VkDescriptorSetAllocateInfo instanceDescriptorSetAllocInfo = {
-                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-                .descriptorPool = m_product->m_descriptorPool,
-                .descriptorSetCount = m_frameInFlightCount,
-                .pSetLayouts = instanceSetLayouts.data(),
-            };
-            instanceDescriptorSets.resize(m_frameInFlightCount);
-            res =
-                vkAllocateDescriptorSets(deviceHandle, &instanceDescriptorSetAllocInfo, instanceDescriptorSets.data());
-            if (res != VK_SUCCESS)
-            {
-                std::cerr << "Failed to allocate instance descriptor sets : " << res << std::endl;
-                return nullptr;
-            }
+            std::cerr << "Failed to allocate instance descriptor sets : " << res << std::endl;
+            return nullptr;
         }
     }
 
     // uniform buffers
 
-    m_product->m_poolMVPUniformBuffers.resize(m_captureCount);
-    m_product->m_poolMVPUniformBuffersMapped.resize(m_captureCount);
-    for (int captureIdx = 0; captureIdx < m_captureCount; captureIdx++)
-    {
-        auto &mvpUniformBuffers = m_product->m_poolMVPUniformBuffers[captureIdx];
-        auto &mvpUniformBuffersMapped = m_product->m_poolMVPUniformBuffersMapped[captureIdx];
-        mvpUniformBuffers.resize(m_frameInFlightCount);
-        mvpUniformBuffersMapped.resize(m_frameInFlightCount);
-        for (int backBufferIdx = 0; backBufferIdx < mvpUniformBuffers.size(); ++backBufferIdx)
-        {
-            BufferBuilder bb;
-            BufferDirector bd;
-            bd.configureUniformBufferBuilder(bb);
-            bb.setSize(sizeof(RenderStateABC::MVP));
-            bb.setDevice(m_device);
-            bb.setName(std::to_string((uintptr_t)this) + " Probe Grid MVP Uniform Buffer");
-            mvpUniformBuffers[backBufferIdx] = bb.build();
-
-            mvpUniformBuffers[backBufferIdx]->mapMemory(&mvpUniformBuffersMapped[backBufferIdx]);
-        }
-
-        m_product->m_probeStorageBuffers.resize(m_frameInFlightCount);
-        m_product->m_probeStorageBuffersMapped.resize(m_frameInFlightCount);
-
-        for (int i = 0; i < m_product->m_probeStorageBuffers.size(); ++i)
-        {
-            BufferBuilder bb;
-            BufferDirector bd;
-            bd.configureStorageBufferBuilder(bb);
-            bb.setSize(sizeof(RenderStateABC::ProbeContainer));
-            bb.setDevice(m_device);
-            bb.setName(std::to_string((uintptr_t)this) + " Probe Grid Probe Container Uniform Buffer");
-            m_product->m_probeStorageBuffers[i] = bb.build();
-
-            m_product->m_probeStorageBuffers[i]->mapMemory(&m_product->m_probeStorageBuffersMapped[i]);
-        }
-
-        std::vector<VkDescriptorBufferInfo> mvpBufferInfos;
-        mvpBufferInfos.reserve(m_frameInFlightCount * m_captureCount);
+    assert(m_product->m_frameAllocator);
+    assert(m_product->m_grid.lock());
+    m_product->m_mvpDynamicEnable = true;
+    m_product->m_probeDynamicEnable = true;
 
-        std::vector<VkDescriptorBufferInfo> probeBufferInfos;
-        probeBufferInfos.reserve(m_frameInFlightCount * m_captureCount);
+    const VkBuffer frameBuffer = m_product->m_frameAllocator->getHandle();
+    const VkDescriptorBufferInfo mvpBufferInfo = {
+        .buffer = frameBuffer,
+        .offset = 0,
+        .range = sizeof(RenderStateABC::MVP),
+    };
+    // the grid of the state keeps its probe count, every frame writes the same size
+    const VkDescriptorBufferInfo probeBufferInfo = {
+        .buffer = frameBuffer,
+        .offset = 0,
+        .range = RenderStateABC::ProbeContainer::getSize(m_product->m_grid.lock()->getProbes().size()),
+    };
 
-        std::vector<std::vector<VkDescriptorImageInfo>> envMapImageInfos;
-        envMapImageInfos.reserve(m_frameInFlightCount * m_captureCount);
+    std::vector<std::vector<VkDescriptorImageInfo>> envMapImageInfos;
+    envMapImageInfos.reserve(m_frameInFlightCount);
 
-        UniformDescriptorBuilder udb;
-        for (int captureIdx = 0; captureIdx < m_captureCount; captureIdx++)
+    UniformDescriptorBuilder udb;
+    for (const VkDescriptorSet &instanceDescriptorSet : m_product->m_instanceDescriptorSets)
+    {
+        udb.addSetWrites(VkWriteDescriptorSet{
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = instanceDescriptorSet,
+            .dstBinding = 0,
+            .dstArrayElement = 0,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+            .pBufferInfo = &mvpBufferInfo,
+        });
+
+        udb.addSetWrites(VkWriteDescriptorSet{
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = instanceDescriptorSet,
+            .dstBinding = 5,
+            .dstArrayElement = 0,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+            .pBufferInfo = &probeBufferInfo,
+        });
+
+        if (m_environmentMaps.size() > 0)
         {
-            const auto &instanceDescriptorSets = m_product->m_poolInstanceDescriptorSets[captureIdx];
-
-            for (uint32_t i = 0u; i < instanceDescriptorSets.size(); ++i)
+            auto &envMapImageArrayInfos = envMapImageInfos.emplace_back();
+            envMapImageArrayInfos.reserve(m_environmentMaps.size());
+            // Max probe count per draw (may be higher)
+            for (uint32_t i = 0u; i < m_environmentMaps.size(); i++)
             {
-                VkDescriptorBufferInfo &mvpBufferInfo = mvpBufferInfos.emplace_back();
-                mvpBufferInfo.buffer = m_product->m_poolMVPUniformBuffers[captureIdx][i]->getHandle();
-                mvpBufferInfo.offset = 0;
-                mvpBufferInfo.range = sizeof(RenderStateABC::MVP);
-                udb.addSetWrites(VkWriteDescriptorSet{
-                    .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-                    .dstSet = instanceDescriptorSets[i],
-                    .dstBinding = 0,
-                    .dstArrayElement = 0,
-                    .descriptorCount = 1,
-                    .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-                    .pBufferInfo = &mvpBufferInfo,
-                });
+                std::shared_ptr<Texture> texPtr = m_environmentMaps[i].lock();
 
-                VkDescriptorBufferInfo &probeBufferInfo = probeBufferInfos.emplace_back();
-                probeBufferInfo.buffer = m_product->m_probeStorageBuffers[i]->getHandle();
-                probeBufferInfo.offset = 0;
-                probeBufferInfo.range = sizeof(RenderStateABC::ProbeContainer);
-                udb.addSetWrites(VkWriteDescriptorSet{
-                    .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-                    .dstSet = instanceDescriptorSets[i],
-                    .dstBinding = 5,
-                    .dstArrayElement = 0,
-                    .descriptorCount = 1,
-                    .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-                    .pBufferInfo = &probeBufferInfo,
-                });
-
-                if (m_environmentMaps.size() > 0)
-                {
-                    auto &envMapImageArrayInfos = envMapImageInfos.emplace_back();
-                    envMapImageArrayInfos.reserve(m_environmentMaps.size());
-                    // Max probe count per draw (may be higher)
-                    for (uint32_t i = 0u; i < m_environmentMaps.size(); i++)
-                    {
-                        std::shared_ptr<Texture> texPtr = m_environmentMaps[i].lock();
-
-                        VkDescriptorImageInfo &envMapImageInfo = envMapImageArrayInfos.emplace_back();
-                        envMapImageInfo.sampler = *texPtr->getSampler();
-                        envMapImageInfo.imageView = texPtr->getImageView();
-                        envMapImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-                    }
-
-                    udb.addSetWrites(VkWriteDescriptorSet{
-                        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-                        .dstSet = instanceDescriptorSets[i],
-                        .dstBinding = 4,
-                        .dstArrayElement = 0,
-                        .descriptorCount = static_cast<uint32_t>(envMapImageArrayInfos.size()),
-                        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                        .pImageInfo = envMapImageArrayInfos.data(),
-                    });
-                }
+                VkDescriptorImageInfo &envMapImageInfo = envMapImageArrayInfos.emplace_back();
+                envMapImageInfo.sampler = *texPtr->getSampler();
+                envMapImageInfo.imageView = texPtr->getImageView();
+                envMapImageInfo.imageLayout = texPtr->getShaderReadLayout();
             }
-        }
 
-        std::vector<VkWriteDescriptorSet> writes = udb.buildAndRestart()->getSetWrites();
-        if (!writes.empty())
-            vkUpdateDescriptorSets(deviceHandle, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+            udb.addSetWrites(VkWriteDescriptorSet{
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = instanceDescriptorSet,
+                .dstBinding = 4,
+                .dstArrayElement = 0,
+                .descriptorCount = static_cast<uint32_t>(envMapImageArrayInfos.size()),
+                .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .pImageInfo = envMapImageArrayInfos.data(),
+            });
+        }
     }
+
+    std::vector<VkWriteDescriptorSet> writes = udb.buildAndRestart()->getSetWrites();
+    if (!writes.empty())
+        vkUpdateDescriptorSets(deviceHandle, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
     return std::move(m_product);
 }
 
@@ -1334,51 +1212,42 @@ void ProbeGridRenderState::updateUniformBuffers(uint32_t backBufferIndex, uint32
                                                 const std::vector<std::shared_ptr<Light>> &lights,
                                                 const std::shared_ptr<ProbeGrid> &probeGrid, bool captureModeEnabled)
 {
-    if (m_poolMVPUniformBuffersMapped[pooledFramebufferIndex].size() > 0)
-    {
-        MVP *mvpData = static_cast<MVP *>(m_poolMVPUniformBuffersMapped[pooledFramebufferIndex][backBufferIndex]);
-        mvpData->model = glm::identity<glm::mat4>();
+    writeMVP(pooledFramebufferIndex, camera, probeGrid, captureModeEnabled);
 
-        if (!captureModeEnabled)
-        {
-            mvpData->proj = camera.getProjectionMatrix();
-            mvpData->views[0] = camera.getViewMatrix();
-        }
-    }
-
-    const std::vector<std::unique_ptr<Probe>> &probes = m_grid.lock()->getProbes();
-    ProbeContainer *probeContainer = static_cast<ProbeContainer *>(m_probeStorageBuffersMapped[backBufferIndex]);
-
-    for (int i = 0; i < probes.size(); i++)
-    {
-        const Probe *probe = probes[i].get();
+    // the displayed grid is the one of this state, which is not necessarily the one of the scene
+    if (m_probeFrameSerial == m_frameAllocator->getFrameSerial())
+        return;
 
-        ProbeContainer::Probe probeData{
-            .position = probe->position,
-        };
+    m_probeFrameSerial = m_frameAllocator->getFrameSerial();
+    writeProbes(*m_grid.lock());
+}
 
-        probeContainer->probes[i] = probeData;
-    }
+uint32_t ProbeGridRenderState::getInstanceCount() const
+{
+    auto gridPtr = m_grid.lock();
+    if (gridPtr->instanceCountOverride > 0)
+        return (uint32_t)gridPtr->instanceCountOverride;
 
-    probeContainer->dimensions = probeGrid->getDimensions();
-    probeContainer->extent = probeGrid->getExtent();
-    probeContainer->cornerPosition = probeGrid->getCornerPosition();
+    return static_cast<uint32_t>(gridPtr->getProbes().size());
 }
 
 void ProbeGridRenderState::recordBackBufferDrawObjectCommands(const VkCommandBuffer &commandBuffer,
                                                               uint32_t subObjectIndex)
 {
-    auto gridPtr = m_grid.lock();
-    const auto &dimensions = gridPtr->getDimensions();
-    uint32_t instanceCount = dimensions.x * dimensions.y * dimensions.z;
-    if (gridPtr->instanceCountOverride > 0)
-        instanceCount = (uint32_t)gridPtr->instanceCountOverride;
-
     VkBuffer vbos[] = {m_mesh->getVertexBufferHandle()};
     VkDeviceSize offsets[] = {0};
     vkCmdBindVertexBuffers(commandBuffer, 0, 1, vbos, offsets);
     vkCmdBindIndexBuffer(commandBuffer, m_mesh->getIndexBufferHandle(), 0, VK_INDEX_TYPE_UINT16);
-    vkCmdDrawIndexed(commandBuffer, m_mesh->getIndexCount(), instanceCount, 0, 0, 0);
+    vkCmdDrawIndexed(commandBuffer, m_mesh->getIndexCount(), getInstanceCount(), 0, 0, 0);
+}
+
+bool ProbeGridRenderState::addToRecordKey(RecordKey &key, uint32_t backBufferIndex, const CameraABC &camera) const
+{
+    if (!RenderStateABC::addToRecordKey(key, backBufferIndex, camera))
+        return false;
+
+    key.add(getInstanceCount());
+    return true;
 }
 
 uint32_t ProbeGridRenderState::getSubObjectCount() const
@@ -1404,6 +1273,17 @@ void ComputeState::recordBackBufferComputeCommands(const VkCommandBuffer &comman
     vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline->getPipelineLayout(), 0, 1,
                             &m_descriptorSets[backBufferIndex], 0, nullptr);
 
+    if (m_waitPreviousDispatch)
+    {
+        VkMemoryBarrier barrier = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+        };
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
     assert(m_workGroup.x > 0 && m_workGroup.y > 0 && m_workGroup.z > 0);
     vkCmdDispatch(commandBuffer, m_workGroup.x, m_workGroup.y, m_workGroup.z);
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <string>
@@ -12,6 +13,8 @@
 class Pipeline;
 class Device;
 class Buffer;
+class FrameAllocator;
+class SceneConstants;
 class CameraABC;
 class Mesh;
 class Model;
@@ -24,6 +27,7 @@ class SkyboxRenderStateBuilder;
 class EnvironmentCaptureRenderStateBuilder;
 class ProbeGridRenderStateBuilder;
 class Texture;
+class TransformStore;
 class RenderPhase;
 
 /**
@@ -50,6 +54,27 @@ class RenderPhase;
 using DescriptorSetUpdatePred =
     std::function<void(const RenderPhase *parentPhase, const VkDescriptorSet &set, uint32_t backBufferIndex)>;
 
+/**
+ * @brief accumulates everything a phase records in a command buffer
+ * two equal keys mean that the same commands would be recorded, so the previous command buffer can be re-submitted
+ *
+ */
+struct RecordKey
+{
+    uint64_t value = 14695981039346656037ull;
+
+    void add(const void *data, size_t size)
+    {
+        const uint8_t *bytes = static_cast<const uint8_t *>(data);
+        for (size_t i = 0u; i < size; i++)
+            value = (value ^ bytes[i]) * 1099511628211ull;
+    }
+    template <typename T> void add(const T &a)
+    {
+        add(&a, sizeof(T));
+    }
+};
+
 class GPUStateI;
 /**
  * @brief same as above but executed at each frame (between the render pass scope)
@@ -124,7 +149,11 @@ class RenderStateABC : public GPUStateI
         struct Probe
         {
             glm::vec3 position;
-            float pad0[1];
+            /**
+             * @brief 1 if the probe is used for shading, 0 if it is enclosed by the geometry
+             *
+             */
+            float active;
         };
 
         glm::uvec3 dimensions;
@@ -133,7 +162,44 @@ class RenderStateABC : public GPUStateI
         float pad1[1];
         glm::vec3 cornerPosition;
         float pad2[1];
-        Probe probes[64];
+
+        /**
+         * @brief the probes of the grid follow the header, as many as the grid holds
+         *
+         */
+        [[nodiscard]] inline Probe *getProbes()
+        {
+            return reinterpret_cast<Probe *>(this + 1);
+        }
+        [[nodiscard]] static constexpr VkDeviceSize getSize(size_t probeCount)
+        {
+            return sizeof(ProbeContainer) + probeCount * sizeof(Probe);
+        }
+    };
+
+    /**
+     * @brief lookup of the probes from their index on the grid, see ProbeGrid
+     *
+     */
+    struct ProbeBrickContainer
+    {
+        glm::uvec3 brickSize;
+        float pad0[1];
+        glm::uvec3 brickDimensions;
+        float pad1[1];
+
+        /**
+         * @brief index of the first probe of every brick follows the header, -1 if the brick is not allocated
+         *
+         */
+        [[nodiscard]] inline int32_t *getBrickProbeOffsets()
+        {
+            return reinterpret_cast<int32_t *>(this + 1);
+        }
+        [[nodiscard]] static constexpr VkDeviceSize getSize(size_t brickCount)
+        {
+            return sizeof(ProbeBrickContainer) + brickCount * sizeof(int32_t);
+        }
     };
 
     struct PointLightContainer
@@ -183,16 +249,28 @@ class RenderStateABC : public GPUStateI
     std::shared_ptr<Pipeline> m_pipeline;
 
     VkDescriptorPool m_descriptorPool;
-    std::vector<std::vector<VkDescriptorSet>> m_poolInstanceDescriptorSets;
+    std::vector<VkDescriptorSet> m_instanceDescriptorSets;
     std::vector<std::vector<VkDescriptorSet>> m_materialDescriptorSetsPerSubObject;
-    std::vector<std::vector<std::unique_ptr<Buffer>>> m_poolMVPUniformBuffers;
-    std::vector<std::vector<void *>> m_poolMVPUniformBuffersMapped;
-    std::vector<std::unique_ptr<Buffer>> m_probeStorageBuffers;
-    std::vector<void *> m_probeStorageBuffersMapped;
-    std::vector<std::unique_ptr<Buffer>> m_pointLightStorageBuffers;
-    std::vector<void *> m_pointLightStorageBuffersMapped;
-    std::vector<std::unique_ptr<Buffer>> m_directionalLightStorageBuffers;
-    std::vector<void *> m_directionalLightStorageBuffersMapped;
+
+    /**
+     * @brief the MVP is written in the frame allocator every frame
+     * the lights are read from the scene constants shared by every state, with dynamic descriptors
+     * (bindings 0, 2 and 3)
+     * the probes and their bricks are written once in the probe table of the scene constants (bindings 5 and 7)
+     *
+     */
+    FrameAllocator *m_frameAllocator = nullptr;
+    SceneConstants *m_sceneConstants = nullptr;
+    bool m_mvpDynamicEnable = false;
+    bool m_lightDynamicEnable = false;
+    bool m_probeDynamicEnable = false;
+
+    uint32_t m_mvpDynamicOffset = 0u;
+    /**
+     * @brief used by the states that write their own probes instead of the ones of the scene
+     *
+     */
+    uint32_t m_probeDynamicOffset = 0u;
 
     DescriptorSetUpdatePredPerFrame m_instanceDescriptorSetUpdatePredPerFrame = nullptr;
     DescriptorSetUpdatePred m_instanceDescriptorSetUpdatePred = nullptr;
@@ -230,6 +308,36 @@ class RenderStateABC : public GPUStateI
                                                         uint32_t backBufferIndex, uint32_t pooledFramebufferIndex);
     virtual void recordBackBufferDrawObjectCommands(const VkCommandBuffer &commandBuffer, uint32_t subObjectIndex) = 0;
 
+    /**
+     * @brief add what this state records in a command buffer to the key of its phase
+     * must be called after updating the uniform buffers as the dynamic offsets are part of the key
+     *
+     * @param key
+     * @param backBufferIndex
+     * @param camera
+     * @return false if the commands cannot be re-submitted (descriptor sets written every frame)
+     */
+    virtual bool addToRecordKey(RecordKey &key, uint32_t backBufferIndex, const CameraABC &camera) const;
+
+  protected:
+    /**
+     * @brief allocate and fill the MVP of the current pooled framebuffer
+     *
+     * @return MVP* nullptr if the MVP is not used or the frame allocator is full
+     */
+    MVP *writeMVP(uint32_t pooledFramebufferIndex, const CameraABC &camera, const std::shared_ptr<ProbeGrid> &probeGrid,
+                  bool captureModeEnabled);
+    void writeProbes(const ProbeGrid &probeGrid);
+
+    /**
+     * @brief gather the dynamic offsets in binding order
+     *
+     * @param dynamicOffsets at least 4 elements
+     * @return uint32_t dynamic offset count
+     */
+    uint32_t getDynamicOffsets(uint32_t *dynamicOffsets) const;
+
+  public:
     /**
      * @brief no implementation yet
      *
@@ -272,6 +380,12 @@ class RenderStateBuilderI
     virtual void setPipeline(std::shared_ptr<Pipeline> pipeline) = 0;
     virtual void addPoolSize(VkDescriptorType poolSizeType, size_t size = 1) = 0;
     virtual void setFrameInFlightCount(uint32_t a) = 0;
+    /**
+     * @brief allocator in which the per frame uniform and storage data is written
+     * it must outlive the state, the render graph owns it
+     *
+     */
+    virtual void setFrameAllocator(FrameAllocator *frameAllocator) = 0;
     virtual void setTexture(std::weak_ptr<Texture> texture) = 0;
 
     /**
@@ -303,7 +417,6 @@ class RenderStateBuilderI
 
     virtual void setInstanceDescriptorEnable(bool enable) = 0;
     virtual void setMaterialDescriptorEnable(bool enable) = 0;
-    virtual void setCaptureCount(uint32_t captureCount) = 0;
 
     virtual std::unique_ptr<GPUStateI> build() = 0;
 };
@@ -315,8 +428,30 @@ class ModelRenderState : public RenderStateABC
   private:
     std::weak_ptr<Model> m_model;
 
+    /**
+     * @brief world matrix of the model read from the store of its scene without locking the model
+     *
+     */
+    std::shared_ptr<const TransformStore> m_transforms;
+    uint32_t m_transformIndex = 0u;
+
     bool m_pushViewPosition = true;
 
+    /**
+     * @brief every mesh is drawn this many times, the shaders tell the instances apart with gl_InstanceIndex
+     *
+     */
+    uint32_t m_instanceCount = 1u;
+
+    /**
+     * @brief texture of the material of every mesh, and the generation of its image written to the set of every back
+     * buffer
+     * the texture streamer replaces the image of a streamed texture, the set is written again before being recorded
+     *
+     */
+    std::vector<std::weak_ptr<Texture>> m_materialTextures;
+    std::vector<std::vector<uint32_t>> m_materialImageGenerations;
+
   public:
     static std::shared_ptr<Texture> s_defaultDiffuseTexture;
 
@@ -328,6 +463,10 @@ class ModelRenderState : public RenderStateABC
                               uint32_t pooledFramebufferIndex, const CameraABC &camera,
                               const std::vector<std::shared_ptr<Light>> &lights,
                               const std::shared_ptr<ProbeGrid> &probeGrid, bool captureModeEnabled) override;
+    void updateDescriptorSetsPerFrame(const RenderPhase *parentPhase, VkCommandBuffer cmd, uint32_t backBufferIndex,
+                                      uint32_t pooledFramebufferIndex) override;
+
+    bool addToRecordKey(RecordKey &key, uint32_t backBufferIndex, const CameraABC &camera) const override;
 
   public:
     [[nodiscard]] uint32_t getSubObjectCount() const override;
@@ -337,6 +476,10 @@ class ModelRenderState : public RenderStateABC
         assert(!m_model.expired());
         return m_model.lock().get();
     }
+    [[nodiscard]] const std::weak_ptr<Model> &getModelReference() const
+    {
+        return m_model;
+    }
 };
 
 class ModelRenderStateBuilder : public RenderStateBuilderI
@@ -353,12 +496,12 @@ class ModelRenderStateBuilder : public RenderStateBuilderI
 
     std::weak_ptr<Texture> m_texture;
     std::vector<std::weak_ptr<Texture>> m_environmentMaps;
+    std::weak_ptr<Texture> m_visibilityAtlas;
 
     bool m_probeDescriptorEnable = true;
     bool m_lightDescriptorEnable = true;
     bool m_textureDescriptorEnable = true;
     bool m_mvpDescriptorEnable = true;
-    uint32_t m_captureCount = 1u;
 
     void restart() override
     {
@@ -382,6 +525,18 @@ class ModelRenderStateBuilder : public RenderStateBuilderI
     {
         m_frameInFlightCount = a;
     }
+    void setFrameAllocator(FrameAllocator *frameAllocator) override
+    {
+        m_product->m_frameAllocator = frameAllocator;
+    }
+    /**
+     * @brief lights and probe table bound when their descriptors are enabled, the render graph owns them
+     *
+     */
+    void setSceneConstants(SceneConstants *sceneConstants)
+    {
+        m_product->m_sceneConstants = sceneConstants;
+    }
     void setTexture(std::weak_ptr<Texture> texture) override
     {
         m_texture = texture;
@@ -392,6 +547,14 @@ class ModelRenderStateBuilder : public RenderStateBuilderI
         for (const std::shared_ptr<Texture> &texture : textures)
             m_environmentMaps.push_back(texture);
     }
+    /**
+     * @brief octahedral distance and squared distance seen from each probe, bound next to the probes
+     *
+     */
+    void setVisibilityAtlas(std::weak_ptr<Texture> texture)
+    {
+        m_visibilityAtlas = texture;
+    }
     void setDescriptorSetUpdatePredPerFrame(DescriptorSetUpdatePredPerFrame pred) override
     {
         assert(false);
@@ -424,10 +587,6 @@ class ModelRenderStateBuilder : public RenderStateBuilderI
     {
         m_product->m_materialDescriptorSetEnable = enable;
     }
-    void setCaptureCount(uint32_t captureCount) override
-    {
-        m_captureCount = captureCount;
-    }
 
     void setModel(std::shared_ptr<Model> model);
 
@@ -451,6 +610,10 @@ class ModelRenderStateBuilder : public RenderStateBuilderI
     {
         m_product->m_pushViewPosition = a;
     }
+    void setInstanceCount(uint32_t instanceCount)
+    {
+        m_product->m_instanceCount = instanceCount;
+    }
 
     std::unique_ptr<GPUStateI> build() override;
 };
@@ -462,6 +625,15 @@ class ImGuiRenderState : public RenderStateABC
   public:
     void recordBackBufferDrawObjectCommands(const VkCommandBuffer &commandBuffer, uint32_t subObjectIndex) override;
 
+    /**
+     * @brief the draw data of the interface changes every frame
+     *
+     */
+    bool addToRecordKey(RecordKey &key, uint32_t backBufferIndex, const CameraABC &camera) const override
+    {
+        return false;
+    }
+
     uint32_t getSubObjectCount() const override
     {
         return 1u;
@@ -479,7 +651,6 @@ class ImGuiRenderStateBuilder : public RenderStateBuilderI
     uint32_t m_frameInFlightCount;
 
     std::weak_ptr<Texture> m_texture;
-    uint32_t m_captureCount = 1u;
 
     void restart() override
     {
@@ -503,6 +674,10 @@ class ImGuiRenderStateBuilder : public RenderStateBuilderI
     {
         m_frameInFlightCount = a;
     }
+    void setFrameAllocator(FrameAllocator *frameAllocator) override
+    {
+        m_product->m_frameAllocator = frameAllocator;
+    }
 
     void setTexture(std::weak_ptr<Texture> texture) override
     {
@@ -541,9 +716,6 @@ class ImGuiRenderStateBuilder : public RenderStateBuilderI
     {
         m_product->m_materialDescriptorSetEnable = enable;
     }
-    void setCaptureCount(uint32_t captureCount) override
-    {
-    }
 
     std::unique_ptr<GPUStateI> build() override;
 };
@@ -563,6 +735,8 @@ class SkyboxRenderState : public RenderStateABC
 
     void recordBackBufferDrawObjectCommands(const VkCommandBuffer &commandBuffer, uint32_t subObjectIndex) override;
 
+    bool addToRecordKey(RecordKey &key, uint32_t backBufferIndex, const CameraABC &camera) const override;
+
     uint32_t getSubObjectCount() const override
     {
         return 1u;
@@ -583,8 +757,6 @@ class SkyboxRenderStateBuilder : public RenderStateBuilderI
 
     bool m_textureDescriptorEnable = true;
 
-    uint32_t m_captureCount = 1u;
-
     void restart() override
     {
         m_product = std::unique_ptr<SkyboxRenderState>(new SkyboxRenderState);
@@ -607,6 +779,10 @@ class SkyboxRenderStateBuilder : public RenderStateBuilderI
     {
         m_frameInFlightCount = a;
     }
+    void setFrameAllocator(FrameAllocator *frameAllocator) override
+    {
+        m_product->m_frameAllocator = frameAllocator;
+    }
     void setTexture(std::weak_ptr<Texture> texture) override
     {
         m_texture = texture;
@@ -644,10 +820,6 @@ class SkyboxRenderStateBuilder : public RenderStateBuilderI
     {
         m_product->m_materialDescriptorSetEnable = enable;
     }
-    void setCaptureCount(uint32_t captureCount) override
-    {
-        m_captureCount = captureCount;
-    }
     void setSkybox(std::shared_ptr<Skybox> skybox)
     {
         m_product->m_skybox = skybox;
@@ -678,6 +850,8 @@ class EnvironmentCaptureRenderState : public RenderStateABC
     void recordBackBufferDescriptorSetsCommands(const VkCommandBuffer &commandBuffer, uint32_t subObjectIndex,
                                                 uint32_t imageIndex, uint32_t pooledFramebufferIndex) override;
 
+    bool addToRecordKey(RecordKey &key, uint32_t backBufferIndex, const CameraABC &camera) const override;
+
     uint32_t getSubObjectCount() const override
     {
         return 1u;
@@ -697,7 +871,6 @@ class EnvironmentCaptureRenderStateBuilder : public RenderStateBuilderI
     std::weak_ptr<Texture> m_texture;
 
     bool m_textureDescriptorEnable = true;
-    uint32_t m_captureCount = 1u;
 
     void restart() override
     {
@@ -721,6 +894,10 @@ class EnvironmentCaptureRenderStateBuilder : public RenderStateBuilderI
     {
         m_frameInFlightCount = a;
     }
+    void setFrameAllocator(FrameAllocator *frameAllocator) override
+    {
+        m_product->m_frameAllocator = frameAllocator;
+    }
     void setTexture(std::weak_ptr<Texture> texture) override
     {
         m_texture = texture;
@@ -758,10 +935,6 @@ class EnvironmentCaptureRenderStateBuilder : public RenderStateBuilderI
     {
         m_product->m_materialDescriptorSetEnable = enable;
     }
-    void setCaptureCount(uint32_t captureCount) override
-    {
-        m_captureCount = captureCount;
-    }
     void setSkybox(std::shared_ptr<Skybox> skybox)
     {
         m_product->m_skybox = skybox;
@@ -784,6 +957,14 @@ class ProbeGridRenderState : public RenderStateABC
 
     std::shared_ptr<Mesh> m_mesh;
 
+    /**
+     * @brief frame in which the probes of the grid were last written, they are shared by every pooled framebuffer
+     *
+     */
+    uint64_t m_probeFrameSerial = UINT64_MAX;
+
+    [[nodiscard]] uint32_t getInstanceCount() const;
+
   public:
     void updateUniformBuffers(uint32_t backBufferIndex, uint32_t singleFrameRenderIndex,
                               uint32_t pooledFramebufferIndex, const CameraABC &camera,
@@ -792,6 +973,8 @@ class ProbeGridRenderState : public RenderStateABC
 
     void recordBackBufferDrawObjectCommands(const VkCommandBuffer &commandBuffer, uint32_t subObjectIndex) override;
 
+    bool addToRecordKey(RecordKey &key, uint32_t backBufferIndex, const CameraABC &camera) const override;
+
     uint32_t getSubObjectCount() const override;
 };
 
@@ -806,7 +989,6 @@ class ProbeGridRenderStateBuilder : public RenderStateBuilderI
 
     std::vector<VkDescriptorPoolSize> m_poolSizes;
     uint32_t m_frameInFlightCount;
-    uint32_t m_captureCount = 1u;
 
     void restart() override
     {
@@ -830,6 +1012,10 @@ class ProbeGridRenderStateBuilder : public RenderStateBuilderI
     {
         m_frameInFlightCount = a;
     }
+    void setFrameAllocator(FrameAllocator *frameAllocator) override
+    {
+        m_product->m_frameAllocator = frameAllocator;
+    }
 
     void setProbeGrid(std::weak_ptr<ProbeGrid> grid)
     {
@@ -874,9 +1060,6 @@ class ProbeGridRenderStateBuilder : public RenderStateBuilderI
     {
         m_product->m_materialDescriptorSetUpdatePred = pred;
     }
-    void setCaptureCount(uint32_t captureCount) override
-    {
-    }
     void setInstanceDescriptorEnable(bool enable) override
     {
         m_product->m_instanceDescriptorSetEnable = enable;
@@ -912,6 +1095,13 @@ class ComputeState : public GPUStateI
 
     glm::ivec3 m_workGroup = glm::ivec3(0, 0, 0);
 
+    /**
+     * @brief the dispatch reads what the previous compute state of the phase wrote
+     * the barrier also covers the dispatches of the previous frames, which were submitted to the queue before
+     *
+     */
+    bool m_waitPreviousDispatch = false;
+
     ComputeState() = default;
 
   public:
@@ -975,6 +1165,10 @@ class ComputeStateBuilder final : public RenderStateBuilderI
     {
         m_frameInFlightCount = a;
     }
+    void setFrameAllocator(FrameAllocator *frameAllocator) override
+    {
+        assert(false);
+    }
     void setTexture(std::weak_ptr<Texture> texture) override
     {
         assert(false);
@@ -1015,8 +1209,9 @@ class ComputeStateBuilder final : public RenderStateBuilderI
     {
         m_product->m_workGroup = workGroup;
     }
-    void setCaptureCount(uint32_t captureCount) override
+    void setWaitPreviousDispatch(bool a)
     {
+        m_product->m_waitPreviousDispatch = a;
     }
 
     std::unique_ptr<GPUStateI> build() override;
@@ -3,6 +3,7 @@
 #include <tracy/Tracy.hpp>
 #include <vulkan/vulkan.h>
 
+#include "engine/frame_arena.hpp"
 #include "engine/probe_grid.hpp"
 
 #include "graphics/device.hpp"
@@ -66,6 +67,9 @@ VkResult Renderer::renderFrame(VkRect2D renderArea, const CameraABC &mainCamera,
 {
     ZoneScoped;
 
+    // the containers of the frame that used the next region are not used anymore
+    m_renderGraph->getFrameArena()->beginFrame();
+
     uint32_t imageIndex;
     VkResult res = acquireNextSwapChainImage(imageIndex);
     if (res != VK_SUCCESS)
@@ -73,9 +77,8 @@ VkResult Renderer::renderFrame(VkRect2D renderArea, const CameraABC &mainCamera,
 
     m_renderGraph->processRendering(imageIndex, renderArea, mainCamera, lights, probeGrid);
     res = presentBackBuffer(imageIndex);
-    if (res != VK_SUCCESS)
-        return res;
 
+    // the back buffers have been submitted whether or not they are presented, the next frame waits for the next ones
     m_renderGraph->swapAllRenderPhasesBackBuffers();
 
     return res;
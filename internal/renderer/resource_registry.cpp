@@ -0,0 +1,70 @@
+#include <cassert>
+
+#include "acceleration_structure_cache.hpp"
+#include "texture_streamer.hpp"
+
+#include "resource_registry.hpp"
+
+ResourceRegistry::~ResourceRegistry()
+{
+    // the structures of the meshes are destroyed before the meshes
+    m_accelerationStructures.reset();
+    m_entries.clear();
+    m_textureStreamer.reset();
+}
+
+void ResourceRegistry::beginSceneSwitch()
+{
+    m_accelerationStructures->releaseExpired();
+}
+
+void ResourceRegistry::endSceneSwitch()
+{
+    uint32_t releasedCount = 0u;
+    for (auto it = m_entries.begin(); it != m_entries.end();)
+    {
+        Entry &e = it->second;
+        if (e.resource.use_count() > 1)
+        {
+            e.unusedSceneCount = 0u;
+            ++it;
+            continue;
+        }
+
+        if (++e.unusedSceneCount <= m_retainedSceneCount)
+        {
+            ++it;
+            continue;
+        }
+
+        it = m_entries.erase(it);
+        releasedCount++;
+    }
+    m_statistics.releasedCount += releasedCount;
+    m_statistics.lastReleasedCount = releasedCount;
+    m_statistics.sceneSwitchCount++;
+
+    // the structures of the released meshes
+    m_accelerationStructures->releaseExpired();
+}
+
+std::unique_ptr<ResourceRegistry> ResourceRegistryBuilder::build()
+{
+    assert(m_product->m_device.lock());
+
+    AccelerationStructureCacheBuilder ascb;
+    ascb.setDevice(m_product->m_device);
+    ascb.setFrameInFlightCount(m_frameInFlightCount);
+    m_product->m_accelerationStructures = ascb.build();
+    if (!m_product->m_accelerationStructures)
+        return nullptr;
+
+    TextureStreamerBuilder tsb;
+    tsb.setDevice(m_product->m_device);
+    tsb.setFrameInFlightCount(m_frameInFlightCount);
+    m_product->m_textureStreamer = tsb.build();
+
+    auto result = std::move(m_product);
+    restart();
+    return result;
+}
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <typeinfo>
+#include <unordered_map>
+
+class Device;
+class AccelerationStructureCache;
+class TextureStreamer;
+class ResourceRegistryBuilder;
+
+/**
+ * @brief device resources loaded by the scenes, kept across scene switches
+ * a resource is looked up by its source and the configuration it is built with, the scenes asking for the same key
+ * share the same resource
+ * a resource that the scenes do not use anymore is released after a given number of scene switches
+ *
+ */
+class ResourceRegistry
+{
+    friend ResourceRegistryBuilder;
+
+  public:
+    struct Statistics
+    {
+        uint32_t resourceCount = 0u;
+        /**
+         * @brief requests served by a resource loaded by a previous request
+         *
+         */
+        uint32_t hitCount = 0u;
+        uint32_t loadCount = 0u;
+        uint32_t releasedCount = 0u;
+        uint32_t sceneSwitchCount = 0u;
+        /**
+         * @brief resources released by the last scene switch
+         *
+         */
+        uint32_t lastReleasedCount = 0u;
+        uint32_t textureCount = 0u;
+        /**
+         * @brief device memory of the textures of the loaded models, at the extent they are first loaded with
+         *
+         */
+        uint64_t textureBytes = 0u;
+    };
+
+  private:
+    struct Entry
+    {
+        std::shared_ptr<void> resource;
+        /**
+         * @brief scene switches since the last scene that used the resource
+         *
+         */
+        uint32_t unusedSceneCount = 0u;
+    };
+
+    std::weak_ptr<Device> m_device;
+
+    std::unordered_map<std::string, Entry> m_entries;
+
+    /**
+     * @brief scenes loaded without using a resource before it is released, the assets shared by two scenes that are
+     * not loaded one after the other survive the scene in between
+     *
+     */
+    uint32_t m_retainedSceneCount = 1u;
+
+    /**
+     * @brief handed to the render graph of every scene, the bottom level structures of the shared meshes are not
+     * built again
+     *
+     */
+    std::shared_ptr<AccelerationStructureCache> m_accelerationStructures;
+    /**
+     * @brief streams the textures of the models loaded through the registry
+     *
+     */
+    std::unique_ptr<TextureStreamer> m_textureStreamer;
+
+    Statistics m_statistics;
+
+    ResourceRegistry() = default;
+
+  public:
+    ~ResourceRegistry();
+
+    ResourceRegistry(const ResourceRegistry &) = delete;
+    ResourceRegistry &operator=(const ResourceRegistry &) = delete;
+    ResourceRegistry(ResourceRegistry &&) = delete;
+    ResourceRegistry &operator=(ResourceRegistry &&) = delete;
+
+    /**
+     * @brief
+     *
+     * @param key source and configuration of the resource, the resources of different types do not share their keys
+     * @param load called if the resource has not been loaded yet, a null resource is not registered
+     * @return std::shared_ptr<TResource>
+     */
+    template <typename TResource>
+    [[nodiscard]] std::shared_ptr<TResource> getOrLoad(const std::string &key,
+                                                       const std::function<std::shared_ptr<TResource>()> &load)
+    {
+        const std::string typedKey = std::string(typeid(TResource).name()) + ':' + key;
+
+        auto it = m_entries.find(typedKey);
+        if (it != m_entries.end())
+        {
+            m_statistics.hitCount++;
+            it->second.unusedSceneCount = 0u;
+            return std::static_pointer_cast<TResource>(it->second.resource);
+        }
+
+        std::shared_ptr<TResource> resource = load();
+        m_statistics.loadCount++;
+        if (resource)
+            m_entries.emplace(typedKey, Entry{.resource = resource});
+        return resource;
+    }
+
+    /**
+     * @brief account the textures loaded along with the meshes of a model file
+     *
+     */
+    inline void recordLoadedTextures(uint32_t count, uint64_t bytes)
+    {
+        m_statistics.textureCount += count;
+        m_statistics.textureBytes += bytes;
+    }
+
+    /**
+     * @brief release the acceleration structures of the objects of the previous scene
+     * called once the previous scene is destroyed and before the next one is loaded, the device being idle, so that
+     * the objects of the next scene never reuse a structure through the address of a destroyed object
+     *
+     */
+    void beginSceneSwitch();
+    /**
+     * @brief release the resources that no scene has used for more than the retained number of scenes
+     * called once the previous scene is destroyed and the next one is loaded, the device being idle
+     *
+     */
+    void endSceneSwitch();
+
+  public:
+    [[nodiscard]] inline const std::shared_ptr<AccelerationStructureCache> &getAccelerationStructureCache() const
+    {
+        return m_accelerationStructures;
+    }
+    [[nodiscard]] inline TextureStreamer *getTextureStreamer() const
+    {
+        return m_textureStreamer.get();
+    }
+    [[nodiscard]] Statistics getStatistics() const
+    {
+        Statistics statistics = m_statistics;
+        statistics.resourceCount = static_cast<uint32_t>(m_entries.size());
+        return statistics;
+    }
+};
+
+class ResourceRegistryBuilder
+{
+  private:
+    std::unique_ptr<ResourceRegistry> m_product;
+
+    uint32_t m_frameInFlightCount = 1u;
+
+    void restart()
+    {
+        m_product = std::unique_ptr<ResourceRegistry>(new ResourceRegistry);
+    }
+
+  public:
+    ResourceRegistryBuilder()
+    {
+        restart();
+    }
+
+    void setDevice(std::weak_ptr<Device> device)
+    {
+        m_product->m_device = device;
+    }
+    void setFrameInFlightCount(uint32_t count)
+    {
+        m_frameInFlightCount = count;
+    }
+    void setRetainedSceneCount(uint32_t count)
+    {
+        m_product->m_retainedSceneCount = count;
+    }
+
+    std::unique_ptr<ResourceRegistry> build();
+};
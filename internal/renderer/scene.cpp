@@ -1,6 +1,7 @@
 #include <tracy/Tracy.hpp>
 
 #include "engine/camera.hpp"
+#include "engine/job_system.hpp"
 #include "engine/scriptable.hpp"
 
 #include "graphics/buffer.hpp"
@@ -22,6 +23,12 @@ SceneABC::~SceneABC()
         ModelRenderState::s_defaultDiffuseTexture.reset();
 }
 
+void SceneABC::addObject(const std::shared_ptr<Model> &object, const Model *parent)
+{
+    object->addToTransformStore(m_transforms, parent);
+    m_objects.push_back(object);
+}
+
 void SceneABC::beginSimulation()
 {
     for (auto &script : m_scripts)
@@ -34,8 +41,48 @@ void SceneABC::updateSimulation(float deltaTime)
 {
     ZoneScoped;
 
-    for (auto &script : m_scripts)
+    size_t first = 0;
+    while (first < m_scripts.size())
     {
-        script->update(deltaTime);
+        // the first script of a batch never conflicts with the empty batch
+        ScriptAccessT batchAccess = {.reads = 0u, .writes = 0u};
+        size_t last = first;
+        for (; last < m_scripts.size(); ++last)
+        {
+            const ScriptAccessT access = m_scripts[last]->getUpdateAccess();
+            if (access.conflictsWith(batchAccess))
+                break;
+
+            batchAccess.reads |= access.reads;
+            batchAccess.writes |= access.writes;
+        }
+
+        if (!m_jobSystem || last - first == 1)
+        {
+            for (size_t i = first; i < last; ++i)
+                m_scripts[i]->update(deltaTime);
+        }
+        else
+        {
+            JobSystem::Group group;
+            for (size_t i = first; i < last; ++i)
+            {
+                if (m_scripts[i]->getUpdateAccess().mainThread)
+                    continue;
+
+                ScriptableABC *script = m_scripts[i].get();
+                m_jobSystem->submit(group, [script, deltaTime]() { script->update(deltaTime); });
+            }
+            for (size_t i = first; i < last; ++i)
+            {
+                if (m_scripts[i]->getUpdateAccess().mainThread)
+                    m_scripts[i]->update(deltaTime);
+            }
+            m_jobSystem->wait(group);
+        }
+
+        first = last;
     }
+
+    m_transforms->update();
 }
\ No newline at end of file
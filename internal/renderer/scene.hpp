@@ -1,7 +1,9 @@
 #pragma once
 
+#include <functional>
 #include <iostream>
 #include <memory>
+#include <string>
 #include <type_traits>
 #include <typeinfo>
 #include <vector>
@@ -12,11 +14,15 @@ class Light;
 class Skybox;
 
 #include "engine/scriptable.hpp"
+#include "engine/transform_store.hpp"
+
+#include "resource_registry.hpp"
 
 class Device;
 class WindowGLFW;
 class RenderGraph;
 class Context;
+class JobSystem;
 
 class SceneABC
 {
@@ -26,21 +32,58 @@ class SceneABC
 
     std::vector<std::unique_ptr<ScriptableABC>> m_scripts;
     std::vector<std::shared_ptr<Model>> m_objects;
+    /**
+     * @brief transforms of the objects, the render states read their world matrices from it
+     *
+     */
+    std::shared_ptr<TransformStore> m_transforms = std::make_shared<TransformStore>();
     std::vector<std::shared_ptr<Light>> m_lights;
     std::shared_ptr<Skybox> m_skybox;
 
+    /**
+     * @brief runs the script updates that do not conflict in parallel, the scripts are updated one by one if null
+     *
+     */
+    JobSystem *m_jobSystem = nullptr;
+    /**
+     * @brief assets shared with the other scenes, the scene loads its own if null
+     *
+     */
+    ResourceRegistry *m_resourceRegistry = nullptr;
+
     SceneABC() = default;
 
+    /**
+     * @brief resource of the registry, loaded by the first scene that asks for it
+     *
+     */
+    template <typename TResource>
+    [[nodiscard]] std::shared_ptr<TResource> getOrLoadResource(
+        const std::string &key, const std::function<std::shared_ptr<TResource>()> &load) const
+    {
+        return m_resourceRegistry ? m_resourceRegistry->getOrLoad<TResource>(key, load) : load();
+    }
+
+    /**
+     * @brief
+     *
+     * @param parent object already added to the scene
+     */
+    void addObject(const std::shared_ptr<Model> &object, const Model *parent = nullptr);
+
     virtual void load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, WindowGLFW *window,
                       RenderGraph *renderGraph, uint32_t frameInFlightCount, uint32_t maxProbeCount) = 0;
 
   public:
     template <typename TScene>
     static std::unique_ptr<SceneABC> load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, WindowGLFW *window,
-                                          RenderGraph *renderGraph, uint32_t frameInFlightCount, uint32_t maxProbeCount)
+                                          RenderGraph *renderGraph, uint32_t frameInFlightCount, uint32_t maxProbeCount,
+                                          JobSystem *jobSystem, ResourceRegistry *resourceRegistry = nullptr)
     {
         static_assert(std::is_base_of_v<SceneABC, TScene> == true);
         std::unique_ptr<SceneABC> out = std::make_unique<TScene>();
+        out->m_jobSystem = jobSystem;
+        out->m_resourceRegistry = resourceRegistry;
         out->load(cx, device, window, renderGraph, frameInFlightCount, maxProbeCount);
         return std::move(out);
     }
@@ -53,6 +96,11 @@ class SceneABC
 
   public:
     void beginSimulation();
+    /**
+     * @brief update the scripts, then the world matrices of the objects they moved
+     * consecutive scripts whose accesses do not conflict are updated in parallel, the order of the others is kept
+     *
+     */
     void updateSimulation(float deltaTime);
 
   public:
@@ -61,6 +109,11 @@ class SceneABC
         return m_objects;
     }
 
+    [[nodiscard]] const TransformStore &getTransforms() const
+    {
+        return *m_transforms;
+    }
+
     [[nodiscard]] const std::vector<std::shared_ptr<Light>> &getLights() const
     {
         return m_lights;
@@ -117,4 +170,31 @@ class SceneABC
 
         return foundComponents;
     }
+
+    /**
+     * @brief first camera or script of the given type, nullptr if there is none
+     * does not allocate, unlike getReadOnlyInstancedComponents, so that it can be called while recording a frame
+     *
+     */
+    template <typename TType> [[nodiscard]] TType *getReadOnlyInstancedComponent() const
+    {
+        if (std::is_base_of<CameraABC, TType>::value)
+        {
+            for (int i = 0; i < m_cameras.size(); ++i)
+            {
+                if (typeid(*m_cameras[i].get()) == typeid(TType))
+                    return dynamic_cast<TType *>(m_cameras[i].get());
+            }
+        }
+        else if (std::is_base_of<ScriptableABC, TType>::value)
+        {
+            for (int i = 0; i < m_scripts.size(); ++i)
+            {
+                if (typeid(*m_scripts[i].get()) == typeid(TType))
+                    return dynamic_cast<TType *>(m_scripts[i].get());
+            }
+        }
+
+        return nullptr;
+    }
 };
\ No newline at end of file
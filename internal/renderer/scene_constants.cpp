@@ -0,0 +1,213 @@
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+
+#include <tracy/Tracy.hpp>
+
+#include "engine/probe_grid.hpp"
+
+#include "graphics/buffer.hpp"
+#include "graphics/device.hpp"
+
+#include "light.hpp"
+
+#include "scene_constants.hpp"
+
+SceneConstants::~SceneConstants() = default;
+
+void SceneConstants::update(const std::vector<std::shared_ptr<Light>> &lights, uint32_t frameIndex)
+{
+    ZoneScoped;
+
+    assert(frameIndex < m_frameInFlightCount);
+
+    Block block = {};
+    packLights(lights, block.pointLights, block.directionalLights);
+
+    if (std::memcmp(&block, &m_block, sizeof(Block)) != 0)
+    {
+        m_block = block;
+        m_version++;
+    }
+
+    m_frameIndex = frameIndex;
+    if (m_copyVersions[m_frameIndex] == m_version)
+        return;
+
+    uint8_t *copy = m_mappedData + m_frameIndex * m_stride;
+    std::memcpy(copy + m_pointLightOffset, &m_block.pointLights, sizeof(m_block.pointLights));
+    std::memcpy(copy + m_directionalLightOffset, &m_block.directionalLights, sizeof(m_block.directionalLights));
+
+    m_copyVersions[m_frameIndex] = m_version;
+    m_uploadCount++;
+}
+
+bool SceneConstants::setProbeGrid(const ProbeGrid &probeGrid)
+{
+    if (!reserveProbeTable(probeGrid.getProbes().size(), probeGrid.getBrickProbeOffsets().size()))
+        return false;
+
+    uint8_t *data = static_cast<uint8_t *>(m_probeTable->getMappedData());
+    packProbes(probeGrid, *reinterpret_cast<RenderStateABC::ProbeContainer *>(data));
+    packProbeBricks(probeGrid, *reinterpret_cast<RenderStateABC::ProbeBrickContainer *>(data + m_probeBrickOffset));
+    return true;
+}
+
+bool SceneConstants::reserveProbeTable(size_t probeCount, size_t brickCount)
+{
+    auto devicePtr = m_device.lock();
+    assert(devicePtr);
+
+    const VkDeviceSize alignment = devicePtr->getPhysicalDeviceProperties().limits.minStorageBufferOffsetAlignment;
+    m_probeRange = RenderStateABC::ProbeContainer::getSize(probeCount);
+    m_probeBrickOffset = (m_probeRange + alignment - 1u) & ~(alignment - 1u);
+    m_probeBrickRange = RenderStateABC::ProbeBrickContainer::getSize(brickCount);
+
+    const VkDeviceSize size = m_probeBrickOffset + m_probeBrickRange;
+    if (m_probeTable && m_probeTable->getSize() >= size)
+        return true;
+
+    BufferBuilder bb;
+    BufferDirector bd;
+    bd.configureStorageBufferBuilder(bb);
+    bb.setSize(size);
+    bb.setDevice(m_device);
+    bb.setName("Probe Table");
+    m_probeTable = bb.build();
+    if (!m_probeTable)
+    {
+        std::cerr << "Failed to create probe table buffer" << std::endl;
+        return false;
+    }
+
+    // a table without grid is read as an empty grid
+    std::memset(m_probeTable->getMappedData(), 0, size);
+    return true;
+}
+
+void SceneConstants::packLights(const std::vector<std::shared_ptr<Light>> &lights,
+                                RenderStateABC::PointLightContainer &pointLights,
+                                RenderStateABC::DirectionalLightContainer &directionalLights)
+{
+    int pointLightCount = 0;
+    int directionalLightCount = 0;
+    for (const std::shared_ptr<Light> &light : lights)
+    {
+        switch (light->type)
+        {
+        case LightTypeE::POINT: {
+            if (pointLightCount >= static_cast<int>(std::size(pointLights.pointLights)))
+                break;
+
+            const PointLight *pointLight = static_cast<const PointLight *>(light.get());
+            pointLights.pointLights[pointLightCount++] = RenderStateABC::PointLightContainer::PointLight{
+                .diffuseColor = pointLight->diffuseColor,
+                .diffusePower = pointLight->diffusePower,
+                .specularColor = pointLight->specularColor,
+                .specularPower = pointLight->specularPower,
+                .position = pointLight->position,
+                .attenuation = pointLight->attenuation,
+            };
+            break;
+        }
+        case LightTypeE::DIRECTIONAL: {
+            if (directionalLightCount >= static_cast<int>(std::size(directionalLights.directionalLights)))
+                break;
+
+            const DirectionalLight *directionalLight = static_cast<const DirectionalLight *>(light.get());
+            directionalLights.directionalLights[directionalLightCount++] =
+                RenderStateABC::DirectionalLightContainer::DirectionalLight{
+                    .diffuseColor = directionalLight->diffuseColor,
+                    .diffusePower = directionalLight->diffusePower,
+                    .specularColor = directionalLight->specularColor,
+                    .specularPower = directionalLight->specularPower,
+                    .direction = directionalLight->direction,
+                };
+            break;
+        }
+        }
+    }
+
+    pointLights.pointLightCount = pointLightCount;
+    directionalLights.directionalLightCount = directionalLightCount;
+}
+
+void SceneConstants::packProbes(const ProbeGrid &probeGrid, RenderStateABC::ProbeContainer &probes)
+{
+    probes.dimensions = probeGrid.getDimensions();
+    probes.extent = probeGrid.getExtent();
+    probes.cornerPosition = probeGrid.getCornerPosition();
+
+    const std::vector<std::unique_ptr<Probe>> &gridProbes = probeGrid.getProbes();
+    RenderStateABC::ProbeContainer::Probe *packedProbes = probes.getProbes();
+    for (size_t i = 0; i < gridProbes.size(); i++)
+    {
+        packedProbes[i] = RenderStateABC::ProbeContainer::Probe{
+            .position = gridProbes[i]->position,
+            .active = gridProbes[i]->active ? 1.f : 0.f,
+        };
+    }
+}
+
+void SceneConstants::packProbeBricks(const ProbeGrid &probeGrid, RenderStateABC::ProbeBrickContainer &bricks)
+{
+    bricks.brickSize = probeGrid.getBrickSize();
+    bricks.brickDimensions = probeGrid.getBrickDimensions();
+
+    const std::vector<int32_t> &brickProbeOffsets = probeGrid.getBrickProbeOffsets();
+    std::copy(brickProbeOffsets.begin(), brickProbeOffsets.end(), bricks.getBrickProbeOffsets());
+}
+
+VkBuffer SceneConstants::getHandle() const
+{
+    return m_buffer->getHandle();
+}
+
+VkBuffer SceneConstants::getProbeTableHandle() const
+{
+    return m_probeTable->getHandle();
+}
+
+std::unique_ptr<SceneConstants> SceneConstantsBuilder::build()
+{
+    assert(m_device.lock());
+    assert(m_product->m_frameInFlightCount > 0u);
+
+    const VkDeviceSize alignment =
+        m_device.lock()->getPhysicalDeviceProperties().limits.minStorageBufferOffsetAlignment;
+    auto alignUp = [alignment](VkDeviceSize size) { return (size + alignment - 1u) & ~(alignment - 1u); };
+
+    m_product->m_pointLightOffset = 0u;
+    m_product->m_directionalLightOffset = alignUp(sizeof(RenderStateABC::PointLightContainer));
+    m_product->m_stride =
+        m_product->m_directionalLightOffset + alignUp(sizeof(RenderStateABC::DirectionalLightContainer));
+
+    BufferBuilder bb;
+    BufferDirector bd;
+    bd.configureFrameRingBufferBuilder(bb);
+    bb.setSize(m_product->m_stride * m_product->m_frameInFlightCount);
+    bb.setDevice(m_device);
+    bb.setName(m_name);
+    m_product->m_buffer = bb.build();
+    if (!m_product->m_buffer)
+    {
+        std::cerr << "Failed to create scene constants buffer" << std::endl;
+        return nullptr;
+    }
+
+    m_product->m_mappedData = static_cast<uint8_t *>(m_product->m_buffer->getMappedData());
+
+    // the states may bind the probes before a grid is given
+    if (!m_product->reserveProbeTable(0u, 0u))
+        return nullptr;
+
+    // every copy starts out of date so that the first update writes it
+    m_product->m_version = 1u;
+    m_product->m_copyVersions.resize(m_product->m_frameInFlightCount, 0u);
+
+    auto result = std::move(m_product);
+    restart();
+    return result;
+}
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "render_state.hpp"
+
+class Device;
+class Buffer;
+class Light;
+class ProbeGrid;
+class SceneConstantsBuilder;
+
+/**
+ * @brief lights and probes of the scene shared by every render state
+ * the lights are packed once per frame, one copy per frame in flight lives in a single persistently mapped buffer
+ * a copy is only rewritten when the packed data differs from the one it holds
+ * the probes do not move once placed, their table is sized from the grid and written once
+ *
+ */
+class SceneConstants
+{
+    friend SceneConstantsBuilder;
+
+  public:
+    struct Block
+    {
+        RenderStateABC::PointLightContainer pointLights;
+        RenderStateABC::DirectionalLightContainer directionalLights;
+    };
+
+  private:
+    std::weak_ptr<Device> m_device;
+
+    std::unique_ptr<Buffer> m_buffer;
+    uint8_t *m_mappedData = nullptr;
+
+    uint32_t m_frameInFlightCount = 1u;
+    uint32_t m_frameIndex = 0u;
+
+    /**
+     * @brief offsets of the containers inside a copy, aligned for dynamic storage descriptors
+     *
+     */
+    VkDeviceSize m_pointLightOffset = 0u;
+    VkDeviceSize m_directionalLightOffset = 0u;
+    VkDeviceSize m_stride = 0u;
+
+    /**
+     * @brief probes followed by the brick lookup, aligned for storage descriptors
+     *
+     */
+    std::unique_ptr<Buffer> m_probeTable;
+    VkDeviceSize m_probeRange = 0u;
+    VkDeviceSize m_probeBrickOffset = 0u;
+    VkDeviceSize m_probeBrickRange = 0u;
+
+    Block m_block = {};
+    uint64_t m_version = 0u;
+    std::vector<uint64_t> m_copyVersions;
+    uint32_t m_uploadCount = 0u;
+
+    SceneConstants() = default;
+
+    /**
+     * @brief make room for the given counts, the current table is kept if it is large enough
+     *
+     */
+    bool reserveProbeTable(size_t probeCount, size_t brickCount);
+
+  public:
+    ~SceneConstants();
+
+    SceneConstants(const SceneConstants &) = delete;
+    SceneConstants &operator=(const SceneConstants &) = delete;
+    SceneConstants(SceneConstants &&) = delete;
+    SceneConstants &operator=(SceneConstants &&) = delete;
+
+    /**
+     * @brief move on to the copy of the given frame and pack the lights into it if they changed
+     * must be called once per frame, after waiting for the fences of the frame that used this copy last
+     *
+     * @param frameIndex back buffer index of the frame, the copy is reused along with the back buffer
+     */
+    void update(const std::vector<std::shared_ptr<Light>> &lights, uint32_t frameIndex);
+
+    /**
+     * @brief size the probe table for the grid and write it
+     * must be called before building the render states that bind the probes, the table is replaced if it is too small
+     *
+     */
+    bool setProbeGrid(const ProbeGrid &probeGrid);
+
+    static void packLights(const std::vector<std::shared_ptr<Light>> &lights,
+                           RenderStateABC::PointLightContainer &pointLights,
+                           RenderStateABC::DirectionalLightContainer &directionalLights);
+    /**
+     * @brief write the header and every probe of the grid, the container must hold ProbeContainer::getSize bytes
+     *
+     */
+    static void packProbes(const ProbeGrid &probeGrid, RenderStateABC::ProbeContainer &probes);
+    static void packProbeBricks(const ProbeGrid &probeGrid, RenderStateABC::ProbeBrickContainer &bricks);
+
+  public:
+    [[nodiscard]] VkBuffer getHandle() const;
+    [[nodiscard]] VkBuffer getProbeTableHandle() const;
+
+    [[nodiscard]] inline uint32_t getPointLightDynamicOffset() const
+    {
+        return static_cast<uint32_t>(m_frameIndex * m_stride + m_pointLightOffset);
+    }
+    [[nodiscard]] inline uint32_t getDirectionalLightDynamicOffset() const
+    {
+        return static_cast<uint32_t>(m_frameIndex * m_stride + m_directionalLightOffset);
+    }
+    [[nodiscard]] inline VkDeviceSize getProbeRange() const
+    {
+        return m_probeRange;
+    }
+    [[nodiscard]] inline VkDeviceSize getProbeBrickOffset() const
+    {
+        return m_probeBrickOffset;
+    }
+    [[nodiscard]] inline VkDeviceSize getProbeBrickRange() const
+    {
+        return m_probeBrickRange;
+    }
+
+    /**
+     * @brief number of copies written since the creation, stays still while the scene does not change
+     *
+     */
+    [[nodiscard]] inline uint32_t getUploadCount() const
+    {
+        return m_uploadCount;
+    }
+};
+
+class SceneConstantsBuilder
+{
+  private:
+    std::unique_ptr<SceneConstants> m_product;
+
+    std::weak_ptr<Device> m_device;
+
+    std::string m_name = "Scene Constants";
+
+    void restart()
+    {
+        m_product = std::unique_ptr<SceneConstants>(new SceneConstants);
+    }
+
+  public:
+    SceneConstantsBuilder()
+    {
+        restart();
+    }
+
+    void setDevice(std::weak_ptr<Device> device)
+    {
+        m_device = device;
+        m_product->m_device = device;
+    }
+    void setFrameInFlightCount(uint32_t a)
+    {
+        m_product->m_frameInFlightCount = a;
+    }
+    void setName(const std::string &name)
+    {
+        m_name = name;
+    }
+
+    std::unique_ptr<SceneConstants> build();
+};
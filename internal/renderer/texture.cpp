@@ -1,5 +1,11 @@
+#include <algorithm>
+#include <cassert>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 
+#include "engine/dds.hpp"
+
 #include "graphics/buffer.hpp"
 #include "graphics/device.hpp"
 #include "graphics/image.hpp"
@@ -24,10 +30,438 @@ Texture::~Texture()
     vkDestroyImageView(deviceHandle, m_imageView, nullptr);
 }
 
+// bytes per texel of the uncompressed formats that can be read back
+static VkDeviceSize getTexelSize(VkFormat format)
+{
+    switch (format)
+    {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+    case VK_FORMAT_R16G16_SFLOAT:
+        return 4u;
+    case VK_FORMAT_R16G16B16A16_SFLOAT:
+        return 8u;
+    case VK_FORMAT_R32G32B32A32_SFLOAT:
+        return 16u;
+    default:
+        return 0u;
+    }
+}
+
+// the whole image changes layout around a copy, every previous command is waited for
+static void transitionWholeImage(Image &image, uint32_t layerCount, VkImageLayout oldLayout, VkImageLayout newLayout)
+{
+    ImageLayoutTransitionBuilder iltb;
+    iltb.setOldLayout(oldLayout);
+    iltb.setNewLayout(newLayout);
+    iltb.setSrcAccessMask(VK_ACCESS_MEMORY_WRITE_BIT);
+    iltb.setDstAccessMask(VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT);
+    iltb.setSrcStageMask(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+    iltb.setDstStageMask(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+    iltb.setImage(image);
+    iltb.setLayerCount(layerCount);
+    image.transitionImageLayout(*iltb.buildAndRestart());
+}
+
+VkDeviceSize Texture::getPixelDataSize() const
+{
+    return (VkDeviceSize)m_width * m_height * m_layerCount * getTexelSize(m_image->getFormat());
+}
+
+// the block-compressed formats that can be uploaded, their block size is given by the DDS helpers
+static DXGIFormat getCompressedDXGIFormat(VkFormat format)
+{
+    switch (format)
+    {
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        return DXGIFormat::BC1_UNORM;
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        return DXGIFormat::BC1_UNORM_SRGB;
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+        return DXGIFormat::BC5_UNORM;
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+        return DXGIFormat::BC7_UNORM;
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+        return DXGIFormat::BC7_UNORM_SRGB;
+    default:
+        return DXGIFormat::UNKNOWN;
+    }
+}
+
+VkDeviceSize Texture::estimateResidentSize(uint32_t firstMipLevel) const
+{
+    const VkFormat format = m_image->getFormat();
+    const DXGIFormat compressedFormat = getCompressedDXGIFormat(format);
+    const bool bCompressed = getDXGIFormatBlockSize(compressedFormat) > 0u;
+
+    // an uncompressed image holds its first level only
+    const uint32_t lastMipLevel = bCompressed ? m_sourceMipLevels : firstMipLevel + 1u;
+
+    VkDeviceSize size = 0u;
+    for (uint32_t i = firstMipLevel; i < lastMipLevel; ++i)
+    {
+        const uint32_t levelWidth = std::max(m_sourceWidth >> i, 1u);
+        const uint32_t levelHeight = std::max(m_sourceHeight >> i, 1u);
+        if (bCompressed)
+            size += getDXGIFormatLevelSize(compressedFormat, levelWidth, levelHeight);
+        else
+            size += (VkDeviceSize)levelWidth * levelHeight * getTexelSize(format);
+    }
+    return size * m_layerCount;
+}
+
+void Texture::swapResidentImage(Texture &other)
+{
+    assert(m_sourceFilename == other.m_sourceFilename);
+
+    std::swap(m_image, other.m_image);
+    std::swap(m_imageView, other.m_imageView);
+    std::swap(m_sampler, other.m_sampler);
+    std::swap(m_width, other.m_width);
+    std::swap(m_height, other.m_height);
+    std::swap(m_firstMipLevel, other.m_firstMipLevel);
+    m_imageGeneration++;
+}
+
+// halve an RGBA8 image with a box filter, the last row or column of an odd dimension is dropped
+static void downsampleRGBA8(std::vector<unsigned char> &pixels, uint32_t &width, uint32_t &height)
+{
+    const uint32_t halfWidth = std::max(width / 2u, 1u);
+    const uint32_t halfHeight = std::max(height / 2u, 1u);
+    const uint32_t stepX = width > 1u ? 2u : 1u;
+    const uint32_t stepY = height > 1u ? 2u : 1u;
+
+    std::vector<unsigned char> halved((size_t)halfWidth * halfHeight * 4u);
+    for (uint32_t y = 0u; y < halfHeight; ++y)
+    {
+        for (uint32_t x = 0u; x < halfWidth; ++x)
+        {
+            const size_t x0 = (size_t)x * stepX;
+            const size_t y0 = (size_t)y * stepY;
+            const size_t x1 = x0 + stepX - 1u;
+            const size_t y1 = y0 + stepY - 1u;
+            for (uint32_t c = 0u; c < 4u; ++c)
+            {
+                const uint32_t sum = pixels[(y0 * width + x0) * 4u + c] + pixels[(y0 * width + x1) * 4u + c] +
+                                     pixels[(y1 * width + x0) * 4u + c] + pixels[(y1 * width + x1) * 4u + c];
+                halved[((size_t)y * halfWidth + x) * 4u + c] = static_cast<unsigned char>((sum + 2u) / 4u);
+            }
+        }
+    }
+
+    pixels = std::move(halved);
+    width = halfWidth;
+    height = halfHeight;
+}
+
+static uint32_t calculateMipLevelCount(uint32_t width, uint32_t height)
+{
+    uint32_t levelCount = 1u;
+    while (std::max(width, height) >> levelCount)
+        levelCount++;
+    return levelCount;
+}
+
+uint32_t TextureBuilder::resolveFirstMipLevel(uint32_t sourceWidth, uint32_t sourceHeight,
+                                              uint32_t sourceMipLevels) const
+{
+    uint32_t level = m_firstMipLevel;
+    if (m_maxExtent > 0u)
+    {
+        while ((std::max(sourceWidth, sourceHeight) >> level) > m_maxExtent)
+            level++;
+    }
+    return std::min(level, sourceMipLevels - 1u);
+}
+
+std::vector<unsigned char> Texture::readPixels() const
+{
+    const VkDeviceSize size = getPixelDataSize();
+    if (size == 0u)
+        return {};
+
+    BufferBuilder bb;
+    BufferDirector bd;
+    bd.configureReadbackBufferBuilder(bb);
+    bb.setDevice(m_device);
+    bb.setSize(size);
+    bb.setName(m_name + " Readback Buffer");
+    std::unique_ptr<Buffer> readbackBuffer = bb.build();
+
+    transitionWholeImage(*m_image, m_layerCount, getShaderReadLayout(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+    m_image->copyImageToBuffer(readbackBuffer->getHandle(), m_layerCount);
+    transitionWholeImage(*m_image, m_layerCount, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, getShaderReadLayout());
+
+    std::vector<unsigned char> pixels(size);
+    readbackBuffer->copyMemoryToData(pixels.data());
+    return pixels;
+}
+
+bool Texture::writePixels(const std::vector<unsigned char> &pixels)
+{
+    const VkDeviceSize size = getPixelDataSize();
+    if (size == 0u || pixels.size() != size)
+        return false;
+
+    BufferBuilder bb;
+    BufferDirector bd;
+    bd.configureStagingBufferBuilder(bb);
+    bb.setDevice(m_device);
+    bb.setSize(size);
+    bb.setName(m_name + " Staging Buffer");
+    std::unique_ptr<Buffer> stagingBuffer = bb.build();
+
+    stagingBuffer->copyDataToMemory(pixels.data());
+
+    transitionWholeImage(*m_image, m_layerCount, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    if (m_layerCount == 6u)
+        m_image->copyBufferToImageCube(stagingBuffer->getHandle());
+    else
+        m_image->copyBufferToImage2D(stagingBuffer->getHandle());
+    transitionWholeImage(*m_image, m_layerCount, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, getShaderReadLayout());
+
+    return true;
+}
+
+static VkFormat getCompressedVkFormat(DXGIFormat format)
+{
+    switch (format)
+    {
+    case DXGIFormat::BC1_UNORM:
+        return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+    case DXGIFormat::BC1_UNORM_SRGB:
+        return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+    case DXGIFormat::BC5_UNORM:
+        return VK_FORMAT_BC5_UNORM_BLOCK;
+    case DXGIFormat::BC7_UNORM:
+        return VK_FORMAT_BC7_UNORM_BLOCK;
+    case DXGIFormat::BC7_UNORM_SRGB:
+        return VK_FORMAT_BC7_SRGB_BLOCK;
+    default:
+        return VK_FORMAT_UNDEFINED;
+    }
+}
+
+std::unique_ptr<Texture> TextureBuilder::buildCompressedAndRestart()
+{
+    auto devicePtr = m_device.lock();
+
+    std::ifstream file(m_textureFilename, std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr << "Failed to open compressed texture : " << m_textureFilename << std::endl;
+        restart();
+        return nullptr;
+    }
+
+    uint32_t magic;
+    DDSHeader header;
+    file.read(reinterpret_cast<char *>(&magic), sizeof(magic));
+    file.read(reinterpret_cast<char *>(&header), sizeof(header));
+    if (!file || magic != DDS_MAGIC || header.size != sizeof(DDSHeader) ||
+        !(header.pixelFormat.flags & DDPF_FOURCC))
+    {
+        std::cerr << "Failed to read compressed texture header : " << m_textureFilename << std::endl;
+        restart();
+        return nullptr;
+    }
+
+    DXGIFormat dxgiFormat = DXGIFormat::UNKNOWN;
+    if (header.pixelFormat.fourCC == makeFourCC('D', 'X', '1', '0'))
+    {
+        DDSHeaderDXT10 headerDXT10;
+        file.read(reinterpret_cast<char *>(&headerDXT10), sizeof(headerDXT10));
+        if (!file)
+        {
+            std::cerr << "Failed to read compressed texture DX10 header : " << m_textureFilename << std::endl;
+            restart();
+            return nullptr;
+        }
+        if (headerDXT10.resourceDimension == DDS_DIMENSION_TEXTURE2D && headerDXT10.arraySize == 1)
+            dxgiFormat = headerDXT10.dxgiFormat;
+    }
+    else if (header.pixelFormat.fourCC == makeFourCC('D', 'X', 'T', '1'))
+    {
+        dxgiFormat = DXGIFormat::BC1_UNORM;
+    }
+    else if (header.pixelFormat.fourCC == makeFourCC('A', 'T', 'I', '2') ||
+             header.pixelFormat.fourCC == makeFourCC('B', 'C', '5', 'U'))
+    {
+        dxgiFormat = DXGIFormat::BC5_UNORM;
+    }
+
+    const VkFormat format = getCompressedVkFormat(dxgiFormat);
+    if (format == VK_FORMAT_UNDEFINED)
+    {
+        std::cerr << "Unsupported compressed texture format : " << m_textureFilename << std::endl;
+        restart();
+        return nullptr;
+    }
+
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(devicePtr->getPhysicalHandle(), format, &formatProperties);
+    if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT))
+    {
+        std::cerr << "Compressed texture format is not supported by the device : " << format << std::endl;
+        restart();
+        return nullptr;
+    }
+
+    // a bogus level count would create an image with more levels than its extent allows
+    if (header.width == 0 || header.height == 0 ||
+        header.mipMapCount > calculateMipLevelCount(header.width, header.height))
+    {
+        std::cerr << "Invalid compressed texture extent or mip count : " << m_textureFilename << std::endl;
+        restart();
+        return nullptr;
+    }
+
+    const uint32_t sourceMipLevels = std::max(header.mipMapCount, 1U);
+    const uint32_t firstMipLevel = resolveFirstMipLevel(header.width, header.height, sourceMipLevels);
+    const uint32_t mipLevels = sourceMipLevels - firstMipLevel;
+    m_product->m_width = std::max(header.width >> firstMipLevel, 1U);
+    m_product->m_height = std::max(header.height >> firstMipLevel, 1U);
+
+    // the levels finer than the first one are not read
+    VkDeviceSize skippedSize = 0;
+    for (uint32_t i = 0; i < firstMipLevel; ++i)
+        skippedSize += getDXGIFormatLevelSize(dxgiFormat, std::max(header.width >> i, 1U),
+                                              std::max(header.height >> i, 1U));
+    file.seekg(skippedSize, std::ios::cur);
+
+    // one copy region per mip level, tightly packed one after the other as in the container
+
+    std::vector<VkBufferImageCopy> regions(mipLevels);
+    VkDeviceSize imageSize = 0;
+    for (uint32_t i = 0; i < mipLevels; ++i)
+    {
+        const uint32_t levelWidth = std::max(header.width >> (firstMipLevel + i), 1U);
+        const uint32_t levelHeight = std::max(header.height >> (firstMipLevel + i), 1U);
+
+        regions[i] = VkBufferImageCopy{
+            .bufferOffset = imageSize,
+            .bufferRowLength = 0,
+            .bufferImageHeight = 0,
+            .imageSubresource =
+                {
+                    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                    .mipLevel = i,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1,
+                },
+            .imageOffset = {0, 0, 0},
+            .imageExtent =
+                {
+                    .width = levelWidth,
+                    .height = levelHeight,
+                    .depth = 1,
+                },
+        };
+
+        imageSize += getDXGIFormatLevelSize(dxgiFormat, levelWidth, levelHeight);
+    }
+
+    m_product->m_imageData.resize(imageSize);
+    file.read(reinterpret_cast<char *>(m_product->m_imageData.data()), imageSize);
+    if (!file)
+    {
+        std::cerr << "Compressed texture is truncated : " << m_textureFilename << std::endl;
+        restart();
+        return nullptr;
+    }
+
+    const VkDeviceSize allocatedBytesBefore = devicePtr->calculateAllocatedBytes();
+
+    ImageBuilder ib;
+    ImageDirector id;
+    id.configureSampledImage2DBuilder(ib);
+    ib.setDevice(m_device);
+    ib.setFormat(format);
+    ib.setWidth(m_product->m_width);
+    ib.setHeight(m_product->m_height);
+    ib.setMipLevels(mipLevels);
+    ib.setTiling(m_tiling);
+    ib.setName(m_textureFilename + m_product->m_name + " Compressed Texture");
+    m_product->m_image = ib.build();
+    if (!m_product->m_image)
+    {
+        restart();
+        return nullptr;
+    }
+
+    BufferBuilder bb;
+    BufferDirector bd;
+    bd.configureStagingBufferBuilder(bb);
+    bb.setDevice(m_device);
+    bb.setSize(imageSize);
+    bb.setName("Compressed Texture Staging Buffer");
+    std::unique_ptr<Buffer> stagingBuffer = bb.build();
+
+    stagingBuffer->copyDataToMemory(m_product->m_imageData.data());
+
+    ImageLayoutTransitionBuilder iltb;
+    ImageLayoutTransitionDirector iltd;
+
+    iltd.configureBuilder<VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL>(iltb);
+    iltb.setImage(*m_product->m_image);
+    iltb.setLevelCount(mipLevels);
+    m_product->m_image->transitionImageLayout(*iltb.buildAndRestart());
+
+    m_product->m_image->copyBufferToImageRegions(stagingBuffer->getHandle(), regions);
+
+    iltd.configureBuilder<VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL>(iltb);
+    iltb.setImage(*m_product->m_image);
+    iltb.setLevelCount(mipLevels);
+    m_product->m_image->transitionImageLayout(*iltb.buildAndRestart());
+
+    stagingBuffer.reset();
+
+    // the blocks now live on the GPU only
+    m_product->m_imageData.clear();
+    m_product->m_imageData.shrink_to_fit();
+
+    if (m_streamingEnable)
+    {
+        m_product->m_sourceFilename = m_textureFilename;
+        m_product->m_sourceWidth = header.width;
+        m_product->m_sourceHeight = header.height;
+        m_product->m_sourceMipLevels = sourceMipLevels;
+        m_product->m_firstMipLevel = firstMipLevel;
+    }
+
+    const VkDeviceSize allocatedBytesAfter = devicePtr->calculateAllocatedBytes();
+    std::cout << "Creating compressed texture " << m_product->m_name << " : " << m_product->m_width << "x"
+              << m_product->m_height << ", " << mipLevels << " mips, " << m_product->m_image->getAllocationSize()
+              << " bytes (RGBA8 : " << (VkDeviceSize)m_product->m_width * m_product->m_height * 4
+              << " bytes), VMA allocated bytes " << allocatedBytesBefore << " -> " << allocatedBytesAfter
+              << std::endl;
+
+    // image view
+
+    m_product->m_imageView = m_product->m_image->createImageView2D();
+
+    // sampler
+
+    SamplerBuilder sb;
+    sb.setDevice(m_device);
+    sb.setMagFilter(m_samplerFilter);
+    sb.setMinFilter(m_samplerFilter);
+    sb.setAddressModeXYZ(VK_SAMPLER_ADDRESS_MODE_REPEAT);
+    sb.setMaxLod((float)mipLevels);
+    m_product->m_sampler = sb.build();
+
+    auto result = std::move(m_product);
+    restart();
+    return result;
+}
+
 std::unique_ptr<Texture> TextureBuilder::buildAndRestart()
 {
     assert(m_device.lock());
 
+    if (m_bLoadFromFile && std::filesystem::path(m_textureFilename).extension() == ".dds")
+        return buildCompressedAndRestart();
+
     size_t imageSize = m_product->m_width * m_product->m_height * 4;
 
     if (m_bLoadFromFile)
@@ -40,6 +474,7 @@ std::unique_ptr<Texture> TextureBuilder::buildAndRestart()
         if (!textureData)
         {
             std::cerr << "Failed to load texture : " << m_textureFilename << std::endl;
+            restart();
             return nullptr;
         }
         m_product->m_width = texWidth;
@@ -50,21 +485,45 @@ std::unique_ptr<Texture> TextureBuilder::buildAndRestart()
         memcpy(m_product->m_imageData.data(), textureData, imageSize);
 
         stbi_image_free(textureData);
+
+        // the file has no mip chain, the coarser levels are downsampled from the first one
+        const uint32_t sourceMipLevels = calculateMipLevelCount(texWidth, texHeight);
+        const uint32_t firstMipLevel = resolveFirstMipLevel(texWidth, texHeight, sourceMipLevels);
+        for (uint32_t i = 0u; i < firstMipLevel; ++i)
+            downsampleRGBA8(m_product->m_imageData, m_product->m_width, m_product->m_height);
+        imageSize = m_product->m_imageData.size();
+
+        if (m_streamingEnable)
+        {
+            m_product->m_sourceFilename = m_textureFilename;
+            m_product->m_sourceWidth = texWidth;
+            m_product->m_sourceHeight = texHeight;
+            m_product->m_sourceMipLevels = sourceMipLevels;
+            m_product->m_firstMipLevel = firstMipLevel;
+        }
     }
 
-    BufferBuilder bb;
-    BufferDirector bd;
-    bd.configureStagingBufferBuilder(bb);
-    bb.setDevice(m_device);
-    bb.setSize(imageSize);
-    bb.setName("Texture Staging Buffer");
-    std::unique_ptr<Buffer> stagingBuffer = bb.build();
+    // a storage texture is written by the device, nothing to upload
+    std::unique_ptr<Buffer> stagingBuffer;
+    if (!m_storageEnable)
+    {
+        BufferBuilder bb;
+        BufferDirector bd;
+        bd.configureStagingBufferBuilder(bb);
+        bb.setDevice(m_device);
+        bb.setSize(imageSize);
+        bb.setName("Texture Staging Buffer");
+        stagingBuffer = bb.build();
 
-    stagingBuffer->copyDataToMemory(m_product->m_imageData.data());
+        stagingBuffer->copyDataToMemory(m_product->m_imageData.data());
+    }
 
     ImageBuilder ib;
     ImageDirector id;
-    id.configureSampledImage2DBuilder(ib);
+    if (m_storageEnable)
+        id.configureStorageImage2DBuilder(ib);
+    else
+        id.configureSampledImage2DBuilder(ib);
     ib.setDevice(m_device);
     ib.setFormat(m_format);
     ib.setWidth(m_product->m_width);
@@ -82,15 +541,25 @@ std::unique_ptr<Texture> TextureBuilder::buildAndRestart()
     ImageLayoutTransitionBuilder iltb;
     ImageLayoutTransitionDirector iltd;
 
-    iltd.configureBuilder<VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL>(iltb);
-    iltb.setImage(*m_product->m_image);
-    m_product->m_image->transitionImageLayout(*iltb.buildAndRestart());
+    if (m_storageEnable)
+    {
+        iltd.configureBuilder<VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL>(iltb);
+        iltb.setImage(*m_product->m_image);
+        m_product->m_image->transitionImageLayout(*iltb.buildAndRestart());
+    }
+    else
+    {
+        iltd.configureBuilder<VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL>(iltb);
+        iltb.setImage(*m_product->m_image);
+        m_product->m_image->transitionImageLayout(*iltb.buildAndRestart());
 
-    m_product->m_image->copyBufferToImage2D(stagingBuffer->getHandle());
+        m_product->m_image->copyBufferToImage2D(stagingBuffer->getHandle());
 
-    iltd.configureBuilder<VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL>(iltb);
-    iltb.setImage(*m_product->m_image);
-    m_product->m_image->transitionImageLayout(*iltb.buildAndRestart());
+        iltd.configureBuilder<VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL>(iltb);
+        iltb.setImage(*m_product->m_image);
+        m_product->m_image->transitionImageLayout(*iltb.buildAndRestart());
+    }
+    m_product->m_storage = m_storageEnable;
 
     // image view
 
@@ -146,6 +615,8 @@ std::unique_ptr<Texture> CubemapBuilder::buildAndRestart()
 {
     assert(m_device.lock());
 
+    m_product->m_layerCount = 6u;
+
     std::array<std::string, 6> filepath = {m_rightTextureFilename,  m_leftTextureFilename,  m_topTextureFilename,
                                            m_bottomTextureFilename, m_frontTextureFilename, m_backTextureFilename};
 
@@ -351,4 +822,13 @@ void TextureDirector::configureUNORMTextureBuilder(CubemapBuilder &builder)
     builder.setFormat(VK_FORMAT_R8G8B8A8_UNORM);
     builder.setTiling(VK_IMAGE_TILING_OPTIMAL);
     builder.setSamplerFilter(VK_FILTER_NEAREST);
+}
+
+void TextureDirector::configureCompressedTextureBuilder(TextureBuilder &builder)
+{
+    // the format is read from the container
+    builder.setFormat(VK_FORMAT_UNDEFINED);
+    builder.setTiling(VK_IMAGE_TILING_OPTIMAL);
+    // the container holds the whole mip chain
+    builder.setSamplerFilter(VK_FILTER_LINEAR);
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <optional>
 #include <vulkan/vulkan.h>
 
@@ -8,11 +9,13 @@
 class Device;
 class TextureBuilder;
 class CubemapBuilder;
+class TextureStreamer;
 
 class Texture
 {
     friend TextureBuilder;
     friend CubemapBuilder;
+    friend TextureStreamer;
 
   private:
     std::weak_ptr<Device> m_device;
@@ -21,6 +24,11 @@ class Texture
 
     uint32_t m_width;
     uint32_t m_height;
+    /**
+     * @brief 6 for a cubemap
+     *
+     */
+    uint32_t m_layerCount = 1u;
 
     std::unique_ptr<Image> m_image;
     VkImageView m_imageView;
@@ -31,8 +39,45 @@ class Texture
 
     std::vector<unsigned char> m_imageData;
 
+    /**
+     * @brief written by the device through a storage image, stays in the general layout
+     *
+     */
+    bool m_storage = false;
+
+    /**
+     * @brief file the texture is streamed from, empty if the texture is not streamed
+     *
+     */
+    std::string m_sourceFilename;
+    uint32_t m_sourceWidth = 0u;
+    uint32_t m_sourceHeight = 0u;
+    /**
+     * @brief levels of the whole chain, the levels of an image that has none in its file are downsampled on load
+     *
+     */
+    uint32_t m_sourceMipLevels = 1u;
+    /**
+     * @brief level of the source held by the first mip level of the image, the finer ones are not resident
+     *
+     */
+    uint32_t m_firstMipLevel = 0u;
+    /**
+     * @brief incremented every time the image is replaced, the descriptor sets written with a previous generation are
+     * written again
+     *
+     */
+    uint32_t m_imageGeneration = 0u;
+
     Texture() = default;
 
+    /**
+     * @brief exchange the image of the texture with the one of another texture streamed from the same file
+     * the other texture keeps the previous image until it is destroyed
+     *
+     */
+    void swapResidentImage(Texture &other);
+
   public:
     ~Texture();
 
@@ -41,6 +86,22 @@ class Texture
     Texture(Texture &&) = delete;
     Texture &operator=(Texture &&) = delete;
 
+    /**
+     * @brief copy the first mip level of every layer back from the device
+     * the image must be in its shader read layout and stays in it
+     *
+     * @return std::vector<unsigned char> empty if the format is not supported
+     */
+    [[nodiscard]] std::vector<unsigned char> readPixels() const;
+    /**
+     * @brief replace the first mip level of every layer, the previous content is discarded
+     * the image is left in its shader read layout
+     *
+     * @param pixels as returned by readPixels()
+     * @return false if the size does not match the texture
+     */
+    bool writePixels(const std::vector<unsigned char> &pixels);
+
   public:
     [[nodiscard]] inline const VkSampler *getSampler() const
     {
@@ -54,6 +115,10 @@ class Texture
     {
         return m_depthImageView;
     }
+    [[nodiscard]] inline VkImage getImageHandle() const
+    {
+        return m_image->getHandle();
+    }
     [[nodiscard]] inline VkFormat getImageFormat() const
     {
         return m_image->getFormat();
@@ -65,6 +130,14 @@ class Texture
 
         return std::nullopt;
     }
+    [[nodiscard]] inline uint32_t getMipLevels() const
+    {
+        return m_image->getMipLevels();
+    }
+    [[nodiscard]] inline VkDeviceSize getImageMemorySize() const
+    {
+        return m_image->getAllocationSize();
+    }
     [[nodiscard]] inline const uint32_t &getWidth() const
     {
         return m_width;
@@ -78,6 +151,61 @@ class Texture
     {
         return m_name;
     }
+    [[nodiscard]] inline uint32_t getLayerCount() const
+    {
+        return m_layerCount;
+    }
+    /**
+     * @brief bytes of the first mip level of every layer, 0 if the format is not supported
+     *
+     */
+    [[nodiscard]] VkDeviceSize getPixelDataSize() const;
+    [[nodiscard]] inline bool isStorage() const
+    {
+        return m_storage;
+    }
+    /**
+     * @brief layout of the image when it is sampled by a shader
+     *
+     */
+    [[nodiscard]] inline VkImageLayout getShaderReadLayout() const
+    {
+        return m_storage ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    }
+    [[nodiscard]] inline bool isStreamed() const
+    {
+        return !m_sourceFilename.empty();
+    }
+    [[nodiscard]] inline const std::string &getSourceFilename() const
+    {
+        return m_sourceFilename;
+    }
+    [[nodiscard]] inline uint32_t getSourceMipLevels() const
+    {
+        return m_sourceMipLevels;
+    }
+    [[nodiscard]] inline uint32_t getFirstMipLevel() const
+    {
+        return m_firstMipLevel;
+    }
+    [[nodiscard]] inline uint32_t getImageGeneration() const
+    {
+        return m_imageGeneration;
+    }
+    /**
+     * @brief largest dimension of the first level of the source
+     *
+     */
+    [[nodiscard]] inline uint32_t getSourceExtent() const
+    {
+        return std::max(m_sourceWidth, m_sourceHeight);
+    }
+    /**
+     * @brief bytes of an image holding the levels of the source from the given one, without the alignment of the
+     * allocation
+     *
+     */
+    [[nodiscard]] VkDeviceSize estimateResidentSize(uint32_t firstMipLevel) const;
 };
 
 class TextureBuilder
@@ -95,12 +223,31 @@ class TextureBuilder
     std::string m_textureFilename;
     bool m_bLoadFromFile = false;
     bool m_depthImageEnable = false;
+    bool m_storageEnable = false;
+    bool m_streamingEnable = false;
+    uint32_t m_firstMipLevel = 0u;
+    uint32_t m_maxExtent = 0u;
 
     void restart()
     {
         m_product = std::unique_ptr<Texture>(new Texture);
     }
 
+    /**
+     * @brief first level of the source to upload, the finest one that honors both the first level and the largest
+     * extent that have been set
+     *
+     */
+    [[nodiscard]] uint32_t resolveFirstMipLevel(uint32_t sourceWidth, uint32_t sourceHeight,
+                                                uint32_t sourceMipLevels) const;
+
+    /**
+     * @brief upload a pre-compressed DDS container (BC1/BC5/BC7 with mips) as is
+     * no CPU decode is done, the blocks are copied to the staging buffer directly
+     *
+     */
+    std::unique_ptr<Texture> buildCompressedAndRestart();
+
   public:
     TextureBuilder()
     {
@@ -128,6 +275,12 @@ class TextureBuilder
         m_bLoadFromFile = false;
     }
 
+    /**
+     * @brief set the file to load the texture from
+     * a .dds file is uploaded as a pre-compressed texture, its format overrides the one given by setFormat()
+     *
+     * @param filename
+     */
     void setTextureFilename(const std::string &filename)
     {
         m_textureFilename = filename;
@@ -154,10 +307,42 @@ class TextureBuilder
     {
         m_depthImageEnable = enable;
     }
+    /**
+     * @brief the texture is filled by a compute shader instead of image data
+     *
+     */
+    void setStorageEnable(bool enable)
+    {
+        m_storageEnable = enable;
+    }
     void setName(std::string name)
     {
         m_product->m_name = name;
     }
+    /**
+     * @brief the texture keeps its file so that the texture streamer can load it again at another resolution
+     *
+     */
+    void setStreamingEnable(bool enable)
+    {
+        m_streamingEnable = enable;
+    }
+    /**
+     * @brief skip the finest levels of the file, the level is clamped to the coarsest one
+     *
+     */
+    void setFirstMipLevel(uint32_t level)
+    {
+        m_firstMipLevel = level;
+    }
+    /**
+     * @brief skip the levels of the file larger than the extent in any dimension, 0 for no limit
+     *
+     */
+    void setMaxExtent(uint32_t extent)
+    {
+        m_maxExtent = extent;
+    }
 
     std::unique_ptr<Texture> buildAndRestart();
 };
@@ -301,4 +486,5 @@ class TextureDirector
     void configureSRGBTextureBuilder(CubemapBuilder &builder);
     void configureUNORMTextureBuilder(TextureBuilder &builder);
     void configureUNORMTextureBuilder(CubemapBuilder &builder);
+    void configureCompressedTextureBuilder(TextureBuilder &builder);
 };
\ No newline at end of file
@@ -0,0 +1,256 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <filesystem>
+#include <iostream>
+#include <limits>
+
+#include <tracy/Tracy.hpp>
+
+#include "engine/camera.hpp"
+
+#include "graphics/device.hpp"
+
+#include "mesh.hpp"
+#include "model.hpp"
+#include "texture.hpp"
+
+#include "texture_streamer.hpp"
+
+TextureStreamer::ViewT TextureStreamer::makeView(const CameraABC &camera, float viewportHeight)
+{
+    const glm::mat4 projection = camera.getProjectionMatrix();
+    return ViewT{
+        .position = camera.getTransform().position,
+        .projectionScale = std::abs(projection[1][1]),
+        .viewportHeight = viewportHeight,
+        .perspective = projection[3][3] == 0.f,
+    };
+}
+
+bool TextureStreamer::load(Texture &texture, uint32_t firstMipLevel)
+{
+    // configured as the model builder does when it first loads the texture
+    TextureBuilder textureBuilder;
+    TextureDirector textureDirector;
+    if (std::filesystem::path(texture.getSourceFilename()).extension() == ".dds")
+    {
+        textureDirector.configureCompressedTextureBuilder(textureBuilder);
+    }
+    else
+    {
+        textureDirector.configureSRGBTextureBuilder(textureBuilder);
+        textureBuilder.setFormat(texture.getImageFormat());
+    }
+    textureBuilder.setDevice(m_device);
+    textureBuilder.setTextureFilename(texture.getSourceFilename());
+    textureBuilder.setName(texture.getName());
+    textureBuilder.setStreamingEnable(true);
+    textureBuilder.setFirstMipLevel(firstMipLevel);
+
+    std::unique_ptr<Texture> streamed = textureBuilder.buildAndRestart();
+    if (!streamed)
+    {
+        std::cerr << "Failed to stream texture : " << texture.getSourceFilename() << std::endl;
+        return false;
+    }
+
+    texture.swapResidentImage(*streamed);
+
+    // the frames in flight may still sample the previous image
+    m_retiredImages.push_back(RetiredImage{
+        .texture = std::move(streamed),
+        .remainingUpdateCount = m_frameInFlightCount + 1u,
+    });
+    m_statistics.loadCount++;
+    return true;
+}
+
+void TextureStreamer::update(const std::vector<std::shared_ptr<Model>> &objects, std::span<const ViewT> views)
+{
+    ZoneScoped;
+
+    auto devicePtr = m_device.lock();
+    assert(devicePtr);
+
+    VkDeviceSize retiredBytes = 0u;
+    for (auto it = m_retiredImages.begin(); it != m_retiredImages.end();)
+    {
+        if (--it->remainingUpdateCount == 0u)
+        {
+            it = m_retiredImages.erase(it);
+            continue;
+        }
+
+        retiredBytes += it->texture->getImageMemorySize();
+        ++it;
+    }
+
+    // usage of the textures seen from the views
+
+    for (auto &[texture, streamed] : m_textures)
+    {
+        streamed.priority = 0.f;
+        streamed.visible = false;
+    }
+
+    for (const std::shared_ptr<Model> &object : objects)
+    {
+        const glm::mat4 world = object->getWorldMatrix();
+        const float scale = std::max({glm::length(glm::vec3(world[0])), glm::length(glm::vec3(world[1])),
+                                      glm::length(glm::vec3(world[2]))});
+
+        for (const std::shared_ptr<Mesh> &mesh : object->getMeshes())
+        {
+            const std::shared_ptr<Texture> texture = mesh->getTexture().lock();
+            if (!texture || !texture->isStreamed())
+                continue;
+
+            // a destroyed texture may have left its address to this one
+            StreamedTexture &streamed = m_textures[texture.get()];
+            if (streamed.texture.expired())
+                streamed = StreamedTexture{.texture = texture};
+
+            const glm::vec3 center = glm::vec3(world * glm::vec4(mesh->getBoundingCenter(), 1.f));
+            const float radius = mesh->getBoundingRadius() * scale;
+            for (const ViewT &view : views)
+            {
+                // pixels covered by the diameter of the bounding sphere
+                float pixels = radius * view.projectionScale * view.viewportHeight;
+                if (view.perspective)
+                    pixels /= std::max(glm::length(center - view.position) - radius, s_minDistance);
+
+                streamed.priority = std::max(streamed.priority, pixels / texture->getSourceExtent());
+            }
+            streamed.visible = true;
+        }
+    }
+
+    // levels needed, the textures that are not seen only keep their finer levels if the budget allows it
+
+    m_upgrades.clear();
+    m_reductions.clear();
+
+    VkDeviceSize residentBytes = 0u;
+    VkDeviceSize requestedBytes = 0u;
+    uint32_t visibleTextureCount = 0u;
+    for (auto it = m_textures.begin(); it != m_textures.end();)
+    {
+        const std::shared_ptr<Texture> texture = it->second.texture.lock();
+        if (!texture)
+        {
+            it = m_textures.erase(it);
+            continue;
+        }
+
+        StreamedTexture &streamed = it->second;
+
+        // a texel of the requested level covers about a pixel
+        const uint32_t coarsestMipLevel = texture->getSourceMipLevels() - 1u;
+        streamed.requestedMipLevel = coarsestMipLevel;
+        if (streamed.priority > 0.f)
+        {
+            const float level = std::max(std::floor(-std::log2(streamed.priority)), 0.f);
+            streamed.requestedMipLevel = std::min(static_cast<uint32_t>(level), coarsestMipLevel);
+        }
+
+        residentBytes += texture->getImageMemorySize();
+        if (streamed.visible)
+        {
+            requestedBytes += texture->estimateResidentSize(streamed.requestedMipLevel);
+            visibleTextureCount++;
+        }
+
+        if (streamed.requestedMipLevel < texture->getFirstMipLevel())
+            m_upgrades.push_back(&streamed);
+        else if (streamed.requestedMipLevel > texture->getFirstMipLevel())
+            m_reductions.push_back(&streamed);
+
+        ++it;
+    }
+
+    std::sort(m_upgrades.begin(), m_upgrades.end(),
+              [](const StreamedTexture *a, const StreamedTexture *b) { return a->priority > b->priority; });
+    std::sort(m_reductions.begin(), m_reductions.end(),
+              [](const StreamedTexture *a, const StreamedTexture *b) { return a->priority < b->priority; });
+
+    // the textures may grow into the free part of the device local heaps, and are reduced if the heaps are over
+    // budget, the retired images are about to be released
+
+    const Device::MemoryBudgetT heap = devicePtr->calculateDeviceLocalBudget();
+    const VkDeviceSize heapLimit = static_cast<VkDeviceSize>(heap.budget * m_heapBudgetRatio);
+    const VkDeviceSize heapUsage = heap.usage - std::min(heap.usage, retiredBytes);
+
+    VkDeviceSize budget = m_budget;
+    if (heapUsage <= heapLimit)
+        budget = std::min(budget, residentBytes + (heapLimit - heapUsage));
+    else
+        budget = std::min(budget, residentBytes - std::min(residentBytes, heapUsage - heapLimit));
+
+    uint32_t loadCount = 0u;
+    size_t reductionIndex = 0u;
+
+    // reduce the least needed textures, less needed than the given priority, until the resident bytes meet the target
+    auto reduceUntil = [&](VkDeviceSize target, float maxPriority) {
+        while (residentBytes > target && reductionIndex < m_reductions.size() && loadCount < m_maxLoadsPerUpdate)
+        {
+            const StreamedTexture &streamed = *m_reductions[reductionIndex];
+            if (streamed.priority >= maxPriority)
+                return;
+            reductionIndex++;
+
+            const std::shared_ptr<Texture> texture = streamed.texture.lock();
+            const VkDeviceSize previousBytes = texture->getImageMemorySize();
+            if (!load(*texture, streamed.requestedMipLevel))
+                continue;
+
+            residentBytes = residentBytes - previousBytes + texture->getImageMemorySize();
+            loadCount++;
+            m_statistics.evictionCount++;
+        }
+    };
+
+    for (const StreamedTexture *upgrade : m_upgrades)
+    {
+        if (loadCount >= m_maxLoadsPerUpdate)
+            break;
+
+        const std::shared_ptr<Texture> texture = upgrade->texture.lock();
+        const VkDeviceSize previousBytes = texture->getImageMemorySize();
+        const VkDeviceSize upgradedBytes = texture->estimateResidentSize(upgrade->requestedMipLevel);
+        const VkDeviceSize grownBytes = upgradedBytes - std::min(upgradedBytes, previousBytes);
+        if (grownBytes > budget)
+            continue;
+
+        reduceUntil(budget - grownBytes, upgrade->priority);
+
+        // a less needed texture may still fit
+        if (residentBytes + grownBytes > budget || loadCount >= m_maxLoadsPerUpdate)
+            continue;
+
+        if (!load(*texture, upgrade->requestedMipLevel))
+            continue;
+
+        residentBytes = residentBytes - previousBytes + texture->getImageMemorySize();
+        loadCount++;
+    }
+
+    reduceUntil(budget, std::numeric_limits<float>::max());
+
+    m_statistics.textureCount = static_cast<uint32_t>(m_textures.size());
+    m_statistics.visibleTextureCount = visibleTextureCount;
+    m_statistics.residentBytes = residentBytes;
+    m_statistics.requestedBytes = requestedBytes;
+    m_statistics.budgetBytes = budget;
+    m_statistics.heapUsageBytes = heap.usage;
+    m_statistics.heapBudgetBytes = heap.budget;
+}
+
+std::unique_ptr<TextureStreamer> TextureStreamerBuilder::build()
+{
+    assert(m_product->m_device.lock());
+
+    auto result = std::move(m_product);
+    restart();
+    return result;
+}
@@ -0,0 +1,226 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.h>
+
+class Device;
+class Texture;
+class Model;
+class CameraABC;
+class TextureStreamerBuilder;
+
+/**
+ * @brief keeps the streamed textures of the models at the resolution they are seen at, within a memory budget
+ * the textures are loaded at a low resolution first, the level a texture needs is estimated on the CPU from the
+ * distance of the meshes using it to the views they are rendered from
+ * a texture is loaded again from its file at its new resolution and its image is replaced, the previous image is
+ * destroyed once the frames in flight do not use it anymore
+ * when the resident textures do not fit the budget, the least needed ones are reduced to free memory for the others
+ *
+ */
+class TextureStreamer
+{
+    friend TextureStreamerBuilder;
+
+  public:
+    /**
+     * @brief point from which the models are rendered, the main camera or a probe capture
+     *
+     */
+    struct ViewT
+    {
+        glm::vec3 position;
+        /**
+         * @brief second diagonal element of the projection matrix, 1 / tan(fovY / 2) for a perspective projection
+         *
+         */
+        float projectionScale = 1.f;
+        float viewportHeight = 1.f;
+        /**
+         * @brief the size of an orthographic projection does not depend on the distance
+         *
+         */
+        bool perspective = true;
+    };
+
+    struct Statistics
+    {
+        uint32_t textureCount = 0u;
+        /**
+         * @brief textures used by the models of the last update
+         *
+         */
+        uint32_t visibleTextureCount = 0u;
+        VkDeviceSize residentBytes = 0u;
+        /**
+         * @brief bytes of the visible textures at the levels the views need
+         *
+         */
+        VkDeviceSize requestedBytes = 0u;
+        /**
+         * @brief the configured budget, lowered when the device local heaps run out of memory
+         *
+         */
+        VkDeviceSize budgetBytes = 0u;
+        VkDeviceSize heapUsageBytes = 0u;
+        VkDeviceSize heapBudgetBytes = 0u;
+        uint64_t loadCount = 0u;
+        uint64_t evictionCount = 0u;
+    };
+
+    /**
+     * @brief largest extent of the textures when they are loaded for the first time
+     *
+     */
+    static constexpr uint32_t s_initialExtent = 128u;
+
+  private:
+    /**
+     * @brief distance to a mesh below which it needs the finest level of its texture, the views inside its bounding
+     * sphere are at this distance
+     *
+     */
+    static constexpr float s_minDistance = 0.01f;
+
+    struct StreamedTexture
+    {
+        std::weak_ptr<Texture> texture;
+        /**
+         * @brief finest level needed by the views, the coarsest level of the texture if no model uses it
+         *
+         */
+        uint32_t requestedMipLevel = 0u;
+        /**
+         * @brief screen pixels per texel of the first level of the source, the most needed textures are loaded first
+         * and reduced last
+         *
+         */
+        float priority = 0.f;
+        bool visible = false;
+    };
+
+    struct RetiredImage
+    {
+        /**
+         * @brief holds the previous image of a texture
+         *
+         */
+        std::unique_ptr<Texture> texture;
+        uint32_t remainingUpdateCount;
+    };
+
+    std::weak_ptr<Device> m_device;
+
+    uint32_t m_frameInFlightCount = 1u;
+
+    VkDeviceSize m_budget = 256u * 1024u * 1024u;
+    /**
+     * @brief part of the budget of the device local heaps that the streamed textures may grow into, the rest is left
+     * to the other allocations
+     *
+     */
+    float m_heapBudgetRatio = 0.9f;
+    /**
+     * @brief textures loaded again by a single update, a load stalls the update until it is uploaded
+     *
+     */
+    uint32_t m_maxLoadsPerUpdate = 2u;
+
+    std::unordered_map<const Texture *, StreamedTexture> m_textures;
+    std::vector<RetiredImage> m_retiredImages;
+
+    std::vector<StreamedTexture *> m_upgrades;
+    std::vector<StreamedTexture *> m_reductions;
+
+    Statistics m_statistics;
+
+    TextureStreamer() = default;
+
+    /**
+     * @brief replace the image of the texture with the given level of its file
+     *
+     * @return false if the file could not be loaded, the texture keeps its image
+     */
+    bool load(Texture &texture, uint32_t firstMipLevel);
+
+  public:
+    ~TextureStreamer() = default;
+
+    TextureStreamer(const TextureStreamer &) = delete;
+    TextureStreamer &operator=(const TextureStreamer &) = delete;
+    TextureStreamer(TextureStreamer &&) = delete;
+    TextureStreamer &operator=(TextureStreamer &&) = delete;
+
+    [[nodiscard]] static ViewT makeView(const CameraABC &camera, float viewportHeight);
+
+    /**
+     * @brief estimate the levels needed by the streamed textures of the models and load or reduce them within the
+     * budget, called once per frame before rendering
+     *
+     * @param objects the models of the scene, the textures of the other scenes are only kept if they fit
+     * @param views
+     */
+    void update(const std::vector<std::shared_ptr<Model>> &objects, std::span<const ViewT> views);
+
+  public:
+    [[nodiscard]] inline VkDeviceSize getBudget() const
+    {
+        return m_budget;
+    }
+    [[nodiscard]] inline const Statistics &getStatistics() const
+    {
+        return m_statistics;
+    }
+
+  public:
+    void setBudget(VkDeviceSize budget)
+    {
+        m_budget = budget;
+    }
+};
+
+class TextureStreamerBuilder
+{
+  private:
+    std::unique_ptr<TextureStreamer> m_product;
+
+    void restart()
+    {
+        m_product = std::unique_ptr<TextureStreamer>(new TextureStreamer);
+    }
+
+  public:
+    TextureStreamerBuilder()
+    {
+        restart();
+    }
+
+    void setDevice(std::weak_ptr<Device> device)
+    {
+        m_product->m_device = device;
+    }
+    void setFrameInFlightCount(uint32_t count)
+    {
+        m_product->m_frameInFlightCount = count;
+    }
+    void setBudget(VkDeviceSize budget)
+    {
+        m_product->m_budget = budget;
+    }
+    void setHeapBudgetRatio(float ratio)
+    {
+        m_product->m_heapBudgetRatio = ratio;
+    }
+    void setMaxLoadsPerUpdate(uint32_t count)
+    {
+        m_product->m_maxLoadsPerUpdate = count;
+    }
+
+    std::unique_ptr<TextureStreamer> build();
+};
@@ -1,6 +1,6 @@
 #version 450
 
-//#define DEBUG_DISPLAY_PROBES
+#extension GL_EXT_control_flow_attributes : enable
 
 layout(location = 1) in vec2 fragUV;
 
@@ -38,16 +38,6 @@ vec4 bilerp(vec4 a, vec4 b, vec4 c, vec4 d, vec2 x)
     return (1.0 - x.y) * xy1 + x.y * xy2;
 }
 
-/// DEBUG
-
-float draw_sphere(in vec2 uv, in vec2 center, in float radius, float resy)
-{
-    float d = distance(uv, center);
-    float c = smoothstep(d, d + 1.5 / resy, radius);
-
-    return c;
-}
-
 layout (std140, binding = 1) uniform parameters {
     int maxCascadeCount;
     int maxProbeCount;
@@ -68,40 +58,58 @@ layout (std140, binding = 3) readonly buffer CascadeUBO {
 } cubo;
 
 // radiance interval storage buffer
-layout (std140, binding = 4) readonly buffer RadianceIntervalUBO {
-    vec4[] intervals;
+// rgba packed in half floats
+layout (std430, binding = 4) readonly buffer RadianceIntervalUBO {
+    uvec2[] intervals;
 } riubo;
 
-vec2 retrieve_probe_position(int cascadeIndex, int probeIndex)
+// cascade layout, specialized by the pipeline (see CascadeLayout)
+// the loops over the cascades have constant bounds and are unrolled
+layout(constant_id = 0) const int CASCADE_COUNT = 3;
+// probe count per dimension of the first cascade
+layout(constant_id = 1) const int PROBE_GRID_SIZE = 4;
+// radiance interval count per probe of the first cascade
+layout(constant_id = 2) const int INTERVAL_COUNT = 8;
+
+int cascade_probe_count(int cascadeIndex)
 {
-    int offset = 0;
-    for (int i = 0; i < cascadeIndex; ++i)
-    {
-        offset += cdubo.descs[i].p;
-    }
+    int s = PROBE_GRID_SIZE >> cascadeIndex;
+    return s * s * s;
+}
 
-    return cubo.positions[offset + probeIndex].position;
+int cascade_interval_count(int cascadeIndex)
+{
+    return INTERVAL_COUNT << (2 * cascadeIndex);
 }
 
-vec4 retrieve_radiance_interval(int cascadeIndex, int probeIndex, int intervalIndex)
+// index of the first probe of a cascade, sum of the probe counts of the previous cascades
+int cascade_probe_offset(int cascadeIndex)
 {
-    cascade_desc desc = cdubo.descs[cascadeIndex];
-    int intervalCount = desc.q;
+    return 8 * (cascade_probe_count(0) - cascade_probe_count(cascadeIndex)) / 7;
+}
 
-    int intervalIndexOffset = 0;
-    for (int i = 0; i < cascadeIndex; ++i)
-    {
-        // get previous cascade (min index is 0)
-        int previousCascadeIndex = max(0, i);
-        cascade_desc previous_desc = cdubo.descs[previousCascadeIndex];
+// index of the first interval of a cascade, every cascade holds half the intervals of the previous one
+int cascade_interval_offset(int cascadeIndex)
+{
+    int intervalCount0 = cascade_probe_count(0) * cascade_interval_count(0);
+    return 2 * (intervalCount0 - cascade_probe_count(cascadeIndex) * cascade_interval_count(cascadeIndex));
+}
 
-        intervalIndexOffset += previous_desc.p * previous_desc.q;
-    }
+vec4 unpack_radiance_interval(int index)
+{
+    uvec2 packed = riubo.intervals[index];
+    return vec4(unpackHalf2x16(packed.x), unpackHalf2x16(packed.y));
+}
+
+vec2 retrieve_probe_position(int cascadeIndex, int probeIndex)
+{
+    return cubo.positions[cascade_probe_offset(cascadeIndex) + probeIndex].position;
+}
 
-    float intervalOffset = 0.0;
-    if (cascadeIndex > 0)
-        intervalOffset = float(1 << (cascadeIndex - 1));
-    intervalOffset *= float(paramsubo.minRadianceintervalLength);
+vec4 retrieve_radiance_interval(int cascadeIndex, int probeIndex, int intervalIndex)
+{
+    int intervalCount = cascade_interval_count(cascadeIndex);
+    int intervalIndexOffset = cascade_interval_offset(cascadeIndex);
 
     // index of interval is offsetted by the number of intervals before hand
     // the number of intervals per probes in the previous cascades
@@ -109,17 +117,14 @@ vec4 retrieve_radiance_interval(int cascadeIndex, int probeIndex, int intervalIn
     int intervalProbeIndex = intervalIndexOffset + probeIndex * intervalCount;
     int computedIntervalIndex = intervalProbeIndex + intervalIndex;
 
-    return riubo.intervals[computedIntervalIndex];
+    return unpack_radiance_interval(computedIntervalIndex);
 }
 
 int[4] get_surrounding_probe_indices_from_uv(vec2 uv, int cascadeIndex)
 {
-    cascade_desc desc = cdubo.descs[cascadeIndex];
-
-    int probeCount = int(desc.p);
+    int probeCount = cascade_probe_count(cascadeIndex);
     int probeRowCount = int(sqrt(float(probeCount)));
-    int intervalCount = int(desc.q);
-    
+
     // closest probe at position "bottom left"
     float probeIndexOffset = 1.0/(float(probeRowCount)*2.0);
 
@@ -143,27 +148,25 @@ vec4 radiance_apply(in vec2 uv)
     // all intervals squashed together
 	vec4 totalRadiance = vec4(0.0);
     
-    int lastCascadeIndex = paramsubo.maxCascadeCount - 1;
-    cascade_desc lastDesc = cdubo.descs[lastCascadeIndex];
+    int lastIntervalCount = cascade_interval_count(CASCADE_COUNT - 1);
     
     // max number of interval
     // iterating on the intervals from probes of the last cascade
-    for (int i = 0; i < lastDesc.q; ++i)
+    for (int i = 0; i < lastIntervalCount; ++i)
     {
         float transparency = 1.0;
         vec4 mergedRadiance = vec4(0.0);
 
         // number of cascades
         // merging intervals from different cascade
-        for (int j = 0; j < paramsubo.maxCascadeCount; ++j)
+        [[unroll]] for (int j = 0; j < CASCADE_COUNT; ++j)
         {
             // computing the right interval index in function of
             // the wanted final interval and the cascade index
-            int intervalIndex = i / (1 << (paramsubo.maxCascadeCount- 1 - j));
+            int intervalIndex = i / (1 << (CASCADE_COUNT - 1 - j));
 
             int[4] probeIndices = get_surrounding_probe_indices_from_uv(uv, j);
-            cascade_desc desc = cdubo.descs[j];
-            
+
             probe p0, p1, p2, p3;
             p0.position = retrieve_probe_position(j, probeIndices[0]);
             p1.position = retrieve_probe_position(j, probeIndices[1]);
@@ -193,52 +196,7 @@ vec4 radiance_apply(in vec2 uv)
         }
         totalRadiance += mergedRadiance;
     }
-	return totalRadiance / float(lastDesc.q) * paramsubo.lightIntensity;
-}
-
-/// PROBE VISUALIZATION
-
-void render_probes(inout vec4 col, in vec2 uv)
-{
-    for (int i = 0; i < paramsubo.maxCascadeCount; ++i)
-    {
-        float probeRadius = float(i + 1) / 100.0;
-
-        cascade_desc desc = cdubo.descs[i];
-        int probeCount = desc.p;
-        int intervalCount = desc.q;
-        
-        int probeIndexOffset = 0;
-        int intervalIndexOffset = 0;
-        for (int j = 0; j < i; ++j)
-        {
-            // get previous cascade (min index is 0)
-            int previousCascadeIndex = max(0, j);
-            cascade_desc previous_desc = cdubo.descs[previousCascadeIndex];
-
-            probeIndexOffset += previous_desc.p;
-            intervalIndexOffset += previous_desc.p * previous_desc.q;
-        }
-
-        for (int j = 0; j < probeCount; ++j)
-        {
-            // index of probe is offsetted by the number of probes in the previous cascade
-            int probeIndex = probeIndexOffset + j;
-
-            vec2 probePos = cubo.positions[probeIndex].position;
-
-            vec4 probeColor = vec4(0.0);
-            for (int k = 0; k < intervalCount; ++k)
-            {
-                int intervalProbeIndex = intervalIndexOffset + j * intervalCount;
-                int intervalIndex = intervalProbeIndex + k;
-                probeColor += riubo.intervals[intervalIndex];
-            }
-            probeColor /= intervalCount;
-            
-            col += probeColor * draw_sphere(uv, probePos, probeRadius, textureSize(baseImage, 0).y);
-        }
-    }
+	return totalRadiance / float(lastIntervalCount) * paramsubo.lightIntensity;
 }
 
 void main()
@@ -247,16 +205,7 @@ void main()
 
     vec4 indirect = vec4(0.0);
     vec2 uv = fragUV;
-    
-#ifdef DEBUG_DISPLAY_PROBES
-    // probes visualization
-    vec4 probeSceneColor = vec4(0.0);
-    render_probes(probeSceneColor, uv);
-    indirect += vec4(probeSceneColor.xyz, 1.0);
-#else
-    indirect += vec4(0.0);
-#endif
-    
+
     // apply radiance to pixel
     vec4 indirectLight = radiance_apply(uv);
     indirect += vec4(indirectLight.rgb, 1.0);
@@ -1,7 +1,11 @@
 #version 450
 
-#define MAX_PROBE_COUNT 64
+// texels per side of a probe tile in the atlases, without its one texel border
+#define IRRADIANCE_TILE_SIZE 8
+#define VISIBILITY_TILE_SIZE 16
 #define DEFAULT_AMBIENT vec3(0.0)
+// offset of the shaded point along its normal, avoids self occlusion on flat surfaces
+#define VISIBILITY_NORMAL_BIAS 0.1
 
 #ifndef DEFAULT_AMBIENT
 	#define DEFAULT_AMBIENT vec3(0.0)
@@ -54,12 +58,17 @@ layout(location = 3) in vec3 fragPos;
 layout(location = 0) out vec4 oColor;
 
 layout(set = 1, binding = 1) uniform sampler2D texSampler;
-layout(set = 0, binding = 4) uniform samplerCube[MAX_PROBE_COUNT] irradianceMaps;
+// octahedral irradiance of every probe, see irradiance_atlas.comp
+layout(set = 0, binding = 4) uniform sampler2D irradianceAtlas;
+// distance to the closest surface seen by the probe and its square, filtered around each direction
+// see visibility_atlas.comp
+layout(set = 0, binding = 6) uniform sampler2D visibilityAtlas;
 
 struct Probe
 {
 	vec3 position;
-	float pad0[1];
+	// 0 if the probe is enclosed by the geometry
+	float active;
 };
 
 layout(std430, set = 0, binding = 5) readonly buffer ProbesData
@@ -73,6 +82,17 @@ layout(std430, set = 0, binding = 5) readonly buffer ProbesData
 	Probe probes[];
 };
 
+// the probes are stored brick by brick, only the bricks close to the geometry are allocated
+layout(std430, set = 0, binding = 7) readonly buffer ProbeBricksData
+{
+	ivec3 brickSize;
+	float pad3[1];
+	ivec3 brickDimensions;
+	float pad4[1];
+	// index of the first probe of every brick, -1 if the brick is not allocated
+	int brickProbeOffsets[];
+};
+
 struct PointLight
 {
 	vec3 diffuseColor;
@@ -143,6 +163,70 @@ void applySingleDirectionalLight(inout LightingResult fragLighting, in Direction
 	fragLighting.specular += vec3(0.0);
 }
 
+vec2 signNotZero(in vec2 v)
+{
+	return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// unit sphere to the [-1, 1] square
+vec2 octEncode(in vec3 direction)
+{
+	const vec2 oct = direction.xy / (abs(direction.x) + abs(direction.y) + abs(direction.z));
+	return direction.z <= 0.0 ? (1.0 - abs(oct.yx)) * signNotZero(oct) : oct;
+}
+
+// coordinates of a direction in the octahedral tile of a probe, the tiles are laid out row by row
+vec2 getAtlasUV(in ivec2 atlasSize, in int tileSize, in int probeIndex, in vec3 direction)
+{
+	const int tileSizeWithBorder = tileSize + 2;
+	const int tilesPerRow = atlasSize.x / tileSizeWithBorder;
+	const vec2 tileOrigin = vec2(probeIndex % tilesPerRow, probeIndex / tilesPerRow) * tileSizeWithBorder;
+
+	// skip the border, the bilinear fetch reads it at the edges of the tile
+	const vec2 texel = tileOrigin + 1.0 + (octEncode(direction) * 0.5 + 0.5) * tileSize;
+	return texel / vec2(atlasSize);
+}
+
+vec3 sampleIrradianceAtlas(in int probeIndex, in vec3 direction)
+{
+	const vec2 uv = getAtlasUV(textureSize(irradianceAtlas, 0), IRRADIANCE_TILE_SIZE, probeIndex, direction);
+	return texture(irradianceAtlas, uv).rgb;
+}
+
+// Chebyshev upper bound of the probability that the probe sees the fragment
+float probeVisibility(in int probeIndex, in vec3 probePosition, in vec3 normal)
+{
+	const vec3 probeToFrag = fragPos + normal * VISIBILITY_NORMAL_BIAS - probePosition;
+	const float distToProbe = length(probeToFrag);
+	const vec2 uv = getAtlasUV(textureSize(visibilityAtlas, 0), VISIBILITY_TILE_SIZE, probeIndex,
+							   probeToFrag / max(distToProbe, 1e-4));
+	const vec2 moments = texture(visibilityAtlas, uv).rg;
+
+	if (distToProbe <= moments.x)
+		return 1.0;
+
+	const float variance = abs(moments.y - moments.x * moments.x);
+	const float delta = distToProbe - moments.x;
+	const float chebyshev = variance / (variance + delta * delta);
+
+	// the bound is loose, sharpen it to remove the remaining leaks
+	return max(chebyshev * chebyshev * chebyshev, 0.0);
+}
+
+// index of a probe in the probe array from its index on the grid, -1 if its brick is not allocated
+int getProbe1DIndex(in ivec3 probe3DIndex)
+{
+	const ivec3 brick3DIndex = probe3DIndex / brickSize;
+	const ivec3 brickWeights = ivec3(brickDimensions.y * brickDimensions.z, brickDimensions.z, 1);
+	const int brickProbeOffset = brickProbeOffsets[int(dot(brick3DIndex, brickWeights))];
+	if (brickProbeOffset < 0)
+		return -1;
+
+	const ivec3 probeLocal3DIndex = probe3DIndex - brick3DIndex * brickSize;
+	const ivec3 weights = ivec3(brickSize.y * brickSize.z, brickSize.z, 1);
+	return brickProbeOffset + int(dot(probeLocal3DIndex, weights));
+}
+
 void applyImageBasedIrradiance(inout LightingResult fragLighting, in vec3 normal)
 {
 	const ivec3 indexBorders = dimensions - ivec3(1u);
@@ -160,33 +244,52 @@ void applyImageBasedIrradiance(inout LightingResult fragLighting, in vec3 normal
 	const ivec3 probe3DIndex101 = min(probeCorner3DIndex + ivec3(1, 0, 1), indexBorders);
 	const ivec3 probe3DIndex111 = min(probeCorner3DIndex + ivec3(1, 1, 1), indexBorders);
 
-	// 1DIndex = 3DIndex.x * dimensions.z + 3DIndex.y * dimensions.z * dimensions.x + 3DIndex.z
-	const ivec3 weights = ivec3(dimensions.y * dimensions.z, dimensions.z, 1);
-	const int probe1DIndex000 = int(dot(probe3DIndex000, weights));
-	const int probe1DIndex010 = int(dot(probe3DIndex010, weights));
-	const int probe1DIndex100 = int(dot(probe3DIndex100, weights));
-	const int probe1DIndex110 = int(dot(probe3DIndex110, weights));
-	const int probe1DIndex001 = int(dot(probe3DIndex001, weights));
-	const int probe1DIndex011 = int(dot(probe3DIndex011, weights));
-	const int probe1DIndex101 = int(dot(probe3DIndex101, weights));
-	const int probe1DIndex111 = int(dot(probe3DIndex111, weights));
-
-	const vec3 probePos000 = probes[probe1DIndex000].position;
-	const vec3 probePos111 = probes[probe1DIndex111].position;
-
-	const vec3 t = (fragPos - probePos000) / (probePos111 - probePos000);
-	
-	const vec3 irradiance000 = texture(irradianceMaps[probe1DIndex000], normal).rgb;
-	const vec3 irradiance010 = texture(irradianceMaps[probe1DIndex010], normal).rgb;
-	const vec3 irradiance100 = texture(irradianceMaps[probe1DIndex100], normal).rgb;
-	const vec3 irradiance110 = texture(irradianceMaps[probe1DIndex110], normal).rgb;
-	const vec3 irradiance001 = texture(irradianceMaps[probe1DIndex001], normal).rgb;
-	const vec3 irradiance011 = texture(irradianceMaps[probe1DIndex011], normal).rgb;
-	const vec3 irradiance101 = texture(irradianceMaps[probe1DIndex101], normal).rgb;
-	const vec3 irradiance111 = texture(irradianceMaps[probe1DIndex111], normal).rgb;
-	
-	vec3 interpIrradiance = trilerpClamped(irradiance000, irradiance100, irradiance010, irradiance110,
-										   irradiance001, irradiance101, irradiance011, irradiance111, t);
+	const int probe1DIndex000 = getProbe1DIndex(probe3DIndex000);
+	const int probe1DIndex010 = getProbe1DIndex(probe3DIndex010);
+	const int probe1DIndex100 = getProbe1DIndex(probe3DIndex100);
+	const int probe1DIndex110 = getProbe1DIndex(probe3DIndex110);
+	const int probe1DIndex001 = getProbe1DIndex(probe3DIndex001);
+	const int probe1DIndex011 = getProbe1DIndex(probe3DIndex011);
+	const int probe1DIndex101 = getProbe1DIndex(probe3DIndex101);
+	const int probe1DIndex111 = getProbe1DIndex(probe3DIndex111);
+
+	// the probes may have been moved out of the geometry, interpolate between their positions on the grid
+	const vec3 probePos000 = cornerPosition + vec3(probe3DIndex000) * spacing;
+	const vec3 probePos111 = cornerPosition + vec3(probe3DIndex111) * spacing;
+
+	const vec3 t = clamp((fragPos - probePos000) / (probePos111 - probePos000), 0.0, 1.0);
+
+	const int probe1DIndices[8] = int[](probe1DIndex000, probe1DIndex100, probe1DIndex010, probe1DIndex110,
+										probe1DIndex001, probe1DIndex101, probe1DIndex011, probe1DIndex111);
+
+	vec3 irradianceSum = vec3(0.0);
+	float weightSum = 0.0;
+	for (int i = 0; i < 8; i++)
+	{
+		const int probe1DIndex = probe1DIndices[i];
+		// no probe in an unallocated brick
+		if (probe1DIndex < 0 || probes[probe1DIndex].active == 0.0)
+			continue;
+
+		const vec3 probePosition = probes[probe1DIndex].position;
+
+		// trilinear weight of the corner
+		const vec3 corner = vec3(i & 1, (i >> 1) & 1, (i >> 2) & 1);
+		const vec3 trilinear = mix(1.0 - t, t, corner);
+		float weight = trilinear.x * trilinear.y * trilinear.z;
+
+		// probes behind the surface are not discarded entirely, a corner would be left without any probe
+		const vec3 fragToProbe = probePosition - fragPos;
+		const float facing = (dot(fragToProbe / max(length(fragToProbe), 1e-4), normal) + 1.0) * 0.5;
+		weight *= facing * facing + 0.2;
+
+		weight *= probeVisibility(probe1DIndex, probePosition, normal);
+
+		irradianceSum += sampleIrradianceAtlas(probe1DIndex, normal) * weight;
+		weightSum += weight;
+	}
+
+	const vec3 interpIrradiance = irradianceSum / max(weightSum, 1e-4);
 
 	fragLighting.diffuse += interpIrradiance;
 	//fragLighting.diffuse += clamp(interpIrradiance, 0.0, 1.0);
@@ -0,0 +1,11 @@
+#version 450
+
+layout(location = 0) in vec3 probeToFrag;
+
+layout(location = 0) out vec2 oMoments;
+
+void main()
+{
+	const float dist = length(probeToFrag);
+	oMoments = vec2(dist, dist * dist);
+}
@@ -0,0 +1,26 @@
+#version 450
+
+#extension GL_EXT_multiview : enable
+
+layout(location = 0) in vec3 aPos;
+
+layout(location = 0) out vec3 probeToFrag;
+
+layout(binding = 0) uniform MVPUniformBufferObject
+{
+	mat4 model;
+	mat4 views[6];
+	mat4 proj;
+} mvp;
+
+void main()
+{
+	const mat4 view = mvp.views[gl_ViewIndex];
+	// every view of the capture is centered on the probe
+	const vec3 probePosition = -transpose(mat3(view)) * view[3].xyz;
+
+	const vec4 worldPos = mvp.model * vec4(aPos, 1.0);
+	probeToFrag = worldPos.xyz - probePosition;
+
+	gl_Position = mvp.proj * view * worldPos;
+}
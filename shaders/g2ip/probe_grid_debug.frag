@@ -0,0 +1,69 @@
+#version 450
+
+// texels per side of a probe tile in the irradiance atlas, without its one texel border
+#define IRRADIANCE_TILE_SIZE 8
+#define IRRADIANCE_TILE_SIZE_WITH_BORDER (IRRADIANCE_TILE_SIZE + 2)
+
+layout(location = 0) in vec3 fragNormal;
+layout(location = 3) in vec3 fragPos;
+layout(location = 4) flat in int instanceIndex;
+
+layout(location = 0) out vec4 oColor;
+
+// octahedral irradiance of every probe, see irradiance_atlas.comp
+layout(set = 0, binding = 4) uniform sampler2D irradianceAtlas;
+
+struct Probe
+{
+	vec3 position;
+	// 0 if the probe is enclosed by the geometry
+	float active;
+};
+
+layout(std430, set = 0, binding = 5) readonly buffer ProbesData
+{
+	ivec3 dimensions;
+	float pad0[1];
+	vec3 extent;
+	float pad1[1];
+	vec3 cornerPosition;
+	float pad2[1];
+	Probe probes[];
+};
+
+vec2 signNotZero(in vec2 v)
+{
+	return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// unit sphere to the [-1, 1] square
+vec2 octEncode(in vec3 direction)
+{
+	const vec2 oct = direction.xy / (abs(direction.x) + abs(direction.y) + abs(direction.z));
+	return direction.z <= 0.0 ? (1.0 - abs(oct.yx)) * signNotZero(oct) : oct;
+}
+
+void main()
+{
+	// one instance per probe, in the order they are stored
+	const int probe1DIndex = instanceIndex;
+
+	// an inactive probe has not been captured
+	if (probes[probe1DIndex].active == 0.0)
+	{
+		oColor = vec4(1.0, 0.0, 0.0, 1.0);
+		return;
+	}
+
+	vec3 normal = normalize(fragNormal);
+
+	const vec2 atlasSize = vec2(textureSize(irradianceAtlas, 0));
+	const int tilesPerRow = int(atlasSize.x) / IRRADIANCE_TILE_SIZE_WITH_BORDER;
+	const vec2 tileOrigin =
+		vec2(probe1DIndex % tilesPerRow, probe1DIndex / tilesPerRow) * IRRADIANCE_TILE_SIZE_WITH_BORDER;
+	const vec2 texel = tileOrigin + 1.0 + (octEncode(normal) * 0.5 + 0.5) * IRRADIANCE_TILE_SIZE;
+
+	vec3 sampleColor = texture(irradianceAtlas, texel / atlasSize).rgb;
+
+	oColor = vec4(sampleColor, 1.0);
+}
@@ -1,6 +1,6 @@
 #version 450
 
-#define DEBUG_DISPLAY_PROBES
+#extension GL_EXT_control_flow_attributes : enable
 
 layout(location = 1) in vec2 fragUV;
 
@@ -38,16 +38,6 @@ vec4 bilerp(vec4 a, vec4 b, vec4 c, vec4 d, vec2 x)
     return (1.0 - x.y) * xy1 + x.y * xy2;
 }
 
-/// DEBUG
-
-float draw_sphere(in vec2 uv, in vec2 center, in float radius, float resy)
-{
-    float d = distance(uv, center);
-    float c = smoothstep(d, d + 1.5 / resy, radius);
-
-    return c;
-}
-
 layout (std140, binding = 1) uniform parameters {
     int maxCascadeCount;
     int maxProbeCount;
@@ -72,36 +62,57 @@ layout (std140, binding = 4) readonly buffer RadianceIntervalUBO {
     vec4[] intervals;
 } riubo;
 
-vec2 retrieve_probe_position(int cascadeIndex, int probeIndex)
+// indirect light evaluated at a lower resolution, occupancy in alpha (see rc/radiance_apply_2d.comp)
+layout(binding = 5) uniform sampler2D indirectImage;
+
+layout(push_constant) uniform IndirectResolution {
+    // texels of the indirect image covering the screen
+    uvec2 extent;
+    // 1 evaluates the indirect light for every pixel
+    uint divisor;
+} resolution;
+
+// cascade layout, specialized by the pipeline (see CascadeLayout)
+// the loops over the cascades have constant bounds and are unrolled
+layout(constant_id = 0) const int CASCADE_COUNT = 3;
+// probe count per dimension of the first cascade
+layout(constant_id = 1) const int PROBE_GRID_SIZE = 16;
+// radiance interval count per probe of the first cascade
+layout(constant_id = 2) const int INTERVAL_COUNT = 16;
+
+int cascade_probe_count(int cascadeIndex)
 {
-    int offset = 0;
-    for (int i = 0; i < cascadeIndex; ++i)
-    {
-        offset += cdubo.descs[i].p;
-    }
+    int s = PROBE_GRID_SIZE >> cascadeIndex;
+    return s * s;
+}
 
-    return cubo.positions[offset + probeIndex].position;
+int cascade_interval_count(int cascadeIndex)
+{
+    return INTERVAL_COUNT << (cascadeIndex);
 }
 
-vec4 retrieve_radiance_interval(int cascadeIndex, int probeIndex, int intervalIndex)
+// index of the first probe of a cascade, sum of the probe counts of the previous cascades
+int cascade_probe_offset(int cascadeIndex)
 {
-    cascade_desc desc = cdubo.descs[cascadeIndex];
-    int intervalCount = desc.q;
+    return 4 * (cascade_probe_count(0) - cascade_probe_count(cascadeIndex)) / 3;
+}
 
-    int intervalIndexOffset = 0;
-    for (int i = 0; i < cascadeIndex; ++i)
-    {
-        // get previous cascade (min index is 0)
-        int previousCascadeIndex = max(0, i);
-        cascade_desc previous_desc = cdubo.descs[previousCascadeIndex];
+// index of the first interval of a cascade, every cascade holds half the intervals of the previous one
+int cascade_interval_offset(int cascadeIndex)
+{
+    int intervalCount0 = cascade_probe_count(0) * cascade_interval_count(0);
+    return 2 * (intervalCount0 - cascade_probe_count(cascadeIndex) * cascade_interval_count(cascadeIndex));
+}
 
-        intervalIndexOffset += previous_desc.p * previous_desc.q;
-    }
+vec2 retrieve_probe_position(int cascadeIndex, int probeIndex)
+{
+    return cubo.positions[cascade_probe_offset(cascadeIndex) + probeIndex].position;
+}
 
-    float intervalOffset = 0.0;
-    if (cascadeIndex > 0)
-        intervalOffset = float(1 << (cascadeIndex - 1));
-    intervalOffset *= float(paramsubo.minRadianceintervalLength);
+vec4 retrieve_radiance_interval(int cascadeIndex, int probeIndex, int intervalIndex)
+{
+    int intervalCount = cascade_interval_count(cascadeIndex);
+    int intervalIndexOffset = cascade_interval_offset(cascadeIndex);
 
     // index of interval is offsetted by the number of intervals before hand
     // the number of intervals per probes in the previous cascades
@@ -114,12 +125,9 @@ vec4 retrieve_radiance_interval(int cascadeIndex, int probeIndex, int intervalIn
 
 int[4] get_surrounding_probe_indices_from_uv(vec2 uv, int cascadeIndex)
 {
-    cascade_desc desc = cdubo.descs[cascadeIndex];
-
-    int probeCount = int(desc.p);
+    int probeCount = cascade_probe_count(cascadeIndex);
     int probeRowCount = int(sqrt(float(probeCount)));
-    int intervalCount = int(desc.q);
-    
+
     // closest probe at position "bottom left"
     float probeIndexOffset = 1.0/(float(probeRowCount)*2.0);
 
@@ -143,8 +151,7 @@ vec4 radiance_apply(in vec2 uv)
     // all intervals squashed together
     vec4 totalRadiance = vec4(0.0);
 
-    int lastCascadeIndex = paramsubo.maxCascadeCount - 1;
-    cascade_desc lastDesc = cdubo.descs[lastCascadeIndex];
+    int lastIntervalCount = cascade_interval_count(CASCADE_COUNT - 1);
 
     vec4 collapsed0 = vec4(0.0);
     vec4 collapsed1 = vec4(0.0);
@@ -153,7 +160,7 @@ vec4 radiance_apply(in vec2 uv)
 
     // max number of interval
     // iterating on the intervals from probes of the last cascade
-    for (int i = 0; i < lastDesc.q; ++i)
+    for (int i = 0; i < lastIntervalCount; ++i)
     {
         // collapsed intervals
         vec4 interval0 = vec4(vec3(0.0), 1.0);
@@ -163,11 +170,11 @@ vec4 radiance_apply(in vec2 uv)
 
         // number of cascades
         // merging intervals from different cascade
-        for (int j = 0; j < paramsubo.maxCascadeCount; ++j)
+        [[unroll]] for (int j = 0; j < CASCADE_COUNT; ++j)
         {
             // computing the right interval index in function of
             // the wanted final interval and the cascade index
-            int qdiff = lastDesc.q / cdubo.descs[j].q;
+            int qdiff = lastIntervalCount / cascade_interval_count(j);
             int intervalIndex = i / qdiff;
 
             int[4] probeIndices = get_surrounding_probe_indices_from_uv(uv, j);
@@ -188,10 +195,10 @@ vec4 radiance_apply(in vec2 uv)
         collapsed2 += interval2;
         collapsed3 += interval3;
     }
-    collapsed0 = (collapsed0 / float(lastDesc.q)) * paramsubo.lightIntensity;
-    collapsed1 = (collapsed1 / float(lastDesc.q)) * paramsubo.lightIntensity;
-    collapsed2 = (collapsed2 / float(lastDesc.q)) * paramsubo.lightIntensity;
-    collapsed3 = (collapsed3 / float(lastDesc.q)) * paramsubo.lightIntensity;
+    collapsed0 = (collapsed0 / float(lastIntervalCount)) * paramsubo.lightIntensity;
+    collapsed1 = (collapsed1 / float(lastIntervalCount)) * paramsubo.lightIntensity;
+    collapsed2 = (collapsed2 / float(lastIntervalCount)) * paramsubo.lightIntensity;
+    collapsed3 = (collapsed3 / float(lastIntervalCount)) * paramsubo.lightIntensity;
 
     int[4] probeIndices = get_surrounding_probe_indices_from_uv(uv, 0);
     
@@ -216,49 +223,33 @@ vec4 radiance_apply(in vec2 uv)
     //return bilerp(vec4(1.0, 0.0, 0.0, 1.0), vec4(0.0, 1.0, 0.0, 1.0), vec4(0.0, 0.0, 1.0, 1.0), vec4(1.0, 0.0, 1.0, 0.0), vec2(lerpy, lerpx));
 }
 
-/// PROBE VISUALIZATION
-
-void render_probes(inout vec4 col, in vec2 uv)
+// bilinear upsample of the indirect image weighted by the occupancy of the direct image
+// there is no depth nor normal in 2D, a texel lying on the other side of an edge does not bleed on the pixel
+vec3 upsample_indirect(in vec2 uv, float occupancy)
 {
-    for (int i = 0; i < paramsubo.maxCascadeCount; ++i)
+    vec2 extent = vec2(resolution.extent);
+    // position relative to the center of the bottom left texel of the 2x2 footprint
+    vec2 position = uv * extent - 0.5;
+    vec2 base = floor(position);
+    vec2 f = position - base;
+
+    vec3 sum = vec3(0.0);
+    float weightSum = 0.0;
+    [[unroll]] for (int i = 0; i < 4; ++i)
     {
-        float probeRadius = float(i + 1) / 100.0;
-
-        cascade_desc desc = cdubo.descs[i];
-        int probeCount = desc.p;
-        int intervalCount = desc.q;
-        
-        int probeIndexOffset = 0;
-        int intervalIndexOffset = 0;
-        for (int j = 0; j < i; ++j)
-        {
-            // get previous cascade (min index is 0)
-            int previousCascadeIndex = max(0, j);
-            cascade_desc previous_desc = cdubo.descs[previousCascadeIndex];
+        vec2 offset = vec2(i & 1, i >> 1);
+        vec2 texel = clamp(base + offset, vec2(0.0), extent - 1.0);
 
-            probeIndexOffset += previous_desc.p;
-            intervalIndexOffset += previous_desc.p * previous_desc.q;
-        }
+        // the occupancy of the texel is in alpha, the base image is not read around the pixel since it is drawn on
+        vec4 texelIndirect = texelFetch(indirectImage, ivec2(texel), 0);
+        vec2 bilinear = mix(1.0 - f, f, offset);
+        // never zero so that a pixel surrounded by texels across an edge still receives light
+        float weight = bilinear.x * bilinear.y * (1.0 - abs(texelIndirect.a - occupancy) + 1e-3);
 
-        for (int j = 0; j < probeCount; ++j)
-        {
-            // index of probe is offsetted by the number of probes in the previous cascade
-            int probeIndex = probeIndexOffset + j;
-
-            vec2 probePos = cubo.positions[probeIndex].position;
-
-            vec4 probeColor = vec4(0.0);
-            for (int k = 0; k < intervalCount; ++k)
-            {
-                int intervalProbeIndex = intervalIndexOffset + j * intervalCount;
-                int intervalIndex = intervalProbeIndex + k;
-                probeColor += riubo.intervals[intervalIndex];
-            }
-            probeColor /= intervalCount;
-            
-            col += probeColor * draw_sphere(uv, probePos, probeRadius, textureSize(baseImage, 0).y);
-        }
+        sum += weight * texelIndirect.rgb;
+        weightSum += weight;
     }
+    return sum / weightSum;
 }
 
 void main()
@@ -267,18 +258,13 @@ void main()
 
     vec4 indirect = vec4(0.0);
     vec2 uv = fragUV;
-    
-#ifdef DEBUG_DISPLAY_PROBES
-    // probes visualization
-    vec4 probeSceneColor = vec4(0.0);
-    render_probes(probeSceneColor, uv);
-    indirect += vec4(probeSceneColor.xyz, 1.0);
-#else
-    indirect += vec4(0.0);
-#endif
-    
+
     // apply radiance to pixel
-    vec4 indirectLight = radiance_apply(uv);
+    vec4 indirectLight;
+    if (resolution.divisor <= 1u)
+        indirectLight = radiance_apply(uv);
+    else
+        indirectLight = vec4(upsample_indirect(uv, step(0.5, direct.w)), 1.0);
     indirect += vec4(indirectLight.rgb, 1.0);
 
     oColor = vec4(direct.rgb + mix(indirect.rgb, direct.rgb, step(0.5, direct.w)), 1.0);
@@ -0,0 +1,15 @@
+#version 450
+
+layout(location = 0) flat in vec4 probeColor;
+// [-1, 1] across the quad of a 2D probe, zero for the 3D probe meshes
+layout(location = 1) in vec2 fragDiscCoord;
+
+layout(location = 0) out vec4 oColor;
+
+void main()
+{
+    if (dot(fragDiscCoord, fragDiscCoord) > 1.0)
+        discard;
+
+    oColor = vec4(probeColor.rgb, 1.0);
+}
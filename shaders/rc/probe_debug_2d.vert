@@ -0,0 +1,60 @@
+#version 450
+
+// one screen quad per probe of every cascade, colored with the average computed by rc/probe_average_2d
+
+layout(location = 0) in vec3 aPos;
+layout(location = 3) in vec2 aUV;
+
+layout(location = 0) flat out vec4 probeColor;
+layout(location = 1) out vec2 fragDiscCoord;
+
+struct probe
+{
+	vec2 position;
+};
+
+// cascade probes position buffer
+layout (std140, binding = 0) readonly buffer CascadeUBO {
+    probe[] positions;
+} cubo;
+
+// average radiance of every probe
+layout (std430, binding = 1) readonly buffer ProbeColorUBO {
+    vec4[] colors;
+} pcubo;
+
+// cascade layout, specialized by the pipeline (see CascadeLayout)
+layout(constant_id = 0) const int CASCADE_COUNT = 3;
+// probe count per dimension of the first cascade
+layout(constant_id = 1) const int PROBE_GRID_SIZE = 16;
+
+int cascade_probe_count(int cascadeIndex)
+{
+    int s = PROBE_GRID_SIZE >> cascadeIndex;
+    return s * s;
+}
+
+// index of the first probe of a cascade, sum of the probe counts of the previous cascades
+int cascade_probe_offset(int cascadeIndex)
+{
+    return 4 * (cascade_probe_count(0) - cascade_probe_count(cascadeIndex)) / 3;
+}
+
+void main()
+{
+    int probeIndex = gl_InstanceIndex;
+    int cascadeIndex = 0;
+    for (int i = 1; i < CASCADE_COUNT; ++i)
+    {
+        if (probeIndex >= cascade_probe_offset(i))
+            cascadeIndex = i;
+    }
+
+    // radius in uv, the probes of the coarser cascades are drawn bigger
+    float probeRadius = float(cascadeIndex + 1) / 100.0;
+    vec2 uv = cubo.positions[probeIndex].position + aPos.xy * probeRadius;
+    gl_Position = vec4(uv * 2.0 - 1.0, 0.0, 1.0);
+
+    probeColor = pcubo.colors[probeIndex];
+    fragDiscCoord = aUV * 2.0 - 1.0;
+}
@@ -0,0 +1,69 @@
+#version 450
+
+// one instance per probe of every cascade, colored with the average computed by rc/probe_average_3d
+
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec3 aNormal;
+layout(location = 2) in vec3 aColor;
+
+layout(location = 0) flat out vec4 probeColor;
+layout(location = 1) out vec2 fragDiscCoord;
+
+layout(binding = 0) uniform MVPUniformBufferObject
+{
+	mat4 model;
+	mat4 views[6];
+	mat4 proj;
+} mvp;
+
+struct probe
+{
+	vec3 position;
+};
+
+// cascade probes position buffer
+layout (std430, binding = 1) readonly buffer CascadeUBO {
+    probe[] positions;
+} cubo;
+
+// average radiance of every probe
+layout (std430, binding = 2) readonly buffer ProbeColorUBO {
+    vec4[] colors;
+} pcubo;
+
+// cascade layout, specialized by the pipeline (see CascadeLayout)
+layout(constant_id = 0) const int CASCADE_COUNT = 3;
+// probe count per dimension of the first cascade
+layout(constant_id = 1) const int PROBE_GRID_SIZE = 4;
+
+int cascade_probe_count(int cascadeIndex)
+{
+    int s = PROBE_GRID_SIZE >> cascadeIndex;
+    return s * s * s;
+}
+
+// index of the first probe of a cascade, sum of the probe counts of the previous cascades
+int cascade_probe_offset(int cascadeIndex)
+{
+    return 8 * (cascade_probe_count(0) - cascade_probe_count(cascadeIndex)) / 7;
+}
+
+void main()
+{
+    int probeIndex = gl_InstanceIndex;
+    int cascadeIndex = 0;
+    for (int i = 1; i < CASCADE_COUNT; ++i)
+    {
+        if (probeIndex >= cascade_probe_offset(i))
+            cascadeIndex = i;
+    }
+
+    // the probes of the coarser cascades are drawn bigger
+    float probeScale = 0.2 * float(cascadeIndex + 1);
+    vec3 pos = aPos * probeScale + cubo.positions[probeIndex].position;
+    gl_Position = mvp.proj * mvp.views[0] * mvp.model * vec4(pos, 1.0);
+
+    probeColor = pcubo.colors[probeIndex];
+    // the mesh is already round
+    fragDiscCoord = vec2(0.0);
+}
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <assimp/Importer.hpp>
 #include <format>
 #include <memory>
@@ -16,9 +17,11 @@
 #include "graphics/buffer.hpp"
 #include "graphics/context.hpp"
 #include "graphics/device.hpp"
+#include "graphics/frame_allocator.hpp"
 #include "graphics/image.hpp"
 #include "graphics/pipeline.hpp"
 #include "graphics/render_pass.hpp"
+#include "graphics/timestamp_query.hpp"
 
 #include "wsi/window.hpp"
 
@@ -26,17 +29,30 @@
 #include "backends/imgui_impl_vulkan.h"
 
 #include "engine/camera.hpp"
+#include "engine/frame_arena.hpp"
+#include "engine/heap_counter.hpp"
+#include "engine/job_system.hpp"
+#include "engine/probe_grid.hpp"
 
 #include "renderer/light.hpp"
 #include "renderer/mesh.hpp"
 #include "renderer/model.hpp"
+#include "renderer/probe_bake.hpp"
 #include "renderer/render_graph.hpp"
+#include "renderer/acceleration_structure_cache.hpp"
+#include "renderer/render_graph_resources.hpp"
 #include "renderer/render_phase.hpp"
 #include "renderer/render_state.hpp"
 #include "renderer/renderer.hpp"
+#include "renderer/resource_registry.hpp"
 #include "renderer/scene.hpp"
+#include "renderer/scene_constants.hpp"
 #include "renderer/skybox.hpp"
 #include "renderer/texture.hpp"
+#include "renderer/texture_streamer.hpp"
+
+#include "scripts/radiance_cascades.hpp"
+#include "scripts/radiance_cascades3d.hpp"
 
 #include "application.hpp"
 
@@ -45,12 +61,33 @@
 
 constexpr uint32_t bufferingType = 3;
 constexpr uint32_t maxProbeCount = 64u;
+/**
+ * @brief frames of a scene that may allocate on the heap, the first submissions build the acceleration structures
+ * and release the resources of the one-time phases
+ *
+ */
+constexpr uint32_t heapWarmUpFrameCount = 2u * bufferingType;
+
+namespace
+{
+/**
+ * @brief format a line of the UI in a stack buffer rather than in a std::string, longer lines are truncated
+ *
+ */
+template <typename... TArgs> void displayText(std::format_string<TArgs...> format, TArgs &&...args)
+{
+    char buffer[256];
+    const auto result = std::format_to_n(buffer, sizeof(buffer), format, std::forward<TArgs>(args)...);
+    ImGui::TextUnformatted(buffer, result.out);
+}
+} // namespace
 
 Application::Application()
 {
     WindowGLFW::init();
     m_profiler = std::make_unique<ImGuiUtils::ProfilersWindow>();
     m_window = std::make_unique<WindowGLFW>();
+    m_jobSystem = std::make_unique<JobSystem>(std::max(std::thread::hardware_concurrency(), 1u) - 1u);
 
     glfwSetKeyCallback(m_window->getHandle(), InputManager::KeyCallback);
     ContextBuilder cb;
@@ -105,6 +142,11 @@ Application::Application()
     scb.setSwapchainPresentMode(VK_PRESENT_MODE_IMMEDIATE_KHR);
     scb.setUseImagesAsSamplers(true);
     m_window->setSwapChain(scb.build());
+
+    ResourceRegistryBuilder rrb;
+    rrb.setDevice(m_discreteDevice);
+    rrb.setFrameInFlightCount(bufferingType);
+    m_resourceRegistry = rrb.build();
 }
 
 Application::~Application()
@@ -114,6 +156,8 @@ Application::~Application()
 
     m_window.reset();
 
+    m_resourceRegistry.reset();
+
     m_discreteDevice.reset();
     m_devices.clear();
 
@@ -174,10 +218,13 @@ int Application::displayImgui()
         return 1;
     }
 
-    ImGui::Text(std::format("Average FPS: {0}", ImGui::GetIO().Framerate).c_str());
+    displayText("Average FPS: {0}", ImGui::GetIO().Framerate);
 
     if (ImGui::CollapsingHeader("Scene Objects", ImGuiTreeNodeFlags_DefaultOpen | ImGuiTreeNodeFlags_Framed))
     {
+        const TransformStore &transforms = m_scene->getTransforms();
+        displayText("Transforms: {0}, {1} updated last frame", transforms.getCount(), transforms.getLastUpdatedCount());
+
         const auto &objects = m_scene->getObjects();
         for (auto &object : objects)
         {
@@ -214,7 +261,9 @@ int Application::displayImgui()
         int lightIndex = 0u;
         for (auto &light : lights)
         {
-            if (ImGui::TreeNode(std::format("Light {0}", lightIndex).c_str()))
+            char label[32];
+            *std::format_to_n(label, sizeof(label) - 1, "Light {0}", lightIndex).out = '\0';
+            if (ImGui::TreeNode(label))
             {
                 ImGui::PushID(lightIndex);
                 if (PointLight *pointLight = dynamic_cast<PointLight *>(light.get()))
@@ -242,6 +291,198 @@ int Application::displayImgui()
         }
     }
 
+    if (ImGui::CollapsingHeader("Job System", ImGuiTreeNodeFlags_Framed))
+    {
+        const JobSystem::Statistics stats = m_jobSystem->getStatistics();
+
+        displayText("Threads: {0}", m_jobSystem->getThreadCount());
+        displayText("Jobs: {0} ({1} stolen)", stats.jobCount, stats.stolenCount);
+    }
+
+    if (ImGui::CollapsingHeader("Frame Allocator", ImGuiTreeNodeFlags_Framed))
+    {
+        const FrameAllocator::Statistics &stats =
+            m_renderer->getRenderGraph()->getFrameAllocator()->getLastFrameStatistics();
+
+        displayText("Allocations: {0}", stats.allocationCount);
+        displayText("Used: {0} / {1} KiB", stats.allocatedBytes / 1024, stats.frameCapacity / 1024);
+        displayText("Peak: {0} KiB", stats.peakAllocatedBytes / 1024);
+        displayText("Failed allocations: {0}", stats.failedAllocationCount);
+        displayText("Scene constants uploads: {0}",
+                    m_renderer->getRenderGraph()->getSceneConstants()->getUploadCount());
+    }
+
+    if (ImGui::CollapsingHeader("Resource Registry", ImGuiTreeNodeFlags_Framed))
+    {
+        const ResourceRegistry::Statistics stats = m_resourceRegistry->getStatistics();
+
+        displayText("Scene loaded in {0:.0f} ms", m_sceneLoadSeconds * 1000.f);
+        displayText("Resources: {0} ({1} released)", stats.resourceCount, stats.releasedCount);
+        displayText("Scene switches: {0} ({1} released by the last one)", stats.sceneSwitchCount,
+                    stats.lastReleasedCount);
+        displayText("Requests: {0} loaded, {1} shared", stats.loadCount, stats.hitCount);
+        displayText("Model textures: {0} ({1} KiB)", stats.textureCount, stats.textureBytes / 1024);
+    }
+
+    if (ImGui::CollapsingHeader("Texture Streaming", ImGuiTreeNodeFlags_Framed))
+    {
+        TextureStreamer *streamer = m_resourceRegistry->getTextureStreamer();
+        const TextureStreamer::Statistics &stats = streamer->getStatistics();
+
+        displayText("Textures: {0} ({1} visible)", stats.textureCount, stats.visibleTextureCount);
+        displayText("Resident: {0} / {1} KiB", stats.residentBytes / 1024, stats.budgetBytes / 1024);
+        displayText("Requested: {0} KiB", stats.requestedBytes / 1024);
+        displayText("Device local heaps: {0} / {1} MiB", stats.heapUsageBytes / (1024 * 1024),
+                    stats.heapBudgetBytes / (1024 * 1024));
+        displayText("Loads: {0} ({1} evictions)", stats.loadCount, stats.evictionCount);
+
+        int budgetMiB = static_cast<int>(streamer->getBudget() / (1024 * 1024));
+        if (ImGui::SliderInt("Budget (MiB)", &budgetMiB, 16, 4096))
+            streamer->setBudget(static_cast<VkDeviceSize>(budgetMiB) * 1024 * 1024);
+    }
+
+    if (ImGui::CollapsingHeader("Frame Arena", ImGuiTreeNodeFlags_Framed))
+    {
+        const FrameArena *arena = m_renderer->getRenderGraph()->getFrameArena();
+        const FrameArena::Statistics &stats = arena->getLastFrameStatistics();
+
+        displayText("Allocations: {0} ({1} on the heap)", stats.allocationCount, stats.overflowCount);
+        displayText("Used: {0} / {1} KiB", stats.allocatedBytes / 1024, stats.capacity / 1024);
+        displayText("Peak: {0} KiB", arena->getPeakAllocatedBytes() / 1024);
+        displayText("Heap allocations: {0} per frame, {1} while rendering", m_frameHeapAllocationCount,
+                    m_renderHeapAllocationCount);
+    }
+
+    if (ImGui::CollapsingHeader("Render Graph Resources", ImGuiTreeNodeFlags_Framed))
+    {
+        const RenderGraphResources::Statistics stats =
+            m_renderer->getRenderGraph()->getResources()->getStatistics();
+
+        displayText("Transient images: {0} in {1} blocks", stats.transientImageCount, stats.memoryBlockCount);
+        displayText("Memory: {0} / {1} KiB", stats.allocatedBytes / 1024, stats.requestedBytes / 1024);
+        displayText("Released: {0} KiB", stats.releasedBytes / 1024);
+        displayText("Barriers: {0} ({1} skipped)", stats.barrierCount, stats.skippedBarrierCount);
+        displayText("Elided semaphores: {0}", stats.elidedSemaphoreCount);
+    }
+
+    if (ImGui::CollapsingHeader("GPU Timings", ImGuiTreeNodeFlags_Framed))
+    {
+        const std::pmr::vector<const TimestampQuery *> queries = m_renderer->getRenderGraph()->getTimestampQueries();
+        if (queries.empty())
+            ImGui::Text("No timed phase");
+
+        // start of every phase from the first one, the async phases overlap the phases that start before they end
+        double firstBegin = queries.empty() ? 0.0 : queries.front()->getBeginMilliseconds();
+        for (const TimestampQuery *query : queries)
+            firstBegin = std::min(firstBegin, query->getBeginMilliseconds());
+        for (const TimestampQuery *query : queries)
+        {
+            displayText("{0}: +{1:.3f} ms, {2:.3f} ms", query->getName(), query->getBeginMilliseconds() - firstBegin,
+                        query->getMilliseconds());
+        }
+    }
+
+    if (ImGui::CollapsingHeader("Acceleration Structures", ImGuiTreeNodeFlags_Framed))
+    {
+        const AccelerationStructureCache::Statistics &stats =
+            m_renderer->getRenderGraph()->getAccelerationStructureCache()->getStatistics();
+
+        displayText("BLAS: {0} ({1} reused)", stats.blasCount, stats.blasReuseCount);
+        displayText("TLAS: {0} ({1} reused)", stats.tlasCount, stats.tlasReuseCount);
+        displayText("TLAS refits: {0} ({1} rebuilds)", stats.tlasUpdateCount, stats.tlasRebuildCount);
+        displayText("Memory: {0} KiB ({1} KiB saved by compaction)", stats.memoryBytes / 1024,
+                    stats.compactionSavedBytes / 1024);
+        displayText("BLAS build batches: {0}", stats.buildBatchCount);
+    }
+
+    if (m_probeGrid && ImGui::CollapsingHeader("Probe Placement", ImGuiTreeNodeFlags_Framed))
+    {
+        const ProbeGrid::PlacementStatistics &stats = m_probeGrid->getPlacementStatistics();
+        const size_t probeCount = m_probeGrid->getProbes().size();
+
+        displayText("Allocated bricks: {0} / {1}", stats.allocatedBrickCount, stats.brickCount);
+        displayText("Relocated probes: {0} / {1}", stats.relocatedProbeCount, probeCount);
+        displayText("Inactive probes: {0} / {1}", stats.inactiveProbeCount, probeCount);
+        // every capture phase skips the inactive probes
+        displayText("Captures saved: {0} per capture phase", stats.inactiveProbeCount);
+        displayText("Placement: {0} rays in {1:.2f} ms", stats.rayCount, stats.seconds * 1000.0);
+    }
+
+    if (m_probeBake && ImGui::CollapsingHeader("Probe Bake", ImGuiTreeNodeFlags_Framed))
+    {
+        const ProbeBake::Statistics &stats = m_probeBake->getStatistics();
+
+        displayText("File: {0}", m_probeBake->getFilename());
+        displayText("Key: {0:016x}", m_probeBake->getKey());
+        ImGui::Text(stats.loaded ? "Probes loaded from the bake" : "Probes captured");
+        if (stats.loaded || stats.saved)
+        {
+            displayText("{0} KiB {1} in {2:.2f} ms", stats.byteCount / 1024, stats.saved ? "saved" : "loaded",
+                        stats.seconds * 1000.0);
+        }
+        if (ImGui::Button("Bake probes"))
+            m_shouldBakeProbes = true;
+    }
+
+    // the radiance of a probe is 2^shift frames old at most
+    auto displayGatherSchedule = [](auto *script) {
+        int periodShift = static_cast<int>(script->getTemporalPeriodShift());
+        if (ImGui::SliderInt("Gather period shift", &periodShift, 0, 4))
+            script->setTemporalPeriodShift(static_cast<uint32_t>(periodShift));
+        displayText("Probes gathered per frame: {0} / {1}", script->getGatheredProbeCountPerFrame(),
+                    script->getTotalProbeCount());
+    };
+
+    auto radianceCascades2D = m_scene->getReadOnlyInstancedComponents<RadianceCascades>();
+    if (!radianceCascades2D.empty() && ImGui::CollapsingHeader("Radiance Cascades 2D", ImGuiTreeNodeFlags_Framed))
+    {
+        displayGatherSchedule(radianceCascades2D[0]);
+
+        // the final image upsamples the indirect light, see GPU Timings for the cost of each resolution
+        const char *resolutions[] = {"Full", "Half", "Quarter"};
+        const uint32_t divisor = radianceCascades2D[0]->getIndirectResolutionDivisor();
+        int resolutionIndex = divisor >= 4u ? 2 : (divisor >= 2u ? 1 : 0);
+        if (ImGui::Combo("Indirect resolution", &resolutionIndex, resolutions, IM_ARRAYSIZE(resolutions)))
+            radianceCascades2D[0]->setIndirectResolutionDivisor(1u << resolutionIndex);
+    }
+
+    auto radianceCascades = m_scene->getReadOnlyInstancedComponents<RadianceCascades3D>();
+    if (!radianceCascades.empty() && ImGui::CollapsingHeader("Radiance Cascades", ImGuiTreeNodeFlags_Framed))
+    {
+        displayGatherSchedule(radianceCascades[0]);
+
+        const std::vector<RadianceCascades3D::CascadeStatistics> &cascades =
+            radianceCascades[0]->getCascadeStatistics();
+        for (size_t i = 0; i < cascades.size(); ++i)
+        {
+            displayText("Cascade {0}: {1} probes, {2} intervals, {3} KiB", i, cascades[i].probeCount,
+                        cascades[i].intervalCount, cascades[i].memoryBytes / 1024);
+        }
+
+        // only filled when the radiance is gathered on the CPU
+        const RadianceCascades3D::GatherStatistics &stats = radianceCascades[0]->getGatherStatistics();
+        if (stats.threadCount > 0u)
+        {
+            // fewer threads show how the gather scales with the core count, 0 uses all of them
+            int threadLimit = static_cast<int>(radianceCascades[0]->getCpuGatherThreadLimit());
+            if (ImGui::SliderInt("Gather thread limit", &threadLimit, 0,
+                                 static_cast<int>(m_jobSystem->getThreadCount())))
+                radianceCascades[0]->setCpuGatherThreadLimit(static_cast<uint32_t>(threadLimit));
+
+            for (size_t i = 0; i < cascades.size(); ++i)
+            {
+                displayText("Cascade {0} gather: {1:.2f} ms, {2} rays", i, cascades[i].gatherSeconds * 1000.0,
+                            cascades[i].rayCount);
+            }
+
+            double raysPerSecond = stats.seconds > 0.0 ? double(stats.rayCount) / stats.seconds : 0.0;
+            displayText("Rays: {0} in {1:.2f} ms", stats.rayCount, stats.seconds * 1000.0);
+            displayText("Threads: {0}", stats.threadCount);
+            displayText("Mrays/s: {0:.2f} ({1:.2f} per core)", raysPerSecond / 1e6,
+                        raysPerSecond / 1e6 / stats.threadCount);
+        }
+    }
+
     ImGui::End();
 
     return 0;
@@ -267,6 +508,11 @@ int Application::runLoop()
 
     bool show_demo_window = true;
 
+    const auto loadBegin = std::chrono::steady_clock::now();
+
+    // the previous scene is destroyed, its objects may leave their addresses to those of this one
+    m_resourceRegistry->beginSceneSwitch();
+
     RendererBuilder rb;
     rb.setDevice(m_discreteDevice);
     rb.setSwapChain(m_window->getSwapChain());
@@ -275,39 +521,41 @@ int Application::runLoop()
     switch (sceneIndex)
     {
     case 0:
-        rb.setRenderGraph(
-            RenderGraphLoader::load<GraphG2IP>(m_discreteDevice, m_window.get(), bufferingType, maxProbeCount));
+        rb.setRenderGraph(RenderGraphLoader::load<GraphG2IP>(m_discreteDevice, m_window.get(), bufferingType,
+                                                             maxProbeCount, m_resourceRegistry.get()));
         m_renderer = rb.build();
         m_scene = SceneABC::load<SceneG2IP>(m_context, m_discreteDevice, m_window.get(), m_renderer->getRenderGraph(),
-                                            bufferingType, maxProbeCount);
+                                            bufferingType, maxProbeCount, m_jobSystem.get(), m_resourceRegistry.get());
         break;
     case 1:
-        rb.setRenderGraph(
-            RenderGraphLoader::load<GraphG2IPRT>(m_discreteDevice, m_window.get(), bufferingType, maxProbeCount));
+        rb.setRenderGraph(RenderGraphLoader::load<GraphG2IPRT>(m_discreteDevice, m_window.get(), bufferingType,
+                                                               maxProbeCount, m_resourceRegistry.get()));
         m_renderer = rb.build();
         m_scene = SceneABC::load<SceneG2IPRT>(m_context, m_discreteDevice, m_window.get(), m_renderer->getRenderGraph(),
-                                              bufferingType, maxProbeCount);
+                                              bufferingType, maxProbeCount, m_jobSystem.get(),
+                                              m_resourceRegistry.get());
         break;
     case 2:
-        rb.setRenderGraph(
-            RenderGraphLoader::load<GraphRC2D>(m_discreteDevice, m_window.get(), bufferingType, maxProbeCount));
+        rb.setRenderGraph(RenderGraphLoader::load<GraphRC2D>(m_discreteDevice, m_window.get(), bufferingType,
+                                                             maxProbeCount, m_resourceRegistry.get()));
         m_renderer = rb.build();
         m_scene = SceneABC::load<SceneRC2D>(m_context, m_discreteDevice, m_window.get(), m_renderer->getRenderGraph(),
-                                            bufferingType, maxProbeCount);
+                                            bufferingType, maxProbeCount, m_jobSystem.get(), m_resourceRegistry.get());
         break;
     case 3:
-        rb.setRenderGraph(
-            RenderGraphLoader::load<GraphRC3D>(m_discreteDevice, m_window.get(), bufferingType, maxProbeCount));
+        rb.setRenderGraph(RenderGraphLoader::load<GraphRC3D>(m_discreteDevice, m_window.get(), bufferingType,
+                                                             maxProbeCount, m_resourceRegistry.get()));
         m_renderer = rb.build();
         m_scene = SceneABC::load<SceneRC3D>(m_context, m_discreteDevice, m_window.get(), m_renderer->getRenderGraph(),
-                                            bufferingType, maxProbeCount);
+                                            bufferingType, maxProbeCount, m_jobSystem.get(), m_resourceRegistry.get());
         break;
     case 4:
-        rb.setRenderGraph(
-            RenderGraphLoader::load<GraphRC3DRT>(m_discreteDevice, m_window.get(), bufferingType, maxProbeCount));
+        rb.setRenderGraph(RenderGraphLoader::load<GraphRC3DRT>(m_discreteDevice, m_window.get(), bufferingType,
+                                                               maxProbeCount, m_resourceRegistry.get()));
         m_renderer = rb.build();
         m_scene = SceneABC::load<SceneRC3DRT>(m_context, m_discreteDevice, m_window.get(), m_renderer->getRenderGraph(),
-                                              bufferingType, maxProbeCount);
+                                              bufferingType, maxProbeCount, m_jobSystem.get(),
+                                              m_resourceRegistry.get());
         break;
     default:
         assert(false);
@@ -330,42 +578,85 @@ int Application::runLoop()
         initImgui(imguiPhase);
 
     auto &lights = m_scene->getLights();
-    std::shared_ptr<ProbeGrid> grid = nullptr;
+    m_probeGrid = nullptr;
+    m_probeBake = nullptr;
     if (SceneG2IP *sc = dynamic_cast<SceneG2IP *>(m_scene.get()))
-        grid = sc->m_grid;
+    {
+        m_probeGrid = sc->m_grid;
+        m_probeBake = sc->m_probeBake.get();
+    }
     else if (SceneG2IPRT *sc = dynamic_cast<SceneG2IPRT *>(m_scene.get()))
-        grid = sc->m_grid;
-    else if (SceneRC3D *sc = dynamic_cast<SceneRC3D *>(m_scene.get()))
-        grid = sc->m_grid0;
-    else if (SceneRC3DRT *sc = dynamic_cast<SceneRC3DRT *>(m_scene.get()))
-        grid = sc->m_grid0;
+        m_probeGrid = sc->m_grid;
 
     CameraABC *mainCamera = m_scene->getMainCamera();
 
     vkDeviceWaitIdle(m_discreteDevice->getHandle());
 
+    // the resources of the previous scene that this one does not share have been kept until now
+    m_resourceRegistry->endSceneSwitch();
+    m_sceneLoadSeconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - loadBegin).count();
+
     m_scene->beginSimulation();
+    uint32_t sceneFrameCount = 0u;
+
+    // the textures are streamed for the main camera and the probe captures, both rendered at the swapchain extent
+    std::vector<TextureStreamer::ViewT> streamingViews;
+    streamingViews.reserve(1u + (m_probeGrid ? m_probeGrid->getProbes().size() : 0u));
     while (!m_window->shouldClose())
     {
         ZoneScoped;
 
+        const uint64_t frameAllocationCount = HeapCounter::getAllocationCount();
+
         m_timeManager.markFrame();
         float deltaTime = m_timeManager.deltaTime();
 
         if (displayImgui())
             break;
 
+        // saving the bake allocates, the frame is not checked
+        const bool bBakedProbes = m_shouldBakeProbes;
+        if (m_shouldBakeProbes)
+        {
+            // the baked textures are moved to transfer layouts, no frame in flight may sample them
+            vkDeviceWaitIdle(m_discreteDevice->getHandle());
+            m_probeBake->save();
+            m_shouldBakeProbes = false;
+        }
+
         m_inputManager.UpdateInputStates();
         m_window->pollEvents();
 
         m_scene->updateSimulation(deltaTime);
 
+        const float viewportHeight = static_cast<float>(m_window->getSwapChain()->getExtent().height);
+        streamingViews.clear();
+        streamingViews.push_back(TextureStreamer::makeView(*mainCamera, viewportHeight));
+        if (m_probeGrid)
+        {
+            for (const std::unique_ptr<Probe> &probe : m_probeGrid->getProbes())
+            {
+                if (!probe->active)
+                    continue;
+
+                // a cube face covers 90 degrees
+                streamingViews.push_back(TextureStreamer::ViewT{
+                    .position = probe->position,
+                    .projectionScale = 1.f,
+                    .viewportHeight = viewportHeight,
+                });
+            }
+        }
+        m_resourceRegistry->getTextureStreamer()->update(m_scene->getObjects(), streamingViews);
+
+        const uint64_t renderAllocationCount = HeapCounter::getAllocationCount();
         VkResult res = m_renderer->renderFrame(
             VkRect2D{
                 .offset = {0, 0},
                 .extent = m_window->getSwapChain()->getExtent(),
             },
-            *mainCamera, lights, grid);
+            *mainCamera, lights, m_probeGrid);
+        m_renderHeapAllocationCount = HeapCounter::getAllocationCount() - renderAllocationCount;
         if (res == VK_ERROR_OUT_OF_DATE_KHR || res == VK_SUBOPTIMAL_KHR)
         {
             m_window->recreateSwapChain();
@@ -376,6 +667,14 @@ int Application::runLoop()
 
         m_window->swapBuffers();
 
+        m_frameHeapAllocationCount = HeapCounter::getAllocationCount() - frameAllocationCount;
+#ifdef ASSERT_NO_FRAME_HEAP_ALLOCATIONS
+        // recreating the swapchain allocates, as the first frames of a scene do
+        assert(sceneFrameCount < heapWarmUpFrameCount || res != VK_SUCCESS || bBakedProbes ||
+               m_frameHeapAllocationCount == 0u);
+#endif
+        sceneFrameCount++;
+
         FrameMark;
 
         static int frameCounter = 0;
@@ -392,6 +691,9 @@ int Application::runLoop()
 
     m_window->recreateSwapChain();
     m_renderer.reset();
+    m_probeGrid.reset();
+    m_probeBake = nullptr;
+    m_shouldBakeProbes = false;
     m_scene.reset();
 
     sceneIndex = (sceneIndex + 1) % sceneCount;
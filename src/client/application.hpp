@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <memory>
 #include <vector>
 
@@ -14,6 +15,10 @@ class SceneABC;
 class RenderPhase;
 class ComputePhase;
 class Texture;
+class ProbeGrid;
+class ProbeBake;
+class JobSystem;
+class ResourceRegistry;
 
 namespace ImGuiUtils
 {
@@ -32,12 +37,44 @@ class Application
     std::shared_ptr<Renderer> m_renderer;
 
     std::unique_ptr<SceneABC> m_scene;
+    /**
+     * @brief probes of the current scene, null if it has none
+     *
+     */
+    std::shared_ptr<ProbeGrid> m_probeGrid;
+    /**
+     * @brief probe data of the current scene stored on disk, null if it cannot be baked
+     *
+     */
+    ProbeBake *m_probeBake = nullptr;
+    /**
+     * @brief the probes are baked between two frames, once the device is idle
+     *
+     */
+    bool m_shouldBakeProbes = false;
 
     std::shared_ptr<ImGuiUtils::ProfilersWindow> m_profiler;
 
     Time::TimeManager m_timeManager;
     InputManager m_inputManager;
 
+    /**
+     * @brief one worker per hardware thread besides the main thread, shared by every scene
+     *
+     */
+    std::unique_ptr<JobSystem> m_jobSystem;
+
+    /**
+     * @brief assets of the scenes kept across scene switches
+     *
+     */
+    std::unique_ptr<ResourceRegistry> m_resourceRegistry;
+    /**
+     * @brief time to build the renderer and the scene, the previous scene being destroyed
+     *
+     */
+    float m_sceneLoadSeconds = 0.f;
+
     /**
      * @brief exit the main loop after a certain amount of frame
      * -1 to deactivate breakage
@@ -45,6 +82,13 @@ class Application
      */
     int m_breakAfterFrameCount = -1;
 
+    /**
+     * @brief heap allocations of the last frame, and of its rendering only
+     *
+     */
+    uint64_t m_frameHeapAllocationCount = 0u;
+    uint64_t m_renderHeapAllocationCount = 0u;
+
     void initImgui(RenderPhase *imguiPhase);
     int displayImgui();
 
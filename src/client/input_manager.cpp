@@ -15,8 +15,9 @@ InputManager::InputManager()
 {
 	currentInstance = this;
 
-	for (auto& key : m_keys)
-		key.second.Set(false, false, false);
+	// every key is inserted up front, the scripts read the keys from several threads
+	for (Keycode key : keycodes)
+		m_keys[key].Set(false, false, false);
 }
 
 
@@ -47,15 +48,18 @@ void InputManager::UpdateInputStates()
 
 bool InputManager::GetKeyDown(Keycode key)
 {
-	return currentInstance->m_keys[key].Down();
+	auto it = currentInstance->m_keys.find(key);
+	return it != currentInstance->m_keys.end() && it->second.Down();
 }
 
 bool InputManager::GetKey(Keycode key)
 {
-	return currentInstance->m_keys[key].Held();
+	auto it = currentInstance->m_keys.find(key);
+	return it != currentInstance->m_keys.end() && it->second.Held();
 }
 
 bool InputManager::GetKeyUp(Keycode key)
 {
-	return currentInstance->m_keys[key].Up();
+	auto it = currentInstance->m_keys.find(key);
+	return it != currentInstance->m_keys.end() && it->second.Up();
 }
\ No newline at end of file
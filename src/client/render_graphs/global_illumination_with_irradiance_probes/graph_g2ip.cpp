@@ -1,11 +1,15 @@
+#include <cmath>
+
 #include "graphics/device.hpp"
 #include "graphics/render_pass.hpp"
 
+#include "renderer/render_graph_resources.hpp"
 #include "renderer/render_phase.hpp"
 #include "renderer/texture.hpp"
 
 #include "wsi/window.hpp"
 
+#include "graph_g2ip_accesses.hpp"
 #include "graph_g2ip.hpp"
 
 void GraphG2IP::load(std::weak_ptr<Device> device, WindowGLFW *window, uint32_t frameInFlightCount,
@@ -17,6 +21,21 @@ void GraphG2IP::load(std::weak_ptr<Device> device, WindowGLFW *window, uint32_t
 
     TextureDirector td;
 
+    // steps of the phases in the graph, the one-time phases come first
+    enum StepE : uint32_t
+    {
+        OPAQUE_CAPTURE_STEP = 0u,
+        SKYBOX_CAPTURE_STEP,
+        PROBE_DISTANCE_CAPTURE_STEP,
+        IRRADIANCE_ATLAS_STEP,
+        VISIBILITY_ATLAS_STEP,
+        OPAQUE_STEP,
+        PROBES_DEBUG_STEP,
+        SKYBOX_STEP,
+        FINAL_DIRECT_STEP,
+        IMGUI_STEP,
+    };
+
     // Capture environment map
     for (int i = 0; i < maxProbeCount; i++)
     {
@@ -25,12 +44,117 @@ void GraphG2IP::load(std::weak_ptr<Device> device, WindowGLFW *window, uint32_t
         captureEnvMapBuilder.setWidth(256);
         captureEnvMapBuilder.setHeight(256);
         captureEnvMapBuilder.setCreateFromUserData(false);
-        captureEnvMapBuilder.setDepthImageEnable(true);
         captureEnvMapBuilder.setInitialLayout(VK_IMAGE_LAYOUT_PREINITIALIZED);
         td.configureUNORMTextureBuilder(captureEnvMapBuilder);
         m_capturedEnvMaps.push_back(captureEnvMapBuilder.buildAndRestart());
     }
 
+    // Capture depth, only used by the capture phases and released once they are done
+    const VkFormat captureDepthFormat = VK_FORMAT_D32_SFLOAT_S8_UINT;
+    std::vector<RenderGraphResources::ResourceId> captureDepths;
+    for (int i = 0; i < maxProbeCount; i++)
+    {
+        RenderGraphResources::ResourceId captureDepth = m_resources->declareTransientImage(TransientImageDesc{
+            .name = "Capture Depth",
+            .format = captureDepthFormat,
+            .extent = {256u, 256u},
+            .cube = true,
+            .usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+            .aspectFlags = VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT,
+        });
+        m_resources->declareAccess(captureDepth, OPAQUE_CAPTURE_STEP, G2IPImageAccesses::s_depthClearAccess);
+        m_resources->declareAccess(captureDepth, SKYBOX_CAPTURE_STEP, G2IPImageAccesses::s_depthLoadAccess);
+        captureDepths.push_back(captureDepth);
+    }
+
+    // Distance to the surfaces seen by the probes, a low resolution is enough once filtered
+    const uint32_t probeDistanceResolution = 64u;
+    const VkFormat momentsFormat = VK_FORMAT_R16G16_SFLOAT;
+    for (int i = 0; i < maxProbeCount; i++)
+    {
+        CubemapBuilder probeDistanceMapBuilder;
+        probeDistanceMapBuilder.setDevice(device);
+        probeDistanceMapBuilder.setWidth(probeDistanceResolution);
+        probeDistanceMapBuilder.setHeight(probeDistanceResolution);
+        probeDistanceMapBuilder.setCreateFromUserData(false);
+        probeDistanceMapBuilder.setFormat(momentsFormat);
+        probeDistanceMapBuilder.setTiling(VK_IMAGE_TILING_OPTIMAL);
+        probeDistanceMapBuilder.setSamplerFilter(VK_FILTER_LINEAR);
+        m_probeDistanceMaps.push_back(probeDistanceMapBuilder.buildAndRestart());
+    }
+
+    std::vector<RenderGraphResources::ResourceId> probeDistanceDepths;
+    for (int i = 0; i < maxProbeCount; i++)
+    {
+        RenderGraphResources::ResourceId probeDistanceDepth = m_resources->declareTransientImage(TransientImageDesc{
+            .name = "Probe Distance Depth",
+            .format = captureDepthFormat,
+            .extent = {probeDistanceResolution, probeDistanceResolution},
+            .cube = true,
+            .usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+            .aspectFlags = VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT,
+        });
+        m_resources->declareAccess(probeDistanceDepth, PROBE_DISTANCE_CAPTURE_STEP,
+                                   G2IPImageAccesses::s_depthClearAccess);
+        probeDistanceDepths.push_back(probeDistanceDepth);
+    }
+
+    // Atlases, square grids of tiles with a border so that a bilinear fetch never reads the next probe
+    const uint32_t tilesPerRow = static_cast<uint32_t>(std::ceil(std::sqrt((float)maxProbeCount)));
+    auto buildAtlas = [&](uint32_t tileSize, const std::string &name) {
+        TextureBuilder atlasBuilder;
+        atlasBuilder.setDevice(device);
+        atlasBuilder.setWidth(tilesPerRow * (tileSize + 2u));
+        atlasBuilder.setHeight(tilesPerRow * (tileSize + 2u));
+        atlasBuilder.setFormat(VK_FORMAT_R16G16B16A16_SFLOAT);
+        atlasBuilder.setTiling(VK_IMAGE_TILING_OPTIMAL);
+        atlasBuilder.setSamplerFilter(VK_FILTER_LINEAR);
+        atlasBuilder.setStorageEnable(true);
+        atlasBuilder.setName(name);
+        return std::shared_ptr<Texture>(atlasBuilder.buildAndRestart());
+    };
+    m_irradianceAtlas = buildAtlas(s_irradianceTileSize, "Irradiance Atlas");
+    m_visibilityAtlas = buildAtlas(s_visibilityTileSize, "Visibility Atlas");
+
+    // written once by the compute phases, read by the opaque phase every frame
+    const ImageAccess atlasWriteAccess = {
+        .layout = VK_IMAGE_LAYOUT_GENERAL,
+        .finalLayout = VK_IMAGE_LAYOUT_GENERAL,
+        .stageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        .accessMask = VK_ACCESS_SHADER_WRITE_BIT,
+    };
+    const ImageAccess atlasReadAccess = {
+        .layout = VK_IMAGE_LAYOUT_GENERAL,
+        .finalLayout = VK_IMAGE_LAYOUT_GENERAL,
+        .stageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+        .accessMask = VK_ACCESS_SHADER_READ_BIT,
+    };
+
+    const RenderGraphResources::ResourceId irradianceAtlas = m_resources->declareExternalImage(
+        "Irradiance Atlas", [this](uint32_t imageIndex) { return m_irradianceAtlas->getImageHandle(); },
+        VK_IMAGE_ASPECT_COLOR_BIT);
+    m_resources->declareAccess(irradianceAtlas, IRRADIANCE_ATLAS_STEP, atlasWriteAccess);
+    m_resources->declareAccess(irradianceAtlas, OPAQUE_STEP, atlasReadAccess);
+    m_resources->declareAccess(irradianceAtlas, PROBES_DEBUG_STEP, atlasReadAccess);
+
+    const RenderGraphResources::ResourceId visibilityAtlas = m_resources->declareExternalImage(
+        "Visibility Atlas", [this](uint32_t imageIndex) { return m_visibilityAtlas->getImageHandle(); },
+        VK_IMAGE_ASPECT_COLOR_BIT);
+    m_resources->declareAccess(visibilityAtlas, VISIBILITY_ATLAS_STEP, atlasWriteAccess);
+    m_resources->declareAccess(visibilityAtlas, OPAQUE_STEP, atlasReadAccess);
+
+    G2IPImageAccesses::declareSwapchainAccesses(*m_resources, window,
+                                                G2IPImageAccesses::ForwardStepsT{
+                                                    .opaque = OPAQUE_STEP,
+                                                    .probesDebug = PROBES_DEBUG_STEP,
+                                                    .skybox = SKYBOX_STEP,
+                                                    .finalDirect = FINAL_DIRECT_STEP,
+                                                    .imgui = IMGUI_STEP,
+                                                });
+
+    if (!m_resources->compile())
+        return;
+
     // Opaque capture
     RenderPassBuilder opaqueCaptureRpb;
     opaqueCaptureRpb.setDevice(device);
@@ -43,10 +167,12 @@ void GraphG2IP::load(std::weak_ptr<Device> device, WindowGLFW *window, uint32_t
     opaqueCaptureRpb.addColorAttachment(*opaqueCaptureColorAttachment);
 
     rpad.configureAttachmentClearBuilder(rpab);
-    rpab.setFormat(m_capturedEnvMaps[0]->getDepthImageFormat().value());
+    rpab.setFormat(captureDepthFormat);
     rpab.setFinalLayout(VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
     auto opaqueCaptureDepthAttachment = rpab.buildAndRestart();
     opaqueCaptureRpb.addDepthAttachment(*opaqueCaptureDepthAttachment);
+    for (RenderGraphResources::ResourceId captureDepth : captureDepths)
+        opaqueCaptureRpb.addPooledDepthAttachment(m_resources->getImageView(captureDepth));
 
     RenderPhaseBuilder<RenderTypeE::RASTER> opaqueCaptureRb;
     opaqueCaptureRb.setDevice(device);
@@ -70,11 +196,13 @@ void GraphG2IP::load(std::weak_ptr<Device> device, WindowGLFW *window, uint32_t
     skyboxCaptureRpb.addColorAttachment(*skyboxCaptureColorAttachment);
 
     rpad.configureAttachmentLoadBuilder(rpab);
-    rpab.setFormat(m_capturedEnvMaps[0]->getDepthImageFormat().value());
+    rpab.setFormat(captureDepthFormat);
     rpab.setInitialLayout(VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
     rpab.setFinalLayout(VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
     auto skyboxCaptureDepthAttachment = rpab.buildAndRestart();
     skyboxCaptureRpb.addDepthAttachment(*skyboxCaptureDepthAttachment);
+    for (RenderGraphResources::ResourceId captureDepth : captureDepths)
+        skyboxCaptureRpb.addPooledDepthAttachment(m_resources->getImageView(captureDepth));
 
     RenderPhaseBuilder<RenderTypeE::RASTER> skyboxCaptureRb;
     skyboxCaptureRb.setDevice(device);
@@ -85,37 +213,56 @@ void GraphG2IP::load(std::weak_ptr<Device> device, WindowGLFW *window, uint32_t
     auto skyboxCapturePhase = skyboxCaptureRb.build();
     m_skyboxCapturePhase = skyboxCapturePhase.get();
 
-    // Irradiance cubemap
-    for (int i = 0; i < maxProbeCount; i++)
+    // Probe distance capture
+    RenderPassBuilder probeDistanceCaptureRpb;
+    probeDistanceCaptureRpb.setDevice(device);
+    rpd.configurePooledCubemapsRenderPassBuilder(probeDistanceCaptureRpb, m_probeDistanceMaps, true);
+
+    rpad.configureAttachmentClearBuilder(rpab);
+    rpab.setFormat(momentsFormat);
+    rpab.setFinalLayout(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    auto probeDistanceColorAttachment = rpab.buildAndRestart();
+    probeDistanceCaptureRpb.addColorAttachment(*probeDistanceColorAttachment);
+
+    rpad.configureAttachmentClearBuilder(rpab);
+    rpab.setFormat(captureDepthFormat);
+    rpab.setFinalLayout(VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+    auto probeDistanceDepthAttachment = rpab.buildAndRestart();
+    probeDistanceCaptureRpb.addDepthAttachment(*probeDistanceDepthAttachment);
+    for (RenderGraphResources::ResourceId probeDistanceDepth : probeDistanceDepths)
+        probeDistanceCaptureRpb.addPooledDepthAttachment(m_resources->getImageView(probeDistanceDepth));
+
+    RenderPhaseBuilder<RenderTypeE::RASTER> probeDistanceCaptureRb;
+    probeDistanceCaptureRb.setDevice(device);
+    probeDistanceCaptureRb.setRenderPass(probeDistanceCaptureRpb.build());
+    probeDistanceCaptureRb.setCaptureEnable(true);
+    // the sky is seen as a surface far away, its squared distance must fit in a half float
+    probeDistanceCaptureRb.setClearColor({{s_probeMaxDistance, s_probeMaxDistance * s_probeMaxDistance, 0.f, 0.f}});
+    probeDistanceCaptureRb.setBufferingType(frameInFlightCount);
+    probeDistanceCaptureRb.setPhaseName("Probe distance capture");
+    auto probeDistanceCapturePhase = probeDistanceCaptureRb.build();
+    m_probeDistanceCapturePhase = probeDistanceCapturePhase.get();
+
+    // Irradiance and visibility atlases, one work group per probe
+    std::unique_ptr<ComputePhase> irradianceAtlasPhase;
     {
-        CubemapBuilder irradianceMapBuilder;
-        irradianceMapBuilder.setDevice(device);
-        irradianceMapBuilder.setWidth(128);
-        irradianceMapBuilder.setHeight(128);
-        irradianceMapBuilder.setCreateFromUserData(false);
-        irradianceMapBuilder.setResolveEnable(true);
-        td.configureUNORMTextureBuilder(irradianceMapBuilder);
-        m_irradianceMaps.push_back(irradianceMapBuilder.buildAndRestart());
+        ComputePhaseBuilder cpb;
+        cpb.setDevice(device);
+        cpb.setBufferingType(frameInFlightCount);
+        cpb.setPhaseName("Irradiance atlas");
+        irradianceAtlasPhase = cpb.build();
+        m_irradianceAtlasPhase = irradianceAtlasPhase.get();
     }
 
-    // Irradiance convolution
-    RenderPassBuilder irradianceConvolutionRpb;
-    irradianceConvolutionRpb.setDevice(device);
-    rpd.configurePooledCubemapsRenderPassBuilder(irradianceConvolutionRpb, m_irradianceMaps, true, false);
-    rpad.configureAttachmentDontCareBuilder(rpab);
-    rpab.setFormat(m_irradianceMaps[0]->getImageFormat());
-    rpab.setFinalLayout(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-    auto irradianceColorAttachment = rpab.buildAndRestart();
-    irradianceConvolutionRpb.addColorAttachment(*irradianceColorAttachment);
-
-    RenderPhaseBuilder<RenderTypeE::RASTER> irradianceConvolutionRb;
-    irradianceConvolutionRb.setDevice(device);
-    irradianceConvolutionRb.setRenderPass(irradianceConvolutionRpb.build());
-    irradianceConvolutionRb.setCaptureEnable(true);
-    irradianceConvolutionRb.setBufferingType(frameInFlightCount);
-    irradianceConvolutionRb.setPhaseName("Irradiance convolution");
-    auto irradianceConvolutionPhase = irradianceConvolutionRb.build();
-    m_irradianceConvolutionPhase = irradianceConvolutionPhase.get();
+    std::unique_ptr<ComputePhase> visibilityAtlasPhase;
+    {
+        ComputePhaseBuilder cpb;
+        cpb.setDevice(device);
+        cpb.setBufferingType(frameInFlightCount);
+        cpb.setPhaseName("Visibility atlas");
+        visibilityAtlasPhase = cpb.build();
+        m_visibilityAtlasPhase = visibilityAtlasPhase.get();
+    }
 
     // Opaque
     RenderPassBuilder opaqueRpb;
@@ -235,7 +382,9 @@ void GraphG2IP::load(std::weak_ptr<Device> device, WindowGLFW *window, uint32_t
 
     addOneTimeRenderPhase(std::move(opaqueCapturePhase));
     addOneTimeRenderPhase(std::move(skyboxCapturePhase));
-    addOneTimeRenderPhase(std::move(irradianceConvolutionPhase));
+    addOneTimeRenderPhase(std::move(probeDistanceCapturePhase));
+    addOneTimePhase(std::move(irradianceAtlasPhase));
+    addOneTimePhase(std::move(visibilityAtlasPhase));
 
     addRenderPhase(std::move(opaquePhase));
     addRenderPhase(std::move(probesDebugPhase));
@@ -3,10 +3,28 @@
 #include "renderer/render_graph.hpp"
 
 class RenderPhase;
+class ComputePhase;
 class Texture;
 
 class GraphG2IP final : public RenderGraph
 {
+  public:
+    /**
+     * @brief distance stored where a probe does not see any surface
+     *
+     */
+    static constexpr float s_probeMaxDistance = 200.f;
+    /**
+     * @brief texels per side of the octahedral irradiance of a probe, without the border
+     *
+     */
+    static constexpr uint32_t s_irradianceTileSize = 8u;
+    /**
+     * @brief texels per side of the octahedral distance moments of a probe, without the border
+     *
+     */
+    static constexpr uint32_t s_visibilityTileSize = 16u;
+
   private:
     void load(std::weak_ptr<Device> device, WindowGLFW *window, uint32_t frameInFlightCount,
               uint32_t maxProbeCount) override;
@@ -15,7 +33,22 @@ class GraphG2IP final : public RenderGraph
     RenderPhase *m_opaqueCapturePhase;
     RenderPhase *m_skyboxCapturePhase;
 
-    RenderPhase *m_irradianceConvolutionPhase;
+    /**
+     * @brief distance from the probes to the opaque surfaces, filtered into the visibility atlas
+     *
+     */
+    RenderPhase *m_probeDistanceCapturePhase;
+
+    /**
+     * @brief fills the irradiance atlas from the captured environment maps
+     *
+     */
+    ComputePhase *m_irradianceAtlasPhase;
+    /**
+     * @brief fills the visibility atlas from the probe distance maps
+     *
+     */
+    ComputePhase *m_visibilityAtlasPhase;
     RenderPhase *m_opaquePhase;
     RenderPhase *m_skyboxPhase;
 
@@ -30,7 +63,18 @@ class GraphG2IP final : public RenderGraph
     RenderPhase *m_probesDebugPhase;
 
     std::vector<std::shared_ptr<Texture>> m_capturedEnvMaps;
-    std::vector<std::shared_ptr<Texture>> m_irradianceMaps;
+    /**
+     * @brief octahedral irradiance of every probe in one texture, a tile with a one texel border per probe
+     *
+     */
+    std::shared_ptr<Texture> m_irradianceAtlas;
+    std::vector<std::shared_ptr<Texture>> m_probeDistanceMaps;
+    /**
+     * @brief mean distance and squared distance around each direction, weights the probes by their visibility
+     * laid out as the irradiance atlas with larger tiles
+     *
+     */
+    std::shared_ptr<Texture> m_visibilityAtlas;
 
   public:
 };
\ No newline at end of file
@@ -0,0 +1,62 @@
+#include "graphics/swapchain.hpp"
+
+#include "wsi/window.hpp"
+
+#include "graph_g2ip_accesses.hpp"
+
+void G2IPImageAccesses::declareSwapchainAccesses(RenderGraphResources &resources, WindowGLFW *window,
+                                                 const ForwardStepsT &steps)
+{
+    resources.setFirstPerFrameStep(steps.opaque);
+
+    // Swapchain, drawn by every per frame phase one after the other
+    const RenderGraphResources::ResourceId swapchainColor = resources.declareExternalImage(
+        "Swapchain Color", [window](uint32_t imageIndex) { return window->getSwapChain()->getImages()[imageIndex]; },
+        VK_IMAGE_ASPECT_COLOR_BIT);
+    const RenderGraphResources::ResourceId swapchainDepth = resources.declareExternalImage(
+        "Swapchain Depth", [window](uint32_t imageIndex) { return window->getSwapChain()->getDepthImage(); },
+        VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT);
+
+    resources.declareAccess(swapchainColor, steps.opaque,
+                            ImageAccess{
+                                .layout = VK_IMAGE_LAYOUT_UNDEFINED,
+                                .finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                                .stageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                                .accessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                            });
+    resources.declareAccess(swapchainDepth, steps.opaque, s_depthClearAccess);
+
+    resources.declareAccess(swapchainColor, steps.probesDebug, s_colorLoadAccess);
+    resources.declareAccess(swapchainDepth, steps.probesDebug,
+                            ImageAccess{
+                                .layout = VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_STENCIL_READ_ONLY_OPTIMAL,
+                                .finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                                .stageMask = s_depthLoadAccess.stageMask,
+                                .accessMask = s_depthLoadAccess.accessMask,
+                            });
+
+    resources.declareAccess(swapchainColor, steps.skybox, s_colorLoadAccess);
+    resources.declareAccess(swapchainDepth, steps.skybox, s_depthLoadAccess);
+
+    // the final image samples the image it draws on
+    resources.declareAccess(
+        swapchainColor, steps.finalDirect,
+        ImageAccess{
+            .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            .finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            .stageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            .accessMask = VK_ACCESS_SHADER_READ_BIT | s_colorLoadAccess.accessMask,
+        });
+
+    resources.declareAccess(swapchainColor, steps.imgui,
+                            ImageAccess{
+                                .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                                .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                                .stageMask = s_colorLoadAccess.stageMask,
+                                .accessMask = s_colorLoadAccess.accessMask,
+                            });
+
+    // every dependency between the per frame phases is declared above
+    for (uint32_t step : {steps.probesDebug, steps.skybox, steps.finalDirect, steps.imgui})
+        resources.setBarrierOnlyDependency(step, true);
+}
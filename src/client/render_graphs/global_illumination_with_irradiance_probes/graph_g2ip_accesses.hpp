@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+
+#include "renderer/render_graph_resources.hpp"
+
+class WindowGLFW;
+
+/**
+ * @brief uses of the images declared by both irradiance probes graphs
+ *
+ */
+struct G2IPImageAccesses
+{
+    static constexpr ImageAccess s_depthClearAccess = {
+        .layout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+        .stageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+        .accessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+    };
+    static constexpr ImageAccess s_depthLoadAccess = {
+        .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+        .finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+        .stageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+        .accessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+    };
+    static constexpr ImageAccess s_colorLoadAccess = {
+        .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .stageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        .accessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+    };
+
+    /**
+     * @brief steps of the per frame phases, in submission order, the opaque phase is the first one
+     *
+     */
+    struct ForwardStepsT
+    {
+        uint32_t opaque;
+        uint32_t probesDebug;
+        uint32_t skybox;
+        uint32_t finalDirect;
+        uint32_t imgui;
+    };
+
+    /**
+     * @brief declare the per frame steps and how they draw on the swapchain one after the other
+     * every dependency between them is declared, the semaphores between them are replaced by barriers
+     *
+     */
+    static void declareSwapchainAccesses(RenderGraphResources &resources, WindowGLFW *window,
+                                         const ForwardStepsT &steps);
+};
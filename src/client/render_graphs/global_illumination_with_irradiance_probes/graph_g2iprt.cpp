@@ -1,11 +1,13 @@
 #include "graphics/device.hpp"
 #include "graphics/render_pass.hpp"
 
+#include "renderer/render_graph_resources.hpp"
 #include "renderer/render_phase.hpp"
 #include "renderer/texture.hpp"
 
 #include "wsi/window.hpp"
 
+#include "graph_g2ip_accesses.hpp"
 #include "graph_g2iprt.hpp"
 
 void GraphG2IPRT::load(std::weak_ptr<Device> device, WindowGLFW *window, uint32_t frameInFlightCount,
@@ -17,6 +19,19 @@ void GraphG2IPRT::load(std::weak_ptr<Device> device, WindowGLFW *window, uint32_
 
     TextureDirector td;
 
+    // steps of the phases in the graph, the one-time phases come first
+    enum StepE : uint32_t
+    {
+        OPAQUE_CAPTURE_STEP = 0u,
+        SKYBOX_CAPTURE_STEP,
+        IRRADIANCE_CONVOLUTION_STEP,
+        OPAQUE_STEP,
+        PROBES_DEBUG_STEP,
+        SKYBOX_STEP,
+        FINAL_DIRECT_STEP,
+        IMGUI_STEP,
+    };
+
     // Capture environment map
     for (int i = 0; i < maxProbeCount; i++)
     {
@@ -25,12 +40,41 @@ void GraphG2IPRT::load(std::weak_ptr<Device> device, WindowGLFW *window, uint32_
         captureEnvMapBuilder.setWidth(256);
         captureEnvMapBuilder.setHeight(256);
         captureEnvMapBuilder.setCreateFromUserData(false);
-        captureEnvMapBuilder.setDepthImageEnable(true);
         captureEnvMapBuilder.setInitialLayout(VK_IMAGE_LAYOUT_PREINITIALIZED);
         td.configureUNORMTextureBuilder(captureEnvMapBuilder);
         m_capturedEnvMaps.push_back(captureEnvMapBuilder.buildAndRestart());
     }
 
+    // Capture depth, only used by the capture phases and released once they are done
+    const VkFormat captureDepthFormat = VK_FORMAT_D32_SFLOAT_S8_UINT;
+    std::vector<RenderGraphResources::ResourceId> captureDepths;
+    for (int i = 0; i < maxProbeCount; i++)
+    {
+        RenderGraphResources::ResourceId captureDepth = m_resources->declareTransientImage(TransientImageDesc{
+            .name = "Capture Depth",
+            .format = captureDepthFormat,
+            .extent = {256u, 256u},
+            .cube = true,
+            .usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+            .aspectFlags = VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT,
+        });
+        m_resources->declareAccess(captureDepth, OPAQUE_CAPTURE_STEP, G2IPImageAccesses::s_depthClearAccess);
+        m_resources->declareAccess(captureDepth, SKYBOX_CAPTURE_STEP, G2IPImageAccesses::s_depthLoadAccess);
+        captureDepths.push_back(captureDepth);
+    }
+
+    G2IPImageAccesses::declareSwapchainAccesses(*m_resources, window,
+                                                G2IPImageAccesses::ForwardStepsT{
+                                                    .opaque = OPAQUE_STEP,
+                                                    .probesDebug = PROBES_DEBUG_STEP,
+                                                    .skybox = SKYBOX_STEP,
+                                                    .finalDirect = FINAL_DIRECT_STEP,
+                                                    .imgui = IMGUI_STEP,
+                                                });
+
+    if (!m_resources->compile())
+        return;
+
     // Opaque capture
     RenderPassBuilder opaqueCaptureRpb;
     opaqueCaptureRpb.setDevice(device);
@@ -43,15 +87,18 @@ void GraphG2IPRT::load(std::weak_ptr<Device> device, WindowGLFW *window, uint32_
     opaqueCaptureRpb.addColorAttachment(*opaqueCaptureColorAttachment);
 
     rpad.configureAttachmentClearBuilder(rpab);
-    rpab.setFormat(m_capturedEnvMaps[0]->getDepthImageFormat().value());
+    rpab.setFormat(captureDepthFormat);
     rpab.setFinalLayout(VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
     auto opaqueCaptureDepthAttachment = rpab.buildAndRestart();
     opaqueCaptureRpb.addDepthAttachment(*opaqueCaptureDepthAttachment);
+    for (RenderGraphResources::ResourceId captureDepth : captureDepths)
+        opaqueCaptureRpb.addPooledDepthAttachment(m_resources->getImageView(captureDepth));
 
     RenderPhaseBuilder<RenderTypeE::RAYTRACE> opaqueCaptureRb;
     opaqueCaptureRb.setDevice(device);
     opaqueCaptureRb.setRenderPass(opaqueCaptureRpb.build());
     opaqueCaptureRb.setCaptureEnable(true);
+    opaqueCaptureRb.setAccelerationStructureCache(m_accelerationStructures.get());
     opaqueCaptureRb.setBufferingType(frameInFlightCount);
     opaqueCaptureRb.setPhaseName("Opaque Capture");
     auto opaqueCapturePhase = opaqueCaptureRb.build();
@@ -70,11 +117,13 @@ void GraphG2IPRT::load(std::weak_ptr<Device> device, WindowGLFW *window, uint32_
     skyboxCaptureRpb.addColorAttachment(*skyboxCaptureColorAttachment);
 
     rpad.configureAttachmentLoadBuilder(rpab);
-    rpab.setFormat(m_capturedEnvMaps[0]->getDepthImageFormat().value());
+    rpab.setFormat(captureDepthFormat);
     rpab.setInitialLayout(VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
     rpab.setFinalLayout(VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
     auto skyboxCaptureDepthAttachment = rpab.buildAndRestart();
     skyboxCaptureRpb.addDepthAttachment(*skyboxCaptureDepthAttachment);
+    for (RenderGraphResources::ResourceId captureDepth : captureDepths)
+        skyboxCaptureRpb.addPooledDepthAttachment(m_resources->getImageView(captureDepth));
 
     RenderPhaseBuilder<RenderTypeE::RASTER> skyboxCaptureRb;
     skyboxCaptureRb.setDevice(device);
@@ -138,6 +187,7 @@ void GraphG2IPRT::load(std::weak_ptr<Device> device, WindowGLFW *window, uint32_
     opaqueRb.setDevice(device);
     opaqueRb.setRenderPass(opaqueRpb.build());
     opaqueRb.setBufferingType(frameInFlightCount);
+    opaqueRb.setAccelerationStructureCache(m_accelerationStructures.get());
     opaqueRb.setPhaseName("Opaque RT");
     auto opaquePhase = opaqueRb.build();
     m_opaquePhase = static_cast<RayTracePhase *>(opaquePhase.get());
@@ -67,6 +67,8 @@ void GraphRC2D::load(std::weak_ptr<Device> device, WindowGLFW *window, uint32_t
         cpb.setDevice(device);
         cpb.setBufferingType(frameInFlightCount);
         cpb.setPhaseName("Compute");
+        // GPU duration shown in the user interface
+        cpb.setTimestampEnable(true);
         computePhase = cpb.build();
         m_computePhase = computePhase.get();
     }
@@ -87,6 +89,7 @@ void GraphRC2D::load(std::weak_ptr<Device> device, WindowGLFW *window, uint32_t
         phaseb.setDevice(device);
         phaseb.setRenderPass(passb.build());
         phaseb.setPhaseName("Final direct + indirect");
+        phaseb.setTimestampEnable(true);
         phaseb.setBufferingType(frameInFlightCount);
         postProcess2Phase = phaseb.build();
         m_finalImageDirectIndirect = postProcess2Phase.get();
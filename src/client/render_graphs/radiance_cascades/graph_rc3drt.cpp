@@ -40,6 +40,10 @@ void GraphRC3DRT::load(std::weak_ptr<Device> device, WindowGLFW *window, uint32_
         opaqueRb.setDevice(device);
         opaqueRb.setRenderPass(opaqueRpb.build());
         opaqueRb.setBufferingType(frameInFlightCount);
+        opaqueRb.setAccelerationStructureCache(m_accelerationStructures.get());
+        opaqueRb.setPhaseName("Opaque");
+        // overlapped by the async gather in the GPU timings
+        opaqueRb.setTimestampEnable(true);
         opaquePhase = opaqueRb.build();
         m_opaquePhase = static_cast<RayTracePhase *>(opaquePhase.get());
     }
@@ -95,6 +99,8 @@ void GraphRC3DRT::load(std::weak_ptr<Device> device, WindowGLFW *window, uint32_
         skyboxRb.setDevice(device);
         skyboxRb.setRenderPass(skyboxRpb.build());
         skyboxRb.setBufferingType(frameInFlightCount);
+        skyboxRb.setPhaseName("Skybox");
+        skyboxRb.setTimestampEnable(true);
         skyboxPhase = skyboxRb.build();
         m_skyboxPhase = skyboxPhase.get();
     }
@@ -123,7 +129,11 @@ void GraphRC3DRT::load(std::weak_ptr<Device> device, WindowGLFW *window, uint32_
         ComputePhaseBuilder cpb;
         cpb.setDevice(device);
         cpb.setBufferingType(frameInFlightCount);
-        cpb.setPhaseName("Compute");
+        cpb.setPhaseName("Compute (async)");
+        // GPU duration shown in the user interface
+        cpb.setTimestampEnable(true);
+        // the gather only reads the scene, it overlaps the rasterization of the frame on the compute queue
+        cpb.setAsyncEnable(true);
         computePhase = cpb.build();
         m_computePhase = computePhase.get();
     }
@@ -144,6 +154,8 @@ void GraphRC3DRT::load(std::weak_ptr<Device> device, WindowGLFW *window, uint32_
         phaseb.setDevice(device);
         phaseb.setRenderPass(passb.build());
         phaseb.setPhaseName("Final direct + indirect");
+        phaseb.setTimestampEnable(true);
+        phaseb.setAsyncComputeWait(m_computePhase);
         phaseb.setBufferingType(frameInFlightCount);
         postProcess2Phase = phaseb.build();
         m_finalImageDirectIndirect = postProcess2Phase.get();
@@ -170,11 +182,12 @@ void GraphRC3DRT::load(std::weak_ptr<Device> device, WindowGLFW *window, uint32_
         m_imguiPhase = imguiPhase.get();
     }
 
+    // submitted first so that the gather starts with the frame
+    addPhase(std::move(computePhase));
     addRenderPhase(std::move(opaquePhase));
     addRenderPhase(std::move(probesDebugPhase));
     addRenderPhase(std::move(skyboxPhase));
     addRenderPhase(std::move(postProcessPhase));
-    addPhase(std::move(computePhase));
     addRenderPhase(std::move(postProcess2Phase));
     addRenderPhase(std::move(imguiPhase));
 }
\ No newline at end of file
@@ -12,12 +12,14 @@
 #include "renderer/light.hpp"
 #include "renderer/mesh.hpp"
 #include "renderer/model.hpp"
+#include "renderer/probe_bake.hpp"
 #include "renderer/render_graph.hpp"
 #include "renderer/render_phase.hpp"
 #include "renderer/render_state.hpp"
 #include "renderer/skybox.hpp"
 #include "renderer/texture.hpp"
 
+#include "engine/bvh.hpp"
 #include "engine/camera.hpp"
 #include "engine/probe_grid.hpp"
 #include "engine/uniform.hpp"
@@ -30,6 +32,8 @@
 
 #include "scene_g2ip.hpp"
 
+SceneG2IP::~SceneG2IP() = default;
+
 void SceneG2IP::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, WindowGLFW *window,
                        RenderGraph *renderGraph, uint32_t frameInFlightCount, uint32_t maxProbeCount)
 {
@@ -63,19 +67,21 @@ void SceneG2IP::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
 
         SkyboxBuilder mainSb;
         mainSb.setDevice(device);
-        mainSb.setCubemap(ctb.buildAndRestart());
+        mainSb.setCubemap(getOrLoadResource<Texture>(
+            "assets/skybox:srgb", [&ctb]() { return std::shared_ptr<Texture>(ctb.buildAndRestart()); }));
         m_skybox = mainSb.buildAndRestart();
 
         ModelBuilder modelBuilder;
         modelBuilder.setDevice(device);
         modelBuilder.setModelFilename("assets/Sponza-master/sponza.glb");
+        modelBuilder.setResourceRegistry(m_resourceRegistry);
         modelBuilder.setName("Sponza");
         std::shared_ptr<Model> loadedModel = modelBuilder.build();
         Transform loadedModelTransform;
         loadedModelTransform.scale = glm::vec3(0.025f);
         loadedModel->setTransform(loadedModelTransform);
 
-        m_objects.push_back(loadedModel);
+        addObject(loadedModel);
         std::shared_ptr<PointLight> light = std::make_shared<PointLight>();
         light->position = glm::vec3(-4.0, 1.0, 0.0);
         light->attenuation = glm::vec3(0.0, 0.2, 0.0);
@@ -140,7 +146,7 @@ void SceneG2IP::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
         modelBuilder2.setMesh(mesh2);
         modelBuilder2.setName("Planes");
 
-        m_objects.push_back(modelBuilder2.build());
+        addObject(modelBuilder2.build());
 
         MeshBuilder sphereMb;
         md.createSphereMeshBuilder(sphereMb, 1.f, 50, 50);
@@ -154,77 +160,206 @@ void SceneG2IP::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
         Transform sphereTransform = sphereModel->getTransform();
         sphereTransform.position = glm::vec3(1.f, 1.f, 0.f);
         sphereModel->setTransform(sphereTransform);
-        m_objects.push_back(sphereModel);
+        addObject(sphereModel);
 
         MeshBuilder cubeMb;
         md.createAssimpMeshBuilder(cubeMb);
         cubeMb.setDevice(device);
         cubeMb.setModelFilename("assets/cube.obj");
-        std::shared_ptr<Mesh> cubeMesh = cubeMb.buildAndRestart();
+        std::shared_ptr<Mesh> cubeMesh = getOrLoadResource<Mesh>(
+            "assets/cube.obj:assimp", [&cubeMb]() { return std::shared_ptr<Mesh>(cubeMb.buildAndRestart()); });
 
         ModelBuilder cubeModelBuilder;
         cubeModelBuilder.setMesh(cubeMesh);
         cubeModelBuilder.setName("Cube");
 
-        m_objects.push_back(cubeModelBuilder.build());
+        addObject(cubeModelBuilder.build());
+    }
+
+    // probes, allocated by bricks close to the geometry and moved out of it before being captured
+    {
+        BVHBuilder bvhb;
+        for (const std::shared_ptr<Model> &object : m_objects)
+        {
+            glm::mat4 transform = object->getWorldMatrix();
+            for (const std::shared_ptr<Mesh> &mesh : object->getMeshes())
+                bvhb.addTriangles(mesh->getVertices(), mesh->getIndices(), transform);
+        }
+        std::unique_ptr<BVH> bvh = bvhb.build();
+
+        ProbeGridBuilder gridBuilder;
+        const glm::vec3 extent = glm::vec3(60.f, 10.f, 20.f);
+        const glm::vec3 cornerPosition = glm::vec3(extent.x * -0.5f, 0.f, extent.z * -0.5f);
+        gridBuilder.setXAxisProbeCount(8u);
+        gridBuilder.setYAxisProbeCount(4u);
+        gridBuilder.setZAxisProbeCount(4u);
+        gridBuilder.setExtent(extent);
+        gridBuilder.setCornerPosition(cornerPosition);
+        gridBuilder.setBrickSize(glm::uvec3(2u));
+        // one capture per probe
+        gridBuilder.setMaxProbeCount(maxProbeCount);
+        gridBuilder.setGeometry(bvh.get());
+        m_grid = gridBuilder.build();
     }
 
     GraphG2IP *rg = dynamic_cast<GraphG2IP *>(renderGraph);
+
+    // the probe table is written once, before the states bind it
+    rg->getSceneConstants()->setProbeGrid(*m_grid);
+
+    // the final probe data is uploaded from the last bake when it still matches the grid and the lights
+    bool probesBaked = false;
+    {
+        ProbeBakeBuilder pbb;
+        pbb.setFilename("cache/g2ip.probes");
+        pbb.setSceneName("g2ip");
+        pbb.setProbeGrid(m_grid);
+        pbb.setLights(m_lights);
+        pbb.addTexture(rg->m_irradianceAtlas);
+        pbb.addTexture(rg->m_visibilityAtlas);
+        m_probeBake = pbb.build();
+
+        probesBaked = m_probeBake && m_probeBake->load();
+        if (probesBaked)
+            rg->skipOneTimePhases();
+    }
+
     // load objects into render graph
     {
-        UniformDescriptorBuilder irradianceConvolutionUdb;
+        // irradiance and visibility atlases, filled once from the captured environment and distance maps
+        auto registerAtlasState = [&](const std::string &shaderName, ComputePhase *phase,
+                                      const std::shared_ptr<Texture> &atlas,
+                                      const std::vector<std::shared_ptr<Texture>> &capturedMaps) {
+            PipelineBuilder<PipelineTypeE::COMPUTE> pb;
+            PipelineDirector<PipelineTypeE::COMPUTE> pd;
+            pd.configureComputeBuilder(pb);
+            pb.setDevice(device);
+            pb.addComputeShaderStage(shaderName);
+            // sizes the array of captured maps
+            pb.addSpecializationConstant(0, maxProbeCount);
+            UniformDescriptorBuilder udb;
+            // atlas
+            udb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
+                .binding = 0,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            });
+            // captured maps
+            udb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
+                .binding = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .descriptorCount = maxProbeCount,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            });
+            pb.addUniformDescriptorPack(udb.buildAndRestart());
+            ComputeStateBuilder csb;
+            csb.setDevice(device);
+            csb.setFrameInFlightCount(frameInFlightCount);
+            csb.setPipeline(pb.build());
+            csb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+            csb.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxProbeCount);
+            // one work group per probe
+            csb.setWorkGroup(glm::ivec3(maxProbeCount, 1, 1));
+            const std::shared_ptr<ProbeGrid> grid = m_grid;
+            const std::shared_ptr<Texture> skyboxTexture = m_skybox->getTexture().lock();
+            csb.setDescriptorSetUpdatePred(
+                [=](const RenderPhase *parentPhase, const VkDescriptorSet set, uint32_t backBufferIndex) {
+                    VkDescriptorImageInfo atlasImageInfo = {
+                        .sampler = VK_NULL_HANDLE,
+                        .imageView = atlas->getImageView(),
+                        .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+                    };
+
+                    std::vector<VkDescriptorImageInfo> mapImageInfos;
+                    mapImageInfos.reserve(capturedMaps.size());
+                    for (uint32_t i = 0; i < capturedMaps.size(); ++i)
+                    {
+                        // the maps of an inactive probe are never captured, fill its tile from the sky
+                        const std::shared_ptr<Texture> &map = grid->isProbeActive(i) ? capturedMaps[i] : skyboxTexture;
+                        mapImageInfos.push_back(VkDescriptorImageInfo{
+                            .sampler = *map->getSampler(),
+                            .imageView = map->getImageView(),
+                            .imageLayout = map->getShaderReadLayout(),
+                        });
+                    }
+
+                    std::vector<VkWriteDescriptorSet> writes;
+                    writes.push_back(VkWriteDescriptorSet{
+                        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                        .dstSet = set,
+                        .dstBinding = 0,
+                        .dstArrayElement = 0,
+                        .descriptorCount = 1,
+                        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                        .pImageInfo = &atlasImageInfo,
+                    });
+                    writes.push_back(VkWriteDescriptorSet{
+                        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                        .dstSet = set,
+                        .dstBinding = 1,
+                        .dstArrayElement = 0,
+                        .descriptorCount = static_cast<uint32_t>(mapImageInfos.size()),
+                        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                        .pImageInfo = mapImageInfos.data(),
+                    });
+                    vkUpdateDescriptorSets(deviceHandle, writes.size(), writes.data(), 0, nullptr);
+                });
+            phase->registerComputeState(COMPUTE_STATE_PTR(csb.build()));
+        };
+        registerAtlasState("g2ip/irradiance_atlas", rg->m_irradianceAtlasPhase, rg->m_irradianceAtlas,
+                           rg->m_capturedEnvMaps);
+        registerAtlasState("g2ip/visibility_atlas", rg->m_visibilityAtlasPhase, rg->m_visibilityAtlas,
+                           rg->m_probeDistanceMaps);
 
-        irradianceConvolutionUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
+        UniformDescriptorBuilder probeDistanceUdb;
+        probeDistanceUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
             .binding = 0,
-            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
             .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
         });
 
-        irradianceConvolutionUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
-            .binding = 1,
-            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-            .descriptorCount = 1,
-            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
-        });
+        PipelineBuilder<PipelineTypeE::GRAPHICS> probeDistancePb;
+        probeDistancePb.setDevice(device);
+        probeDistancePb.addVertexShaderStage("g2ip/probe_distance");
+        probeDistancePb.addFragmentShaderStage("g2ip/probe_distance");
+        probeDistancePb.setRenderPass(rg->m_probeDistanceCapturePhase->getRenderPass());
+        probeDistancePb.setExtent(window->getSwapChain()->getExtent());
 
-        PipelineBuilder<PipelineTypeE::GRAPHICS> irradianceConvolutionPb;
-        irradianceConvolutionPb.setDevice(device);
-        irradianceConvolutionPb.addVertexShaderStage("skybox");
-        irradianceConvolutionPb.addFragmentShaderStage("g2ip/irradiance_convolution");
-        irradianceConvolutionPb.setRenderPass(rg->m_irradianceConvolutionPhase->getRenderPass());
-        irradianceConvolutionPb.setExtent(window->getSwapChain()->getExtent());
+        PipelineDirector<PipelineTypeE::GRAPHICS> probeDistancePd;
+        probeDistancePd.configureColorDepthRasterizerBuilder(probeDistancePb);
+        probeDistancePb.setBlendEnable(VK_FALSE);
+        // the back faces of the walls also hide what is behind them
+        probeDistancePb.setCullMode(VK_CULL_MODE_NONE);
+        probeDistancePb.addUniformDescriptorPack(probeDistanceUdb.buildAndRestart());
 
-        PipelineDirector<PipelineTypeE::GRAPHICS> irradianceConvolutionPd;
-        irradianceConvolutionPd.configureColorDepthRasterizerBuilder(irradianceConvolutionPb);
-        irradianceConvolutionPb.addUniformDescriptorPack(irradianceConvolutionUdb.buildAndRestart());
-
-        std::shared_ptr<Pipeline> irradianceConvolutionPipeline = irradianceConvolutionPb.build();
+        std::shared_ptr<Pipeline> probeDistancePipeline = probeDistancePb.build();
 
         // material
         UniformDescriptorBuilder phongInstanceUdb;
         phongInstanceUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
             .binding = 0,
-            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
             .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
         });
         phongInstanceUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
             .binding = 2,
-            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
             .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
         });
         phongInstanceUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
             .binding = 3,
-            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
             .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
         });
         phongInstanceUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
             .binding = 4,
             .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-            .descriptorCount = maxProbeCount,
+            .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
         });
         phongInstanceUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
@@ -233,6 +368,18 @@ void SceneG2IP::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
             .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
         });
+        phongInstanceUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
+            .binding = 6,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+        });
+        phongInstanceUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
+            .binding = 7,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+        });
 
         UniformDescriptorBuilder phongMaterialUdb;
         phongMaterialUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
@@ -264,26 +411,26 @@ void SceneG2IP::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
         UniformDescriptorBuilder phongCaptureInstanceUdb;
         phongCaptureInstanceUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
             .binding = 0,
-            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
             .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
         });
         phongCaptureInstanceUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
             .binding = 2,
-            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
             .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
         });
         phongCaptureInstanceUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
             .binding = 3,
-            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
             .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
         });
         phongCaptureInstanceUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
             .binding = 4,
             .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-            .descriptorCount = maxProbeCount,
+            .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
         });
         phongCaptureInstanceUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
@@ -292,6 +439,18 @@ void SceneG2IP::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
             .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
         });
+        phongCaptureInstanceUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
+            .binding = 6,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+        });
+        phongCaptureInstanceUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
+            .binding = 7,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+        });
 
         UniformDescriptorBuilder phongCaptureMaterialUdb;
         phongCaptureMaterialUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
@@ -323,7 +482,7 @@ void SceneG2IP::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
         UniformDescriptorBuilder environmentMapUdb;
         environmentMapUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
             .binding = 0,
-            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
             .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
         });
@@ -355,7 +514,7 @@ void SceneG2IP::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
         UniformDescriptorBuilder environmentMapCaptureUdb;
         environmentMapCaptureUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
             .binding = 0,
-            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
             .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
         });
@@ -403,36 +562,59 @@ void SceneG2IP::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
         {
             ModelRenderStateBuilder mrsb;
             mrsb.setFrameInFlightCount(frameInFlightCount);
-            mrsb.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
-            mrsb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+            mrsb.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
+            mrsb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC);
+            mrsb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC);
+            mrsb.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
             mrsb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-            mrsb.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxProbeCount);
+            mrsb.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
             mrsb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
             mrsb.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
             mrsb.setDevice(device);
+            mrsb.setFrameAllocator(rg->getFrameAllocator());
+            mrsb.setSceneConstants(rg->getSceneConstants());
             mrsb.setModel(m_objects[i]);
 
             // Check if the mesh is the quad, the sphere or the cube
             if (i != 1 && i != 2 && i != 3)
             {
-                mrsb.setEnvironmentMaps(rg->m_irradianceMaps);
+                mrsb.setEnvironmentMaps({rg->m_irradianceAtlas});
+                mrsb.setVisibilityAtlas(rg->m_visibilityAtlas);
                 mrsb.setPipeline(phongPipeline);
 
                 ModelRenderStateBuilder captureMrsb;
                 captureMrsb.setFrameInFlightCount(window->getSwapChain()->getSwapChainImageCount());
-                captureMrsb.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
-                captureMrsb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+                captureMrsb.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
+                captureMrsb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC);
+                captureMrsb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC);
+                captureMrsb.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
                 captureMrsb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-                captureMrsb.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxProbeCount);
+                captureMrsb.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
                 captureMrsb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
                 captureMrsb.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
                 captureMrsb.setDevice(device);
+                captureMrsb.setFrameAllocator(rg->getFrameAllocator());
+                captureMrsb.setSceneConstants(rg->getSceneConstants());
                 captureMrsb.setModel(m_objects[i]);
                 captureMrsb.setPipeline(phongCapturePipeline);
-                captureMrsb.setEnvironmentMaps(rg->m_irradianceMaps);
-                captureMrsb.setCaptureCount(maxProbeCount);
+                captureMrsb.setEnvironmentMaps({rg->m_irradianceAtlas});
+                captureMrsb.setVisibilityAtlas(rg->m_visibilityAtlas);
 
                 rg->m_opaqueCapturePhase->registerRenderStateToAllPool(RENDER_STATE_PTR(captureMrsb.build()));
+
+                ModelRenderStateBuilder distanceMrsb;
+                distanceMrsb.setFrameInFlightCount(window->getSwapChain()->getSwapChainImageCount());
+                distanceMrsb.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
+                distanceMrsb.setDevice(device);
+                distanceMrsb.setFrameAllocator(rg->getFrameAllocator());
+                distanceMrsb.setModel(m_objects[i]);
+                distanceMrsb.setTextureDescriptorEnable(false);
+                distanceMrsb.setProbeDescriptorEnable(false);
+                distanceMrsb.setLightDescriptorEnable(false);
+                distanceMrsb.setPushViewPositionEnable(false);
+                distanceMrsb.setPipeline(probeDistancePipeline);
+
+                rg->m_probeDistanceCapturePhase->registerRenderStateToAllPool(RENDER_STATE_PTR(distanceMrsb.build()));
             }
             else
             {
@@ -441,7 +623,17 @@ void SceneG2IP::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
                 mrsb.setLightDescriptorEnable(false);
                 mrsb.setPipeline(environmentMapPipeline);
 
-                mrsb.setEnvironmentMaps(rg->m_irradianceMaps);
+                // the irradiance is not stored as a cubemap anymore, show what the probes captured
+                // nothing is captured when the probes are baked
+                if (probesBaked)
+                {
+                    mrsb.setEnvironmentMaps(std::vector<std::shared_ptr<Texture>>(rg->m_capturedEnvMaps.size(),
+                                                                                  m_skybox->getTexture().lock()));
+                }
+                else
+                {
+                    mrsb.setEnvironmentMaps(rg->m_capturedEnvMaps);
+                }
             }
 
             rg->m_opaquePhase->registerRenderStateToAllPool(RENDER_STATE_PTR(mrsb.build()));
@@ -450,19 +642,19 @@ void SceneG2IP::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
         UniformDescriptorBuilder probeGridDebugUdb;
         probeGridDebugUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
             .binding = 0,
-            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
             .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
         });
         probeGridDebugUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
             .binding = 4,
             .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-            .descriptorCount = maxProbeCount,
+            .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
         });
         probeGridDebugUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
             .binding = 5,
-            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
             .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
         });
@@ -470,7 +662,7 @@ void SceneG2IP::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
         PipelineBuilder<PipelineTypeE::GRAPHICS> probeGridDebugPb;
         probeGridDebugPb.setDevice(device);
         probeGridDebugPb.addVertexShaderStage("probe_grid_debug");
-        probeGridDebugPb.addFragmentShaderStage("probe_grid_debug");
+        probeGridDebugPb.addFragmentShaderStage("g2ip/probe_grid_debug");
         probeGridDebugPb.setRenderPass(rg->m_probesDebugPhase->getRenderPass());
         probeGridDebugPb.setExtent(window->getSwapChain()->getExtent());
         probeGridDebugPb.addPushConstantRange(VkPushConstantRange{
@@ -485,17 +677,6 @@ void SceneG2IP::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
 
         std::shared_ptr<Pipeline> probeGridDebugPipeline = probeGridDebugPb.build();
 
-        // probes
-        ProbeGridBuilder gridBuilder;
-        const glm::vec3 extent = glm::vec3(60.f, 10.f, 20.f);
-        const glm::vec3 cornerPosition = glm::vec3(extent.x * -0.5f, 0.f, extent.z * -0.5f);
-        gridBuilder.setXAxisProbeCount(4u);
-        gridBuilder.setYAxisProbeCount(4u);
-        gridBuilder.setZAxisProbeCount(4u);
-        gridBuilder.setExtent(extent);
-        gridBuilder.setCornerPosition(cornerPosition);
-        m_grid = gridBuilder.build();
-
         MeshDirector md;
         MeshBuilder sphereMb;
         md.createSphereMeshBuilder(sphereMb, 0.5f, 50, 50);
@@ -509,13 +690,14 @@ void SceneG2IP::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
 
         ProbeGridRenderStateBuilder prsb;
         prsb.setFrameInFlightCount(frameInFlightCount);
-        prsb.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
-        prsb.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxProbeCount);
-        prsb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        prsb.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
+        prsb.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+        prsb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC);
         prsb.setDevice(device);
+        prsb.setFrameAllocator(rg->getFrameAllocator());
         prsb.setPipeline(probeGridDebugPipeline);
         prsb.setProbeGrid(m_grid);
-        prsb.setEnvironmentMaps(rg->m_irradianceMaps);
+        prsb.setEnvironmentMaps({rg->m_irradianceAtlas});
         prsb.setMesh(cubeMesh);
         rg->m_probesDebugPhase->registerRenderStateToAllPool(RENDER_STATE_PTR(prsb.build()));
 
@@ -523,7 +705,7 @@ void SceneG2IP::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
         UniformDescriptorBuilder skyboxUdb;
         skyboxUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
             .binding = 0,
-            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
             .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
         });
@@ -552,7 +734,7 @@ void SceneG2IP::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
         UniformDescriptorBuilder skyboxOpaqueUdb;
         skyboxOpaqueUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
             .binding = 0,
-            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
             .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
         });
@@ -579,24 +761,12 @@ void SceneG2IP::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
 
         if (m_skybox)
         {
-            for (int i = 0; i < maxProbeCount; i++)
-            {
-                EnvironmentCaptureRenderStateBuilder irsb;
-                irsb.setFrameInFlightCount(1);
-                irsb.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
-                irsb.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
-                irsb.setDevice(device);
-                irsb.setSkybox(m_skybox);
-                irsb.setTexture(rg->m_capturedEnvMaps[i]);
-                irsb.setPipeline(irradianceConvolutionPipeline);
-                rg->m_irradianceConvolutionPhase->registerRenderStateToSpecificPool(RENDER_STATE_PTR(irsb.build()), i);
-            }
-
             SkyboxRenderStateBuilder srsb;
             srsb.setFrameInFlightCount(frameInFlightCount);
-            srsb.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+            srsb.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
             srsb.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
             srsb.setDevice(device);
+            srsb.setFrameAllocator(rg->getFrameAllocator());
             srsb.setSkybox(m_skybox);
             srsb.setTexture(m_skybox->getTexture());
             srsb.setPipeline(skyboxPipeline);
@@ -604,13 +774,13 @@ void SceneG2IP::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
 
             SkyboxRenderStateBuilder captureSrsb;
             captureSrsb.setFrameInFlightCount(frameInFlightCount);
-            captureSrsb.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+            captureSrsb.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
             captureSrsb.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
             captureSrsb.setDevice(device);
+            captureSrsb.setFrameAllocator(rg->getFrameAllocator());
             captureSrsb.setSkybox(m_skybox);
             captureSrsb.setTexture(m_skybox->getTexture());
             captureSrsb.setPipeline(skyboxCapturePipeline);
-            captureSrsb.setCaptureCount(maxProbeCount);
 
             rg->m_skyboxCapturePhase->registerRenderStateToAllPool(RENDER_STATE_PTR(captureSrsb.build()));
         }
@@ -650,8 +820,7 @@ void SceneG2IP::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
                     .imageView = rg->m_skyboxPhase->getMostRecentRenderedImage().second,
                     .imageLayout = VK_IMAGE_LAYOUT_ATTACHMENT_OPTIMAL_KHR,
                 };
-                std::vector<VkWriteDescriptorSet> writes;
-                writes.push_back(VkWriteDescriptorSet{
+                VkWriteDescriptorSet write = {
                     .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
                     .dstSet = set,
                     .dstBinding = 0,
@@ -659,9 +828,8 @@ void SceneG2IP::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
                     .descriptorCount = 1,
                     .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
                     .pImageInfo = &imageInfo,
-                });
-
-                vkUpdateDescriptorSets(deviceHandle, writes.size(), writes.data(), 0, nullptr);
+                };
+                vkUpdateDescriptorSets(deviceHandle, 1, &write, 0, nullptr);
             });
             PipelineBuilder<PipelineTypeE::GRAPHICS> pb;
             PipelineDirector<PipelineTypeE::GRAPHICS> pd;
@@ -10,6 +10,7 @@ class RenderGraph;
 class Context;
 class ProbeGrid;
 class Model;
+class ProbeBake;
 
 class SceneG2IP final : public SceneABC
 {
@@ -18,7 +19,15 @@ class SceneG2IP final : public SceneABC
 
     std::shared_ptr<Model> m_screen;
 
+    /**
+     * @brief irradiance atlas and visibility maps stored on disk
+     *
+     */
+    std::unique_ptr<ProbeBake> m_probeBake;
+
   public:
+    ~SceneG2IP() override;
+
     void load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, WindowGLFW *window,
                        RenderGraph *renderGraph, uint32_t frameInFlightCount, uint32_t maxProbeCount) override;
 };
\ No newline at end of file
@@ -71,19 +71,21 @@ void SceneG2IPRT::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device,
 
         SkyboxBuilder mainSb;
         mainSb.setDevice(device);
-        mainSb.setCubemap(ctb.buildAndRestart());
+        mainSb.setCubemap(getOrLoadResource<Texture>(
+            "assets/skybox:srgb", [&ctb]() { return std::shared_ptr<Texture>(ctb.buildAndRestart()); }));
         m_skybox = mainSb.buildAndRestart();
 
         ModelBuilder modelBuilder;
         modelBuilder.setDevice(device);
         modelBuilder.setModelFilename("assets/Sponza-master/sponza.glb");
+        modelBuilder.setResourceRegistry(m_resourceRegistry);
         modelBuilder.setName("Sponza");
         std::shared_ptr<Model> loadedModel = modelBuilder.build();
         Transform loadedModelTransform;
         loadedModelTransform.scale = glm::vec3(0.025f);
         loadedModel->setTransform(loadedModelTransform);
 
-        m_objects.push_back(loadedModel);
+        addObject(loadedModel);
         std::shared_ptr<PointLight> light = std::make_shared<PointLight>();
         light->position = glm::vec3(-25.0, 1.0, 0.0);
         light->attenuation = glm::vec3(0.0, 0.0, 0.5);
@@ -177,7 +179,8 @@ void SceneG2IPRT::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device,
         md.createAssimpMeshBuilder(cubeMb);
         cubeMb.setDevice(device);
         cubeMb.setModelFilename("assets/cube.obj");
-        std::shared_ptr<Mesh> cubeMesh = cubeMb.buildAndRestart();
+        std::shared_ptr<Mesh> cubeMesh = getOrLoadResource<Mesh>(
+            "assets/cube.obj:assimp", [&cubeMb]() { return std::shared_ptr<Mesh>(cubeMb.buildAndRestart()); });
 
         ModelBuilder cubeModelBuilder;
         cubeModelBuilder.setMesh(cubeMesh);
@@ -186,14 +189,31 @@ void SceneG2IPRT::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device,
         // m_objects.push_back(cubeModelBuilder.build());
     }
 
+    // probes
+    {
+        ProbeGridBuilder gridBuilder;
+        const glm::vec3 extent = glm::vec3(60.f, 20.f, 20.f);
+        const glm::vec3 cornerPosition = glm::vec3(extent.x * -0.5f, 0.f, extent.z * -0.5f);
+        gridBuilder.setXAxisProbeCount(4u);
+        gridBuilder.setYAxisProbeCount(4u);
+        gridBuilder.setZAxisProbeCount(4u);
+        gridBuilder.setExtent(extent);
+        gridBuilder.setCornerPosition(cornerPosition);
+        m_grid = gridBuilder.build();
+    }
+
     GraphG2IPRT *rg = dynamic_cast<GraphG2IPRT *>(renderGraph);
+
+    // the probe table is written once, before the states bind it
+    rg->getSceneConstants()->setProbeGrid(*m_grid);
+
     // load objects into render graph
     {
         UniformDescriptorBuilder irradianceConvolutionUdb;
 
         irradianceConvolutionUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
             .binding = 0,
-            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
             .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
         });
@@ -222,19 +242,19 @@ void SceneG2IPRT::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device,
         UniformDescriptorBuilder phongInstanceUdb;
         phongInstanceUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
             .binding = 0,
-            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
             .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
         });
         phongInstanceUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
             .binding = 2,
-            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
             .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
         });
         phongInstanceUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
             .binding = 3,
-            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
             .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
         });
@@ -250,6 +270,13 @@ void SceneG2IPRT::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device,
             .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
         });
+        // probe bricks, unused by the ray traced visibility
+        phongInstanceUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
+            .binding = 7,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+        });
         phongInstanceUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
             .binding = 6,
             .descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR,
@@ -291,19 +318,19 @@ void SceneG2IPRT::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device,
         UniformDescriptorBuilder phongCaptureInstanceUdb;
         phongCaptureInstanceUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
             .binding = 0,
-            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
             .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
         });
         phongCaptureInstanceUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
             .binding = 2,
-            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
             .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
         });
         phongCaptureInstanceUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
             .binding = 3,
-            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
             .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
         });
@@ -319,6 +346,13 @@ void SceneG2IPRT::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device,
             .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
         });
+        // probe bricks, unused by the ray traced visibility
+        phongCaptureInstanceUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
+            .binding = 7,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+        });
         phongCaptureInstanceUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
             .binding = 6,
             .descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR,
@@ -356,7 +390,7 @@ void SceneG2IPRT::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device,
         UniformDescriptorBuilder environmentMapUdb;
         environmentMapUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
             .binding = 0,
-            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
             .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
         });
@@ -388,7 +422,7 @@ void SceneG2IPRT::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device,
         UniformDescriptorBuilder environmentMapCaptureUdb;
         environmentMapCaptureUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
             .binding = 0,
-            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
             .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
         });
@@ -436,11 +470,12 @@ void SceneG2IPRT::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device,
         {
             ModelRenderStateBuilder mrsb;
             mrsb.setFrameInFlightCount(frameInFlightCount);
-            mrsb.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
-            mrsb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-            mrsb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+            mrsb.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
+            mrsb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC);
+            mrsb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC);
             mrsb.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxProbeCount);
             mrsb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+            mrsb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
 #ifdef USE_NV_PRO_CORE
             mrsb.addPoolSize(VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, 1);
 #else
@@ -450,6 +485,8 @@ void SceneG2IPRT::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device,
             mrsb.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
 
             mrsb.setDevice(device);
+            mrsb.setFrameAllocator(rg->getFrameAllocator());
+            mrsb.setSceneConstants(rg->getSceneConstants());
             mrsb.setModel(m_objects[i]);
             mrsb.setInstanceDescriptorSetUpdatePredPerFrame([=](const RenderPhase *parentPhase, VkCommandBuffer cmd,
                                                                 const GPUStateI *self, const VkDescriptorSet &set,
@@ -462,8 +499,7 @@ void SceneG2IPRT::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device,
                     .accelerationStructureCount = static_cast<uint32_t>(tlas.size()),
                     .pAccelerationStructures = tlas.data(),
                 };
-                std::vector<VkWriteDescriptorSet> writes;
-                writes.push_back(VkWriteDescriptorSet{
+                VkWriteDescriptorSet write = {
                     .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
                     .pNext = &descASInfo,
                     .dstSet = set,
@@ -471,9 +507,8 @@ void SceneG2IPRT::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device,
                     .dstArrayElement = 0,
                     .descriptorCount = descASInfo.accelerationStructureCount,
                     .descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR,
-                });
-
-                vkUpdateDescriptorSets(deviceHandle, writes.size(), writes.data(), 0, nullptr);
+                };
+                vkUpdateDescriptorSets(deviceHandle, 1, &write, 0, nullptr);
             });
 
             // Check if the mesh is the quad, the sphere or the cube
@@ -484,11 +519,12 @@ void SceneG2IPRT::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device,
 
                 ModelRenderStateBuilder captureMrsb;
                 captureMrsb.setFrameInFlightCount(window->getSwapChain()->getSwapChainImageCount());
-                captureMrsb.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
-                captureMrsb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-                captureMrsb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+                captureMrsb.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
+                captureMrsb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC);
+                captureMrsb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC);
                 captureMrsb.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxProbeCount);
                 captureMrsb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+                captureMrsb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
                 captureMrsb.addPoolSize(
                     VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR,
                     1); // number of tlas in the ray tracing phase (there are as many objects as render states
@@ -497,11 +533,11 @@ void SceneG2IPRT::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device,
                 captureMrsb.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
 
                 captureMrsb.setDevice(device);
+                captureMrsb.setFrameAllocator(rg->getFrameAllocator());
+                captureMrsb.setSceneConstants(rg->getSceneConstants());
                 captureMrsb.setModel(m_objects[i]);
                 captureMrsb.setPipeline(phongCapturePipeline);
                 captureMrsb.setEnvironmentMaps(rg->m_irradianceMaps);
-                captureMrsb.setCaptureCount(maxProbeCount);
-                captureMrsb.setCaptureCount(maxProbeCount);
                 captureMrsb.setInstanceDescriptorSetUpdatePredPerFrame(
                     [=](const RenderPhase *parentPhase, VkCommandBuffer cmd, const GPUStateI *self,
                         const VkDescriptorSet &set, uint32_t backBufferIndex) {
@@ -514,8 +550,7 @@ void SceneG2IPRT::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device,
                             .accelerationStructureCount = static_cast<uint32_t>(tlas.size()),
                             .pAccelerationStructures = tlas.data(),
                         };
-                        std::vector<VkWriteDescriptorSet> writes;
-                        writes.push_back(VkWriteDescriptorSet{
+                        VkWriteDescriptorSet write = {
                             .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
                             .pNext = &descASInfo,
                             .dstSet = set,
@@ -523,9 +558,8 @@ void SceneG2IPRT::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device,
                             .dstArrayElement = 0,
                             .descriptorCount = descASInfo.accelerationStructureCount,
                             .descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR,
-                        });
-
-                        vkUpdateDescriptorSets(deviceHandle, writes.size(), writes.data(), 0, nullptr);
+                        };
+                        vkUpdateDescriptorSets(deviceHandle, 1, &write, 0, nullptr);
                     });
 
                 rg->m_opaqueCapturePhase->registerRenderStateToAllPool(RENDER_STATE_PTR(captureMrsb.build()));
@@ -552,7 +586,7 @@ void SceneG2IPRT::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device,
         UniformDescriptorBuilder probeGridDebugUdb;
         probeGridDebugUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
             .binding = 0,
-            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
             .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
         });
@@ -564,7 +598,7 @@ void SceneG2IPRT::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device,
         });
         probeGridDebugUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
             .binding = 5,
-            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
             .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
         });
@@ -587,17 +621,6 @@ void SceneG2IPRT::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device,
 
         std::shared_ptr<Pipeline> probeGridDebugPipeline = probeGridDebugPb.build();
 
-        // probes
-        ProbeGridBuilder gridBuilder;
-        const glm::vec3 extent = glm::vec3(60.f, 20.f, 20.f);
-        const glm::vec3 cornerPosition = glm::vec3(extent.x * -0.5f, 0.f, extent.z * -0.5f);
-        gridBuilder.setXAxisProbeCount(4u);
-        gridBuilder.setYAxisProbeCount(4u);
-        gridBuilder.setZAxisProbeCount(4u);
-        gridBuilder.setExtent(extent);
-        gridBuilder.setCornerPosition(cornerPosition);
-        m_grid = gridBuilder.build();
-
         MeshDirector md;
         MeshBuilder sphereMb;
         md.createSphereMeshBuilder(sphereMb, 0.5f, 50, 50);
@@ -611,10 +634,11 @@ void SceneG2IPRT::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device,
 
         ProbeGridRenderStateBuilder prsb;
         prsb.setFrameInFlightCount(frameInFlightCount);
-        prsb.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+        prsb.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
         prsb.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxProbeCount);
-        prsb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        prsb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC);
         prsb.setDevice(device);
+        prsb.setFrameAllocator(rg->getFrameAllocator());
         prsb.setPipeline(probeGridDebugPipeline);
         prsb.setProbeGrid(m_grid);
         prsb.setEnvironmentMaps(rg->m_irradianceMaps);
@@ -625,7 +649,7 @@ void SceneG2IPRT::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device,
         UniformDescriptorBuilder skyboxUdb;
         skyboxUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
             .binding = 0,
-            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
             .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
         });
@@ -654,7 +678,7 @@ void SceneG2IPRT::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device,
         UniformDescriptorBuilder skyboxOpaqueUdb;
         skyboxOpaqueUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
             .binding = 0,
-            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
             .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
         });
@@ -685,9 +709,10 @@ void SceneG2IPRT::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device,
             {
                 EnvironmentCaptureRenderStateBuilder irsb;
                 irsb.setFrameInFlightCount(1);
-                irsb.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+                irsb.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
                 irsb.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
                 irsb.setDevice(device);
+                irsb.setFrameAllocator(rg->getFrameAllocator());
                 irsb.setSkybox(m_skybox);
                 irsb.setTexture(rg->m_capturedEnvMaps[i]);
                 irsb.setPipeline(irradianceConvolutionPipeline);
@@ -696,9 +721,10 @@ void SceneG2IPRT::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device,
 
             SkyboxRenderStateBuilder srsb;
             srsb.setFrameInFlightCount(frameInFlightCount);
-            srsb.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+            srsb.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
             srsb.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
             srsb.setDevice(device);
+            srsb.setFrameAllocator(rg->getFrameAllocator());
             srsb.setSkybox(m_skybox);
             srsb.setTexture(m_skybox->getTexture());
             srsb.setPipeline(skyboxPipeline);
@@ -706,13 +732,13 @@ void SceneG2IPRT::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device,
 
             SkyboxRenderStateBuilder captureSrsb;
             captureSrsb.setFrameInFlightCount(frameInFlightCount);
-            captureSrsb.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+            captureSrsb.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
             captureSrsb.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
             captureSrsb.setDevice(device);
+            captureSrsb.setFrameAllocator(rg->getFrameAllocator());
             captureSrsb.setSkybox(m_skybox);
             captureSrsb.setTexture(m_skybox->getTexture());
             captureSrsb.setPipeline(skyboxCapturePipeline);
-            captureSrsb.setCaptureCount(maxProbeCount);
 
             rg->m_skyboxCapturePhase->registerRenderStateToAllPool(RENDER_STATE_PTR(captureSrsb.build()));
         }
@@ -752,8 +778,7 @@ void SceneG2IPRT::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device,
                     .imageView = rg->m_skyboxPhase->getMostRecentRenderedImage().second,
                     .imageLayout = VK_IMAGE_LAYOUT_ATTACHMENT_OPTIMAL_KHR,
                 };
-                std::vector<VkWriteDescriptorSet> writes;
-                writes.push_back(VkWriteDescriptorSet{
+                VkWriteDescriptorSet write = {
                     .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
                     .dstSet = set,
                     .dstBinding = 0,
@@ -761,9 +786,8 @@ void SceneG2IPRT::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device,
                     .descriptorCount = 1,
                     .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
                     .pImageInfo = &imageInfo,
-                });
-
-                vkUpdateDescriptorSets(deviceHandle, writes.size(), writes.data(), 0, nullptr);
+                };
+                vkUpdateDescriptorSets(deviceHandle, 1, &write, 0, nullptr);
             });
             PipelineBuilder<PipelineTypeE::GRAPHICS> pb;
             PipelineDirector<PipelineTypeE::GRAPHICS> pd;
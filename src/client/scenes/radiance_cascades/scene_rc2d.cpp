@@ -1,4 +1,7 @@
+#include <algorithm>
+#include <array>
 #include <iostream>
+#include <string>
 
 #include <vulkan/vulkan.hpp>
 
@@ -87,7 +90,7 @@ void SceneRC2D::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
             std::shared_ptr<Model> model = modelBuilder.build();
             model->setTransform(t);
 
-            m_objects.push_back(model);
+            addObject(model);
         }
         {
             mb.setDevice(device);
@@ -110,7 +113,7 @@ void SceneRC2D::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
             std::shared_ptr<Model> model = modelBuilder.build();
             model->setTransform(t);
 
-            m_objects.push_back(model);
+            addObject(model);
         }
         {
             mb.setDevice(device);
@@ -133,7 +136,7 @@ void SceneRC2D::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
             std::shared_ptr<Model> model = modelBuilder.build();
             model->setTransform(t);
 
-            m_objects.push_back(model);
+            addObject(model);
         }
 
         {
@@ -157,7 +160,7 @@ void SceneRC2D::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
             std::shared_ptr<Model> model = modelBuilder.build();
             model->setTransform(t);
 
-            m_objects.push_back(model);
+            addObject(model);
         }
     }
 
@@ -167,6 +170,8 @@ void SceneRC2D::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
         .frameInFlightCount = frameInFlightCount,
     };
     radianceCascadesScript->init(&init);
+    // the indirect light is evaluated at half resolution and upsampled in the final image
+    radianceCascadesScript->setIndirectResolutionDivisor(2u);
     radianceCascadesScript->redCube = *(m_objects.end() - 4);
     radianceCascadesScript->greenCube = *(m_objects.end() - 3);
     radianceCascadesScript->blueCube = *(m_objects.end() - 2);
@@ -174,25 +179,47 @@ void SceneRC2D::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
     m_scripts.push_back(std::move(radianceCascadesScript));
 
     GraphRC2D *rg = dynamic_cast<GraphRC2D *>(renderGraph);
+
+    // low resolution indirect light, one image per frame in flight like the radiance intervals it is evaluated from
+    // the extent is the one of the swapchain at load, the final image reads it with uvs and survives a resize
+    {
+        const VkExtent2D screenExtent = window->getSwapChain()->getExtent();
+        TextureBuilder indirectImageBuilder;
+        for (uint32_t i = 0u; i < frameInFlightCount; ++i)
+        {
+            indirectImageBuilder.setDevice(device);
+            indirectImageBuilder.setWidth(
+                std::max(screenExtent.width / RadianceCascades::s_minIndirectResolutionDivisor, 1u));
+            indirectImageBuilder.setHeight(
+                std::max(screenExtent.height / RadianceCascades::s_minIndirectResolutionDivisor, 1u));
+            indirectImageBuilder.setFormat(VK_FORMAT_R16G16B16A16_SFLOAT);
+            indirectImageBuilder.setTiling(VK_IMAGE_TILING_OPTIMAL);
+            indirectImageBuilder.setSamplerFilter(VK_FILTER_NEAREST);
+            indirectImageBuilder.setStorageEnable(true);
+            indirectImageBuilder.setName("Indirect Image " + std::to_string(i));
+            m_indirectImages.push_back(indirectImageBuilder.buildAndRestart());
+        }
+    }
+
     // load objects into render graph
     {
         // material
         UniformDescriptorBuilder phongInstanceUdb;
         phongInstanceUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
             .binding = 0,
-            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
             .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
         });
         phongInstanceUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
             .binding = 2,
-            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
             .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
         });
         phongInstanceUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
             .binding = 3,
-            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
             .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
         });
@@ -244,15 +271,17 @@ void SceneRC2D::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
         {
             ModelRenderStateBuilder mrsb;
             mrsb.setFrameInFlightCount(frameInFlightCount);
-            mrsb.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
-            mrsb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-            mrsb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+            mrsb.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
+            mrsb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC);
+            mrsb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC);
             mrsb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
             mrsb.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxProbeCount);
             mrsb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
             mrsb.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
             mrsb.setProbeDescriptorEnable(false);
             mrsb.setDevice(device);
+            mrsb.setFrameAllocator(rg->getFrameAllocator());
+            mrsb.setSceneConstants(rg->getSceneConstants());
 
             mrsb.setModel(m_objects[i]);
 
@@ -296,8 +325,7 @@ void SceneRC2D::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
                     .imageView = rg->m_opaquePhase->getMostRecentRenderedImage().second,
                     .imageLayout = VK_IMAGE_LAYOUT_ATTACHMENT_OPTIMAL_KHR,
                 };
-                std::vector<VkWriteDescriptorSet> writes;
-                writes.push_back(VkWriteDescriptorSet{
+                VkWriteDescriptorSet write = {
                     .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
                     .dstSet = set,
                     .dstBinding = 0,
@@ -305,9 +333,8 @@ void SceneRC2D::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
                     .descriptorCount = 1,
                     .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
                     .pImageInfo = &imageInfo,
-                });
-
-                vkUpdateDescriptorSets(deviceHandle, writes.size(), writes.data(), 0, nullptr);
+                };
+                vkUpdateDescriptorSets(deviceHandle, 1, &write, 0, nullptr);
             });
             PipelineBuilder<PipelineTypeE::GRAPHICS> pb;
             PipelineDirector<PipelineTypeE::GRAPHICS> pd;
@@ -340,6 +367,9 @@ void SceneRC2D::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
             pd.configureComputeBuilder(pb);
             pb.setDevice(device);
             pb.addComputeShaderStage("rc/radiance_gather_2d");
+            // the loops over the cascades are unrolled for the layout of the script
+            if (RadianceCascades *rc = getReadOnlyInstancedComponent<RadianceCascades>())
+                rc->getCascadeLayout().specialize(pb);
             UniformDescriptorBuilder udb;
             // rendered image
             udb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
@@ -375,7 +405,20 @@ void SceneRC2D::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
                 .descriptorCount = 1,
                 .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
             });
+            // radiance interval storage buffer of the previous frame
+            udb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
+                .binding = 5,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            });
             pb.addUniformDescriptorPack(udb.buildAndRestart());
+            // gather schedule
+            pb.addPushConstantRange(VkPushConstantRange{
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+                .offset = 0,
+                .size = sizeof(CascadeGatherSchedule),
+            });
             ComputeStateBuilder csb;
             csb.setDevice(device);
             csb.setFrameInFlightCount(frameInFlightCount);
@@ -385,15 +428,24 @@ void SceneRC2D::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
             csb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
             csb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
             csb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-            auto s = getReadOnlyInstancedComponents<RadianceCascades>();
-            if (!s.empty())
+            csb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+            // the intervals of the previous frame are copied for the probes that are not gathered this frame
+            csb.setWaitPreviousDispatch(true);
+            RadianceCascades *rc = getReadOnlyInstancedComponent<RadianceCascades>();
+            if (rc)
             {
-                auto rc = s[0];
                 csb.setWorkGroup(glm::ivec3(rc->getCascadeCount(), 1, 1));
             }
             csb.setDescriptorSetUpdatePredPerFrame([=](const RenderPhase *parentPhase, VkCommandBuffer cmd,
                                                        const GPUStateI *self, const VkDescriptorSet set,
                                                        uint32_t backBufferIndex) {
+                if (RadianceCascades *rc = getReadOnlyInstancedComponent<RadianceCascades>())
+                {
+                    const CascadeGatherSchedule schedule = rc->advanceGatherSchedule();
+                    vkCmdPushConstants(cmd, self->getPipeline()->getPipelineLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                                       sizeof(CascadeGatherSchedule), &schedule);
+                }
+
                 const auto &sampler = window->getSwapChain()->getSampler();
                 if (!sampler.has_value())
                     return;
@@ -403,8 +455,7 @@ void SceneRC2D::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
                     .imageView = rg->m_finalImageDirect->getMostRecentRenderedImage().second,
                     .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
                 };
-                std::vector<VkWriteDescriptorSet> writes;
-                writes.push_back(VkWriteDescriptorSet{
+                VkWriteDescriptorSet write = {
                     .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
                     .dstSet = set,
                     .dstBinding = 0,
@@ -412,17 +463,306 @@ void SceneRC2D::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
                     .descriptorCount = 1,
                     .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
                     .pImageInfo = &imageInfo,
+                };
+                vkUpdateDescriptorSets(deviceHandle, 1, &write, 0, nullptr);
+            });
+            csb.setDescriptorSetUpdatePred(
+                [&](const RenderPhase *parentPhase, const VkDescriptorSet set, uint32_t backBufferIndex) {
+                    RadianceCascades *rc = getReadOnlyInstancedComponent<RadianceCascades>();
+                    std::vector<VkWriteDescriptorSet> writes;
+                    if (rc)
+                    {
+                        {
+                            VkDescriptorBufferInfo bufferInfo = {
+                                .buffer = rc->getParametersBufferHandle()->getHandle(),
+                                .offset = 0,
+                                .range = rc->getParametersBufferHandle()->getSize(),
+                            };
+                            writes.push_back(VkWriteDescriptorSet{
+                                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                                .dstSet = set,
+                                .dstBinding = 1,
+                                .dstArrayElement = 0,
+                                .descriptorCount = 1,
+                                .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                                .pBufferInfo = &bufferInfo,
+                            });
+                        }
+                        {
+                            VkDescriptorBufferInfo bufferInfo = {
+                                .buffer = rc->getCascadesDescBufferHandle()->getHandle(),
+                                .offset = 0,
+                                .range = rc->getCascadesDescBufferHandle()->getSize(),
+                            };
+                            writes.push_back(VkWriteDescriptorSet{
+                                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                                .dstSet = set,
+                                .dstBinding = 2,
+                                .dstArrayElement = 0,
+                                .descriptorCount = 1,
+                                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                .pBufferInfo = &bufferInfo,
+                            });
+                        }
+                        {
+                            VkDescriptorBufferInfo bufferInfo = {
+                                .buffer = rc->getProbePositionsBufferHandle()->getHandle(),
+                                .offset = 0,
+                                .range = rc->getProbePositionsBufferHandle()->getSize(),
+                            };
+                            writes.push_back(VkWriteDescriptorSet{
+                                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                                .dstSet = set,
+                                .dstBinding = 3,
+                                .dstArrayElement = 0,
+                                .descriptorCount = 1,
+                                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                .pBufferInfo = &bufferInfo,
+                            });
+                        }
+                        {
+                            VkDescriptorBufferInfo bufferInfo = {
+                                .buffer = rc->getRadianceIntervalsStorageBufferHandle(backBufferIndex)->getHandle(),
+                                .offset = 0,
+                                .range = rc->getRadianceIntervalsStorageBufferHandle(backBufferIndex)->getSize(),
+                            };
+                            writes.push_back(VkWriteDescriptorSet{
+                                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                                .dstSet = set,
+                                .dstBinding = 4,
+                                .dstArrayElement = 0,
+                                .descriptorCount = 1,
+                                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                .pBufferInfo = &bufferInfo,
+                            });
+                        }
+                        {
+                            VkDescriptorBufferInfo bufferInfo = {
+                                .buffer =
+                                    rc->getPreviousRadianceIntervalsStorageBufferHandle(backBufferIndex)->getHandle(),
+                                .offset = 0,
+                                .range =
+                                    rc->getPreviousRadianceIntervalsStorageBufferHandle(backBufferIndex)->getSize(),
+                            };
+                            writes.push_back(VkWriteDescriptorSet{
+                                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                                .dstSet = set,
+                                .dstBinding = 5,
+                                .dstArrayElement = 0,
+                                .descriptorCount = 1,
+                                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                .pBufferInfo = &bufferInfo,
+                            });
+                        }
+                    }
+                    vkUpdateDescriptorSets(deviceHandle, writes.size(), writes.data(), 0, nullptr);
                 });
-                vkUpdateDescriptorSets(deviceHandle, writes.size(), writes.data(), 0, nullptr);
+            rg->m_computePhase->registerComputeState(COMPUTE_STATE_PTR(csb.build()));
+        }
+
+        // average radiance of every probe for the debug overlay, once per frame instead of once per pixel
+        {
+            PipelineBuilder<PipelineTypeE::COMPUTE> pb;
+            PipelineDirector<PipelineTypeE::COMPUTE> pd;
+            pd.configureComputeBuilder(pb);
+            pb.setDevice(device);
+            pb.addComputeShaderStage("rc/probe_average_2d");
+            if (RadianceCascades *rc = getReadOnlyInstancedComponent<RadianceCascades>())
+                rc->getCascadeLayout().specialize(pb);
+            UniformDescriptorBuilder udb;
+            // radiance interval storage buffer
+            udb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
+                .binding = 0,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
             });
+            // probe colors buffer
+            udb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
+                .binding = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            });
+            pb.addUniformDescriptorPack(udb.buildAndRestart());
+            ComputeStateBuilder csb;
+            csb.setDevice(device);
+            csb.setFrameInFlightCount(frameInFlightCount);
+            csb.setPipeline(pb.build());
+            csb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+            csb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+            // the radiance intervals are written by the gather dispatch of the same phase
+            csb.setWaitPreviousDispatch(true);
+            RadianceCascades *rc = getReadOnlyInstancedComponent<RadianceCascades>();
+            if (rc)
+                csb.setWorkGroup(rc->getProbeAverageWorkGroupCount());
             csb.setDescriptorSetUpdatePred(
                 [&](const RenderPhase *parentPhase, const VkDescriptorSet set, uint32_t backBufferIndex) {
-                    auto s = getReadOnlyInstancedComponents<RadianceCascades>();
+                    RadianceCascades *rc = getReadOnlyInstancedComponent<RadianceCascades>();
                     std::vector<VkWriteDescriptorSet> writes;
-                    if (!s.empty())
+                    if (rc)
                     {
-                        auto rc = s[0];
+                        VkDescriptorBufferInfo intervalsBufferInfo = {
+                            .buffer = rc->getRadianceIntervalsStorageBufferHandle(backBufferIndex)->getHandle(),
+                            .offset = 0,
+                            .range = rc->getRadianceIntervalsStorageBufferHandle(backBufferIndex)->getSize(),
+                        };
+                        writes.push_back(VkWriteDescriptorSet{
+                            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                            .dstSet = set,
+                            .dstBinding = 0,
+                            .dstArrayElement = 0,
+                            .descriptorCount = 1,
+                            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                            .pBufferInfo = &intervalsBufferInfo,
+                        });
+                        VkDescriptorBufferInfo colorsBufferInfo = {
+                            .buffer = rc->getProbeColorsBufferHandle(backBufferIndex)->getHandle(),
+                            .offset = 0,
+                            .range = rc->getProbeColorsBufferHandle(backBufferIndex)->getSize(),
+                        };
+                        writes.push_back(VkWriteDescriptorSet{
+                            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                            .dstSet = set,
+                            .dstBinding = 1,
+                            .dstArrayElement = 0,
+                            .descriptorCount = 1,
+                            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                            .pBufferInfo = &colorsBufferInfo,
+                        });
+                    }
+                    vkUpdateDescriptorSets(deviceHandle, writes.size(), writes.data(), 0, nullptr);
+                });
+            rg->m_computePhase->registerComputeState(COMPUTE_STATE_PTR(csb.build()));
+        }
 
+        // indirect light at a lower resolution, upsampled by the final image
+        {
+            PipelineBuilder<PipelineTypeE::COMPUTE> pb;
+            PipelineDirector<PipelineTypeE::COMPUTE> pd;
+            pd.configureComputeBuilder(pb);
+            pb.setDevice(device);
+            pb.addComputeShaderStage("rc/radiance_apply_2d");
+            if (RadianceCascades *rc = getReadOnlyInstancedComponent<RadianceCascades>())
+                rc->getCascadeLayout().specialize(pb);
+            UniformDescriptorBuilder udb;
+            // indirect image
+            udb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
+                .binding = 0,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            });
+            udb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
+                .binding = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            });
+            // cascade desc buffer
+            udb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
+                .binding = 2,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            });
+            // cascade probes position buffer
+            udb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
+                .binding = 3,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            });
+            // radiance interval storage buffer
+            udb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
+                .binding = 4,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            });
+            // rendered image
+            udb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
+                .binding = 5,
+                .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            });
+            pb.addUniformDescriptorPack(udb.buildAndRestart());
+            // indirect resolution
+            pb.addPushConstantRange(VkPushConstantRange{
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+                .offset = 0,
+                .size = sizeof(RadianceCascades::indirect_resolution),
+            });
+            ComputeStateBuilder csb;
+            csb.setDevice(device);
+            csb.setFrameInFlightCount(frameInFlightCount);
+            csb.setPipeline(pb.build());
+            csb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+            csb.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+            csb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+            csb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+            csb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+            csb.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+            // the radiance intervals are written by the gather dispatch of the same phase
+            csb.setWaitPreviousDispatch(true);
+            // one thread per texel of the whole image, the threads outside of the resolution of the script return
+            const uint32_t localSize = RadianceCascades::s_radianceApplyLocalSize;
+            csb.setWorkGroup(glm::ivec3((m_indirectImages[0]->getWidth() + localSize - 1u) / localSize,
+                                        (m_indirectImages[0]->getHeight() + localSize - 1u) / localSize, 1));
+            csb.setDescriptorSetUpdatePredPerFrame([=, this](const RenderPhase *parentPhase, VkCommandBuffer cmd,
+                                                             const GPUStateI *self, const VkDescriptorSet set,
+                                                             uint32_t backBufferIndex) {
+                if (RadianceCascades *rc = getReadOnlyInstancedComponent<RadianceCascades>())
+                {
+                    const VkExtent2D screenExtent = window->getSwapChain()->getExtent();
+                    const RadianceCascades::indirect_resolution resolution = rc->getIndirectResolution(
+                        glm::uvec2(screenExtent.width, screenExtent.height),
+                        glm::uvec2(m_indirectImages[0]->getWidth(), m_indirectImages[0]->getHeight()));
+                    vkCmdPushConstants(cmd, self->getPipeline()->getPipelineLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                                       sizeof(RadianceCascades::indirect_resolution), &resolution);
+                }
+
+                const auto &sampler = window->getSwapChain()->getSampler();
+                if (!sampler.has_value())
+                    return;
+
+                VkDescriptorImageInfo imageInfo = {
+                    .sampler = *sampler.value(),
+                    .imageView = rg->m_finalImageDirect->getMostRecentRenderedImage().second,
+                    .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                };
+                VkWriteDescriptorSet write = {
+                    .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                    .dstSet = set,
+                    .dstBinding = 5,
+                    .dstArrayElement = 0,
+                    .descriptorCount = 1,
+                    .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                    .pImageInfo = &imageInfo,
+                };
+                vkUpdateDescriptorSets(deviceHandle, 1, &write, 0, nullptr);
+            });
+            csb.setDescriptorSetUpdatePred(
+                [&](const RenderPhase *parentPhase, const VkDescriptorSet set, uint32_t backBufferIndex) {
+                    RadianceCascades *rc = getReadOnlyInstancedComponent<RadianceCascades>();
+                    std::vector<VkWriteDescriptorSet> writes;
+                    VkDescriptorImageInfo indirectImageInfo = {
+                        .sampler = VK_NULL_HANDLE,
+                        .imageView = m_indirectImages[backBufferIndex]->getImageView(),
+                        .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+                    };
+                    writes.push_back(VkWriteDescriptorSet{
+                        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                        .dstSet = set,
+                        .dstBinding = 0,
+                        .dstArrayElement = 0,
+                        .descriptorCount = 1,
+                        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                        .pImageInfo = &indirectImageInfo,
+                    });
+                    if (rc)
+                    {
                         {
                             VkDescriptorBufferInfo bufferInfo = {
                                 .buffer = rc->getParametersBufferHandle()->getHandle(),
@@ -508,9 +848,22 @@ void SceneRC2D::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
             rsb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
             rsb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
             rsb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-            rsb.setInstanceDescriptorSetUpdatePredPerFrame([=](const RenderPhase *parentPhase, VkCommandBuffer cmd,
-                                                               const GPUStateI *self, const VkDescriptorSet set,
-                                                               uint32_t backBufferIndex) {
+            rsb.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+            rsb.setInstanceDescriptorSetUpdatePredPerFrame([=, this](const RenderPhase *parentPhase,
+                                                                     VkCommandBuffer cmd, const GPUStateI *self,
+                                                                     const VkDescriptorSet set,
+                                                                     uint32_t backBufferIndex) {
+                // same resolution as the compute dispatch of this frame
+                if (RadianceCascades *rc = getReadOnlyInstancedComponent<RadianceCascades>())
+                {
+                    const VkExtent2D screenExtent = window->getSwapChain()->getExtent();
+                    const RadianceCascades::indirect_resolution resolution = rc->getIndirectResolution(
+                        glm::uvec2(screenExtent.width, screenExtent.height),
+                        glm::uvec2(m_indirectImages[0]->getWidth(), m_indirectImages[0]->getHeight()));
+                    vkCmdPushConstants(cmd, self->getPipeline()->getPipelineLayout(), VK_SHADER_STAGE_FRAGMENT_BIT, 0,
+                                       sizeof(RadianceCascades::indirect_resolution), &resolution);
+                }
+
                 const auto &sampler = window->getSwapChain()->getSampler();
                 if (!sampler.has_value())
                     return;
@@ -534,8 +887,7 @@ void SceneRC2D::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
                     .imageView = mostRecentImage.second,
                     .imageLayout = VK_IMAGE_LAYOUT_ATTACHMENT_OPTIMAL_KHR,
                 };
-                std::vector<VkWriteDescriptorSet> writes;
-                writes.push_back(VkWriteDescriptorSet{
+                VkWriteDescriptorSet write = {
                     .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
                     .dstSet = set,
                     .dstBinding = 0,
@@ -543,17 +895,29 @@ void SceneRC2D::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
                     .descriptorCount = 1,
                     .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
                     .pImageInfo = &imageInfo,
-                });
-                vkUpdateDescriptorSets(deviceHandle, writes.size(), writes.data(), 0, nullptr);
+                };
+                vkUpdateDescriptorSets(deviceHandle, 1, &write, 0, nullptr);
             });
             rsb.setInstanceDescriptorSetUpdatePred(
                 [&](const RenderPhase *parentPhase, const VkDescriptorSet set, uint32_t backBufferIndex) {
                     std::vector<VkWriteDescriptorSet> writes;
-                    auto s = getReadOnlyInstancedComponents<RadianceCascades>();
-                    if (!s.empty())
+                    VkDescriptorImageInfo indirectImageInfo = {
+                        .sampler = *m_indirectImages[backBufferIndex]->getSampler(),
+                        .imageView = m_indirectImages[backBufferIndex]->getImageView(),
+                        .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+                    };
+                    writes.push_back(VkWriteDescriptorSet{
+                        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                        .dstSet = set,
+                        .dstBinding = 5,
+                        .dstArrayElement = 0,
+                        .descriptorCount = 1,
+                        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                        .pImageInfo = &indirectImageInfo,
+                    });
+                    RadianceCascades *rc = getReadOnlyInstancedComponent<RadianceCascades>();
+                    if (rc)
                     {
-                        auto rc = s[0];
-
                         {
                             VkDescriptorBufferInfo bufferInfo = {
                                 .buffer = rc->getParametersBufferHandle()->getHandle(),
@@ -628,6 +992,9 @@ void SceneRC2D::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
             pb.setRenderPass(rg->m_finalImageDirectIndirect->getRenderPass());
             pb.addVertexShaderStage("pp/screen");
             pb.addFragmentShaderStage("pp/radiance_apply");
+            // the loops over the cascades are unrolled for the layout of the script
+            if (RadianceCascades *rc = getReadOnlyInstancedComponent<RadianceCascades>())
+                rc->getCascadeLayout().specialize(pb);
             pb.setExtent(window->getSwapChain()->getExtent());
             pb.setDepthTestEnable(VK_FALSE);
             pb.setDepthWriteEnable(VK_FALSE);
@@ -668,6 +1035,109 @@ void SceneRC2D::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
                 .descriptorCount = 1,
                 .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
             });
+            // low resolution indirect image
+            udb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
+                .binding = 5,
+                .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+            });
+            pb.addUniformDescriptorPack(udb.buildAndRestart());
+            // indirect resolution
+            pb.addPushConstantRange(VkPushConstantRange{
+                .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+                .offset = 0,
+                .size = sizeof(RadianceCascades::indirect_resolution),
+            });
+            rsb.setPipeline(pb.build());
+            rg->m_finalImageDirectIndirect->registerRenderStateToAllPool(RENDER_STATE_PTR(rsb.build()));
+        }
+
+        // probes of every cascade drawn in one instanced call over the final image, colored with their average
+        // radiance
+        {
+            ModelRenderStateBuilder rsb;
+            rsb.setDevice(device);
+            rsb.setProbeDescriptorEnable(false);
+            rsb.setLightDescriptorEnable(false);
+            rsb.setTextureDescriptorEnable(false);
+            rsb.setMVPDescriptorEnable(false);
+            rsb.setPushViewPositionEnable(false);
+            rsb.setFrameInFlightCount(frameInFlightCount);
+            rsb.setModel(m_screen);
+            rsb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+            rsb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+            if (RadianceCascades *rc = getReadOnlyInstancedComponent<RadianceCascades>())
+                rsb.setInstanceCount(rc->getTotalProbeCount());
+            rsb.setInstanceDescriptorSetUpdatePredPerFrame([=, this](const RenderPhase *parentPhase,
+                                                                     VkCommandBuffer cmd, const GPUStateI *self,
+                                                                     const VkDescriptorSet set,
+                                                                     uint32_t backBufferIndex) {
+                RadianceCascades *rc = getReadOnlyInstancedComponent<RadianceCascades>();
+                if (!rc)
+                    return;
+
+                VkDescriptorBufferInfo positionsBufferInfo = {
+                    .buffer = rc->getProbePositionsBufferHandle()->getHandle(),
+                    .offset = 0,
+                    .range = rc->getProbePositionsBufferHandle()->getSize(),
+                };
+                VkDescriptorBufferInfo colorsBufferInfo = {
+                    .buffer = rc->getProbeColorsBufferHandle(backBufferIndex)->getHandle(),
+                    .offset = 0,
+                    .range = rc->getProbeColorsBufferHandle(backBufferIndex)->getSize(),
+                };
+                const std::array<VkWriteDescriptorSet, 2> writes = {
+                    VkWriteDescriptorSet{
+                        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                        .dstSet = set,
+                        .dstBinding = 0,
+                        .dstArrayElement = 0,
+                        .descriptorCount = 1,
+                        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                        .pBufferInfo = &positionsBufferInfo,
+                    },
+                    VkWriteDescriptorSet{
+                        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                        .dstSet = set,
+                        .dstBinding = 1,
+                        .dstArrayElement = 0,
+                        .descriptorCount = 1,
+                        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                        .pBufferInfo = &colorsBufferInfo,
+                    },
+                };
+                vkUpdateDescriptorSets(deviceHandle, writes.size(), writes.data(), 0, nullptr);
+            });
+            PipelineBuilder<PipelineTypeE::GRAPHICS> pb;
+            PipelineDirector<PipelineTypeE::GRAPHICS> pd;
+            pd.configureColorDepthRasterizerBuilder(pb);
+            pb.setDevice(device);
+            pb.setRenderPass(rg->m_finalImageDirectIndirect->getRenderPass());
+            pb.addVertexShaderStage("rc/probe_debug_2d");
+            pb.addFragmentShaderStage("rc/probe_debug");
+            if (RadianceCascades *rc = getReadOnlyInstancedComponent<RadianceCascades>())
+                rc->getCascadeLayout().specialize(pb);
+            pb.setExtent(window->getSwapChain()->getExtent());
+            pb.setDepthTestEnable(VK_FALSE);
+            pb.setDepthWriteEnable(VK_FALSE);
+            pb.setBlendEnable(VK_FALSE);
+            pb.setFrontFace(VK_FRONT_FACE_CLOCKWISE);
+            UniformDescriptorBuilder udb;
+            // cascade probes position buffer
+            udb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
+                .binding = 0,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+            });
+            // probe colors buffer
+            udb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
+                .binding = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+            });
             pb.addUniformDescriptorPack(udb.buildAndRestart());
             rsb.setPipeline(pb.build());
             rg->m_finalImageDirectIndirect->registerRenderStateToAllPool(RENDER_STATE_PTR(rsb.build()));
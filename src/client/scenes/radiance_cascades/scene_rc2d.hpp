@@ -3,11 +3,17 @@
 #include "renderer/scene.hpp"
 
 class Device;
+class Texture;
 
 class SceneRC2D final : public SceneABC
 {
   private:
     std::shared_ptr<Model> m_screen;
+    /**
+     * @brief indirect light evaluated at a lower resolution by the compute phase, one per frame in flight
+     *
+     */
+    std::vector<std::shared_ptr<Texture>> m_indirectImages;
 
   public:
     void load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, WindowGLFW *window, RenderGraph *renderGraph,
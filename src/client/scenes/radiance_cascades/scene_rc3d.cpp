@@ -1,3 +1,4 @@
+#include <array>
 #include <iostream>
 
 #include <vulkan/vulkan.hpp>
@@ -19,7 +20,6 @@
 #include "renderer/texture.hpp"
 
 #include "engine/camera.hpp"
-#include "engine/probe_grid.hpp"
 #include "engine/uniform.hpp"
 
 #include "render_graphs/radiance_cascades/graph_rc3d.hpp"
@@ -72,19 +72,21 @@ void SceneRC3D::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
 
         SkyboxBuilder mainSb;
         mainSb.setDevice(device);
-        mainSb.setCubemap(ctb.buildAndRestart());
+        mainSb.setCubemap(getOrLoadResource<Texture>(
+            "assets/skybox:srgb", [&ctb]() { return std::shared_ptr<Texture>(ctb.buildAndRestart()); }));
         m_skybox = mainSb.buildAndRestart();
 
         ModelBuilder modelBuilder;
         modelBuilder.setDevice(device);
         modelBuilder.setModelFilename("assets/Sponza-master/sponza.glb");
+        modelBuilder.setResourceRegistry(m_resourceRegistry);
         modelBuilder.setName("Sponza");
         std::shared_ptr<Model> loadedModel = modelBuilder.build();
         Transform loadedModelTransform;
         loadedModelTransform.scale = glm::vec3(0.025f);
         loadedModel->setTransform(loadedModelTransform);
 
-        m_objects.push_back(loadedModel);
+        addObject(loadedModel);
         std::shared_ptr<PointLight> light = std::make_shared<PointLight>();
         light->position = glm::vec3(-4.0, 1.0, 0.0);
         light->attenuation = glm::vec3(0.0, 0.0, 1.0);
@@ -120,19 +122,19 @@ void SceneRC3D::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
         UniformDescriptorBuilder phongInstanceUdb;
         phongInstanceUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
             .binding = 0,
-            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
             .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
         });
         phongInstanceUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
             .binding = 2,
-            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
             .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
         });
         phongInstanceUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
             .binding = 3,
-            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
             .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
         });
@@ -148,6 +150,12 @@ void SceneRC3D::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
             .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
         });
+        phongInstanceUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
+            .binding = 7,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+        });
 
         UniformDescriptorBuilder phongMaterialUdb;
         phongMaterialUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
@@ -195,14 +203,16 @@ void SceneRC3D::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
         {
             ModelRenderStateBuilder mrsb;
             mrsb.setFrameInFlightCount(frameInFlightCount);
-            mrsb.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
-            mrsb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-            mrsb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-            mrsb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+            mrsb.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
+            mrsb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC);
+            mrsb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC);
             mrsb.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxProbeCount);
             mrsb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+            mrsb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
             mrsb.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
             mrsb.setDevice(device);
+            mrsb.setFrameAllocator(rg->getFrameAllocator());
+            mrsb.setSceneConstants(rg->getSceneConstants());
             mrsb.setModel(m_objects[i]);
 
             mrsb.setPipeline(phongPipeline);
@@ -210,101 +220,112 @@ void SceneRC3D::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
             rg->m_opaquePhase->registerRenderStateToAllPool(RENDER_STATE_PTR(mrsb.build()));
         }
 
-        UniformDescriptorBuilder probeGridDebugUdb;
-        probeGridDebugUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
-            .binding = 0,
-            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-            .descriptorCount = 1,
-            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
-        });
-        probeGridDebugUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
-            .binding = 4,
-            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-            .descriptorCount = maxProbeCount,
-            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
-        });
-        probeGridDebugUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
-            .binding = 5,
-            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-            .descriptorCount = 1,
-            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-        });
+        // probes of every cascade drawn in one instanced call, colored with their average radiance
+        {
+            MeshDirector md;
+            MeshBuilder sphereMb;
+            md.createSphereMeshBuilder(sphereMb, 0.5f, 16, 16);
+            sphereMb.setDevice(device);
+            ModelBuilder modelBuilder;
+            modelBuilder.setMesh(sphereMb.buildAndRestart());
+            modelBuilder.setName("probes debug");
+            m_probesDebug = modelBuilder.build();
 
-        PipelineBuilder<PipelineTypeE::GRAPHICS> probeGridDebugPb;
-        probeGridDebugPb.setDevice(device);
-        probeGridDebugPb.addVertexShaderStage("probe_grid_debug");
-        probeGridDebugPb.addFragmentShaderStage("forward/white");
-        probeGridDebugPb.setRenderPass(rg->m_probesDebugPhase->getRenderPass());
-        probeGridDebugPb.setExtent(window->getSwapChain()->getExtent());
-        probeGridDebugPb.addPushConstantRange(VkPushConstantRange{
-            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
-            .offset = 0,
-            .size = 16,
-        });
+            ModelRenderStateBuilder rsb;
+            rsb.setDevice(device);
+            rsb.setProbeDescriptorEnable(false);
+            rsb.setLightDescriptorEnable(false);
+            rsb.setTextureDescriptorEnable(false);
+            rsb.setPushViewPositionEnable(false);
+            rsb.setFrameInFlightCount(frameInFlightCount);
+            rsb.setFrameAllocator(rg->getFrameAllocator());
+            rsb.setModel(m_probesDebug);
+            rsb.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
+            rsb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+            rsb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+            if (auto s = getReadOnlyInstancedComponents<RadianceCascades3D>(); !s.empty())
+                rsb.setInstanceCount(s[0]->getTotalProbeCount());
+            rsb.setInstanceDescriptorSetUpdatePredPerFrame([=, this](const RenderPhase *parentPhase,
+                                                                     VkCommandBuffer cmd, const GPUStateI *self,
+                                                                     const VkDescriptorSet set,
+                                                                     uint32_t backBufferIndex) {
+                auto s = getReadOnlyInstancedComponents<RadianceCascades3D>();
+                if (s.empty())
+                    return;
+                VkDescriptorBufferInfo positionsBufferInfo = {
+                    .buffer = s[0]->getProbePositionsBufferHandle()->getHandle(),
+                    .offset = 0,
+                    .range = s[0]->getProbePositionsBufferHandle()->getSize(),
+                };
+                VkDescriptorBufferInfo colorsBufferInfo = {
+                    .buffer = s[0]->getProbeColorsBufferHandle(backBufferIndex)->getHandle(),
+                    .offset = 0,
+                    .range = s[0]->getProbeColorsBufferHandle(backBufferIndex)->getSize(),
+                };
+                const std::array<VkWriteDescriptorSet, 2> writes = {
+                    VkWriteDescriptorSet{
+                        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                        .dstSet = set,
+                        .dstBinding = 1,
+                        .dstArrayElement = 0,
+                        .descriptorCount = 1,
+                        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                        .pBufferInfo = &positionsBufferInfo,
+                    },
+                    VkWriteDescriptorSet{
+                        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                        .dstSet = set,
+                        .dstBinding = 2,
+                        .dstArrayElement = 0,
+                        .descriptorCount = 1,
+                        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                        .pBufferInfo = &colorsBufferInfo,
+                    },
+                };
+                vkUpdateDescriptorSets(deviceHandle, writes.size(), writes.data(), 0, nullptr);
+            });
 
-        PipelineDirector<PipelineTypeE::GRAPHICS> probeGridDebugPd;
-        probeGridDebugPd.configureColorDepthRasterizerBuilder(probeGridDebugPb);
-        // probeGridDebugPb.setPolygonMode(VK_POLYGON_MODE_LINE);
-        probeGridDebugPb.addUniformDescriptorPack(probeGridDebugUdb.buildAndRestart());
-
-        std::shared_ptr<Pipeline> probeGridDebugPipeline = probeGridDebugPb.build();
-
-        // probes
-        auto s = getReadOnlyInstancedComponents<RadianceCascades3D>();
-        m_grid0 = std::make_unique<ProbeGrid>();
-        m_grid0->setProbesForce(s[0]->probePositions[0]);
-        m_grid0->instanceCountOverride = s[0]->probePositions[0].size();
-        m_grid1 = std::make_unique<ProbeGrid>();
-        m_grid1->setProbesForce(s[0]->probePositions[1]);
-        m_grid1->instanceCountOverride = s[0]->probePositions[1].size();
-        m_grid2 = std::make_unique<ProbeGrid>();
-        m_grid2->setProbesForce(s[0]->probePositions[2]);
-        m_grid2->instanceCountOverride = s[0]->probePositions[2].size();
-
-        MeshDirector md;
-        MeshBuilder sphereMb;
-        md.createSphereMeshBuilder(sphereMb, 0.5f, 50, 50);
-        sphereMb.setDevice(device);
-        std::shared_ptr<Mesh> sphereMesh = sphereMb.buildAndRestart();
-
-        MeshBuilder cubeMb;
-        md.createCubeMeshBuilder(cubeMb, glm::vec3(0.5));
-        cubeMb.setDevice(device);
-        std::shared_ptr<Mesh> cubeMesh = cubeMb.buildAndRestart();
-
-        ProbeGridRenderStateBuilder prsb0;
-        prsb0.setFrameInFlightCount(frameInFlightCount);
-        prsb0.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-        prsb0.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxProbeCount);
-        prsb0.setDevice(device);
-        prsb0.setPipeline(probeGridDebugPipeline);
-        prsb0.setProbeGrid(m_grid0);
-        prsb0.setMesh(cubeMesh);
-        rg->m_probesDebugPhase->registerRenderStateToAllPool(RENDER_STATE_PTR(prsb0.build()));
-        ProbeGridRenderStateBuilder prsb1;
-        prsb1.setFrameInFlightCount(frameInFlightCount);
-        prsb1.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-        prsb1.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxProbeCount);
-        prsb1.setDevice(device);
-        prsb1.setPipeline(probeGridDebugPipeline);
-        prsb1.setProbeGrid(m_grid1);
-        prsb1.setMesh(sphereMesh);
-        rg->m_probesDebugPhase->registerRenderStateToAllPool(RENDER_STATE_PTR(prsb1.build()));
-        ProbeGridRenderStateBuilder prsb2;
-        prsb2.setFrameInFlightCount(frameInFlightCount);
-        prsb2.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-        prsb2.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxProbeCount);
-        prsb2.setDevice(device);
-        prsb2.setPipeline(probeGridDebugPipeline);
-        prsb2.setProbeGrid(m_grid2);
-        prsb2.setMesh(cubeMesh);
-        rg->m_probesDebugPhase->registerRenderStateToAllPool(RENDER_STATE_PTR(prsb2.build()));
+            PipelineBuilder<PipelineTypeE::GRAPHICS> pb;
+            PipelineDirector<PipelineTypeE::GRAPHICS> pd;
+            pd.configureColorDepthRasterizerBuilder(pb);
+            pb.setDevice(device);
+            pb.addVertexShaderStage("rc/probe_debug_3d");
+            pb.addFragmentShaderStage("rc/probe_debug");
+            if (auto scripts = getReadOnlyInstancedComponents<RadianceCascades3D>(); !scripts.empty())
+                scripts[0]->getCascadeLayout().specialize(pb);
+            pb.setRenderPass(rg->m_probesDebugPhase->getRenderPass());
+            pb.setExtent(window->getSwapChain()->getExtent());
+            UniformDescriptorBuilder udb;
+            udb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
+                .binding = 0,
+                .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+            });
+            // cascade probes position buffer
+            udb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
+                .binding = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+            });
+            // probe colors buffer
+            udb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
+                .binding = 2,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+            });
+            pb.addUniformDescriptorPack(udb.buildAndRestart());
+            rsb.setPipeline(pb.build());
+            rg->m_probesDebugPhase->registerRenderStateToAllPool(RENDER_STATE_PTR(rsb.build()));
+        }
 
         // skybox
         UniformDescriptorBuilder skyboxUdb;
         skyboxUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
             .binding = 0,
-            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
             .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
         });
@@ -333,7 +354,7 @@ void SceneRC3D::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
         UniformDescriptorBuilder skyboxOpaqueUdb;
         skyboxOpaqueUdb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
             .binding = 0,
-            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
             .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
         });
@@ -348,9 +369,10 @@ void SceneRC3D::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
         {
             SkyboxRenderStateBuilder srsb;
             srsb.setFrameInFlightCount(frameInFlightCount);
-            srsb.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+            srsb.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
             srsb.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
             srsb.setDevice(device);
+            srsb.setFrameAllocator(rg->getFrameAllocator());
             srsb.setSkybox(m_skybox);
             srsb.setTexture(m_skybox->getTexture());
             srsb.setPipeline(skyboxPipeline);
@@ -431,6 +453,9 @@ void SceneRC3D::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
             pd.configureComputeBuilder(pb);
             pb.setDevice(device);
             pb.addComputeShaderStage("rc/radiance_gather_3drt");
+            // the loops over the cascades are unrolled for the layout of the script
+            if (auto scripts = getReadOnlyInstancedComponents<RadianceCascades3D>(); !scripts.empty())
+                scripts[0]->getCascadeLayout().specialize(pb);
             UniformDescriptorBuilder udb;
             // rendered image
             udb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
@@ -466,7 +491,20 @@ void SceneRC3D::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
                 .descriptorCount = 1,
                 .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
             });
+            // radiance interval storage buffer of the previous frame
+            udb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
+                .binding = 8,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            });
             pb.addUniformDescriptorPack(udb.buildAndRestart());
+            // gather schedule, after the view position
+            pb.addPushConstantRange(VkPushConstantRange{
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+                .offset = 0,
+                .size = 16 + sizeof(CascadeGatherSchedule),
+            });
             ComputeStateBuilder csb;
             csb.setDevice(device);
             csb.setFrameInFlightCount(frameInFlightCount);
@@ -476,15 +514,25 @@ void SceneRC3D::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
             csb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
             csb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
             csb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+            csb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+            // the intervals of the previous frame are copied for the probes that are not gathered this frame
+            csb.setWaitPreviousDispatch(true);
             auto s = getReadOnlyInstancedComponents<RadianceCascades3D>();
             if (!s.empty())
             {
                 auto rc = s[0];
-                csb.setWorkGroup(glm::ivec3(rc->getCascadeCount(), 1, 1));
+                csb.setWorkGroup(rc->getGatherWorkGroupCount());
             }
             csb.setDescriptorSetUpdatePredPerFrame([=](const RenderPhase *parentPhase, VkCommandBuffer cmd,
                                                        const GPUStateI *self, const VkDescriptorSet set,
                                                        uint32_t backBufferIndex) {
+                if (auto scripts = getReadOnlyInstancedComponents<RadianceCascades3D>(); !scripts.empty())
+                {
+                    const CascadeGatherSchedule schedule = scripts[0]->advanceGatherSchedule();
+                    vkCmdPushConstants(cmd, self->getPipeline()->getPipelineLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 16,
+                                       sizeof(CascadeGatherSchedule), &schedule);
+                }
+
                 const auto &sampler = window->getSwapChain()->getSampler();
                 if (!sampler.has_value())
                     return;
@@ -494,8 +542,7 @@ void SceneRC3D::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
                     .imageView = rg->m_finalImageDirect->getMostRecentRenderedImage().second,
                     .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
                 };
-                std::vector<VkWriteDescriptorSet> writes;
-                writes.push_back(VkWriteDescriptorSet{
+                VkWriteDescriptorSet write = {
                     .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
                     .dstSet = set,
                     .dstBinding = 0,
@@ -503,8 +550,8 @@ void SceneRC3D::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
                     .descriptorCount = 1,
                     .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
                     .pImageInfo = &imageInfo,
-                });
-                vkUpdateDescriptorSets(deviceHandle, writes.size(), writes.data(), 0, nullptr);
+                };
+                vkUpdateDescriptorSets(deviceHandle, 1, &write, 0, nullptr);
             });
             csb.setDescriptorSetUpdatePred(
                 [&](const RenderPhase *parentPhase, const VkDescriptorSet set, uint32_t backBufferIndex) {
@@ -578,6 +625,102 @@ void SceneRC3D::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
                                 .pBufferInfo = &bufferInfo,
                             });
                         }
+                        {
+                            VkDescriptorBufferInfo bufferInfo = {
+                                .buffer =
+                                    rc->getPreviousRadianceIntervalsStorageBufferHandle(backBufferIndex)->getHandle(),
+                                .offset = 0,
+                                .range =
+                                    rc->getPreviousRadianceIntervalsStorageBufferHandle(backBufferIndex)->getSize(),
+                            };
+                            writes.push_back(VkWriteDescriptorSet{
+                                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                                .dstSet = set,
+                                .dstBinding = 8,
+                                .dstArrayElement = 0,
+                                .descriptorCount = 1,
+                                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                .pBufferInfo = &bufferInfo,
+                            });
+                        }
+                    }
+                    vkUpdateDescriptorSets(deviceHandle, writes.size(), writes.data(), 0, nullptr);
+                });
+            rg->m_computePhase->registerComputeState(COMPUTE_STATE_PTR(csb.build()));
+        }
+
+        // average radiance of every probe for the debug overlay, once per frame instead of once per pixel
+        {
+            PipelineBuilder<PipelineTypeE::COMPUTE> pb;
+            PipelineDirector<PipelineTypeE::COMPUTE> pd;
+            pd.configureComputeBuilder(pb);
+            pb.setDevice(device);
+            pb.addComputeShaderStage("rc/probe_average_3d");
+            if (auto scripts = getReadOnlyInstancedComponents<RadianceCascades3D>(); !scripts.empty())
+                scripts[0]->getCascadeLayout().specialize(pb);
+            UniformDescriptorBuilder udb;
+            // radiance interval storage buffer
+            udb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
+                .binding = 0,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            });
+            // probe colors buffer
+            udb.addSetLayoutBinding(VkDescriptorSetLayoutBinding{
+                .binding = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            });
+            pb.addUniformDescriptorPack(udb.buildAndRestart());
+            ComputeStateBuilder csb;
+            csb.setDevice(device);
+            csb.setFrameInFlightCount(frameInFlightCount);
+            csb.setPipeline(pb.build());
+            csb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+            csb.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+            // the radiance intervals are written by the gather dispatch of the same phase
+            csb.setWaitPreviousDispatch(true);
+            auto s = getReadOnlyInstancedComponents<RadianceCascades3D>();
+            if (!s.empty())
+                csb.setWorkGroup(s[0]->getProbeAverageWorkGroupCount());
+            csb.setDescriptorSetUpdatePred(
+                [&](const RenderPhase *parentPhase, const VkDescriptorSet set, uint32_t backBufferIndex) {
+                    auto s = getReadOnlyInstancedComponents<RadianceCascades3D>();
+                    std::vector<VkWriteDescriptorSet> writes;
+                    if (!s.empty())
+                    {
+                        auto rc = s[0];
+
+                        VkDescriptorBufferInfo intervalsBufferInfo = {
+                            .buffer = rc->getRadianceIntervalsStorageBufferHandle(backBufferIndex)->getHandle(),
+                            .offset = 0,
+                            .range = rc->getRadianceIntervalsStorageBufferHandle(backBufferIndex)->getSize(),
+                        };
+                        writes.push_back(VkWriteDescriptorSet{
+                            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                            .dstSet = set,
+                            .dstBinding = 0,
+                            .dstArrayElement = 0,
+                            .descriptorCount = 1,
+                            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                            .pBufferInfo = &intervalsBufferInfo,
+                        });
+                        VkDescriptorBufferInfo colorsBufferInfo = {
+                            .buffer = rc->getProbeColorsBufferHandle(backBufferIndex)->getHandle(),
+                            .offset = 0,
+                            .range = rc->getProbeColorsBufferHandle(backBufferIndex)->getSize(),
+                        };
+                        writes.push_back(VkWriteDescriptorSet{
+                            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                            .dstSet = set,
+                            .dstBinding = 1,
+                            .dstArrayElement = 0,
+                            .descriptorCount = 1,
+                            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                            .pBufferInfo = &colorsBufferInfo,
+                        });
                     }
                     vkUpdateDescriptorSets(deviceHandle, writes.size(), writes.data(), 0, nullptr);
                 });
@@ -625,8 +768,7 @@ void SceneRC3D::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
                     .imageView = mostRecentImage.second,
                     .imageLayout = VK_IMAGE_LAYOUT_ATTACHMENT_OPTIMAL_KHR,
                 };
-                std::vector<VkWriteDescriptorSet> writes;
-                writes.push_back(VkWriteDescriptorSet{
+                VkWriteDescriptorSet write = {
                     .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
                     .dstSet = set,
                     .dstBinding = 0,
@@ -634,8 +776,8 @@ void SceneRC3D::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
                     .descriptorCount = 1,
                     .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
                     .pImageInfo = &imageInfo,
-                });
-                vkUpdateDescriptorSets(deviceHandle, writes.size(), writes.data(), 0, nullptr);
+                };
+                vkUpdateDescriptorSets(deviceHandle, 1, &write, 0, nullptr);
             });
             rsb.setInstanceDescriptorSetUpdatePred(
                 [&](const RenderPhase *parentPhase, const VkDescriptorSet set, uint32_t backBufferIndex) {
@@ -719,6 +861,9 @@ void SceneRC3D::load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, Wi
             pb.setRenderPass(rg->m_finalImageDirectIndirect->getRenderPass());
             pb.addVertexShaderStage("pp/screen");
             pb.addFragmentShaderStage("deferred/radiance_apply");
+            // the loops over the cascades are unrolled for the layout of the script
+            if (auto scripts = getReadOnlyInstancedComponents<RadianceCascades3D>(); !scripts.empty())
+                scripts[0]->getCascadeLayout().specialize(pb);
             pb.setExtent(window->getSwapChain()->getExtent());
             pb.setDepthTestEnable(VK_FALSE);
             pb.setDepthWriteEnable(VK_FALSE);
@@ -8,15 +8,16 @@ class Device;
 class WindowGLFW;
 class RenderGraph;
 class Context;
-class ProbeGrid;
 class Model;
 
 class SceneRC3D final : public SceneABC
 {
   public:
-    std::shared_ptr<ProbeGrid> m_grid0;
-    std::shared_ptr<ProbeGrid> m_grid1;
-    std::shared_ptr<ProbeGrid> m_grid2;
+    /**
+     * @brief mesh instanced on every probe of every cascade
+     *
+     */
+    std::shared_ptr<Model> m_probesDebug;
 
     std::shared_ptr<Model> m_screen;
 
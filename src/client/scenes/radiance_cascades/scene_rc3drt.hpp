@@ -2,22 +2,25 @@
 
 #include <memory>
 
+#include "engine/bvh.hpp"
+
 #include "renderer/scene.hpp"
 
 class Device;
 class WindowGLFW;
 class RenderGraph;
 class Context;
-class ProbeGrid;
 class Model;
 class Buffer;
 
 class SceneRC3DRT final : public SceneABC
 {
   public:
-    std::shared_ptr<ProbeGrid> m_grid0;
-    std::shared_ptr<ProbeGrid> m_grid1;
-    std::shared_ptr<ProbeGrid> m_grid2;
+    /**
+     * @brief mesh instanced on every probe of every cascade
+     *
+     */
+    std::shared_ptr<Model> m_probesDebug;
 
     std::shared_ptr<Model> m_screen;
 
@@ -26,6 +29,13 @@ class SceneRC3DRT final : public SceneABC
     std::unique_ptr<Buffer> m_dirLightSSBO;
     std::vector<void*> m_dirLightSSBOMapped;
 
+    /**
+     * @brief scene geometry traced on the CPU when the device does not support ray queries
+     *
+     */
+    std::unique_ptr<BVH> m_bvh;
+    bool m_cpuGather = false;
+
   public:
     void load(std::weak_ptr<Context> cx, std::weak_ptr<Device> device, WindowGLFW *window, RenderGraph *renderGraph,
               uint32_t frameInFlightCount, uint32_t maxProbeCount) override;
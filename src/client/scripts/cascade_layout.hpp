@@ -0,0 +1,153 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "graphics/pipeline.hpp"
+
+/**
+ * @brief constant_id of the specialization constants declared by the radiance cascades shaders
+ *
+ */
+enum class CascadeSpecializationE : uint32_t
+{
+    CASCADE_COUNT = 0,
+    /**
+     * @brief probe count per dimension of the first cascade
+     *
+     */
+    PROBE_GRID_SIZE = 1,
+    /**
+     * @brief radiance interval count per probe of the first cascade
+     *
+     */
+    INTERVAL_COUNT = 2,
+};
+
+/**
+ * @brief probe and interval counts of every cascade and their offsets in the radiance cascades buffers
+ * every cascade halves the probe count per dimension and doubles the interval count per dimension of the directions
+ * the shaders rebuild the same values from the specialization constants of their pipeline
+ *
+ * @tparam TDimensionCount 2 or 3
+ */
+template <uint32_t TDimensionCount> struct CascadeLayout
+{
+    static_assert(TDimensionCount == 2u || TDimensionCount == 3u);
+
+    /**
+     * @brief 1024 probes per dimension at most, the 3D probes are indexed with 10 bits per dimension
+     *
+     */
+    static constexpr uint32_t s_maxCascadeCount = 11u;
+
+    uint32_t cascadeCount = 0u;
+    uint32_t probeGridSize = 0u;
+
+    std::array<uint32_t, s_maxCascadeCount> probeCounts = {};
+    std::array<uint32_t, s_maxCascadeCount> intervalCounts = {};
+    /**
+     * @brief first probe and first interval of every cascade, the last offset is the total count
+     *
+     */
+    std::array<uint32_t, s_maxCascadeCount + 1u> probeOffsets = {};
+    std::array<uint32_t, s_maxCascadeCount + 1u> intervalOffsets = {};
+
+    /**
+     * @brief
+     *
+     * @param probeGridSize power of two
+     * @param intervalCount
+     * @param cascadeCount clamped so that the last cascade has one probe per dimension at least
+     */
+    static constexpr CascadeLayout make(uint32_t probeGridSize, uint32_t intervalCount, uint32_t cascadeCount)
+    {
+        CascadeLayout layout;
+        layout.probeGridSize = probeGridSize;
+        layout.cascadeCount = 0u;
+        for (uint32_t c = 0u; c < cascadeCount && c < s_maxCascadeCount && (probeGridSize >> c) > 0u; ++c)
+        {
+            uint32_t probeCount = 1u;
+            for (uint32_t d = 0u; d < TDimensionCount; ++d)
+                probeCount *= probeGridSize >> c;
+
+            layout.probeCounts[c] = probeCount;
+            layout.intervalCounts[c] = intervalCount << ((TDimensionCount - 1u) * c);
+            layout.probeOffsets[c + 1u] = layout.probeOffsets[c] + probeCount;
+            layout.intervalOffsets[c + 1u] = layout.intervalOffsets[c] + probeCount * layout.intervalCounts[c];
+            layout.cascadeCount++;
+        }
+        return layout;
+    }
+
+    /**
+     * @brief the shaders compute the offsets as the sums of geometric series instead of accumulating the cascades
+     * probes : P0 * (1 - r^c) / (1 - r) with r = 1 / 2^D
+     * intervals : 2 * (M0 - Mc), the interval count of a cascade is half the one of the previous cascade
+     *
+     */
+    [[nodiscard]] constexpr bool matchesShaderOffsets() const
+    {
+        constexpr uint32_t ratio = 1u << TDimensionCount;
+        for (uint32_t c = 0u; c < cascadeCount; ++c)
+        {
+            const uint32_t intervals0 = probeCounts[0] * intervalCounts[0];
+            const uint32_t intervalsC = probeCounts[c] * intervalCounts[c];
+            if (probeOffsets[c] != ratio * (probeCounts[0] - probeCounts[c]) / (ratio - 1u))
+                return false;
+            if (intervalOffsets[c] != 2u * (intervals0 - intervalsC))
+                return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief give the layout to the shaders of the pipeline, the loops over the cascades are unrolled when the
+     * pipeline is created
+     *
+     */
+    void specialize(BasePipelineBuilder &builder) const
+    {
+        builder.addSpecializationConstant(static_cast<uint32_t>(CascadeSpecializationE::CASCADE_COUNT), cascadeCount);
+        builder.addSpecializationConstant(static_cast<uint32_t>(CascadeSpecializationE::PROBE_GRID_SIZE),
+                                          probeGridSize);
+        builder.addSpecializationConstant(static_cast<uint32_t>(CascadeSpecializationE::INTERVAL_COUNT),
+                                          intervalCounts[0]);
+    }
+};
+
+/**
+ * @brief temporal amortization of the radiance gathering, given to the gather shaders as push constants
+ * the probes of cascade c are split in 2^min(c, maxPeriodShift) interleaved subsets, one subset is gathered per
+ * frame and the intervals of the other probes are copied from the storage buffer of the previous frame in flight
+ * a lighting change reaches every probe after 2^maxPeriodShift frames at most
+ *
+ */
+struct CascadeGatherSchedule
+{
+    uint32_t frameIndex = 0u;
+    /**
+     * @brief 0 gathers every probe every frame
+     *
+     */
+    uint32_t maxPeriodShift = 0u;
+
+    /**
+     * @brief frames between two gathers of the same probe
+     *
+     */
+    [[nodiscard]] constexpr uint32_t getPeriod(uint32_t cascadeIndex) const
+    {
+        return 1u << (cascadeIndex < maxPeriodShift ? cascadeIndex : maxPeriodShift);
+    }
+    /**
+     * @brief same test as is_probe_gathered in the gather shaders
+     *
+     * @param probeIndex index of the probe in its cascade
+     */
+    [[nodiscard]] constexpr bool isProbeGathered(uint32_t cascadeIndex, uint32_t probeIndex) const
+    {
+        const uint32_t period = getPeriod(cascadeIndex);
+        return probeIndex % period == frameIndex % period;
+    }
+};
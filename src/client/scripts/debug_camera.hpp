@@ -21,4 +21,13 @@ class DebugCamera : public ScriptableABC
     void init(void *userData) override;
     void begin() override;
     void update(float deltaTime) override;
+
+    [[nodiscard]] ScriptAccessT getUpdateAccess() const override
+    {
+        return ScriptAccessT{
+            .reads = SCRIPT_RESOURCE_MAIN_CAMERA_BIT,
+            .writes = SCRIPT_RESOURCE_MAIN_CAMERA_BIT,
+            .mainThread = false,
+        };
+    }
 };
\ No newline at end of file
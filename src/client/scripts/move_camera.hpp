@@ -33,4 +33,17 @@ class MoveCamera : public ScriptableABC
     void init(void *userData) override;
     void begin() override;
     void update(float deltaTime) override;
+
+    /**
+     * @brief reads the cursor and the mouse buttons from glfw
+     *
+     */
+    [[nodiscard]] ScriptAccessT getUpdateAccess() const override
+    {
+        return ScriptAccessT{
+            .reads = SCRIPT_RESOURCE_MAIN_CAMERA_BIT,
+            .writes = SCRIPT_RESOURCE_MAIN_CAMERA_BIT,
+            .mainThread = true,
+        };
+    }
 };
\ No newline at end of file
@@ -11,4 +11,9 @@ class Probes : public ScriptableABC
     void init(void *userData) override;
     void begin() override;
     void update(float deltaTime) override;
+
+    [[nodiscard]] ScriptAccessT getUpdateAccess() const override
+    {
+        return ScriptAccessT{.reads = 0u, .writes = 0u, .mainThread = false};
+    }
 };
\ No newline at end of file
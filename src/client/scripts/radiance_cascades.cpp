@@ -178,6 +178,23 @@ void RadianceCascades::init(void *userData)
             m_radianceIntervalsStorageBufferRW.push_back(bb.build());
         }
     }
+
+    // buffer 4 is the average radiance of every probe
+    // write : probe average compute pass, after the radiance gathering
+    // read : vertex shader of the probe debug overlay
+    {
+        for (int i = 0; i < data->frameInFlightCount; ++i)
+        {
+            BufferDirector bd;
+            BufferBuilder bb;
+            bd.configureStorageBufferBuilder(bb);
+            bb.setDevice(m_device);
+            bb.setName("Radiance Cascades Probe Colors Buffer");
+            bb.setSize(sizeof(glm::vec4) * getTotalProbeCount());
+
+            m_probeColorsBuffers.push_back(bb.build());
+        }
+    }
 }
 
 void RadianceCascades::begin()
@@ -230,3 +247,14 @@ void RadianceCascades::update(float deltaTime)
         start = a;
     }
 }
+
+CascadeGatherSchedule RadianceCascades::advanceGatherSchedule()
+{
+    // the first frame has no intervals of a previous frame to copy
+    CascadeGatherSchedule schedule = {
+        .frameIndex = m_gatherFrameIndex,
+        .maxPeriodShift = m_gatherFrameIndex == 0u ? 0u : m_temporalPeriodShift,
+    };
+    m_gatherFrameIndex++;
+    return schedule;
+}
@@ -10,6 +10,8 @@
 
 #include "engine/scriptable.hpp"
 
+#include "cascade_layout.hpp"
+
 class Device;
 class Model;
 
@@ -26,13 +28,55 @@ class RadianceCascades : public ScriptableABC
     std::shared_ptr<Model> blueCube;
     std::shared_ptr<Model> blackCube;
 
+    /**
+     * @brief probes averaged by one work group of the probe average compute shader
+     *
+     */
+    static constexpr uint32_t s_probeAverageLocalSize = 64u;
+    /**
+     * @brief pixels evaluated by one work group of the low resolution radiance apply compute shader, per dimension
+     *
+     */
+    static constexpr uint32_t s_radianceApplyLocalSize = 8u;
+    /**
+     * @brief the low resolution indirect image is allocated for this divisor, a greater divisor uses a part of it
+     *
+     */
+    static constexpr uint32_t s_minIndirectResolutionDivisor = 2u;
+
+    /**
+     * @brief resolution of the indirect light, given to the radiance apply shaders as push constants
+     *
+     */
+    struct indirect_resolution
+    {
+        /**
+         * @brief texels of the low resolution indirect image covering the screen
+         *
+         */
+        glm::uvec2 extent;
+        /**
+         * @brief 1 evaluates the indirect light for every pixel in the final image
+         *
+         */
+        uint32_t divisor;
+    };
+
   private:
-    const int m_maxCascadeCount = 3;
+    /**
+     * @brief 16 * 16 probes and 16 radiance intervals per probe in the first cascade, given to the shaders
+     *
+     */
+    static constexpr CascadeLayout<2> s_cascadeLayout = CascadeLayout<2>::make(16u, 16u, 3u);
+    // the shaders compute the offsets of the cascades from the specialization constants
+    static_assert(s_cascadeLayout.matchesShaderOffsets());
+
+    const int m_maxCascadeCount = s_cascadeLayout.cascadeCount;
     // p = probe count is a square number
-    const int m_maxProbeCount = 16 * 16;
+    const int m_maxProbeCount = s_cascadeLayout.probeCounts[0];
     // q = discrete value count will be doubled every cascade
     // number of radiance intervals for the probes from first cascade
-    const int m_minDiscreteValueCount = 16;
+    const int m_minDiscreteValueCount = s_cascadeLayout.intervalCounts[0];
     // dw = radiance interval length will be doubled every cascade
     // taken from https://www.shadertoy.com/view/mtlBzX
     const float m_minRadianceintervalLength =
@@ -109,6 +153,29 @@ class RadianceCascades : public ScriptableABC
      *
      */
     std::vector<std::unique_ptr<Buffer>> m_radianceIntervalsStorageBufferRW;
+    /**
+     * @brief average radiance of every probe, written by the probe average compute pass for the debug overlay
+     * one per frame in flight like the radiance intervals
+     *
+     */
+    std::vector<std::unique_ptr<Buffer>> m_probeColorsBuffers;
+
+    /**
+     * @brief frames gathered since the script started, selects the probes gathered by the next frame
+     *
+     */
+    uint32_t m_gatherFrameIndex = 0u;
+    /**
+     * @brief see CascadeGatherSchedule::maxPeriodShift
+     *
+     */
+    uint32_t m_temporalPeriodShift = 0u;
+
+    /**
+     * @brief the indirect light is evaluated for one pixel out of divisor * divisor and upsampled in the final image
+     *
+     */
+    uint32_t m_indirectResolutionDivisor = 1u;
 
     cascade createCascade(cascade_desc cd) const;
     std::vector<cascade> createCascades(cascade_desc desc0, int cascadeCount) const;
@@ -120,11 +187,79 @@ class RadianceCascades : public ScriptableABC
     virtual void begin() override;
     virtual void update(float deltaTime) override;
 
+    /**
+     * @brief moves the cubes
+     *
+     */
+    [[nodiscard]] virtual ScriptAccessT getUpdateAccess() const override
+    {
+        return ScriptAccessT{.reads = 0u, .writes = SCRIPT_RESOURCE_OBJECT_TRANSFORMS_BIT, .mainThread = false};
+    }
+
+    /**
+     * @brief schedule of the gather of this frame, called once per gathered frame
+     * the first frame gathers every probe since there are no previous intervals to copy
+     *
+     */
+    CascadeGatherSchedule advanceGatherSchedule();
+
   public:
     [[nodisacrd]] inline const int getCascadeCount() const
     {
         return m_maxCascadeCount;
     }
+    [[nodiscard]] inline const CascadeLayout<2> &getCascadeLayout() const
+    {
+        return s_cascadeLayout;
+    }
+    [[nodiscard]] inline uint32_t getIndirectResolutionDivisor() const
+    {
+        return m_indirectResolutionDivisor;
+    }
+    /**
+     * @brief
+     *
+     * @param divisor 1, 2 or 4
+     */
+    inline void setIndirectResolutionDivisor(uint32_t divisor)
+    {
+        m_indirectResolutionDivisor = divisor;
+    }
+    /**
+     * @brief
+     *
+     * @param screenExtent extent of the final image
+     * @param imageExtent extent of the low resolution indirect image
+     */
+    [[nodiscard]] inline indirect_resolution getIndirectResolution(glm::uvec2 screenExtent,
+                                                                   glm::uvec2 imageExtent) const
+    {
+        const uint32_t divisor = m_indirectResolutionDivisor;
+        return indirect_resolution{
+            .extent = glm::min((screenExtent + divisor - 1u) / divisor, imageExtent),
+            .divisor = divisor,
+        };
+    }
+    [[nodiscard]] inline uint32_t getTemporalPeriodShift() const
+    {
+        return m_temporalPeriodShift;
+    }
+    inline void setTemporalPeriodShift(uint32_t shift)
+    {
+        m_temporalPeriodShift = shift;
+    }
+    /**
+     * @brief probes gathered by every frame once the gather is amortized over the period of every cascade
+     *
+     */
+    [[nodiscard]] inline uint32_t getGatheredProbeCountPerFrame() const
+    {
+        const CascadeGatherSchedule schedule = {.maxPeriodShift = m_temporalPeriodShift};
+        uint32_t probeCount = 0u;
+        for (uint32_t c = 0u; c < s_cascadeLayout.cascadeCount; ++c)
+            probeCount += (s_cascadeLayout.probeCounts[c] + schedule.getPeriod(c) - 1u) / schedule.getPeriod(c);
+        return probeCount;
+    }
     [[nodiscard]] inline const Buffer *getParametersBufferHandle() const
     {
         return m_radianceCascadesParametersBuffer.get();
@@ -141,4 +276,33 @@ class RadianceCascades : public ScriptableABC
     {
         return m_radianceIntervalsStorageBufferRW[inFlightCount].get();
     }
+    /**
+     * @brief radiance intervals gathered by the frame before, copied for the probes that are not gathered this frame
+     *
+     */
+    [[nodiscard]] inline const Buffer *getPreviousRadianceIntervalsStorageBufferHandle(uint32_t inFlightCount) const
+    {
+        const size_t frameInFlightCount = m_radianceIntervalsStorageBufferRW.size();
+        return m_radianceIntervalsStorageBufferRW[(inFlightCount + frameInFlightCount - 1u) % frameInFlightCount].get();
+    }
+    [[nodiscard]] inline const Buffer *getProbeColorsBufferHandle(uint32_t inFlightCount) const
+    {
+        return m_probeColorsBuffers[inFlightCount].get();
+    }
+    /**
+     * @brief probes of every cascade, one instance of the debug overlay each
+     *
+     */
+    [[nodiscard]] inline uint32_t getTotalProbeCount() const
+    {
+        return s_cascadeLayout.probeOffsets[s_cascadeLayout.cascadeCount];
+    }
+    /**
+     * @brief one thread per probe of every cascade
+     *
+     */
+    [[nodiscard]] inline glm::ivec3 getProbeAverageWorkGroupCount() const
+    {
+        return glm::ivec3((getTotalProbeCount() + s_probeAverageLocalSize - 1u) / s_probeAverageLocalSize, 1, 1);
+    }
 };
\ No newline at end of file
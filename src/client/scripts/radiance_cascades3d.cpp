@@ -1,9 +1,26 @@
+#include <algorithm>
+#include <bit>
+#include <chrono>
 #include <iostream>
+#include <limits>
+
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <tracy/Tracy.hpp>
 
 #include "graphics/device.hpp"
 
+#include "renderer/light.hpp"
+
+#include "engine/bvh.hpp"
+#include "engine/job_system.hpp"
+
 #include "radiance_cascades3d.hpp"
 
+// the shaders compute the offsets of the cascades from the specialization constants
+static_assert(CascadeLayout<3>::make(4u, 8u, 3u).matchesShaderOffsets());
+
 int RadianceCascades3D::getTotalProbeCount(std::vector<cascade> cascades) const
 {
     int probeCount = 0;
@@ -14,39 +31,39 @@ int RadianceCascades3D::getTotalProbeCount(std::vector<cascade> cascades) const
     return probeCount;
 }
 
+uint32_t RadianceCascades3D::getMortonIndex(uint32_t x, uint32_t y, uint32_t z)
+{
+    // interleave the 10 lower bits of each coordinate
+    auto spreadBits = [](uint32_t v) {
+        v &= 0x000003ffu;
+        v = (v | (v << 16)) & 0x030000ffu;
+        v = (v | (v << 8)) & 0x0300f00fu;
+        v = (v | (v << 4)) & 0x030c30c3u;
+        v = (v | (v << 2)) & 0x09249249u;
+        return v;
+    };
+    return spreadBits(x) | (spreadBits(y) << 1) | (spreadBits(z) << 2);
+}
+
 RadianceCascades3D::cascade RadianceCascades3D::createCascade(cascade_desc cd) const
 {
     cascade result(cd.p);
     result.desc = cd;
 
-    // probe count per dimension
-    float px = std::cbrt(float(cd.p));
-    float py = px;
-    float pz = px;
-    float ipx = 1.0 / px;
-    float ipy = 1.0 / py;
-    float ipz = 1.0 / pz;
-
-    // center the probes
-    glm::vec3 offset = glm::vec3(ipx * -0.5, ipy * -0.5, ipz * -0.5) * m_range;
-
-    std::cout << "----------------------------new cascade---------------------------" << std::endl;
+    // probe count per dimension, the probe count is the cube of a power of two
+    uint32_t dimension = static_cast<uint32_t>(std::round(std::cbrt(float(cd.p))));
+    glm::vec3 spacing = m_range / float(dimension);
 
-    // probes within  the cascade
-    for (int i = 0; i < (int)px; ++i)
+    // probes are centered in their cell, the grid is centered on the origin
+    for (uint32_t i = 0; i < dimension; ++i)
     {
-        for (int j = 0; j < (int)py; ++j)
+        for (uint32_t j = 0; j < dimension; ++j)
         {
-            for (int k = 0; k < (int)pz; ++k)
+            for (uint32_t k = 0; k < dimension; ++k)
             {
-                // initialize probe posititon
-                int probeIndex = int(px * i + j + px * py * k);
-                result.probes[probeIndex].position.x = ipx * m_range.x * float(i) - offset.x;
-                result.probes[probeIndex].position.y = ipy * m_range.y * float(j) - offset.y;
-                result.probes[probeIndex].position.z = ipz * m_range.z * float(k) - offset.z;
-                std::cout << probeIndex << " : " << result.probes[probeIndex].position.x << ", "
-                          << result.probes[probeIndex].position.y << ", " << result.probes[probeIndex].position.z
-                          << std::endl;
+                uint32_t probeIndex = getMortonIndex(i, j, k);
+                result.probes[probeIndex].position =
+                    spacing * (glm::vec3(float(i), float(j), float(k)) + 0.5f) - m_range * 0.5f;
             }
         }
     }
@@ -54,6 +71,9 @@ RadianceCascades3D::cascade RadianceCascades3D::createCascade(cascade_desc cd) c
     // radiance interval count
     result.m = cd.p * cd.q;
 
+    std::cout << "Radiance cascade : " << dimension << "^3 probes, " << cd.q << " intervals per probe, interval length "
+              << cd.dw << std::endl;
+
     return result;
 }
 std::vector<RadianceCascades3D::cascade> RadianceCascades3D::createCascades(cascade_desc desc0, int cascadeCount) const
@@ -81,6 +101,25 @@ void RadianceCascades3D::init(void *userData)
     auto data = (init_data *)userData;
     m_device = data->device;
 
+    uint32_t dimensionSize = std::bit_ceil(std::clamp(data->probeGridSize, 1u, s_maxProbeGridSize));
+    if (dimensionSize != data->probeGridSize)
+        std::cerr << "Radiance cascades probe grid size set to " << dimensionSize << std::endl;
+    m_dimensionSize = static_cast<int>(dimensionSize);
+    m_maxProbeCount = m_dimensionSize * m_dimensionSize * m_dimensionSize;
+    // every cascade halves the probe count per dimension
+    m_maxCascadeCount = static_cast<int>(
+        std::clamp(data->cascadeCount, 1u, static_cast<uint32_t>(std::bit_width(dimensionSize))));
+    // the intervals of all the cascades sum to twice the ones of the first cascade, their offsets are 32 bits
+    const uint32_t maxDiscreteValueCount = std::numeric_limits<uint32_t>::max() / (2u * m_maxProbeCount);
+    uint32_t minDiscreteValueCount = std::clamp(data->minDiscreteValueCount, 1u, maxDiscreteValueCount);
+    if (minDiscreteValueCount != data->minDiscreteValueCount)
+        std::cerr << "Radiance cascades discrete value count set to " << minDiscreteValueCount << std::endl;
+    m_minDiscreteValueCount = static_cast<int>(minDiscreteValueCount);
+    m_cascadeLayout = CascadeLayout<3>::make(dimensionSize, minDiscreteValueCount, m_maxCascadeCount);
+    m_range = data->range;
+    m_minRadianceintervalLength =
+        glm::vec2(1366, 768).length() * 4.0 / (float(1 << 2 * m_maxCascadeCount) - 1.0);
+
     {
         BufferDirector bd;
         BufferBuilder bb;
@@ -117,6 +156,7 @@ void RadianceCascades3D::init(void *userData)
         {
             descs.push_back(cascades[i].desc);
         }
+        m_cascadeDescs = descs;
 
         BufferDirector bd;
         BufferBuilder bb;
@@ -144,6 +184,7 @@ void RadianceCascades3D::init(void *userData)
             {
                 positions.push_back(p);
                 probePositions[i].push_back(p.position);
+                m_probePositions.push_back(p.position);
             }
         }
 
@@ -177,11 +218,37 @@ void RadianceCascades3D::init(void *userData)
                 intervalCount += cascades[i].m;
             }
 
-            bb.setSize(sizeof(glm::vec4) * intervalCount);
+            bb.setSize(sizeof(radiance_interval) * intervalCount);
 
             m_radianceIntervalsStorageBufferRW.push_back(bb.build());
         }
     }
+
+    // buffer 4 is the average radiance of every probe
+    // write : probe average compute pass, after the radiance gathering
+    // read : vertex shader of the probe debug overlay
+    {
+        for (int i = 0; i < data->frameInFlightCount; ++i)
+        {
+            BufferDirector bd;
+            BufferBuilder bb;
+            bd.configureStorageBufferBuilder(bb);
+            bb.setDevice(m_device);
+            bb.setName("Radiance Cascades Probe Colors Buffer");
+            bb.setSize(sizeof(glm::vec4) * getTotalProbeCount());
+
+            m_probeColorsBuffers.push_back(bb.build());
+        }
+    }
+
+    m_cascadeStatistics.resize(cascades.size());
+    for (int i = 0; i < cascades.size(); ++i)
+    {
+        m_cascadeStatistics[i].probeCount = cascades[i].desc.p;
+        m_cascadeStatistics[i].intervalCount = cascades[i].m;
+        const size_t frameBytes = sizeof(radiance_interval) * cascades[i].m + sizeof(glm::vec4) * cascades[i].desc.p;
+        m_cascadeStatistics[i].memoryBytes = sizeof(probe) * cascades[i].desc.p + frameBytes * data->frameInFlightCount;
+    }
 }
 
 void RadianceCascades3D::begin()
@@ -192,3 +259,185 @@ void RadianceCascades3D::update(float deltaTime)
 {
     // TODO : make the probes of the cascades follow the view frustum
 }
+
+CascadeGatherSchedule RadianceCascades3D::advanceGatherSchedule()
+{
+    // the first frame has no intervals of a previous frame to copy
+    CascadeGatherSchedule schedule = {
+        .frameIndex = m_gatherFrameIndex,
+        .maxPeriodShift = m_gatherFrameIndex == 0u ? 0u : m_temporalPeriodShift,
+    };
+    m_gatherFrameIndex++;
+    return schedule;
+}
+
+uint32_t RadianceCascades3D::traceRadianceInterval(const BVH &bvh, const std::vector<std::shared_ptr<Light>> &lights,
+                                                   int cascadeIndex, const glm::vec3 &origin,
+                                                   const glm::vec3 &direction, glm::vec4 &radiance) const
+{
+    uint32_t rayCount = 1u;
+
+    // taken from https://www.shadertoy.com/view/mtlBzX
+    float t1 = m_cascadeDescs[0].dw;
+    float tMin = cascadeIndex == 0 ? 0.f : t1 * float(1 << 2 * (cascadeIndex - 1));
+    float tMax = t1 * float(1 << 2 * cascadeIndex);
+
+    BVH::Hit hit;
+    if (!bvh.intersect(BVH::Ray{.origin = origin, .direction = direction, .tMin = tMin, .tMax = tMax - tMin}, hit))
+    {
+        radiance = glm::vec4(0.f);
+        return rayCount;
+    }
+
+    const glm::vec3 &v0 = bvh.getHitVertex(hit, 0u);
+    const glm::vec3 &v1 = bvh.getHitVertex(hit, 1u);
+    const glm::vec3 &v2 = bvh.getHitVertex(hit, 2u);
+    glm::vec3 normal = glm::cross(v1 - v0, v2 - v0);
+    glm::vec3 p = (v0 + v1 + v2) / 3.f;
+
+    glm::vec3 diffuse = glm::vec3(0.f);
+    for (const std::shared_ptr<Light> &light : lights)
+    {
+        glm::vec3 lightDir;
+        float lightDist;
+        float attenuation = 1.f;
+        if (light->type == LightTypeE::POINT)
+        {
+            const PointLight &pointLight = static_cast<const PointLight &>(*light);
+            glm::vec3 fragPosToLightPos = pointLight.position - p;
+            lightDist = glm::length(fragPosToLightPos);
+            lightDir = fragPosToLightPos / lightDist;
+            attenuation = glm::dot(pointLight.attenuation, glm::vec3(1.f, lightDist, lightDist * lightDist));
+        }
+        else
+        {
+            lightDir = glm::normalize(static_cast<const DirectionalLight &>(*light).direction);
+            lightDist = 999.f;
+        }
+
+        rayCount++;
+        if (bvh.occluded(BVH::Ray{.origin = p, .direction = lightDir, .tMin = 0.01f, .tMax = lightDist}))
+            continue;
+
+        float diffuseIntensity = std::max(glm::dot(normal, lightDir), 0.f);
+        diffuse += diffuseIntensity * light->diffuseColor * light->diffusePower / attenuation;
+    }
+
+    radiance = glm::vec4(diffuse, 1.f);
+    return rayCount;
+}
+
+void RadianceCascades3D::gatherRadianceIntervalsOnCpu(const BVH &bvh, const std::vector<std::shared_ptr<Light>> &lights,
+                                                      uint32_t frameIndex, JobSystem &jobSystem)
+{
+    ZoneScoped;
+
+    radiance_interval *intervals =
+        static_cast<radiance_interval *>(m_radianceIntervalsStorageBufferRW[frameIndex]->getMappedData());
+    if (!intervals)
+        return;
+
+    // the probes that are not gathered this frame keep the intervals of the previous frame
+    const radiance_interval *previousIntervals = static_cast<const radiance_interval *>(
+        getPreviousRadianceIntervalsStorageBufferHandle(frameIndex)->getMappedData());
+    const CascadeGatherSchedule schedule = advanceGatherSchedule();
+
+    m_gatherStatistics = GatherStatistics{};
+
+    for (int c = 0; c < m_cascadeDescs.size(); ++c)
+    {
+        const cascade_desc &desc = m_cascadeDescs[c];
+        const int probeIndexOffset = static_cast<int>(m_cascadeLayout.probeOffsets[c]);
+        const int intervalIndexOffset = static_cast<int>(m_cascadeLayout.intervalOffsets[c]);
+
+        float intervalOffset = 0.f;
+        if (c > 0)
+            intervalOffset = float(1 << (c - 1));
+        intervalOffset *= m_minRadianceintervalLength;
+
+        // same directions and interval indices as the compute shader, the probes write disjoint ranges of intervals
+        auto gatherProbes = [&](uint32_t first, uint32_t last) {
+            uint64_t rayCount = 0u;
+            float sqrtIntervalCount = std::sqrt(float(desc.q));
+            int thetaCount = int(sqrtIntervalCount) / 2;
+            for (uint32_t i = first; i < last; ++i)
+            {
+                int intervalProbeIndex = intervalIndexOffset + i * int(desc.q);
+                if (!schedule.isProbeGathered(c, i))
+                {
+                    std::copy_n(previousIntervals + intervalProbeIndex, desc.q, intervals + intervalProbeIndex);
+                    continue;
+                }
+
+                const glm::vec3 &position = m_probePositions[probeIndexOffset + i];
+
+                for (int j = 0; j < int(sqrtIntervalCount); ++j)
+                {
+                    float phi = glm::pi<float>() * float(j + 1) / sqrtIntervalCount;
+                    for (int k = 0; k < thetaCount; ++k)
+                    {
+                        float theta = 2.f * glm::pi<float>() * float(k) / float(thetaCount);
+                        glm::vec3 dir = glm::vec3(std::sin(phi) * std::cos(theta), std::cos(phi),
+                                                  std::sin(phi) * std::sin(theta));
+
+                        glm::vec4 radiance;
+                        rayCount += traceRadianceInterval(bvh, lights, c, position + dir * intervalOffset, dir,
+                                                          radiance);
+                        intervals[intervalProbeIndex + k] = radiance_interval{
+                            .rg = glm::packHalf2x16(glm::vec2(radiance.r, radiance.g)),
+                            .ba = glm::packHalf2x16(glm::vec2(radiance.b, radiance.a)),
+                        };
+                    }
+                }
+            }
+            return rayCount;
+        };
+
+        auto start = std::chrono::steady_clock::now();
+
+        // probes are morton ordered, contiguous chunks keep the threads in neighbouring regions of the scene
+        m_threadRayCounts.assign(jobSystem.getThreadCount(), 0u);
+        const uint32_t threadCount =
+            jobSystem.parallelFor(desc.p, s_cpuGatherChunkSize, m_cpuGatherThreadLimit,
+                                  [&](uint32_t first, uint32_t last, uint32_t threadIndex) {
+                                      m_threadRayCounts[threadIndex] += gatherProbes(first, last);
+                                  });
+        m_gatherStatistics.threadCount = std::max(m_gatherStatistics.threadCount, threadCount);
+
+        CascadeStatistics &stats = m_cascadeStatistics[c];
+        stats.gatherSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        stats.rayCount = 0u;
+        for (uint64_t count : m_threadRayCounts)
+            stats.rayCount += count;
+
+        m_gatherStatistics.rayCount += stats.rayCount;
+        m_gatherStatistics.seconds += stats.gatherSeconds;
+    }
+}
+
+void RadianceCascades3D::averageProbeColorsOnCpu(uint32_t frameIndex)
+{
+    ZoneScoped;
+
+    const radiance_interval *intervals =
+        static_cast<const radiance_interval *>(m_radianceIntervalsStorageBufferRW[frameIndex]->getMappedData());
+    glm::vec4 *probeColors = static_cast<glm::vec4 *>(m_probeColorsBuffers[frameIndex]->getMappedData());
+    if (!intervals || !probeColors)
+        return;
+
+    // same average as rc/probe_average_3d.comp
+    for (uint32_t c = 0u; c < m_cascadeLayout.cascadeCount; ++c)
+    {
+        const uint32_t intervalCount = m_cascadeLayout.intervalCounts[c];
+        const radiance_interval *cascadeIntervals = intervals + m_cascadeLayout.intervalOffsets[c];
+        for (uint32_t i = 0u; i < m_cascadeLayout.probeCounts[c]; ++i)
+        {
+            const radiance_interval *probeIntervals = cascadeIntervals + i * intervalCount;
+            glm::vec4 probeColor = glm::vec4(0.f);
+            for (uint32_t k = 0u; k < intervalCount; ++k)
+                probeColor += glm::vec4(glm::unpackHalf2x16(probeIntervals[k].rg),
+                                        glm::unpackHalf2x16(probeIntervals[k].ba));
+            probeColors[m_cascadeLayout.probeOffsets[c] + i] = probeColor / float(intervalCount);
+        }
+    }
+}
@@ -10,7 +10,12 @@
 
 #include "engine/scriptable.hpp"
 
+#include "cascade_layout.hpp"
+
 class Device;
+class BVH;
+class JobSystem;
+class Light;
 
 class RadianceCascades3D : public ScriptableABC
 {
@@ -19,25 +24,75 @@ class RadianceCascades3D : public ScriptableABC
     {
         std::weak_ptr<Device> device;
         uint32_t frameInFlightCount;
+
+        /**
+         * @brief size of the volume covered by the probes, centered on the origin
+         *
+         */
+        glm::vec3 range = glm::vec3(10.f);
+        /**
+         * @brief probe count per dimension of the first cascade, rounded up to a power of two
+         * every following cascade halves it
+         *
+         */
+        uint32_t probeGridSize = 4u;
+        uint32_t cascadeCount = 3u;
+        /**
+         * @brief number of radiance intervals of the probes of the first cascade, multiplied by 4 every cascade
+         *
+         */
+        uint32_t minDiscreteValueCount = 8u;
+    };
+
+    /**
+     * @brief radiance interval as stored in the storage buffer, rgba in half floats
+     *
+     */
+    struct radiance_interval
+    {
+        uint32_t rg;
+        uint32_t ba;
     };
 
+    /**
+     * @brief probes handled by one work group of the gather compute shader
+     *
+     */
+    static constexpr uint32_t s_gatherLocalSize = 128u;
+    /**
+     * @brief largest probe grid size, the gather dispatches one work group per 128 probes along y and the devices
+     * only guarantee 65535 work groups per dimension
+     *
+     */
+    static constexpr uint32_t s_maxProbeGridSize = 128u;
+    /**
+     * @brief probes averaged by one work group of the probe average compute shader
+     *
+     */
+    static constexpr uint32_t s_probeAverageLocalSize = 64u;
+    /**
+     * @brief probes gathered by a thread before it takes the next ones, the upper cascades have few probes of many
+     * intervals
+     *
+     */
+    static constexpr uint32_t s_cpuGatherChunkSize = 8u;
+
   private:
-    const glm::vec3 m_range = glm::vec3(10.f);
-    const int m_maxCascadeCount = 3;
+    glm::vec3 m_range = glm::vec3(10.f);
+    int m_maxCascadeCount = 3;
     /**
      * @brief probe count per dimension
      *
      */
-    const int m_dimensionSize = 4;
-    // p = probe count is a square number
-    const int m_maxProbeCount = m_dimensionSize * m_dimensionSize * m_dimensionSize;
+    int m_dimensionSize = 4;
+    // p = probe count is a cube number
+    int m_maxProbeCount = m_dimensionSize * m_dimensionSize * m_dimensionSize;
     // q = discrete value count will be doubled every cascade
     // number of radiance intervals for the probes from first cascade
-    const int m_minDiscreteValueCount = 8;
+    int m_minDiscreteValueCount = 8;
     // dw = radiance interval length will be doubled every cascade
     // taken from https://www.shadertoy.com/view/mtlBzX
-    const float m_minRadianceintervalLength =
-        glm::vec2(1366, 768).length() * 4.0 / (float(1 << 2 * m_maxCascadeCount) - 1.0);
+    float m_minRadianceintervalLength = 0.f;
 
     // intensity of every lights (when applying irradiance)
     const float m_lightIntensity = 1.f;
@@ -58,9 +113,14 @@ class RadianceCascades3D : public ScriptableABC
     };
     std::unique_ptr<Buffer> m_radianceCascadesParametersBuffer;
 
+    /**
+     * @brief padded to the std430 stride of the shaders
+     *
+     */
     struct probe
     {
         glm::vec3 position;
+        float pad0[1];
     };
 
     struct cascade_desc
@@ -91,8 +151,50 @@ class RadianceCascades3D : public ScriptableABC
         }
     };
 
+  public:
+    struct GatherStatistics
+    {
+        uint64_t rayCount = 0u;
+        double seconds = 0.0;
+        uint32_t threadCount = 0u;
+    };
+
+    struct CascadeStatistics
+    {
+        uint32_t probeCount = 0u;
+        uint32_t intervalCount = 0u;
+        /**
+         * @brief probe positions, radiance intervals and probe colors of every frame in flight
+         *
+         */
+        size_t memoryBytes = 0u;
+        /**
+         * @brief last CPU gather of the cascade
+         *
+         */
+        uint64_t rayCount = 0u;
+        double gatherSeconds = 0.0;
+    };
+
+  private:
     std::weak_ptr<Device> m_device;
 
+    std::vector<cascade_desc> m_cascadeDescs;
+    /**
+     * @brief same counts as the cascade descs, given to the shaders
+     *
+     */
+    CascadeLayout<3> m_cascadeLayout;
+    std::vector<glm::vec3> m_probePositions;
+
+    GatherStatistics m_gatherStatistics;
+    std::vector<CascadeStatistics> m_cascadeStatistics;
+    /**
+     * @brief rays traced by each thread of the CPU gather, kept across frames so that the gather does not allocate
+     *
+     */
+    std::vector<uint64_t> m_threadRayCounts;
+
     /**
      * @brief buffer containing the cascades description
      *
@@ -109,12 +211,45 @@ class RadianceCascades3D : public ScriptableABC
      *
      */
     std::vector<std::unique_ptr<Buffer>> m_radianceIntervalsStorageBufferRW;
+    /**
+     * @brief average radiance of every probe, written by the probe average compute pass for the debug overlay
+     * one per frame in flight like the radiance intervals
+     *
+     */
+    std::vector<std::unique_ptr<Buffer>> m_probeColorsBuffers;
+
+    /**
+     * @brief frames gathered since the script started, selects the probes gathered by the next frame
+     *
+     */
+    uint32_t m_gatherFrameIndex = 0u;
+    /**
+     * @brief see CascadeGatherSchedule::maxPeriodShift
+     *
+     */
+    uint32_t m_temporalPeriodShift = 0u;
+
+    uint32_t m_cpuGatherThreadLimit = 0u;
+
+    /**
+     * @brief index of a probe in its cascade, neighbouring probes are close in memory
+     *
+     */
+    static uint32_t getMortonIndex(uint32_t x, uint32_t y, uint32_t z);
 
     cascade createCascade(cascade_desc cd) const;
     std::vector<cascade> createCascades(cascade_desc desc0, int cascadeCount) const;
 
     int getTotalProbeCount(std::vector<cascade> cascades) const;
 
+    /**
+     * @brief radiance coming from a direction, same as raycasting_function in radiance_gather_3drt.comp
+     *
+     * @return uint32_t number of rays traced (gather ray and shadow rays)
+     */
+    uint32_t traceRadianceInterval(const BVH &bvh, const std::vector<std::shared_ptr<Light>> &lights, int cascadeIndex,
+                                   const glm::vec3 &origin, const glm::vec3 &direction, glm::vec4 &radiance) const;
+
   public:
     /**
      * @brief probes positions per casacde
@@ -126,11 +261,86 @@ class RadianceCascades3D : public ScriptableABC
     virtual void begin() override;
     virtual void update(float deltaTime) override;
 
+    [[nodiscard]] virtual ScriptAccessT getUpdateAccess() const override
+    {
+        return ScriptAccessT{.reads = 0u, .writes = 0u, .mainThread = false};
+    }
+
+    /**
+     * @brief gather the radiance intervals on the CPU when the device cannot trace rays from a compute shader
+     * the probes are split between the threads of the job system, the intervals are written to the storage buffer of
+     * the frame
+     *
+     * @param bvh scene geometry in world space
+     * @param lights
+     * @param frameIndex frame in flight whose storage buffer is not used by the device anymore
+     */
+    void gatherRadianceIntervalsOnCpu(const BVH &bvh, const std::vector<std::shared_ptr<Light>> &lights,
+                                      uint32_t frameIndex, JobSystem &jobSystem);
+    /**
+     * @brief average radiance of every probe for the debug overlay, written instead of the probe average compute pass
+     * when the radiance intervals are gathered on the CPU
+     *
+     * @param frameIndex frame in flight whose probe colors are not read by the device anymore
+     */
+    void averageProbeColorsOnCpu(uint32_t frameIndex);
+
+    /**
+     * @brief schedule of the gather of this frame, called once per gathered frame
+     * the first frame gathers every probe since there are no previous intervals to copy
+     *
+     */
+    CascadeGatherSchedule advanceGatherSchedule();
+
   public:
     [[nodisacrd]] inline const int getCascadeCount() const
     {
         return m_maxCascadeCount;
     }
+    /**
+     * @brief one work group per cascade along x, the probes of a cascade are split along y
+     *
+     */
+    [[nodiscard]] inline glm::ivec3 getGatherWorkGroupCount() const
+    {
+        return glm::ivec3(m_maxCascadeCount, (m_maxProbeCount + s_gatherLocalSize - 1) / s_gatherLocalSize, 1);
+    }
+    [[nodiscard]] inline const CascadeLayout<3> &getCascadeLayout() const
+    {
+        return m_cascadeLayout;
+    }
+    [[nodiscard]] inline uint32_t getTemporalPeriodShift() const
+    {
+        return m_temporalPeriodShift;
+    }
+    inline void setTemporalPeriodShift(uint32_t shift)
+    {
+        m_temporalPeriodShift = shift;
+    }
+    [[nodiscard]] inline uint32_t getCpuGatherThreadLimit() const
+    {
+        return m_cpuGatherThreadLimit;
+    }
+    /**
+     * @brief measure how the CPU gather scales with the thread count, 0 uses every thread of the job system
+     *
+     */
+    inline void setCpuGatherThreadLimit(uint32_t limit)
+    {
+        m_cpuGatherThreadLimit = limit;
+    }
+    /**
+     * @brief probes gathered by every frame once the gather is amortized over the period of every cascade
+     *
+     */
+    [[nodiscard]] inline uint32_t getGatheredProbeCountPerFrame() const
+    {
+        const CascadeGatherSchedule schedule = {.maxPeriodShift = m_temporalPeriodShift};
+        uint32_t probeCount = 0u;
+        for (uint32_t c = 0u; c < m_cascadeLayout.cascadeCount; ++c)
+            probeCount += (m_cascadeLayout.probeCounts[c] + schedule.getPeriod(c) - 1u) / schedule.getPeriod(c);
+        return probeCount;
+    }
     [[nodiscard]] inline const Buffer *getParametersBufferHandle() const
     {
         return m_radianceCascadesParametersBuffer.get();
@@ -147,4 +357,54 @@ class RadianceCascades3D : public ScriptableABC
     {
         return m_radianceIntervalsStorageBufferRW[inFlightCount].get();
     }
+    /**
+     * @brief radiance intervals gathered by the frame before, copied for the probes that are not gathered this frame
+     *
+     */
+    [[nodiscard]] inline const Buffer *getPreviousRadianceIntervalsStorageBufferHandle(uint32_t inFlightCount) const
+    {
+        const size_t frameInFlightCount = m_radianceIntervalsStorageBufferRW.size();
+        return m_radianceIntervalsStorageBufferRW[(inFlightCount + frameInFlightCount - 1u) % frameInFlightCount].get();
+    }
+    [[nodiscard]] inline const Buffer *getProbeColorsBufferHandle(uint32_t inFlightCount) const
+    {
+        return m_probeColorsBuffers[inFlightCount].get();
+    }
+    /**
+     * @brief probe colors averaged by the frame before, complete while the gather of this frame is running
+     *
+     */
+    [[nodiscard]] inline const Buffer *getPreviousProbeColorsBufferHandle(uint32_t inFlightCount) const
+    {
+        const size_t frameInFlightCount = m_probeColorsBuffers.size();
+        return m_probeColorsBuffers[(inFlightCount + frameInFlightCount - 1u) % frameInFlightCount].get();
+    }
+    /**
+     * @brief probes of every cascade, one instance of the debug overlay each
+     *
+     */
+    [[nodiscard]] inline uint32_t getTotalProbeCount() const
+    {
+        return m_cascadeLayout.probeOffsets[m_cascadeLayout.cascadeCount];
+    }
+    /**
+     * @brief one thread per probe of every cascade
+     *
+     */
+    [[nodiscard]] inline glm::ivec3 getProbeAverageWorkGroupCount() const
+    {
+        return glm::ivec3((getTotalProbeCount() + s_probeAverageLocalSize - 1u) / s_probeAverageLocalSize, 1, 1);
+    }
+    /**
+     * @brief last CPU gather, empty if the radiance is gathered by the device
+     *
+     */
+    [[nodiscard]] inline const GatherStatistics &getGatherStatistics() const
+    {
+        return m_gatherStatistics;
+    }
+    [[nodiscard]] inline const std::vector<CascadeStatistics> &getCascadeStatistics() const
+    {
+        return m_cascadeStatistics;
+    }
 };
\ No newline at end of file
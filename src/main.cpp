@@ -2,12 +2,15 @@
 
 #include <tracy/Tracy.hpp>
 
+#include "engine/heap_counter.hpp"
+
 #include "client/application.hpp"
 
 void *operator new(std ::size_t count)
 {
     auto ptr = malloc(count);
     TracyAlloc(ptr, count);
+    HeapCounter::recordAllocation();
     return ptr;
 }
 void operator delete(void *ptr) noexcept
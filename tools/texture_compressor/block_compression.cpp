@@ -0,0 +1,313 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "block_compression.hpp"
+
+constexpr int BLOCK_TEXEL_COUNT = 16;
+
+/**
+ * @brief find two endpoints along the principal axis of the block colors
+ *
+ * @param texels RGBA8 texels
+ * @param channelCount number of channels taken into account (3 or 4)
+ * @param endpoint0 low end of the segment
+ * @param endpoint1 high end of the segment
+ */
+static void findEndpoints(const uint8_t *texels, int channelCount, float endpoint0[4], float endpoint1[4])
+{
+    float mean[4] = {};
+    for (int i = 0; i < BLOCK_TEXEL_COUNT; ++i)
+        for (int c = 0; c < channelCount; ++c)
+            mean[c] += texels[i * 4 + c];
+    for (int c = 0; c < channelCount; ++c)
+        mean[c] /= BLOCK_TEXEL_COUNT;
+
+    float covariance[4][4] = {};
+    for (int i = 0; i < BLOCK_TEXEL_COUNT; ++i)
+    {
+        for (int a = 0; a < channelCount; ++a)
+        {
+            for (int b = 0; b < channelCount; ++b)
+                covariance[a][b] += (texels[i * 4 + a] - mean[a]) * (texels[i * 4 + b] - mean[b]);
+        }
+    }
+
+    // power iteration
+    float axis[4] = {1.f, 1.f, 1.f, 1.f};
+    for (int iteration = 0; iteration < 8; ++iteration)
+    {
+        float next[4] = {};
+        for (int a = 0; a < channelCount; ++a)
+            for (int b = 0; b < channelCount; ++b)
+                next[a] += covariance[a][b] * axis[b];
+
+        float length = 0.f;
+        for (int c = 0; c < channelCount; ++c)
+            length = std::max(length, std::abs(next[c]));
+        if (length == 0.f)
+            break;
+
+        for (int c = 0; c < channelCount; ++c)
+            axis[c] = next[c] / length;
+    }
+
+    float axisLengthSq = 0.f;
+    for (int c = 0; c < channelCount; ++c)
+        axisLengthSq += axis[c] * axis[c];
+
+    float minT = 0.f;
+    float maxT = 0.f;
+    if (axisLengthSq > 0.f)
+    {
+        minT = 1e9f;
+        maxT = -1e9f;
+        for (int i = 0; i < BLOCK_TEXEL_COUNT; ++i)
+        {
+            float t = 0.f;
+            for (int c = 0; c < channelCount; ++c)
+                t += (texels[i * 4 + c] - mean[c]) * axis[c];
+            t /= axisLengthSq;
+            minT = std::min(minT, t);
+            maxT = std::max(maxT, t);
+        }
+    }
+
+    for (int c = 0; c < channelCount; ++c)
+    {
+        endpoint0[c] = std::clamp(mean[c] + axis[c] * minT, 0.f, 255.f);
+        endpoint1[c] = std::clamp(mean[c] + axis[c] * maxT, 0.f, 255.f);
+    }
+    for (int c = channelCount; c < 4; ++c)
+    {
+        endpoint0[c] = 255.f;
+        endpoint1[c] = 255.f;
+    }
+}
+
+static uint16_t packRGB565(const float color[4])
+{
+    const uint16_t r = (uint16_t)std::lround(color[0] * 31.f / 255.f);
+    const uint16_t g = (uint16_t)std::lround(color[1] * 63.f / 255.f);
+    const uint16_t b = (uint16_t)std::lround(color[2] * 31.f / 255.f);
+    return (r << 11) | (g << 5) | b;
+}
+
+static void unpackRGB565(uint16_t packed, int color[3])
+{
+    const int r = (packed >> 11) & 31;
+    const int g = (packed >> 5) & 63;
+    const int b = packed & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+void encodeBlockBC1(const uint8_t *texels, uint8_t *block)
+{
+    float endpoint0[4], endpoint1[4];
+    findEndpoints(texels, 3, endpoint0, endpoint1);
+
+    uint16_t color0 = packRGB565(endpoint1);
+    uint16_t color1 = packRGB565(endpoint0);
+    // color0 > color1 selects the opaque 4 colors mode
+    if (color0 < color1)
+        std::swap(color0, color1);
+
+    uint32_t indices = 0;
+    if (color0 != color1)
+    {
+        int palette[4][3];
+        unpackRGB565(color0, palette[0]);
+        unpackRGB565(color1, palette[1]);
+        for (int c = 0; c < 3; ++c)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+
+        for (int i = 0; i < BLOCK_TEXEL_COUNT; ++i)
+        {
+            uint32_t bestIndex = 0;
+            int bestError = INT32_MAX;
+            for (uint32_t p = 0; p < 4; ++p)
+            {
+                int error = 0;
+                for (int c = 0; c < 3; ++c)
+                {
+                    const int d = texels[i * 4 + c] - palette[p][c];
+                    error += d * d;
+                }
+                if (error < bestError)
+                {
+                    bestError = error;
+                    bestIndex = p;
+                }
+            }
+            indices |= bestIndex << (2 * i);
+        }
+    }
+
+    block[0] = color0 & 0xFF;
+    block[1] = color0 >> 8;
+    block[2] = color1 & 0xFF;
+    block[3] = color1 >> 8;
+    for (int b = 0; b < 4; ++b)
+        block[4 + b] = (indices >> (8 * b)) & 0xFF;
+}
+
+/**
+ * @brief encode a single channel of the block, BC5 is made of two of these
+ *
+ */
+static void encodeBlockBC4(const uint8_t *texels, int channel, uint8_t *block)
+{
+    uint8_t minValue = 255;
+    uint8_t maxValue = 0;
+    for (int i = 0; i < BLOCK_TEXEL_COUNT; ++i)
+    {
+        minValue = std::min(minValue, texels[i * 4 + channel]);
+        maxValue = std::max(maxValue, texels[i * 4 + channel]);
+    }
+
+    // red0 > red1 selects the 8 values mode
+    block[0] = maxValue;
+    block[1] = minValue;
+
+    uint64_t indices = 0;
+    if (maxValue > minValue)
+    {
+        // index 0 is red0, index 1 is red1 and indices 2 to 7 are interpolated from red0 to red1
+        constexpr uint64_t stepToIndex[8] = {0, 2, 3, 4, 5, 6, 7, 1};
+        const float scale = 7.f / (maxValue - minValue);
+        for (int i = 0; i < BLOCK_TEXEL_COUNT; ++i)
+        {
+            const long step = std::lround((maxValue - texels[i * 4 + channel]) * scale);
+            indices |= stepToIndex[step] << (3 * i);
+        }
+    }
+
+    for (int b = 0; b < 6; ++b)
+        block[2 + b] = (indices >> (8 * b)) & 0xFF;
+}
+
+void encodeBlockBC5(const uint8_t *texels, uint8_t *block)
+{
+    encodeBlockBC4(texels, 0, block);
+    encodeBlockBC4(texels, 1, block + 8);
+}
+
+class BitWriter
+{
+  private:
+    uint8_t *m_data;
+    uint32_t m_bit = 0;
+
+  public:
+    BitWriter(uint8_t *data) : m_data(data)
+    {
+    }
+
+    void write(uint32_t value, uint32_t bitCount)
+    {
+        for (uint32_t i = 0; i < bitCount; ++i, ++m_bit)
+        {
+            if ((value >> i) & 1)
+                m_data[m_bit >> 3] |= 1 << (m_bit & 7);
+        }
+    }
+};
+
+/**
+ * @brief quantize an endpoint to 7 bits per channel and a shared p-bit
+ *
+ */
+static void quantizeEndpointBC7(const float endpoint[4], uint32_t quantized[4], uint32_t &pBit)
+{
+    float bestError = 1e9f;
+    for (uint32_t p = 0; p < 2; ++p)
+    {
+        uint32_t candidate[4];
+        float error = 0.f;
+        for (int c = 0; c < 4; ++c)
+        {
+            candidate[c] = (uint32_t)std::clamp(std::lround((endpoint[c] - p) / 2.f), 0L, 127L);
+            const float d = endpoint[c] - (float)((candidate[c] << 1) | p);
+            error += d * d;
+        }
+        if (error < bestError)
+        {
+            bestError = error;
+            pBit = p;
+            std::memcpy(quantized, candidate, sizeof(candidate));
+        }
+    }
+}
+
+void encodeBlockBC7(const uint8_t *texels, uint8_t *block)
+{
+    constexpr uint32_t weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+    float endpoint0[4], endpoint1[4];
+    findEndpoints(texels, 4, endpoint0, endpoint1);
+
+    uint32_t quantized[2][4];
+    uint32_t pBits[2];
+    quantizeEndpointBC7(endpoint0, quantized[0], pBits[0]);
+    quantizeEndpointBC7(endpoint1, quantized[1], pBits[1]);
+
+    int palette[16][4];
+    for (int c = 0; c < 4; ++c)
+    {
+        const uint32_t e0 = (quantized[0][c] << 1) | pBits[0];
+        const uint32_t e1 = (quantized[1][c] << 1) | pBits[1];
+        for (int i = 0; i < 16; ++i)
+            palette[i][c] = (int)(((64 - weights[i]) * e0 + weights[i] * e1 + 32) >> 6);
+    }
+
+    uint32_t indices[BLOCK_TEXEL_COUNT];
+    for (int i = 0; i < BLOCK_TEXEL_COUNT; ++i)
+    {
+        int bestError = INT32_MAX;
+        for (uint32_t p = 0; p < 16; ++p)
+        {
+            int error = 0;
+            for (int c = 0; c < 4; ++c)
+            {
+                const int d = texels[i * 4 + c] - palette[p][c];
+                error += d * d;
+            }
+            if (error < bestError)
+            {
+                bestError = error;
+                indices[i] = p;
+            }
+        }
+    }
+
+    // the most significant bit of the anchor index is implicit and must be 0
+    if (indices[0] & 8)
+    {
+        std::swap(quantized[0], quantized[1]);
+        std::swap(pBits[0], pBits[1]);
+        for (int i = 0; i < BLOCK_TEXEL_COUNT; ++i)
+            indices[i] = 15 - indices[i];
+    }
+
+    std::memset(block, 0, 16);
+    BitWriter writer(block);
+
+    // mode 6
+    writer.write(1 << 6, 7);
+    for (int c = 0; c < 4; ++c)
+    {
+        writer.write(quantized[0][c], 7);
+        writer.write(quantized[1][c], 7);
+    }
+    writer.write(pBits[0], 1);
+    writer.write(pBits[1], 1);
+
+    writer.write(indices[0], 3);
+    for (int i = 1; i < BLOCK_TEXEL_COUNT; ++i)
+        writer.write(indices[i], 4);
+}
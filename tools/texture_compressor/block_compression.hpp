@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * @brief encode a 4x4 block of RGBA8 texels (row major, 64 bytes) into a 8 bytes BC1 block
+ * alpha is ignored
+ *
+ */
+void encodeBlockBC1(const uint8_t *texels, uint8_t *block);
+
+/**
+ * @brief encode the red and green channels of a 4x4 block of RGBA8 texels into a 16 bytes BC5 block
+ * meant for tangent space normal maps
+ *
+ */
+void encodeBlockBC5(const uint8_t *texels, uint8_t *block);
+
+/**
+ * @brief encode a 4x4 block of RGBA8 texels into a 16 bytes BC7 block
+ * only mode 6 (single subset, RGBA endpoints, 4 bits indices) is used
+ *
+ */
+void encodeBlockBC7(const uint8_t *texels, uint8_t *block);
@@ -0,0 +1,290 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include "engine/dds.hpp"
+
+#include "block_compression.hpp"
+
+/**
+ * @brief offline texture compressor
+ * converts source images into DDS containers holding a full chain of BC1/BC5/BC7 mips
+ * the output is written next to the input with the .dds extension, where ModelBuilder looks for it
+ *
+ * usage : texture_compressor [--format bc1|bc5|bc7] [--linear] [--no-flip] [--threads N] <image>...
+ *
+ */
+
+struct MipLevel
+{
+    uint32_t width;
+    uint32_t height;
+    std::vector<uint8_t> texels;
+};
+
+static float srgbToLinear(float value)
+{
+    return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+static float linearToSrgb(float value)
+{
+    return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.f / 2.4f) - 0.055f;
+}
+
+/**
+ * @brief 2x2 box filter, the color channels are averaged in linear space for sRGB textures
+ *
+ */
+static MipLevel downsample(const MipLevel &source, bool isSrgb)
+{
+    MipLevel result;
+    result.width = std::max(source.width / 2, 1U);
+    result.height = std::max(source.height / 2, 1U);
+    result.texels.resize((size_t)result.width * result.height * 4);
+
+    for (uint32_t y = 0; y < result.height; ++y)
+    {
+        for (uint32_t x = 0; x < result.width; ++x)
+        {
+            for (uint32_t c = 0; c < 4; ++c)
+            {
+                const bool isColor = isSrgb && c < 3;
+
+                float sum = 0.f;
+                for (uint32_t j = 0; j < 2; ++j)
+                {
+                    for (uint32_t i = 0; i < 2; ++i)
+                    {
+                        const uint32_t sx = std::min(x * 2 + i, source.width - 1);
+                        const uint32_t sy = std::min(y * 2 + j, source.height - 1);
+                        const float value = source.texels[((size_t)sy * source.width + sx) * 4 + c] / 255.f;
+                        sum += isColor ? srgbToLinear(value) : value;
+                    }
+                }
+
+                const float average = isColor ? linearToSrgb(sum / 4.f) : sum / 4.f;
+                result.texels[((size_t)y * result.width + x) * 4 + c] =
+                    (uint8_t)std::lround(std::clamp(average, 0.f, 1.f) * 255.f);
+            }
+        }
+    }
+
+    return result;
+}
+
+/**
+ * @brief encode every block of a mip level, block rows are distributed over the worker threads
+ *
+ */
+static std::vector<uint8_t> encodeLevel(const MipLevel &level, DXGIFormat format, uint32_t threadCount)
+{
+    const uint32_t blockCountX = (level.width + 3) / 4;
+    const uint32_t blockCountY = (level.height + 3) / 4;
+    const uint32_t blockSize = getDXGIFormatBlockSize(format);
+
+    std::function<void(const uint8_t *, uint8_t *)> encodeBlock;
+    switch (format)
+    {
+    case DXGIFormat::BC1_UNORM:
+    case DXGIFormat::BC1_UNORM_SRGB:
+        encodeBlock = encodeBlockBC1;
+        break;
+    case DXGIFormat::BC5_UNORM:
+        encodeBlock = encodeBlockBC5;
+        break;
+    default:
+        encodeBlock = encodeBlockBC7;
+        break;
+    }
+
+    std::vector<uint8_t> result((size_t)blockCountX * blockCountY * blockSize);
+
+    std::atomic<uint32_t> nextRow = 0;
+    auto worker = [&]() {
+        uint8_t texels[16 * 4];
+        for (uint32_t by = nextRow++; by < blockCountY; by = nextRow++)
+        {
+            for (uint32_t bx = 0; bx < blockCountX; ++bx)
+            {
+                // clamp to the edge for the partial blocks of non multiple of 4 extents
+                for (uint32_t j = 0; j < 4; ++j)
+                {
+                    for (uint32_t i = 0; i < 4; ++i)
+                    {
+                        const uint32_t x = std::min(bx * 4 + i, level.width - 1);
+                        const uint32_t y = std::min(by * 4 + j, level.height - 1);
+                        std::memcpy(&texels[(j * 4 + i) * 4], &level.texels[((size_t)y * level.width + x) * 4], 4);
+                    }
+                }
+
+                encodeBlock(texels, &result[((size_t)by * blockCountX + bx) * blockSize]);
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(threadCount);
+    for (uint32_t i = 0; i < threadCount; ++i)
+        threads.emplace_back(worker);
+    for (std::thread &thread : threads)
+        thread.join();
+
+    return result;
+}
+
+static bool writeDDS(const std::filesystem::path &path, DXGIFormat format, const std::vector<MipLevel> &levels,
+                     const std::vector<std::vector<uint8_t>> &blocks)
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    DDSHeader header = {
+        .size = sizeof(DDSHeader),
+        .flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE,
+        .height = levels[0].height,
+        .width = levels[0].width,
+        .pitchOrLinearSize = (uint32_t)blocks[0].size(),
+        .depth = 0,
+        .mipMapCount = (uint32_t)levels.size(),
+        .pixelFormat =
+            {
+                .size = sizeof(DDSPixelFormat),
+                .flags = DDPF_FOURCC,
+                .fourCC = makeFourCC('D', 'X', '1', '0'),
+            },
+        .caps = DDSCAPS_TEXTURE | DDSCAPS_MIPMAP | DDSCAPS_COMPLEX,
+    };
+    DDSHeaderDXT10 headerDXT10 = {
+        .dxgiFormat = format,
+        .resourceDimension = DDS_DIMENSION_TEXTURE2D,
+        .miscFlag = 0,
+        .arraySize = 1,
+        .miscFlags2 = 0,
+    };
+
+    file.write(reinterpret_cast<const char *>(&DDS_MAGIC), sizeof(DDS_MAGIC));
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(&headerDXT10), sizeof(headerDXT10));
+    for (const std::vector<uint8_t> &levelBlocks : blocks)
+        file.write(reinterpret_cast<const char *>(levelBlocks.data()), levelBlocks.size());
+
+    return file.good();
+}
+
+static bool compressTexture(const std::filesystem::path &inputPath, DXGIFormat format, bool flip,
+                            uint32_t threadCount)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // match the orientation of TextureBuilder which flips the images on load
+    stbi_set_flip_vertically_on_load(flip);
+
+    int width, height, channels;
+    stbi_uc *data = stbi_load(inputPath.string().c_str(), &width, &height, &channels, STBI_rgb_alpha);
+    if (!data)
+    {
+        std::cerr << "Failed to load texture : " << inputPath << std::endl;
+        return false;
+    }
+
+    std::vector<MipLevel> levels;
+    levels.push_back(MipLevel{
+        .width = (uint32_t)width,
+        .height = (uint32_t)height,
+        .texels = std::vector<uint8_t>(data, data + (size_t)width * height * 4),
+    });
+    stbi_image_free(data);
+
+    const bool isSrgb = format == DXGIFormat::BC1_UNORM_SRGB || format == DXGIFormat::BC7_UNORM_SRGB;
+    while (levels.back().width > 1 || levels.back().height > 1)
+        levels.push_back(downsample(levels.back(), isSrgb));
+
+    std::vector<std::vector<uint8_t>> blocks;
+    blocks.reserve(levels.size());
+    size_t compressedSize = 0;
+    for (const MipLevel &level : levels)
+    {
+        blocks.push_back(encodeLevel(level, format, threadCount));
+        compressedSize += blocks.back().size();
+    }
+
+    std::filesystem::path outputPath = inputPath;
+    outputPath.replace_extension(".dds");
+    if (!writeDDS(outputPath, format, levels, blocks))
+    {
+        std::cerr << "Failed to write compressed texture : " << outputPath << std::endl;
+        return false;
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << inputPath.string() << " -> " << outputPath.string() << " : " << width << "x" << height << ", "
+              << levels.size() << " mips, " << (size_t)width * height * 4 << " -> " << compressedSize << " bytes in "
+              << std::chrono::duration<float, std::milli>(end - start).count() << " ms" << std::endl;
+
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    std::string formatName = "bc7";
+    bool isLinear = false;
+    bool flip = true;
+    uint32_t threadCount = std::max(std::thread::hardware_concurrency(), 1U);
+    std::vector<std::filesystem::path> inputPaths;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--format" && i + 1 < argc)
+            formatName = argv[++i];
+        else if (arg == "--linear")
+            isLinear = true;
+        else if (arg == "--no-flip")
+            flip = false;
+        else if (arg == "--threads" && i + 1 < argc)
+            threadCount = std::max(std::stoi(argv[++i]), 1);
+        else
+            inputPaths.push_back(arg);
+    }
+
+    DXGIFormat format;
+    if (formatName == "bc1")
+        format = isLinear ? DXGIFormat::BC1_UNORM : DXGIFormat::BC1_UNORM_SRGB;
+    else if (formatName == "bc5")
+        format = DXGIFormat::BC5_UNORM;
+    else if (formatName == "bc7")
+        format = isLinear ? DXGIFormat::BC7_UNORM : DXGIFormat::BC7_UNORM_SRGB;
+    else
+        inputPaths.clear();
+
+    if (inputPaths.empty())
+    {
+        std::cerr << "Usage : texture_compressor [--format bc1|bc5|bc7] [--linear] [--no-flip] [--threads N] "
+                     "<image>..."
+                  << std::endl;
+        return 1;
+    }
+
+    int failureCount = 0;
+    for (const std::filesystem::path &inputPath : inputPaths)
+    {
+        if (!compressTexture(inputPath, format, flip, threadCount))
+            ++failureCount;
+    }
+
+    return failureCount == 0 ? 0 : 1;
+}